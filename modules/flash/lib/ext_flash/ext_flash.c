@@ -2,42 +2,130 @@
 
 #define MAX_SPI_BUFFER_SIZE 2100
 
-extern const flash_list_t flash_list[] = {
+const flash_list_t flash_list[] = {
     {"winbond w25n01gv", {0xEF, 0xAA, 0x21}}};
 
+#ifndef EXT_FLASH_NO_STATIC_BUF
 /* FIXME Find a better way to handle this without global buf */
 uint8_t spi_xfer_buf[MAX_SPI_BUFFER_SIZE];
 uint8_t spi_rcv_buf[MAX_SPI_BUFFER_SIZE];
+#endif
 
-int8_t flash_spi_transfer(flash_device_t* flash_dev,
-                          spi_transfer_t* spi_xfer_data)
+/* Opcode, address and dummy bytes, returns the header length */
+static uint16_t build_header(const spi_transfer_t* spi_xfer_data,
+                             uint8_t* hdr)
 {
     uint16_t len = 0;
-    int32_t status = FLASH_SUCCESS;
 
-    memset(spi_xfer_buf, 0, MAX_SPI_BUFFER_SIZE);
-    memset(spi_rcv_buf, 0, MAX_SPI_BUFFER_SIZE);
+    hdr[len++] = spi_xfer_data->opcode;
 
-    spi_xfer_buf[0] = spi_xfer_data->opcode;
-    len++;
-
-    
     if (spi_xfer_data->dummy_cyles_pos == 0)
     {
+        memset(hdr + len, 0, spi_xfer_data->dummy_cycles);
         len += spi_xfer_data->dummy_cycles;
     }
 
     if (spi_xfer_data->addr_len != 0)
     {
-        memcpy(spi_xfer_buf + len, spi_xfer_data->addr, spi_xfer_data->addr_len);
+        memcpy(hdr + len, spi_xfer_data->addr, spi_xfer_data->addr_len);
         len += spi_xfer_data->addr_len;
     }
 
     if (spi_xfer_data->dummy_cyles_pos == 1)
     {
+        memset(hdr + len, 0, spi_xfer_data->dummy_cycles);
         len += spi_xfer_data->dummy_cycles;
     }
 
+    return len;
+}
+
+#ifdef EXT_FLASH_NO_STATIC_BUF
+/*
+ * Stages a transfer in the caller's scratch arena for a plain spi_xfer hook:
+ * header plus tx data when there is tx data (a header only transfer goes
+ * out from the stack) and header plus rx data for what comes back.
+ */
+static int8_t stage_scratch(flash_device_t* flash_dev,
+                            const spi_transfer_t* spi_xfer_data,
+                            uint8_t* hdr, uint16_t* len, uint8_t** tx_buf,
+                            uint8_t** rx_buf, uint32_t* rx_len)
+{
+    uint32_t used = 0;
+
+    *tx_buf = hdr;
+    *rx_buf = NULL;
+    *rx_len = 0;
+
+    if (spi_xfer_data->tx_len != 0)
+    {
+        used = *len + spi_xfer_data->tx_len;
+    }
+    if (spi_xfer_data->rx_len != 0)
+    {
+        *rx_len = *len + spi_xfer_data->tx_len + spi_xfer_data->rx_len;
+    }
+
+    if ((flash_dev->scratch == NULL) ||
+        ((used + *rx_len) > flash_dev->scratch_len))
+    {
+        LOG_FLASH(ERROR, "Flash: %s, %d: scratch of %u B, %u B needed",
+                  __func__, __LINE__, flash_dev->scratch_len,
+                  used + *rx_len);
+        return FLASH_INVALID_PARAMS;
+    }
+
+    if (used != 0)
+    {
+        *tx_buf = flash_dev->scratch;
+        memcpy(*tx_buf, hdr, *len);
+        memcpy(*tx_buf + *len, spi_xfer_data->tx_buf, spi_xfer_data->tx_len);
+        *len = used;
+    }
+    if (*rx_len != 0)
+    {
+        *rx_buf = flash_dev->scratch + used;
+    }
+    return FLASH_SUCCESS;
+}
+#endif
+
+int8_t flash_spi_transfer(flash_device_t* flash_dev,
+                          spi_transfer_t* spi_xfer_data)
+{
+    uint16_t len = 0;
+    int32_t status = FLASH_SUCCESS;
+    uint8_t* rcv_buf;
+#ifdef EXT_FLASH_NO_STATIC_BUF
+    uint8_t hdr[EXT_FLASH_SPI_HDR_SIZE];
+    uint8_t* tx_buf;
+    uint32_t rx_len;
+
+    len = build_header(spi_xfer_data, hdr);
+
+    if (flash_dev->spi_xfer_seg != NULL)
+    {
+        /* Data phase straight from/to the caller, nothing to copy back */
+        rcv_buf = NULL;
+        status = flash_dev->spi_xfer_seg(hdr, len, spi_xfer_data->tx_buf,
+                                         spi_xfer_data->tx_len,
+                                         spi_xfer_data->rx_buf,
+                                         spi_xfer_data->rx_len);
+        len += spi_xfer_data->tx_len;
+    }
+    else
+    {
+        status = stage_scratch(flash_dev, spi_xfer_data, hdr, &len, &tx_buf,
+                               &rcv_buf, &rx_len);
+        if (status != FLASH_SUCCESS)
+        {
+            return status;
+        }
+        status = flash_dev->spi_xfer(tx_buf, len, rcv_buf, rx_len);
+    }
+#else
+    len = build_header(spi_xfer_data, spi_xfer_buf);
+
     if (spi_xfer_data->tx_len != 0)
     {
         memcpy(spi_xfer_buf + len, spi_xfer_data->tx_buf, spi_xfer_data->tx_len);
@@ -48,8 +136,10 @@ int8_t flash_spi_transfer(flash_device_t* flash_dev,
     NRF_LOG_HEXDUMP_DEBUG(spi_xfer_buf, len);
 
     /* Transfer SPI data and receive */
+    rcv_buf = spi_rcv_buf;
     status = flash_dev->spi_xfer(spi_xfer_buf, len, spi_rcv_buf,
                                  (len + spi_xfer_data->rx_len));
+#endif
     if (status != FLASH_SUCCESS)
     {
         LOG_FLASH(ERROR, "Flash: %s, %d: SPI Xfer failed!", __func__, __LINE__);
@@ -58,13 +148,16 @@ int8_t flash_spi_transfer(flash_device_t* flash_dev,
 
     while (spi_xfer_done == false);
 
+    FLASH_STATS_XFER(flash_dev, spi_xfer_data->opcode, len,
+                     spi_xfer_data->rx_len);
+
     spi_xfer_done = false;
 
-    if (spi_xfer_data->rx_len != 0)
+    if ((spi_xfer_data->rx_len != 0) && (rcv_buf != NULL))
     {
         NRF_LOG_DEBUG("rx_l: %d", spi_xfer_data->rx_len);
-        memcpy(spi_xfer_data->rx_buf, spi_rcv_buf + len, spi_xfer_data->rx_len);
-        NRF_LOG_HEXDUMP_DEBUG(spi_rcv_buf, len + spi_xfer_data->rx_len);
+        memcpy(spi_xfer_data->rx_buf, rcv_buf + len, spi_xfer_data->rx_len);
+        NRF_LOG_HEXDUMP_DEBUG(rcv_buf, len + spi_xfer_data->rx_len);
     }
 
     return FLASH_SUCCESS;
@@ -4,12 +4,24 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <string.h>
 
 //#define NRFX_LOG_MODULE EXT_FLASH
 #include <nrfx_log.h>
 
+#include "flash_stats.h"
+
 #define MAX_FLASH_ID_SZ 3U
 
+/* Opcode, address and dummy bytes of one command, at most */
+#define EXT_FLASH_SPI_HDR_SIZE  8U
+/*
+ * Scratch arena a plain spi_xfer hook needs with EXT_FLASH_NO_STATIC_BUF:
+ * one command header plus the largest data phase, a page with its spare.
+ */
+#define EXT_FLASH_SCRATCH_SIZE(page_size, spare_size) \
+    (EXT_FLASH_SPI_HDR_SIZE + (page_size) + (spare_size))
+
 #define ERROR   0
 #define INFO    1
 
@@ -59,11 +71,48 @@ typedef struct flash_device
     int32_t (*spi_xfer)(uint8_t* tx_buf, uint32_t tx_len, uint8_t* rx_buf,
                         uint32_t rx_len);
     void (*sleep)(uint32_t ms);
+    /*
+     * Busy wait of a number of microseconds, optional. Waits shorter than a
+     * millisecond are rounded up to a 1 ms sleep if NULL.
+     */
+    void (*delay_us)(uint32_t us);
     uint32_t flash_size;
     uint16_t num_of_pages_per_block;
     uint16_t num_of_blocks;
     uint16_t page_size;
     uint16_t num_ecc_bytes_per_page;
+    /* log2 of page_size and num_of_pages_per_block, filled in at init */
+    uint8_t page_shift;
+    uint8_t block_shift;
+    /* Called with the page number when a read needed ECC correction */
+    void (*ecc_corrected)(void* ctx, uint32_t page);
+    void* ecc_ctx;
+    /*
+     * Block protection mode (chip specific) set up at init, 0 leaves the
+     * array writable, and the protection register as last read or written.
+     */
+    uint8_t prot_init_mode;
+    uint8_t prot_reg;
+    /* Chip state tracked by the driver between commands, chip specific */
+    uint8_t dev_state;
+#ifdef EXT_FLASH_NO_STATIC_BUF
+    /*
+     * No driver buffers in this build. spi_xfer_seg, if set, clocks out hdr
+     * and then the data phase with chip select held, tx and rx data going
+     * straight to/from the caller buffers. Without it spi_xfer is used and
+     * transfers are staged in scratch, EXT_FLASH_SCRATCH_SIZE bytes.
+     */
+    int32_t (*spi_xfer_seg)(const uint8_t* hdr, uint32_t hdr_len,
+                            const uint8_t* tx_buf, uint32_t tx_len,
+                            uint8_t* rx_buf, uint32_t rx_len);
+    uint8_t* scratch;
+    uint32_t scratch_len;
+#endif
+#ifdef EXT_FLASH_STATS
+    /* Free running microsecond counter, optional. Latencies read 0 if NULL */
+    uint32_t (*time_us)(void);
+    flash_stats_t stats;
+#endif
 } flash_device_t;
 
 int8_t flash_spi_transfer(flash_device_t* flash_dev,
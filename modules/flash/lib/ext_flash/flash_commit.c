@@ -0,0 +1,522 @@
+#include "flash_commit.h"
+
+enum flash_commit_page_state
+{
+    PAGE_ERASED = 0,
+    PAGE_TAGGED,
+    PAGE_UNREADABLE
+};
+
+/* CRC-32 (IEEE, reflected), nibble table */
+static uint32_t crc32_update(uint32_t crc, const uint8_t* data, uint32_t len)
+{
+    static const uint32_t table[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC,
+        0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+        0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C};
+
+    crc = ~crc;
+    for (uint32_t i = 0; i < len; i++)
+    {
+        crc = table[(crc ^ data[i]) & 0x0F] ^ (crc >> 4);
+        crc = table[(crc ^ (data[i] >> 4)) & 0x0F] ^ (crc >> 4);
+    }
+    return ~crc;
+}
+
+static void put_le16(uint8_t* p, uint16_t val)
+{
+    p[0] = (uint8_t)val;
+    p[1] = (uint8_t)(val >> 8);
+}
+
+static void put_le32(uint8_t* p, uint32_t val)
+{
+    put_le16(p, (uint16_t)val);
+    put_le16(p + 2, (uint16_t)(val >> 16));
+}
+
+static uint16_t get_le16(const uint8_t* p)
+{
+    return (uint16_t)(p[0] | ((uint16_t)p[1] << 8));
+}
+
+static uint32_t get_le32(const uint8_t* p)
+{
+    return get_le16(p) | ((uint32_t)get_le16(p + 2) << 16);
+}
+
+/* Fixed little endian layout, crc last */
+static void tag_encode(const flash_commit_tag_t* tag, uint8_t* raw)
+{
+    put_le16(&raw[0], tag->magic);
+    raw[2] = tag->flags;
+    raw[3] = tag->reserved;
+    put_le32(&raw[4], tag->seq);
+    put_le16(&raw[8], tag->index);
+    put_le16(&raw[10], tag->len);
+    put_le32(&raw[12], tag->crc);
+}
+
+static void tag_decode(const uint8_t* raw, flash_commit_tag_t* tag)
+{
+    tag->magic = get_le16(&raw[0]);
+    tag->flags = raw[2];
+    tag->reserved = raw[3];
+    tag->seq = get_le32(&raw[4]);
+    tag->index = get_le16(&raw[8]);
+    tag->len = get_le16(&raw[10]);
+    tag->crc = get_le32(&raw[12]);
+}
+
+/* CRC over the payload and every tag byte but the crc itself */
+static uint32_t tag_crc(const uint8_t* raw, const uint8_t* data, uint32_t len)
+{
+    return crc32_update(crc32_update(0, data, len), raw,
+                        FLASH_COMMIT_TAG_SIZE - sizeof(uint32_t));
+}
+
+static uint32_t abs_page(const flash_commit_t* fc, uint32_t page)
+{
+    return (fc->cfg.first_block * fc->pages_per_block) + page;
+}
+
+static uint32_t next(const flash_commit_t* fc, uint32_t page)
+{
+    return (page + 1 == fc->region_pages) ? 0 : page + 1;
+}
+
+static uint32_t prev(const flash_commit_t* fc, uint32_t page)
+{
+    return (page == 0) ? fc->region_pages - 1 : page - 1;
+}
+
+/*
+ * Reads the tag, plus the payload into data when data is not NULL. A page
+ * whose spare reads all 0xFF counts as erased.
+ */
+static uint8_t read_tag(flash_commit_t* fc, uint32_t page,
+                        flash_commit_tag_t* tag, uint8_t* data,
+                        uint32_t data_len, uint8_t* raw)
+{
+    bool erased = true;
+
+    fc->counters.mount_page_reads++;
+    if (fc->cfg.page_read(fc->cfg.flash_dev, abs_page(fc, page), data,
+                          (data != NULL) ? data_len : 0, raw) != FLASH_SUCCESS)
+    {
+        return PAGE_UNREADABLE;
+    }
+
+    for (uint8_t i = 0; i < FLASH_COMMIT_TAG_SIZE; i++)
+    {
+        erased &= (raw[i] == 0xFF);
+    }
+    if (erased)
+    {
+        return PAGE_ERASED;
+    }
+
+    tag_decode(raw, tag);
+    if ((tag->magic != FLASH_COMMIT_MAGIC) || (tag->len > fc->page_size))
+    {
+        return PAGE_UNREADABLE;
+    }
+    return PAGE_TAGGED;
+}
+
+/* Reads the page and checks the payload against the tag CRC */
+static bool check_page(flash_commit_t* fc, uint32_t page,
+                       flash_commit_tag_t* tag, uint8_t* data)
+{
+    uint8_t raw[FLASH_COMMIT_TAG_SIZE];
+
+    if (read_tag(fc, page, tag, data, fc->page_size, raw) != PAGE_TAGGED)
+    {
+        return false;
+    }
+    return tag_crc(raw, data, tag->len) == tag->crc;
+}
+
+/*
+ * Walks back from the commit page at last over the pages of transaction seq,
+ * checking every CRC. Pages of other transactions in between (a block that
+ * could not be erased) are skipped, but never more than a block's worth.
+ */
+static bool check_transaction(flash_commit_t* fc, uint32_t last, uint32_t seq,
+                              uint16_t last_index)
+{
+    flash_commit_tag_t tag;
+    uint32_t page = last;
+    uint32_t expect = last_index;
+    uint32_t gap = 0;
+    uint32_t len = 0;
+
+    while (true)
+    {
+        if (check_page(fc, page, &tag, fc->cfg.page_buf) &&
+            (tag.seq == seq) && (tag.index == expect))
+        {
+            len += tag.len;
+            gap = 0;
+            if (expect == 0)
+            {
+                break;
+            }
+            expect--;
+        }
+        else if (++gap > fc->pages_per_block)
+        {
+            return false;
+        }
+        page = prev(fc, page);
+    }
+
+    fc->valid = true;
+    fc->seq = seq;
+    fc->first_page = page;
+    fc->last_page = last;
+    fc->num_pages = (uint32_t)last_index + 1;
+    fc->len = len;
+    return true;
+}
+
+/* Data and tag must read back all 0xFF */
+static bool page_blank(flash_commit_t* fc, uint32_t page)
+{
+    uint8_t raw[FLASH_COMMIT_TAG_SIZE];
+
+    if (fc->cfg.page_read(fc->cfg.flash_dev, abs_page(fc, page),
+                          fc->cfg.page_buf, fc->page_size, raw) !=
+        FLASH_SUCCESS)
+    {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < fc->page_size; i++)
+    {
+        if (fc->cfg.page_buf[i] != 0xFF)
+        {
+            return false;
+        }
+    }
+    for (uint8_t i = 0; i < FLASH_COMMIT_TAG_SIZE; i++)
+    {
+        if (raw[i] != 0xFF)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool in_committed(const flash_commit_t* fc, uint32_t page)
+{
+    uint32_t span;
+    uint32_t dist;
+
+    if (!fc->valid)
+    {
+        return false;
+    }
+    span = (fc->last_page + fc->region_pages - fc->first_page) %
+           fc->region_pages;
+    dist = (page + fc->region_pages - fc->first_page) % fc->region_pages;
+    return dist <= span;
+}
+
+static bool block_in_committed(const flash_commit_t* fc, uint32_t block)
+{
+    uint32_t first = block * fc->pages_per_block;
+    uint32_t last = first + fc->pages_per_block - 1;
+
+    /* The span is contiguous in log order: it covers first or starts inside */
+    return in_committed(fc, first) ||
+           ((fc->valid) && (fc->first_page >= first) &&
+            (fc->first_page <= last));
+}
+
+uint32_t flash_commit_max_len(const flash_commit_t* fc)
+{
+    /* Old and new transaction plus the block erased ahead must fit */
+    uint32_t pages = (fc->region_pages - (2 * fc->pages_per_block)) / 2;
+
+    return pages * fc->page_size;
+}
+
+int8_t flash_commit_mount(flash_commit_t* fc, const flash_commit_config_t* cfg)
+{
+    uint8_t raw[FLASH_COMMIT_TAG_SIZE];
+    flash_commit_tag_t tag;
+    uint32_t head_block = 0;
+    uint32_t head_seq = 0;
+    uint16_t head_index = 0;
+    uint32_t last_used = 0;
+    uint32_t scan_limit;
+    uint32_t page;
+    bool found = false;
+    uint8_t state;
+
+    if ((fc == NULL) || (cfg == NULL) || (cfg->flash_dev == NULL) ||
+        (cfg->page_program == NULL) || (cfg->page_read == NULL) ||
+        (cfg->erase == NULL) || (cfg->page_buf == NULL) ||
+        (cfg->num_blocks < 3) ||
+        ((cfg->first_block + cfg->num_blocks) > cfg->flash_dev->num_of_blocks))
+    {
+        return FLASH_INVALID_PARAMS;
+    }
+
+    memset(fc, 0, sizeof(flash_commit_t));
+    fc->cfg = *cfg;
+    fc->page_size = cfg->flash_dev->page_size;
+    fc->pages_per_block = cfg->flash_dev->num_of_pages_per_block;
+    fc->region_pages = cfg->num_blocks * fc->pages_per_block;
+
+    /*
+     * Head block: the one whose first page is newest. A transaction can span
+     * blocks, so ties on the sequence go to the higher page index.
+     */
+    for (uint32_t block = 0; block < cfg->num_blocks; block++)
+    {
+        state = read_tag(fc, block * fc->pages_per_block, &tag, NULL, 0, raw);
+        if ((state == PAGE_TAGGED) &&
+            (!found || (tag.seq > head_seq) ||
+             ((tag.seq == head_seq) && (tag.index > head_index))))
+        {
+            found = true;
+            head_seq = tag.seq;
+            head_index = tag.index;
+            head_block = block;
+        }
+    }
+
+    if (!found)
+    {
+        LOG_FLASH(INFO, "flash_commit: %s, %d: empty region", __func__,
+                  __LINE__);
+        return FLASH_SUCCESS;
+    }
+
+    /* Last programmed page of the head block and the newest sequence */
+    fc->last_seq = head_seq;
+    for (uint32_t i = 0; i < fc->pages_per_block; i++)
+    {
+        page = (head_block * fc->pages_per_block) + i;
+        state = read_tag(fc, page, &tag, NULL, 0, raw);
+        if (state == PAGE_ERASED)
+        {
+            continue;
+        }
+        if (state == PAGE_TAGGED)
+        {
+            if (tag.seq > fc->last_seq)
+            {
+                fc->last_seq = tag.seq;
+            }
+        }
+        else
+        {
+            fc->counters.torn_pages++;
+        }
+        last_used = page;
+    }
+
+    /*
+     * Newest commit marker whose transaction checks out. The current one ends
+     * at most a torn transaction, torn pages and a failed block behind.
+     */
+    scan_limit = (2 * (flash_commit_max_len(fc) / fc->page_size)) +
+                 (2 * fc->pages_per_block);
+    page = last_used;
+    for (uint32_t i = 0; (i < scan_limit) && !fc->valid; i++)
+    {
+        if ((read_tag(fc, page, &tag, NULL, 0, raw) == PAGE_TAGGED) &&
+            (tag.flags & FLASH_COMMIT_FLAG_COMMIT))
+        {
+            if (!check_transaction(fc, page, tag.seq, tag.index))
+            {
+                fc->counters.torn_pages++;
+            }
+        }
+        page = prev(fc, page);
+    }
+
+    /*
+     * A program cut early can leave a page that still reads as erased, so
+     * the first program after mount blank checks its page.
+     */
+    fc->next_page = next(fc, last_used);
+    fc->blank_check = true;
+
+    if (!fc->valid)
+    {
+        LOG_FLASH(INFO, "flash_commit: %s, %d: no committed transaction",
+                  __func__, __LINE__);
+    }
+    return FLASH_SUCCESS;
+}
+
+int8_t flash_commit_write(flash_commit_t* fc, const uint8_t* data,
+                          uint32_t len)
+{
+    uint8_t raw[FLASH_COMMIT_TAG_SIZE];
+    flash_commit_tag_t tag;
+    uint32_t num_pages;
+    uint32_t page = fc->next_page;
+    uint32_t first_page = 0;
+    uint32_t off = 0;
+    uint32_t block;
+    uint32_t attempts = 0;
+    uint32_t seq = fc->last_seq + 1;
+    int8_t status;
+
+    if ((data == NULL) || (len == 0) || (len > flash_commit_max_len(fc)))
+    {
+        return FLASH_INVALID_PARAMS;
+    }
+    num_pages = (len + fc->page_size - 1) / fc->page_size;
+
+    for (uint32_t i = 0; i < num_pages; attempts++)
+    {
+        if (attempts >= fc->region_pages)
+        {
+            return FLASH_MISC_FAILURE;
+        }
+
+        /* Erase ahead, never into the transaction that is still current */
+        if ((page % fc->pages_per_block) == 0)
+        {
+            block = page / fc->pages_per_block;
+            if (block_in_committed(fc, block))
+            {
+                LOG_FLASH(ERROR, "flash_commit: %s, %d: region full",
+                          __func__, __LINE__);
+                return FLASH_MISC_FAILURE;
+            }
+
+            status = fc->cfg.erase(
+                fc->cfg.flash_dev,
+                abs_page(fc, page) * fc->page_size,
+                fc->page_size * fc->pages_per_block);
+            if (status < FLASH_SUCCESS)
+            {
+                return status;
+            }
+            if (status != FLASH_SUCCESS)
+            {
+                fc->counters.erase_errors++;
+                page = (page + fc->pages_per_block) % fc->region_pages;
+                continue;
+            }
+            fc->counters.blocks_erased++;
+            fc->blank_check = false;
+        }
+        else if (fc->blank_check && !page_blank(fc, page))
+        {
+            fc->counters.torn_pages++;
+            page = next(fc, page);
+            continue;
+        }
+
+        memset(&tag, 0, sizeof(tag));
+        tag.magic = FLASH_COMMIT_MAGIC;
+        tag.flags = (i == (num_pages - 1)) ? FLASH_COMMIT_FLAG_COMMIT : 0;
+        tag.seq = seq;
+        tag.index = (uint16_t)i;
+        tag.len = (uint16_t)(((len - off) > fc->page_size) ? fc->page_size
+                                                            : (len - off));
+        tag_encode(&tag, raw);
+        tag.crc = tag_crc(raw, &data[off], tag.len);
+        tag_encode(&tag, raw);
+
+        status = fc->cfg.page_program(fc->cfg.flash_dev, abs_page(fc, page),
+                                      &data[off], tag.len, raw);
+        if (status < FLASH_SUCCESS)
+        {
+            return status;
+        }
+        if (status != FLASH_SUCCESS)
+        {
+            /*
+             * Leave the page behind, the next one takes the same index. Mount
+             * finds blocks by their first page, so losing that one leaves the
+             * whole block behind and the next one gets erased.
+             */
+            fc->counters.program_errors++;
+            if ((page % fc->pages_per_block) == 0)
+            {
+                page = (page + fc->pages_per_block) % fc->region_pages;
+            }
+            else
+            {
+                page = next(fc, page);
+            }
+            continue;
+        }
+
+        fc->blank_check = false;
+        fc->counters.pages_programmed++;
+        if (i == 0)
+        {
+            first_page = page;
+        }
+        off += tag.len;
+        i++;
+        fc->last_seq = seq;
+        fc->next_page = next(fc, page);
+        page = fc->next_page;
+    }
+
+    fc->valid = true;
+    fc->seq = seq;
+    fc->first_page = first_page;
+    fc->last_page = prev(fc, fc->next_page);
+    fc->num_pages = num_pages;
+    fc->len = len;
+    fc->counters.commits++;
+
+    return FLASH_SUCCESS;
+}
+
+int8_t flash_commit_read(flash_commit_t* fc, uint8_t* buf, uint32_t buf_len,
+                         uint32_t* len)
+{
+    flash_commit_tag_t tag;
+    uint32_t page = fc->first_page;
+    uint32_t off = 0;
+    uint32_t index = 0;
+
+    if (!fc->valid)
+    {
+        return FLASH_DETECT_FAIL;
+    }
+    if ((buf == NULL) || (buf_len < fc->len))
+    {
+        return FLASH_INVALID_PARAMS;
+    }
+
+    while (index < fc->num_pages)
+    {
+        if (check_page(fc, page, &tag, fc->cfg.page_buf) &&
+            (tag.seq == fc->seq) && (tag.index == index))
+        {
+            memcpy(&buf[off], fc->cfg.page_buf, tag.len);
+            off += tag.len;
+            index++;
+        }
+        else if (page == fc->last_page)
+        {
+            LOG_FLASH(ERROR, "flash_commit: %s, %d: transaction unreadable",
+                      __func__, __LINE__);
+            return FLASH_MISC_FAILURE;
+        }
+        page = next(fc, page);
+    }
+
+    if (len != NULL)
+    {
+        *len = off;
+    }
+    return FLASH_SUCCESS;
+}
@@ -0,0 +1,107 @@
+#ifndef __FLASH_COMMIT_H__
+#define __FLASH_COMMIT_H__
+
+#include "ext_flash.h"
+
+/*
+ * Power-fail safe blob store. Every write of the blob is a transaction of
+ * consecutive pages appended to a dedicated log of blocks. Each page carries
+ * a tag in the ECC protected spare bytes: transaction sequence number, page
+ * index, payload length and a CRC over payload and tag. The last page of a
+ * transaction has the commit flag set and is programmed last, so the commit
+ * marker costs no extra page.
+ *
+ * At mount the log head is found from the first page of every block plus a
+ * scan of the head block, then the newest transaction whose commit page and
+ * pages all check out is taken. Tag reads are bounded by num_blocks +
+ * pages_per_block + 2 * (largest transaction + one block), plus one CRC pass
+ * per candidate transaction. A torn transaction is simply ignored and the
+ * previous one stays current.
+ */
+
+#define FLASH_COMMIT_TAG_SIZE       16U
+#define FLASH_COMMIT_MAGIC          (0xC0A7)
+#define FLASH_COMMIT_FLAG_COMMIT    (0x01)
+
+typedef struct flash_commit_tag
+{
+    uint16_t magic;
+    uint8_t flags;
+    uint8_t reserved;
+    uint32_t seq;
+    uint16_t index;
+    uint16_t len;
+    uint32_t crc;
+} flash_commit_tag_t;
+
+typedef struct flash_commit_config
+{
+    flash_device_t* flash_dev;
+    /* Page access with FLASH_COMMIT_TAG_SIZE bytes of ECC protected spare */
+    int8_t (*page_program)(flash_device_t* flash_dev, uint32_t page,
+                           const uint8_t* data, uint32_t len,
+                           const uint8_t* spare);
+    int8_t (*page_read)(flash_device_t* flash_dev, uint32_t page,
+                        uint8_t* data, uint32_t len, uint8_t* spare);
+    int8_t (*erase)(flash_device_t* flash_dev, uint32_t addr,
+                    uint32_t erase_len);
+    /* Log region in blocks, at least 3 */
+    uint32_t first_block;
+    uint32_t num_blocks;
+    /* Page sized scratch buffer used to check CRCs at mount */
+    uint8_t* page_buf;
+} flash_commit_config_t;
+
+typedef struct flash_commit_counters
+{
+    uint32_t mount_page_reads;
+    uint32_t torn_pages;
+    uint32_t commits;
+    uint32_t pages_programmed;
+    uint32_t blocks_erased;
+    uint32_t erase_errors;
+    uint32_t program_errors;
+} flash_commit_counters_t;
+
+typedef struct flash_commit
+{
+    flash_commit_config_t cfg;
+    uint32_t page_size;
+    uint32_t pages_per_block;
+    uint32_t region_pages;
+    /* Next page to program, relative to the region */
+    uint32_t next_page;
+    /* Set at mount until the first page is programmed or a block erased */
+    bool blank_check;
+    /* Highest sequence number seen, committed or not */
+    uint32_t last_seq;
+    /* Current committed transaction */
+    bool valid;
+    uint32_t seq;
+    uint32_t first_page;
+    uint32_t last_page;
+    uint32_t num_pages;
+    uint32_t len;
+    flash_commit_counters_t counters;
+} flash_commit_t;
+
+/* Scans the region and recovers the last committed transaction */
+int8_t flash_commit_mount(flash_commit_t* fc, const flash_commit_config_t* cfg);
+/*
+ * Writes len bytes as a new transaction, all or nothing across power loss.
+ * Pages or blocks the driver reports as failed (positive media codes) are
+ * skipped, a failed first page skips its whole block; bus errors and
+ * timeouts (negative codes) abort the transaction.
+ */
+int8_t flash_commit_write(flash_commit_t* fc, const uint8_t* data,
+                          uint32_t len);
+/*
+ * Copies the committed blob into buf. FLASH_DETECT_FAIL if nothing was ever
+ * committed, FLASH_INVALID_PARAMS if buf_len is too small.
+ */
+int8_t flash_commit_read(flash_commit_t* fc, uint8_t* buf, uint32_t buf_len,
+                         uint32_t* len);
+/* Largest blob a single transaction can hold */
+uint32_t flash_commit_max_len(const flash_commit_t* fc);
+
+#endif
@@ -0,0 +1,244 @@
+#include "flash_gc.h"
+
+/* Block of an absolute page, relative to first_block, num_blocks if outside */
+static uint32_t page_block(const flash_gc_t* gc, uint32_t page)
+{
+    uint32_t block = (page >> gc->cfg.flash_dev->block_shift) -
+                     gc->cfg.first_block;
+
+    return (block < gc->cfg.num_blocks) ? block : gc->cfg.num_blocks;
+}
+
+static uint32_t cost_avg(uint32_t avg, uint32_t sample)
+{
+    return (avg == 0) ? sample : (avg - (avg >> 3) + (sample >> 3));
+}
+
+static uint32_t pick_victim(flash_gc_t* gc)
+{
+    uint32_t victim = FLASH_GC_NO_VICTIM;
+    uint64_t best = 0;
+    uint64_t score;
+    uint32_t valid;
+
+    for (uint32_t b = 0; b < gc->cfg.num_blocks; b++)
+    {
+        valid = gc->cfg.valid[b];
+        if ((gc->cfg.stamp[b] == 0) || (valid >= gc->pages_per_block))
+        {
+            continue;
+        }
+
+        score = ((uint64_t)(gc->pages_per_block - valid) *
+                 (gc->seq - gc->cfg.stamp[b] + 1)) /
+                (gc->pages_per_block + valid);
+        if ((victim == FLASH_GC_NO_VICTIM) || (score > best) ||
+            ((score == best) && (valid < gc->cfg.valid[victim])))
+        {
+            victim = b;
+            best = score;
+        }
+    }
+
+    return victim;
+}
+
+int8_t flash_gc_init(flash_gc_t* gc, const flash_gc_config_t* cfg)
+{
+    if ((gc == NULL) || (cfg == NULL) || (cfg->flash_dev == NULL) ||
+        (cfg->erase == NULL) || (cfg->page_valid == NULL) ||
+        (cfg->move_page == NULL) || (cfg->block_free == NULL) ||
+        (cfg->time_us == NULL) || (cfg->valid == NULL) ||
+        (cfg->stamp == NULL) || (cfg->num_blocks == 0))
+    {
+        return FLASH_INVALID_PARAMS;
+    }
+
+    memset(gc, 0, sizeof(*gc));
+    gc->cfg = *cfg;
+    gc->pages_per_block = 1UL << cfg->flash_dev->block_shift;
+    gc->block_size = 1UL << (cfg->flash_dev->page_shift +
+                             cfg->flash_dev->block_shift);
+    gc->victim = FLASH_GC_NO_VICTIM;
+    gc->move_avg_us = cfg->move_us;
+    gc->erase_avg_us = cfg->erase_us;
+
+    memset(cfg->valid, 0, cfg->num_blocks * sizeof(cfg->valid[0]));
+    memset(cfg->stamp, 0, cfg->num_blocks * sizeof(cfg->stamp[0]));
+
+    return FLASH_SUCCESS;
+}
+
+void flash_gc_page_written(flash_gc_t* gc, uint32_t page)
+{
+    uint32_t block = page_block(gc, page);
+
+    if (block < gc->cfg.num_blocks)
+    {
+        gc->cfg.valid[block]++;
+    }
+
+    if (gc->moving)
+    {
+        gc->counters.gc_pages++;
+    }
+    else
+    {
+        gc->counters.host_pages++;
+    }
+}
+
+void flash_gc_page_invalidated(flash_gc_t* gc, uint32_t page)
+{
+    uint32_t block = page_block(gc, page);
+
+    if ((block < gc->cfg.num_blocks) && (gc->cfg.valid[block] != 0))
+    {
+        gc->cfg.valid[block]--;
+    }
+}
+
+void flash_gc_block_closed(flash_gc_t* gc, uint32_t block)
+{
+    block -= gc->cfg.first_block;
+    if (block < gc->cfg.num_blocks)
+    {
+        gc->cfg.stamp[block] = ++gc->seq;
+    }
+}
+
+int8_t flash_gc_run(flash_gc_t* gc, uint32_t budget_us, uint32_t* blocks)
+{
+    uint32_t start = gc->cfg.time_us();
+    uint32_t elapsed;
+    uint32_t op_start;
+    uint32_t reclaimed = 0;
+    uint32_t page;
+    uint32_t block;
+    int8_t status = FLASH_SUCCESS;
+
+    gc->counters.runs++;
+
+    while (status == FLASH_SUCCESS)
+    {
+        elapsed = gc->cfg.time_us() - start;
+
+        if (gc->victim == FLASH_GC_NO_VICTIM)
+        {
+            gc->victim = pick_victim(gc);
+            gc->cursor = 0;
+            if (gc->victim == FLASH_GC_NO_VICTIM)
+            {
+                gc->counters.no_victim++;
+                break;
+            }
+        }
+
+        block = gc->cfg.first_block + gc->victim;
+
+        if (gc->cursor < gc->pages_per_block)
+        {
+            page = (block << gc->cfg.flash_dev->block_shift) + gc->cursor;
+            if (!gc->cfg.page_valid(gc->cfg.ctx, page))
+            {
+                gc->cursor++;
+                gc->counters.pages_scanned++;
+                continue;
+            }
+
+            if ((budget_us != 0) && ((elapsed + gc->move_avg_us) > budget_us))
+            {
+                break;
+            }
+
+            op_start = gc->cfg.time_us();
+            gc->moving = true;
+            status = gc->cfg.move_page(gc->cfg.ctx, page);
+            gc->moving = false;
+            gc->move_avg_us = cost_avg(gc->move_avg_us,
+                                       gc->cfg.time_us() - op_start);
+            if (status != FLASH_SUCCESS)
+            {
+                LOG_FLASH(ERROR, "flash_gc: %s, %d: move of page %u failed",
+                          __func__, __LINE__, page);
+                break;
+            }
+            gc->cursor++;
+            gc->counters.pages_scanned++;
+            gc->counters.pages_moved++;
+            continue;
+        }
+
+        if (gc->cfg.valid[gc->victim] != 0)
+        {
+            /* Moves did not invalidate the old copies, leave the block */
+            LOG_FLASH(ERROR, "flash_gc: %s, %d: block %u still has %u "
+                             "valid pages", __func__, __LINE__, block,
+                      gc->cfg.valid[gc->victim]);
+            gc->victim = FLASH_GC_NO_VICTIM;
+            status = FLASH_MISC_FAILURE;
+            break;
+        }
+
+        if ((budget_us != 0) && ((elapsed + gc->erase_avg_us) > budget_us))
+        {
+            break;
+        }
+
+        op_start = gc->cfg.time_us();
+        status = gc->cfg.erase(gc->cfg.flash_dev, block * gc->block_size,
+                               gc->block_size);
+        gc->erase_avg_us = cost_avg(gc->erase_avg_us,
+                                    gc->cfg.time_us() - op_start);
+        if (status < FLASH_SUCCESS)
+        {
+            break;
+        }
+
+        gc->cfg.stamp[gc->victim] = 0;
+        gc->victim = FLASH_GC_NO_VICTIM;
+        if (status != FLASH_SUCCESS)
+        {
+            /* Worn out, the block is retired and never handed back */
+            LOG_FLASH(ERROR, "flash_gc: %s, %d: erase of block %u failed",
+                      __func__, __LINE__, block);
+            gc->counters.erase_errors++;
+            status = FLASH_SUCCESS;
+            continue;
+        }
+
+        gc->counters.blocks_reclaimed++;
+        reclaimed++;
+        gc->cfg.block_free(gc->cfg.ctx, block);
+        break;
+    }
+
+    elapsed = gc->cfg.time_us() - start;
+    if (elapsed > gc->counters.max_run_us)
+    {
+        gc->counters.max_run_us = elapsed;
+    }
+    if ((budget_us != 0) && (elapsed > budget_us))
+    {
+        gc->counters.budget_overruns++;
+    }
+
+    if (blocks != NULL)
+    {
+        *blocks = reclaimed;
+    }
+
+    return status;
+}
+
+uint32_t flash_gc_write_amp(const flash_gc_t* gc)
+{
+    if (gc->counters.host_pages == 0)
+    {
+        return 100;
+    }
+
+    return (uint32_t)(((uint64_t)(gc->counters.host_pages +
+                                  gc->counters.gc_pages) * 100) /
+                      gc->counters.host_pages);
+}
@@ -0,0 +1,101 @@
+#ifndef __FLASH_GC_H__
+#define __FLASH_GC_H__
+
+#include "ext_flash.h"
+
+/*
+ * Incremental garbage collector for storage layers that write out of place
+ * (FTL, log, key-value store). Compacting a whole block at once costs up to
+ * 64 page moves plus an erase, hundreds of milliseconds in one go. Here the
+ * work is cut into single page moves and erases and flash_gc_run() does as
+ * many as fit in the time budget it is given, picking up where it stopped
+ * on the next call.
+ *
+ * The owner keeps its own mapping and tells the collector about it:
+ * pages written and invalidated, and blocks closed once full. In return the
+ * collector asks it whether a page is still live, to move a live page to
+ * its write frontier and takes the block back through block_free once it is
+ * erased. A move has to call flash_gc_page_written() for the new copy and
+ * flash_gc_page_invalidated() for the old one like any other write.
+ *
+ * Victims are picked by cost-benefit: free space gained times age, over the
+ * cost of copying out the live pages, (invalid * age) / (pages + valid).
+ * Cold blocks that are mostly stale go first, hot blocks get time to
+ * invalidate more of their pages before they are worth copying.
+ */
+
+typedef struct flash_gc_config
+{
+    flash_device_t* flash_dev;
+    int8_t (*erase)(flash_device_t* flash_dev, uint32_t addr,
+                    uint32_t erase_len);
+    /* Owner callbacks, page and block numbers are absolute */
+    bool (*page_valid)(void* ctx, uint32_t page);
+    int8_t (*move_page)(void* ctx, uint32_t page);
+    void (*block_free)(void* ctx, uint32_t block);
+    void* ctx;
+    /* Free running microsecond clock the budget is measured on */
+    uint32_t (*time_us)(void);
+    /* Blocks managed */
+    uint32_t first_block;
+    uint32_t num_blocks;
+    /* Per block storage, num_blocks entries each */
+    uint16_t* valid;
+    uint32_t* stamp;
+    /* Initial cost guesses in us, refined as operations are timed */
+    uint32_t move_us;
+    uint32_t erase_us;
+} flash_gc_config_t;
+
+typedef struct flash_gc_counters
+{
+    uint32_t runs;
+    uint32_t pages_scanned;
+    uint32_t pages_moved;
+    uint32_t blocks_reclaimed;
+    uint32_t erase_errors;
+    uint32_t no_victim;
+    /* Runs that went over budget because an operation took longer */
+    uint32_t budget_overruns;
+    uint32_t max_run_us;
+    /* Pages written by the owner on its own and by moves */
+    uint32_t host_pages;
+    uint32_t gc_pages;
+} flash_gc_counters_t;
+
+typedef struct flash_gc
+{
+    flash_gc_config_t cfg;
+    uint32_t pages_per_block;
+    uint32_t block_size;
+    /* Close sequence, stamp of a block is the value when it was closed */
+    uint32_t seq;
+    /* Block being collected, relative to first_block, and next page in it */
+    uint32_t victim;
+    uint32_t cursor;
+    bool moving;
+    /* Running average cost of one move and one erase in us */
+    uint32_t move_avg_us;
+    uint32_t erase_avg_us;
+    flash_gc_counters_t counters;
+} flash_gc_t;
+
+#define FLASH_GC_NO_VICTIM      UINT32_MAX
+
+/* Starts with every block free, valid counts zero */
+int8_t flash_gc_init(flash_gc_t* gc, const flash_gc_config_t* cfg);
+void flash_gc_page_written(flash_gc_t* gc, uint32_t page);
+void flash_gc_page_invalidated(flash_gc_t* gc, uint32_t page);
+/* The block is full and may be collected from now on */
+void flash_gc_block_closed(flash_gc_t* gc, uint32_t block);
+/*
+ * Works until one block is reclaimed or budget_us is spent, 0 meaning no
+ * time limit. An operation is only started when its average cost fits in
+ * what is left of the budget, so a run may do nothing. blocks gets the
+ * number of blocks handed back through block_free and may be NULL.
+ */
+int8_t flash_gc_run(flash_gc_t* gc, uint32_t budget_us, uint32_t* blocks);
+/* GC write amplification, (host + gc pages) / host pages, times 100 */
+uint32_t flash_gc_write_amp(const flash_gc_t* gc);
+
+#endif
@@ -0,0 +1,142 @@
+#include "flash_scrub.h"
+
+/* Same codes as the W25N01GV status register ECC field */
+#define SCRUB_ECC_CLEAN         0U
+#define SCRUB_ECC_CORRECTED     1U
+
+#ifndef FLASH_SCRUB_BARRIER
+#define FLASH_SCRUB_BARRIER()   __sync_synchronize()
+#endif
+
+static int8_t check_page(flash_scrub_t* scrub, uint32_t page)
+{
+    uint8_t ecc;
+    int8_t status;
+
+    status = scrub->cfg.page_check(scrub->cfg.flash_dev, page, &ecc);
+    if (status != FLASH_SUCCESS)
+    {
+        return status;
+    }
+    scrub->counters.pages_checked++;
+
+    if (ecc == SCRUB_ECC_CLEAN)
+    {
+        return FLASH_SUCCESS;
+    }
+
+    if (ecc == SCRUB_ECC_CORRECTED)
+    {
+        scrub->counters.corrected++;
+    }
+    else
+    {
+        scrub->counters.uncorrectable++;
+    }
+
+    scrub->busy_page = page;
+    status = scrub->cfg.relocate(scrub->cfg.ctx, page,
+                                 (ecc != SCRUB_ECC_CORRECTED));
+    scrub->busy_page = UINT32_MAX;
+    scrub->counters.relocations++;
+    if (status != FLASH_SUCCESS)
+    {
+        /* Stays where it is, the next pass or read will report it again */
+        LOG_FLASH(ERROR, "flash_scrub: %s, %d: relocate of page %u failed: %d",
+                  __func__, __LINE__, page, status);
+        scrub->counters.relocate_errors++;
+    }
+
+    return FLASH_SUCCESS;
+}
+
+int8_t flash_scrub_init(flash_scrub_t* scrub, const flash_scrub_config_t* cfg)
+{
+    if ((scrub == NULL) || (cfg == NULL) || (cfg->flash_dev == NULL) ||
+        (cfg->page_check == NULL) || (cfg->relocate == NULL) ||
+        (cfg->queue == NULL) || (cfg->queue_size == 0) ||
+        ((cfg->queue_size & (cfg->queue_size - 1)) != 0) ||
+        (cfg->num_pages == 0))
+    {
+        return FLASH_INVALID_PARAMS;
+    }
+
+    memset(scrub, 0, sizeof(*scrub));
+    scrub->cfg = *cfg;
+    scrub->busy_page = UINT32_MAX;
+
+    cfg->flash_dev->ecc_ctx = scrub;
+    cfg->flash_dev->ecc_corrected = flash_scrub_note;
+
+    return FLASH_SUCCESS;
+}
+
+void flash_scrub_note(void* ctx, uint32_t page)
+{
+    flash_scrub_t* scrub = ctx;
+    uint32_t head = scrub->head;
+
+    if (page == scrub->busy_page)
+    {
+        return;
+    }
+
+    if ((head - scrub->tail) >= scrub->cfg.queue_size)
+    {
+        /* The patrol gets to it eventually */
+        scrub->counters.queue_drops++;
+        return;
+    }
+
+    scrub->cfg.queue[head & (scrub->cfg.queue_size - 1)] = page;
+    FLASH_SCRUB_BARRIER();
+    scrub->head = head + 1;
+    scrub->counters.queued++;
+}
+
+int8_t flash_scrub_step(flash_scrub_t* scrub, uint32_t max_checks,
+                        uint32_t* checks)
+{
+    uint32_t done = 0;
+    uint32_t page;
+    int8_t status = FLASH_SUCCESS;
+
+    while ((done < max_checks) && (scrub->tail != scrub->head))
+    {
+        FLASH_SCRUB_BARRIER();
+        page = scrub->cfg.queue[scrub->tail & (scrub->cfg.queue_size - 1)];
+        scrub->tail++;
+
+        status = check_page(scrub, page);
+        if (status != FLASH_SUCCESS)
+        {
+            break;
+        }
+        done++;
+    }
+
+    while ((status == FLASH_SUCCESS) && (done < max_checks))
+    {
+        page = scrub->cfg.first_page + scrub->cursor;
+
+        status = check_page(scrub, page);
+        if (status != FLASH_SUCCESS)
+        {
+            break;
+        }
+        done++;
+
+        if (++scrub->cursor == scrub->cfg.num_pages)
+        {
+            scrub->cursor = 0;
+            scrub->counters.passes++;
+        }
+    }
+
+    if (checks != NULL)
+    {
+        *checks = done;
+    }
+
+    return status;
+}
@@ -0,0 +1,80 @@
+#ifndef __FLASH_SCRUB_H__
+#define __FLASH_SCRUB_H__
+
+#include "ext_flash.h"
+
+/*
+ * Background ECC scrubber. A page that needed ECC correction is still good
+ * but on its way out; moving it now costs one page copy, waiting until it
+ * is uncorrectable costs the data. Two sources feed the scrubber:
+ *  - reads in the hot path, through the flash_device_t ecc_corrected hook,
+ *    which only queue the page number
+ *  - a patrol that walks the region a few pages at a time, loading each
+ *    page into the chip buffer and reading back only its ECC status
+ *
+ * flash_scrub_step() is meant for the idle loop. Queued pages are checked
+ * again and, if they still need correction, handed to the relocate callback
+ * together with the pages the patrol finds. The scrubber does not know which
+ * pages hold live data: relocate gets called for stale pages too and should
+ * just return FLASH_SUCCESS for those.
+ */
+
+typedef struct flash_scrub_config
+{
+    flash_device_t* flash_dev;
+    /* Loads a page and reports its ECC code, e.g. w25n01gv_page_check */
+    int8_t (*page_check)(flash_device_t* flash_dev, uint32_t page,
+                         uint8_t* ecc);
+    /*
+     * Moves the data of page somewhere else. uncorrectable is set when the
+     * page could not be corrected, so the owner has to recover it another
+     * way or drop it.
+     */
+    int8_t (*relocate)(void* ctx, uint32_t page, bool uncorrectable);
+    void* ctx;
+    /* Pages to patrol */
+    uint32_t first_page;
+    uint32_t num_pages;
+    /* Queue of pages reported by reads, power of two entries */
+    uint32_t* queue;
+    uint32_t queue_size;
+} flash_scrub_config_t;
+
+typedef struct flash_scrub_counters
+{
+    uint32_t pages_checked;
+    uint32_t passes;
+    uint32_t queued;
+    uint32_t queue_drops;
+    uint32_t corrected;
+    uint32_t uncorrectable;
+    uint32_t relocations;
+    uint32_t relocate_errors;
+} flash_scrub_counters_t;
+
+typedef struct flash_scrub
+{
+    flash_scrub_config_t cfg;
+    /* Free running queue indices, head written by the hook, tail by step */
+    volatile uint32_t head;
+    volatile uint32_t tail;
+    /* Next patrol page, relative to first_page */
+    uint32_t cursor;
+    /* Page being relocated, its own reads are not queued again */
+    uint32_t busy_page;
+    flash_scrub_counters_t counters;
+} flash_scrub_t;
+
+/* Installs the scrubber as the ecc_corrected hook of cfg->flash_dev */
+int8_t flash_scrub_init(flash_scrub_t* scrub, const flash_scrub_config_t* cfg);
+/* ecc_corrected hook, ctx is the scrubber */
+void flash_scrub_note(void* ctx, uint32_t page);
+/*
+ * Checks up to max_checks pages, queued ones first, then the patrol. Each
+ * check is one page load and a status read, plus a relocation when needed.
+ * The number done goes to checks, which may be NULL.
+ */
+int8_t flash_scrub_step(flash_scrub_t* scrub, uint32_t max_checks,
+                        uint32_t* checks);
+
+#endif
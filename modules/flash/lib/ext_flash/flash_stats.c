@@ -0,0 +1,177 @@
+#include "ext_flash.h"
+
+#ifdef EXT_FLASH_STATS
+
+static const char* const op_names[FLASH_STATS_OP_MAX] = {"read", "program",
+                                                         "erase"};
+
+static uint8_t hist_bucket(uint32_t us)
+{
+    uint8_t bucket = 0;
+
+    while ((us != 0) && (bucket < (FLASH_STATS_HIST_BUCKETS - 1)))
+    {
+        us >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+uint32_t flash_stats_now(flash_device_t* flash_dev)
+{
+    if (flash_dev->time_us == NULL)
+    {
+        return 0;
+    }
+    return flash_dev->time_us();
+}
+
+void flash_stats_reset(flash_device_t* flash_dev)
+{
+    memset(&flash_dev->stats, 0, sizeof(flash_stats_t));
+    flash_dev->stats.cur_op = FLASH_STATS_OP_NONE;
+}
+
+void flash_stats_xfer(flash_device_t* flash_dev, uint8_t opcode,
+                      uint32_t tx_len, uint32_t rx_len)
+{
+    flash_stats_t* stats = &flash_dev->stats;
+    flash_opcode_stats_t* entry = NULL;
+
+    for (uint8_t i = 0; i < stats->num_opcodes; i++)
+    {
+        if (stats->opcodes[i].opcode == opcode)
+        {
+            entry = &stats->opcodes[i];
+            break;
+        }
+    }
+
+    if (entry == NULL)
+    {
+        if (stats->num_opcodes == FLASH_STATS_MAX_OPCODES)
+        {
+            stats->opcode_overflow++;
+            return;
+        }
+        entry = &stats->opcodes[stats->num_opcodes++];
+        entry->opcode = opcode;
+    }
+
+    entry->xfers++;
+    entry->tx_bytes += tx_len;
+    entry->rx_bytes += rx_len;
+}
+
+void flash_stats_status_poll(flash_device_t* flash_dev)
+{
+    flash_dev->stats.status_polls++;
+    flash_dev->stats.cur_op_polls++;
+}
+
+void flash_stats_op_begin(flash_device_t* flash_dev, uint8_t op)
+{
+    flash_dev->stats.cur_op = op;
+    flash_dev->stats.cur_op_polls = 0;
+    flash_dev->stats.cur_op_start_us = flash_stats_now(flash_dev);
+}
+
+void flash_stats_op_end(flash_device_t* flash_dev)
+{
+    flash_stats_t* stats = &flash_dev->stats;
+    flash_op_stats_t* op;
+    uint32_t elapsed;
+
+    if (stats->cur_op >= FLASH_STATS_OP_MAX)
+    {
+        return;
+    }
+
+    op = &stats->ops[stats->cur_op];
+    elapsed = flash_stats_now(flash_dev) - stats->cur_op_start_us;
+
+    op->count++;
+    op->status_polls += stats->cur_op_polls;
+    op->total_us += elapsed;
+    if (elapsed > op->max_us)
+    {
+        op->max_us = elapsed;
+    }
+    op->hist[hist_bucket(elapsed)]++;
+
+    stats->cur_op = FLASH_STATS_OP_NONE;
+}
+
+void flash_stats_busy_wait(flash_device_t* flash_dev, uint32_t start_us)
+{
+    flash_dev->stats.busy_waits++;
+    flash_dev->stats.busy_wait_us += flash_stats_now(flash_dev) - start_us;
+}
+
+void flash_stats_ecc(flash_device_t* flash_dev, bool corrected, bool failed)
+{
+    if (corrected)
+    {
+        flash_dev->stats.ecc_corrected_pages++;
+    }
+    if (failed)
+    {
+        flash_dev->stats.ecc_failed_pages++;
+    }
+}
+
+void flash_stats_dump(flash_device_t* flash_dev)
+{
+    flash_stats_t* stats = &flash_dev->stats;
+
+    LOG_FLASH(INFO, "Flash stats: status polls %u, busy waits %u (%u us)",
+              stats->status_polls, stats->busy_waits,
+              (uint32_t)stats->busy_wait_us);
+    LOG_FLASH(INFO, "Flash stats: ECC corrected pages %u, failed pages %u",
+              stats->ecc_corrected_pages, stats->ecc_failed_pages);
+
+    for (uint8_t i = 0; i < stats->num_opcodes; i++)
+    {
+        LOG_FLASH(INFO, "  opcode 0x%02X: xfers %u, tx %u B, rx %u B",
+                  stats->opcodes[i].opcode, stats->opcodes[i].xfers,
+                  stats->opcodes[i].tx_bytes, stats->opcodes[i].rx_bytes);
+    }
+    if (stats->opcode_overflow != 0)
+    {
+        LOG_FLASH(INFO, "  untracked opcode xfers %u", stats->opcode_overflow);
+    }
+
+    for (uint8_t op = 0; op < FLASH_STATS_OP_MAX; op++)
+    {
+        flash_op_stats_t* op_stats = &stats->ops[op];
+
+        if (op_stats->count == 0)
+        {
+            continue;
+        }
+
+        LOG_FLASH(INFO, "  %s: count %u, avg %u us, max %u us, polls %u",
+                  op_names[op], op_stats->count,
+                  (uint32_t)(op_stats->total_us / op_stats->count),
+                  op_stats->max_us, op_stats->status_polls);
+
+        for (uint8_t b = 0; b < FLASH_STATS_HIST_BUCKETS; b++)
+        {
+            if (op_stats->hist[b] != 0)
+            {
+                if (b == (FLASH_STATS_HIST_BUCKETS - 1))
+                {
+                    LOG_FLASH(INFO, "    >= %u us: %u", (1U << (b - 1)),
+                              op_stats->hist[b]);
+                }
+                else
+                {
+                    LOG_FLASH(INFO, "    < %u us: %u", (1U << b),
+                              op_stats->hist[b]);
+                }
+            }
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,102 @@
+#ifndef __FLASH_STATS_H__
+#define __FLASH_STATS_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Optional flash instrumentation. Build with EXT_FLASH_STATS defined to get a
+ * stats block in every flash_device_t, otherwise all the hooks below compile
+ * to nothing.
+ */
+
+#define FLASH_STATS_MAX_OPCODES     16U
+/* Bucket 0 is < 1us, bucket n holds [2^(n-1), 2^n) us, last one is open */
+#define FLASH_STATS_HIST_BUCKETS    24U
+
+enum flash_stats_op
+{
+    FLASH_STATS_OP_READ = 0,
+    FLASH_STATS_OP_PROGRAM,
+    FLASH_STATS_OP_ERASE,
+    FLASH_STATS_OP_MAX,
+    FLASH_STATS_OP_NONE = FLASH_STATS_OP_MAX
+};
+
+typedef struct flash_opcode_stats
+{
+    uint8_t opcode;
+    uint32_t xfers;
+    uint32_t tx_bytes;
+    uint32_t rx_bytes;
+} flash_opcode_stats_t;
+
+typedef struct flash_op_stats
+{
+    uint32_t count;
+    uint32_t status_polls;
+    uint32_t max_us;
+    uint64_t total_us;
+    uint32_t hist[FLASH_STATS_HIST_BUCKETS];
+} flash_op_stats_t;
+
+typedef struct flash_stats
+{
+    flash_opcode_stats_t opcodes[FLASH_STATS_MAX_OPCODES];
+    uint8_t num_opcodes;
+    uint32_t opcode_overflow;
+    flash_op_stats_t ops[FLASH_STATS_OP_MAX];
+    uint32_t status_polls;
+    uint32_t busy_waits;
+    uint64_t busy_wait_us;
+    uint32_t ecc_corrected_pages;
+    uint32_t ecc_failed_pages;
+    /* Operation currently being timed */
+    uint8_t cur_op;
+    uint32_t cur_op_start_us;
+    uint32_t cur_op_polls;
+} flash_stats_t;
+
+struct flash_device;
+
+#ifdef EXT_FLASH_STATS
+
+void flash_stats_reset(struct flash_device* flash_dev);
+void flash_stats_dump(struct flash_device* flash_dev);
+void flash_stats_xfer(struct flash_device* flash_dev, uint8_t opcode,
+                      uint32_t tx_len, uint32_t rx_len);
+void flash_stats_status_poll(struct flash_device* flash_dev);
+void flash_stats_op_begin(struct flash_device* flash_dev, uint8_t op);
+void flash_stats_op_end(struct flash_device* flash_dev);
+uint32_t flash_stats_now(struct flash_device* flash_dev);
+void flash_stats_busy_wait(struct flash_device* flash_dev, uint32_t start_us);
+void flash_stats_ecc(struct flash_device* flash_dev, bool corrected,
+                     bool failed);
+
+#define FLASH_STATS_RESET(dev)              flash_stats_reset(dev)
+#define FLASH_STATS_DUMP(dev)               flash_stats_dump(dev)
+#define FLASH_STATS_XFER(dev, opcode, tx_len, rx_len) \
+    flash_stats_xfer((dev), (opcode), (tx_len), (rx_len))
+#define FLASH_STATS_STATUS_POLL(dev)        flash_stats_status_poll(dev)
+#define FLASH_STATS_OP_BEGIN(dev, op)       flash_stats_op_begin((dev), (op))
+#define FLASH_STATS_OP_END(dev)             flash_stats_op_end(dev)
+#define FLASH_STATS_NOW(dev)                flash_stats_now(dev)
+#define FLASH_STATS_BUSY_WAIT(dev, start)   flash_stats_busy_wait((dev), (start))
+#define FLASH_STATS_ECC(dev, corrected, failed) \
+    flash_stats_ecc((dev), (corrected), (failed))
+
+#else
+
+#define FLASH_STATS_RESET(dev)              do { } while (0)
+#define FLASH_STATS_DUMP(dev)               do { } while (0)
+#define FLASH_STATS_XFER(dev, opcode, tx_len, rx_len) do { } while (0)
+#define FLASH_STATS_STATUS_POLL(dev)        do { } while (0)
+#define FLASH_STATS_OP_BEGIN(dev, op)       do { } while (0)
+#define FLASH_STATS_OP_END(dev)             do { } while (0)
+#define FLASH_STATS_NOW(dev)                (0U)
+#define FLASH_STATS_BUSY_WAIT(dev, start)   do { (void)(start); } while (0)
+#define FLASH_STATS_ECC(dev, corrected, failed) do { } while (0)
+
+#endif
+
+#endif
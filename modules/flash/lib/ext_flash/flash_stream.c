@@ -0,0 +1,260 @@
+#include "flash_stream.h"
+
+static void notify(flash_stream_t* stream, uint8_t event)
+{
+    if (stream->cfg.evt_handler != NULL)
+    {
+        stream->cfg.evt_handler(stream, event, stream->cfg.ctx);
+    }
+}
+
+static void advance(flash_stream_t* stream, uint32_t len)
+{
+    stream->write_addr += len;
+    if (stream->write_addr < (stream->cfg.base_addr + stream->cfg.region_len))
+    {
+        return;
+    }
+
+    if (stream->cfg.wrap)
+    {
+        stream->write_addr = stream->cfg.base_addr;
+        stream->counters.region_wraps++;
+    }
+    else
+    {
+        stream->region_full = true;
+        notify(stream, FLASH_STREAM_EVT_REGION_FULL);
+    }
+}
+
+/* Erases the block ahead of its first page, skipping blocks that fail */
+static int8_t prepare_page(flash_stream_t* stream)
+{
+    while (!stream->region_full)
+    {
+        if ((stream->write_addr & (stream->block_size - 1)) != 0)
+        {
+            return FLASH_SUCCESS;
+        }
+
+        if (stream->cfg.erase(stream->cfg.flash_dev, stream->write_addr,
+                              stream->block_size) == FLASH_SUCCESS)
+        {
+            stream->counters.blocks_erased++;
+            return FLASH_SUCCESS;
+        }
+
+        LOG_FLASH(ERROR, "flash_stream: %s, %d: erase failed at 0x%x",
+                  __func__, __LINE__, stream->write_addr);
+        stream->counters.erase_errors++;
+        advance(stream, stream->block_size);
+    }
+
+    return FLASH_MISC_FAILURE;
+}
+
+static void check_low_watermark(flash_stream_t* stream)
+{
+    uint32_t high_events = stream->high_events;
+
+    if ((high_events != stream->low_events) &&
+        (flash_stream_fill(stream) <= stream->cfg.low_watermark))
+    {
+        stream->low_events = high_events;
+        notify(stream, FLASH_STREAM_EVT_LOW_WATERMARK);
+    }
+}
+
+int8_t flash_stream_init(flash_stream_t* stream,
+                         const flash_stream_config_t* cfg)
+{
+    uint32_t page_size;
+    uint32_t block_size;
+
+    if ((stream == NULL) || (cfg == NULL) || (cfg->flash_dev == NULL) ||
+        (cfg->write == NULL) || (cfg->erase == NULL) || (cfg->ring == NULL))
+    {
+        return FLASH_INVALID_PARAMS;
+    }
+
+    page_size = cfg->flash_dev->page_size;
+    block_size = page_size * cfg->flash_dev->num_of_pages_per_block;
+
+    if ((page_size == 0) || ((page_size & (page_size - 1)) != 0) ||
+        ((block_size & (block_size - 1)) != 0) ||
+        ((cfg->ring_size & (cfg->ring_size - 1)) != 0) ||
+        (cfg->ring_size < page_size) ||
+        ((cfg->base_addr & (block_size - 1)) != 0) ||
+        ((cfg->region_len & (block_size - 1)) != 0) ||
+        (cfg->region_len == 0) ||
+        (cfg->high_watermark > cfg->ring_size) ||
+        ((cfg->high_watermark != 0) &&
+         (cfg->low_watermark >= cfg->high_watermark)))
+    {
+        LOG_FLASH(ERROR, "flash_stream: %s, %d: invalid config",
+                  __func__, __LINE__);
+        return FLASH_INVALID_PARAMS;
+    }
+
+    memset(stream, 0, sizeof(flash_stream_t));
+    stream->cfg = *cfg;
+    stream->page_size = page_size;
+    stream->block_size = block_size;
+    stream->write_addr = cfg->base_addr;
+
+    return FLASH_SUCCESS;
+}
+
+uint32_t flash_stream_fill(const flash_stream_t* stream)
+{
+    return stream->head - stream->tail;
+}
+
+int8_t flash_stream_push(flash_stream_t* stream, const void* data,
+                         uint32_t len)
+{
+    uint32_t mask = stream->cfg.ring_size - 1;
+    uint32_t head = stream->head;
+    uint32_t fill = head - stream->tail;
+    uint32_t off = head & mask;
+    uint32_t first;
+
+    if ((len == 0) || (len > stream->cfg.ring_size))
+    {
+        return FLASH_INVALID_PARAMS;
+    }
+
+    if ((stream->cfg.ring_size - fill) < len)
+    {
+        stream->counters.overruns++;
+        stream->counters.dropped_bytes += len;
+        return FLASH_MISC_FAILURE;
+    }
+
+    first = stream->cfg.ring_size - off;
+    if (first > len)
+    {
+        first = len;
+    }
+    memcpy(&stream->cfg.ring[off], data, first);
+    memcpy(stream->cfg.ring, (const uint8_t*)data + first, len - first);
+
+    /* Record contents must land before the consumer sees the new head */
+    FLASH_STREAM_BARRIER();
+    stream->head = head + len;
+
+    fill += len;
+    stream->counters.pushed_records++;
+    stream->counters.pushed_bytes += len;
+    if (fill > stream->counters.max_fill)
+    {
+        stream->counters.max_fill = fill;
+    }
+
+    if ((stream->cfg.high_watermark != 0) &&
+        (fill >= stream->cfg.high_watermark) &&
+        (stream->high_events == stream->low_events))
+    {
+        stream->high_events++;
+        notify(stream, FLASH_STREAM_EVT_HIGH_WATERMARK);
+    }
+
+    return FLASH_SUCCESS;
+}
+
+int8_t flash_stream_process(flash_stream_t* stream, uint32_t max_pages,
+                            uint32_t* pages)
+{
+    uint32_t mask = stream->cfg.ring_size - 1;
+    uint32_t written = 0;
+    uint32_t tail;
+    int8_t status = FLASH_SUCCESS;
+
+    while ((max_pages == 0) || (written < max_pages))
+    {
+        tail = stream->tail;
+        if ((stream->head - tail) < stream->page_size)
+        {
+            break;
+        }
+        /* Pairs with the barrier in push, head before ring contents */
+        FLASH_STREAM_BARRIER();
+
+        status = prepare_page(stream);
+        if (status != FLASH_SUCCESS)
+        {
+            break;
+        }
+
+        status = stream->cfg.write(stream->cfg.flash_dev, stream->write_addr,
+                                   &stream->cfg.ring[tail & mask],
+                                   stream->page_size);
+        if (status != FLASH_SUCCESS)
+        {
+            /* Keep the data, the next call retries it on the next page */
+            LOG_FLASH(ERROR, "flash_stream: %s, %d: program failed at 0x%x",
+                      __func__, __LINE__, stream->write_addr);
+            stream->counters.write_errors++;
+            advance(stream, stream->page_size);
+            break;
+        }
+
+        /* Page is out of the ring before the producer may reuse it */
+        FLASH_STREAM_BARRIER();
+        stream->tail = tail + stream->page_size;
+        stream->counters.pages_written++;
+        written++;
+        advance(stream, stream->page_size);
+    }
+
+    check_low_watermark(stream);
+
+    if (pages != NULL)
+    {
+        *pages = written;
+    }
+    return status;
+}
+
+int8_t flash_stream_flush(flash_stream_t* stream)
+{
+    uint32_t mask = stream->cfg.ring_size - 1;
+    uint32_t fill;
+    int8_t status;
+
+    status = flash_stream_process(stream, 0, NULL);
+    if (status != FLASH_SUCCESS)
+    {
+        return status;
+    }
+
+    fill = flash_stream_fill(stream);
+    if (fill != 0)
+    {
+        status = prepare_page(stream);
+        if (status != FLASH_SUCCESS)
+        {
+            return status;
+        }
+
+        status = stream->cfg.write(stream->cfg.flash_dev, stream->write_addr,
+                                   &stream->cfg.ring[stream->tail & mask],
+                                   fill);
+        if (status != FLASH_SUCCESS)
+        {
+            stream->counters.write_errors++;
+            advance(stream, stream->page_size);
+            return status;
+        }
+        stream->counters.pages_written++;
+        advance(stream, stream->page_size);
+    }
+
+    /* Realign so every full page is contiguous in the ring again */
+    stream->head = 0;
+    stream->tail = 0;
+    check_low_watermark(stream);
+
+    return FLASH_SUCCESS;
+}
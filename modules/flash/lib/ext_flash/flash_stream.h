@@ -0,0 +1,117 @@
+#ifndef __FLASH_STREAM_H__
+#define __FLASH_STREAM_H__
+
+#include "ext_flash.h"
+
+/*
+ * Streaming flash writer. Interrupt handlers push records into a lock-free
+ * single producer / single consumer ring and a background task drains it to
+ * flash one page at a time, erasing each block of the region just before it
+ * is first written. The producer never blocks: a record that does not fit is
+ * dropped whole and counted as an overrun.
+ *
+ * Only flash_stream_push() may run in the producer context, everything else
+ * belongs to the consumer. The ring size must be a power of two and a
+ * multiple of the page size, so the page at the read index is always
+ * contiguous and is programmed straight out of the ring.
+ */
+
+enum flash_stream_event
+{
+    /* Fill level reached high_watermark, producer should throttle */
+    FLASH_STREAM_EVT_HIGH_WATERMARK = 0,
+    /* Fill level dropped to low_watermark after a high watermark event */
+    FLASH_STREAM_EVT_LOW_WATERMARK,
+    /* The end of the region was reached and wrap is not set */
+    FLASH_STREAM_EVT_REGION_FULL,
+};
+
+struct flash_stream;
+
+typedef void (*flash_stream_evt_handler_t)(struct flash_stream* stream,
+                                           uint8_t event, void* ctx);
+
+typedef struct flash_stream_config
+{
+    flash_device_t* flash_dev;
+    /* Driver entry points, e.g. w25n01gc_flash_write/erase */
+    int8_t (*write)(flash_device_t* flash_dev, uint32_t addr,
+                    uint8_t* write_buf, uint32_t write_len);
+    int8_t (*erase)(flash_device_t* flash_dev, uint32_t addr,
+                    uint32_t erase_len);
+    /* Ring storage, power of two, multiple of page_size */
+    uint8_t* ring;
+    uint32_t ring_size;
+    /* Flash region, block aligned */
+    uint32_t base_addr;
+    uint32_t region_len;
+    /* Start over at base_addr when the region is full */
+    bool wrap;
+    /* Fill levels in bytes, high_watermark 0 disables the events */
+    uint32_t high_watermark;
+    uint32_t low_watermark;
+    /* Called from the producer for HIGH, from the consumer otherwise */
+    flash_stream_evt_handler_t evt_handler;
+    void* ctx;
+} flash_stream_config_t;
+
+typedef struct flash_stream_counters
+{
+    /* Producer side */
+    uint32_t pushed_records;
+    uint32_t pushed_bytes;
+    uint32_t overruns;
+    uint32_t dropped_bytes;
+    uint32_t max_fill;
+    /* Consumer side */
+    uint32_t pages_written;
+    uint32_t blocks_erased;
+    uint32_t write_errors;
+    uint32_t erase_errors;
+    uint32_t region_wraps;
+} flash_stream_counters_t;
+
+typedef struct flash_stream
+{
+    flash_stream_config_t cfg;
+    uint32_t page_size;
+    uint32_t block_size;
+    /* Free running byte indices, head written by producer, tail by consumer */
+    volatile uint32_t head;
+    volatile uint32_t tail;
+    /* Watermark state, high_events by producer and low_events by consumer */
+    volatile uint32_t high_events;
+    volatile uint32_t low_events;
+    /* Next flash address to program */
+    uint32_t write_addr;
+    bool region_full;
+    flash_stream_counters_t counters;
+} flash_stream_t;
+
+/* Ordering between ring contents and index updates */
+#ifndef FLASH_STREAM_BARRIER
+#define FLASH_STREAM_BARRIER()  __sync_synchronize()
+#endif
+
+int8_t flash_stream_init(flash_stream_t* stream,
+                         const flash_stream_config_t* cfg);
+/*
+ * Producer side, safe from an ISR. Copies the whole record or nothing;
+ * returns FLASH_MISC_FAILURE on overrun.
+ */
+int8_t flash_stream_push(flash_stream_t* stream, const void* data,
+                         uint32_t len);
+/*
+ * Consumer side. Programs up to max_pages full pages (0 drains every full
+ * page) and reports the number written in pages, which may be NULL.
+ */
+int8_t flash_stream_process(flash_stream_t* stream, uint32_t max_pages,
+                            uint32_t* pages);
+/*
+ * Programs the last partial page, the rest of the page stays erased. The
+ * producer must be stopped; the ring restarts empty at the next page.
+ */
+int8_t flash_stream_flush(flash_stream_t* stream);
+uint32_t flash_stream_fill(const flash_stream_t* stream);
+
+#endif
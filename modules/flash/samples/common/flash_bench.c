@@ -0,0 +1,437 @@
+#include <stdlib.h>
+
+#include "flash_bench.h"
+#include "w25n01gv_internal.h"
+
+#define FLASH_BENCH_LINE_LEN    128
+/* ECC sector, the smallest unit a page may be partially programmed in */
+#define FLASH_BENCH_SECTOR_SIZE (W25N01GV_PAGE_SIZE / W25N01GV_SECTORS_PER_PAGE)
+
+static void result_init(flash_bench_result_t* result, const char* name,
+                        uint8_t pattern, uint32_t xfer_size)
+{
+    memset(result, 0, sizeof(flash_bench_result_t));
+    result->name = name;
+    result->pattern = pattern;
+    result->xfer_size = xfer_size;
+    result->min_us = UINT32_MAX;
+}
+
+static void result_add(flash_bench_t* bench, flash_bench_result_t* result,
+                       uint32_t bytes, uint32_t elapsed_us)
+{
+    if ((bench->lat_buf != NULL) && (result->ops < bench->lat_buf_len))
+    {
+        bench->lat_buf[result->ops] = elapsed_us;
+    }
+
+    result->ops++;
+    result->bytes += bytes;
+    result->total_us += elapsed_us;
+    if (elapsed_us < result->min_us)
+    {
+        result->min_us = elapsed_us;
+    }
+    if (elapsed_us > result->max_us)
+    {
+        result->max_us = elapsed_us;
+    }
+}
+
+static int cmp_u32(const void* a, const void* b)
+{
+    uint32_t x = *(const uint32_t*)a;
+    uint32_t y = *(const uint32_t*)b;
+
+    return (x > y) - (x < y);
+}
+
+/* Percentiles over the recorded samples, the first lat_buf_len ops */
+static void result_finish(flash_bench_t* bench, flash_bench_result_t* result)
+{
+    uint32_t n = result->ops;
+
+    if (n == 0)
+    {
+        result->min_us = 0;
+        return;
+    }
+
+    if (bench->lat_buf == NULL)
+    {
+        return;
+    }
+
+    if (n > bench->lat_buf_len)
+    {
+        n = bench->lat_buf_len;
+    }
+
+    qsort(bench->lat_buf, n, sizeof(uint32_t), cmp_u32);
+    result->p50_us = bench->lat_buf[((n - 1) * 50) / 100];
+    result->p90_us = bench->lat_buf[((n - 1) * 90) / 100];
+    result->p99_us = bench->lat_buf[((n - 1) * 99) / 100];
+}
+
+/* Address dependent pattern so a misplaced page shows up on verify */
+static void fill_pattern(uint8_t* buf, uint32_t addr, uint32_t len)
+{
+    for (uint32_t i = 0; i < len; i++)
+    {
+        uint32_t a = addr + i;
+        buf[i] = (uint8_t)(a ^ (a >> 8) ^ (a >> 16));
+    }
+}
+
+static bool check_pattern(const uint8_t* buf, uint32_t addr, uint32_t len)
+{
+    for (uint32_t i = 0; i < len; i++)
+    {
+        uint32_t a = addr + i;
+        if (buf[i] != (uint8_t)(a ^ (a >> 8) ^ (a >> 16)))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static uint32_t block_size(flash_bench_t* bench)
+{
+    return (uint32_t)bench->flash_dev->page_size *
+           bench->flash_dev->num_of_pages_per_block;
+}
+
+/*
+ * Distance between two slots, xfer_size rounded up to whole ECC sectors. The
+ * W25N01GV takes at most 4 partial programs per page and, with ECC on, one
+ * per 512 byte sector, so packed 64 B slots would reprogram sectors and
+ * corrupt their ECC. Small transfers get a sector each instead.
+ */
+static uint32_t slot_pitch(uint32_t xfer_size)
+{
+    return (xfer_size + FLASH_BENCH_SECTOR_SIZE - 1) &
+           ~(FLASH_BENCH_SECTOR_SIZE - 1);
+}
+
+static uint32_t num_ops(flash_bench_t* bench, uint32_t xfer_size)
+{
+    uint32_t ops = bench->region_len / slot_pitch(xfer_size);
+
+    if ((bench->max_ops != 0) && (ops > bench->max_ops))
+    {
+        ops = bench->max_ops;
+    }
+    return ops;
+}
+
+static uint32_t gcd(uint32_t a, uint32_t b)
+{
+    while (b != 0)
+    {
+        uint32_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+/*
+ * Slot visited at step i. Random order walks i * stride mod n with a stride
+ * coprime to n, which touches every slot exactly once, so programs still
+ * only hit erased pages.
+ */
+static uint32_t slot_step(uint32_t n)
+{
+    uint32_t stride = (uint32_t)(((uint64_t)n * 618) / 1000) | 1U;
+
+    while (gcd(stride, n) != 1)
+    {
+        stride += 2;
+    }
+    return stride;
+}
+
+static uint32_t slot(uint8_t pattern, uint32_t i, uint32_t n, uint32_t stride)
+{
+    if (pattern == FLASH_BENCH_RANDOM)
+    {
+        return (uint32_t)(((uint64_t)i * stride) % n);
+    }
+    return i;
+}
+
+int8_t flash_bench_erase(flash_bench_t* bench, uint8_t pattern,
+                         uint32_t span, flash_bench_result_t* result)
+{
+    uint32_t blk_size = block_size(bench);
+    uint32_t n = (span + blk_size - 1) / blk_size;
+    uint32_t stride = slot_step(n);
+    uint32_t start;
+    uint32_t addr;
+    int8_t status;
+
+    result_init(result, "erase", pattern, blk_size);
+
+    for (uint32_t i = 0; i < n; i++)
+    {
+        addr = bench->base_addr + slot(pattern, i, n, stride) * blk_size;
+
+        start = bench->time_us();
+        status = w25n01gc_flash_erase(bench->flash_dev, addr, blk_size);
+        if (status != FLASH_SUCCESS)
+        {
+            result->errors++;
+            continue;
+        }
+        result_add(bench, result, blk_size, bench->time_us() - start);
+    }
+
+    result_finish(bench, result);
+    return (result->errors == 0) ? FLASH_SUCCESS : FLASH_MISC_FAILURE;
+}
+
+int8_t flash_bench_program(flash_bench_t* bench, uint8_t pattern,
+                           uint32_t xfer_size, flash_bench_result_t* result)
+{
+    uint32_t n = num_ops(bench, xfer_size);
+    uint32_t stride = slot_step(n);
+    uint32_t start;
+    uint32_t addr;
+    int8_t status;
+
+    result_init(result, "program", pattern, xfer_size);
+
+    if ((xfer_size > bench->buf_len) || (n == 0))
+    {
+        return FLASH_INVALID_PARAMS;
+    }
+
+    for (uint32_t i = 0; i < n; i++)
+    {
+        addr = bench->base_addr +
+               slot(pattern, i, n, stride) * slot_pitch(xfer_size);
+        fill_pattern(bench->buf, addr, xfer_size);
+
+        start = bench->time_us();
+        status = w25n01gc_flash_write(bench->flash_dev, addr, bench->buf,
+                                      xfer_size);
+        if (status != FLASH_SUCCESS)
+        {
+            result->errors++;
+            continue;
+        }
+        result_add(bench, result, xfer_size, bench->time_us() - start);
+    }
+
+    result_finish(bench, result);
+    return (result->errors == 0) ? FLASH_SUCCESS : FLASH_MISC_FAILURE;
+}
+
+int8_t flash_bench_read(flash_bench_t* bench, uint8_t pattern,
+                        uint32_t xfer_size, bool verify,
+                        flash_bench_result_t* result)
+{
+    uint32_t n = num_ops(bench, xfer_size);
+    uint32_t stride = slot_step(n);
+    uint32_t start;
+    uint32_t addr;
+    int8_t status;
+
+    result_init(result, "read", pattern, xfer_size);
+
+    if ((xfer_size > bench->buf_len) || (n == 0))
+    {
+        return FLASH_INVALID_PARAMS;
+    }
+
+    for (uint32_t i = 0; i < n; i++)
+    {
+        addr = bench->base_addr +
+               slot(pattern, i, n, stride) * slot_pitch(xfer_size);
+
+        start = bench->time_us();
+        status = w25n01gc_flash_read(bench->flash_dev, addr, bench->buf,
+                                     xfer_size);
+        if (status != FLASH_SUCCESS)
+        {
+            result->errors++;
+            continue;
+        }
+        result_add(bench, result, xfer_size, bench->time_us() - start);
+
+        if (verify && !check_pattern(bench->buf, addr, xfer_size))
+        {
+            result->errors++;
+        }
+    }
+
+    result_finish(bench, result);
+    return (result->errors == 0) ? FLASH_SUCCESS : FLASH_MISC_FAILURE;
+}
+
+int8_t flash_bench_sweep(flash_bench_t* bench, uint32_t min_size,
+                         uint32_t max_size, bool verify)
+{
+    static const uint8_t patterns[] = {FLASH_BENCH_SEQUENTIAL,
+                                       FLASH_BENCH_RANDOM};
+    flash_bench_result_t result;
+    int8_t status = FLASH_SUCCESS;
+    uint32_t span;
+
+    if ((min_size == 0) || (max_size > bench->buf_len))
+    {
+        return FLASH_INVALID_PARAMS;
+    }
+
+    for (uint32_t size = min_size; size <= max_size; size <<= 1)
+    {
+        span = num_ops(bench, size) * slot_pitch(size);
+        if (span == 0)
+        {
+            break;
+        }
+
+        for (uint8_t p = 0; p < sizeof(patterns); p++)
+        {
+            if (flash_bench_erase(bench, patterns[p], span, &result) !=
+                FLASH_SUCCESS)
+            {
+                status = FLASH_MISC_FAILURE;
+            }
+            flash_bench_print(&result);
+            if (bench->flush != NULL)
+            {
+                bench->flush();
+            }
+
+            if (flash_bench_program(bench, patterns[p], size, &result) !=
+                FLASH_SUCCESS)
+            {
+                status = FLASH_MISC_FAILURE;
+            }
+            flash_bench_print(&result);
+            if (bench->flush != NULL)
+            {
+                bench->flush();
+            }
+
+            if (flash_bench_read(bench, patterns[p], size, verify, &result) !=
+                FLASH_SUCCESS)
+            {
+                status = FLASH_MISC_FAILURE;
+            }
+            flash_bench_print(&result);
+            if (bench->flush != NULL)
+            {
+                bench->flush();
+            }
+        }
+    }
+
+    return status;
+}
+
+/*
+ * Kept out of line with volatile operands so the compiler can neither hoist
+ * the geometry out of the loop nor turn the division into a shift itself,
+ * which is what the driver would see with geometry from flash_device_t.
+ */
+static uint32_t __attribute__((noinline))
+geometry_div(uint32_t addr, volatile uint16_t* page_size,
+             volatile uint16_t* pages_per_block)
+{
+    uint32_t page = addr / *page_size;
+    uint32_t col = addr % *page_size;
+    uint32_t block = page / *pages_per_block;
+
+    return page ^ col ^ block;
+}
+
+static uint32_t __attribute__((noinline))
+geometry_shift(uint32_t addr, volatile uint8_t* page_shift,
+               volatile uint8_t* block_shift)
+{
+    uint32_t page = addr >> *page_shift;
+    uint32_t col = addr & ((1UL << *page_shift) - 1);
+    uint32_t block = page >> *block_shift;
+
+    return page ^ col ^ block;
+}
+
+int8_t flash_bench_geometry(flash_bench_t* bench, uint32_t iterations)
+{
+    flash_device_t* flash_dev = bench->flash_dev;
+    volatile uint16_t page_size = flash_dev->page_size;
+    volatile uint16_t pages_per_block = flash_dev->num_of_pages_per_block;
+    volatile uint8_t page_shift = flash_dev->page_shift;
+    volatile uint8_t block_shift = flash_dev->block_shift;
+    volatile uint32_t sink = 0;
+    uint32_t div_us;
+    uint32_t shift_us;
+    uint32_t start;
+    uint32_t addr;
+    char line[FLASH_BENCH_LINE_LEN];
+
+    if ((iterations == 0) || (flash_dev->flash_size == 0) ||
+        ((flash_dev->flash_size & (flash_dev->flash_size - 1)) != 0))
+    {
+        return FLASH_INVALID_PARAMS;
+    }
+
+    /* Same odd stride walk through the chip for both variants */
+    start = bench->time_us();
+    addr = 0;
+    for (uint32_t i = 0; i < iterations; i++)
+    {
+        sink ^= geometry_div(addr, &page_size, &pages_per_block);
+        addr = (addr + 0x9E3779B1UL) & (flash_dev->flash_size - 1);
+    }
+    div_us = bench->time_us() - start;
+
+    start = bench->time_us();
+    addr = 0;
+    for (uint32_t i = 0; i < iterations; i++)
+    {
+        sink ^= geometry_shift(addr, &page_shift, &block_shift);
+        addr = (addr + 0x9E3779B1UL) & (flash_dev->flash_size - 1);
+    }
+    shift_us = bench->time_us() - start;
+
+    snprintf(line, sizeof(line),
+             "geometry: %lu ops, div/mod %lu ns/op, shift/mask %lu ns/op",
+             (unsigned long)iterations,
+             (unsigned long)(((uint64_t)div_us * 1000) / iterations),
+             (unsigned long)(((uint64_t)shift_us * 1000) / iterations));
+    LOG_FLASH(INFO, "%s", NRF_LOG_PUSH(line));
+    return FLASH_SUCCESS;
+}
+
+void flash_bench_print_header(void)
+{
+    LOG_FLASH(INFO, "op      pat   size   ops   KB/s    p50    p90    p99"
+                    "    max err");
+}
+
+void flash_bench_print(const flash_bench_result_t* result)
+{
+    char line[FLASH_BENCH_LINE_LEN];
+    uint32_t kbps = 0;
+
+    if (result->total_us != 0)
+    {
+        kbps = (uint32_t)((result->bytes * 1000000ULL) /
+                          (result->total_us * 1024ULL));
+    }
+
+    /* Single preformatted line, the nRF logger takes at most 6 arguments */
+    snprintf(line, sizeof(line),
+             "%-7s %-3s %6lu %5lu %6lu %6lu %6lu %6lu %6lu %3lu",
+             result->name,
+             (result->pattern == FLASH_BENCH_RANDOM) ? "rnd" : "seq",
+             (unsigned long)result->xfer_size, (unsigned long)result->ops,
+             (unsigned long)kbps, (unsigned long)result->p50_us,
+             (unsigned long)result->p90_us, (unsigned long)result->p99_us,
+             (unsigned long)result->max_us, (unsigned long)result->errors);
+    LOG_FLASH(INFO, "%s", NRF_LOG_PUSH(line));
+}
@@ -0,0 +1,77 @@
+#ifndef _FLASH_BENCH_H_
+#define _FLASH_BENCH_H_
+
+#include "ext_flash.h"
+
+/*
+ * Platform agnostic flash benchmark core shared by the samples. The platform
+ * supplies the device, a microsecond clock and a transfer buffer; results are
+ * printed through LOG_FLASH so they end up on RTT/UART or stdout.
+ */
+
+enum flash_bench_pattern
+{
+    FLASH_BENCH_SEQUENTIAL = 0,
+    FLASH_BENCH_RANDOM
+};
+
+typedef struct flash_bench_result
+{
+    const char* name;
+    uint8_t pattern;
+    uint32_t xfer_size;
+    uint32_t ops;
+    uint32_t errors;
+    uint32_t min_us;
+    uint32_t max_us;
+    uint32_t p50_us;
+    uint32_t p90_us;
+    uint32_t p99_us;
+    uint64_t bytes;
+    uint64_t total_us;
+} flash_bench_result_t;
+
+typedef struct flash_bench
+{
+    flash_device_t* flash_dev;
+    uint32_t (*time_us)(void);
+    /* Region under test, block aligned */
+    uint32_t base_addr;
+    uint32_t region_len;
+    /* Upper bound on calls per test, 0 runs the whole region */
+    uint32_t max_ops;
+    /* Transfer buffer, at least as large as the biggest xfer_size */
+    uint8_t* buf;
+    uint32_t buf_len;
+    /* Per-op latency samples for percentiles, optional */
+    uint32_t* lat_buf;
+    uint32_t lat_buf_len;
+    /* Called after every printed row to drain deferred logs, optional */
+    void (*flush)(void);
+} flash_bench_t;
+
+int8_t flash_bench_erase(flash_bench_t* bench, uint8_t pattern,
+                         uint32_t span, flash_bench_result_t* result);
+int8_t flash_bench_program(flash_bench_t* bench, uint8_t pattern,
+                           uint32_t xfer_size, flash_bench_result_t* result);
+int8_t flash_bench_read(flash_bench_t* bench, uint8_t pattern,
+                        uint32_t xfer_size, bool verify,
+                        flash_bench_result_t* result);
+/*
+ * Runs erase/program/read in sequential and random order for every power of
+ * two transfer size from min_size to max_size and prints one row per test.
+ * Program and read slots are at least one 512 byte ECC sector apart, so
+ * transfers below that still program every sector only once per erase.
+ */
+int8_t flash_bench_sweep(flash_bench_t* bench, uint32_t min_size,
+                         uint32_t max_size, bool verify);
+/*
+ * Times address decomposition into page/column/block with division against
+ * the shift/mask geometry used by the driver, over iterations addresses.
+ * Needs a real clock in time_us; prints ns per decomposition for each.
+ */
+int8_t flash_bench_geometry(flash_bench_t* bench, uint32_t iterations);
+void flash_bench_print_header(void);
+void flash_bench_print(const flash_bench_result_t* result);
+
+#endif
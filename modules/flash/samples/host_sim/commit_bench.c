@@ -0,0 +1,289 @@
+#include <stdlib.h>
+
+#include "commit_bench.h"
+#include "flash_commit.h"
+#include "w25n01gv_internal.h"
+
+static uint32_t rng_state;
+
+static uint32_t rng(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+/* Blob length and contents are a function of the version */
+static uint32_t blob_len(uint32_t version, uint32_t max_len)
+{
+    uint32_t h = version * 2654435761U;
+
+    return 4 + ((h ^ (h >> 15)) % (max_len - 4));
+}
+
+static void blob_fill(uint8_t* buf, uint32_t version, uint32_t len)
+{
+    uint32_t x = version | 1;
+
+    memcpy(buf, &version, sizeof(version));
+    for (uint32_t i = sizeof(version); i < len; i++)
+    {
+        x = x * 1103515245U + 12345U;
+        buf[i] = (uint8_t)(x >> 16);
+    }
+}
+
+/* Version the blob holds if it matches one exactly, UINT32_MAX otherwise */
+static uint32_t blob_version(const uint8_t* buf, uint32_t len,
+                             uint8_t* scratch, uint32_t max_len)
+{
+    uint32_t version;
+
+    if (len < sizeof(version))
+    {
+        return UINT32_MAX;
+    }
+    memcpy(&version, buf, sizeof(version));
+    if (blob_len(version, max_len) != len)
+    {
+        return UINT32_MAX;
+    }
+    blob_fill(scratch, version, len);
+    return (memcmp(buf, scratch, len) == 0) ? version : UINT32_MAX;
+}
+
+static int8_t remount(w25n01gv_sim_t* sim, flash_device_t* flash_dev,
+                      flash_commit_t* fc, const flash_commit_config_t* cfg)
+{
+    int8_t status;
+
+    w25n01gv_sim_power_cycle(sim);
+    status = w25n01gv_init(flash_dev);
+    if (status != FLASH_SUCCESS)
+    {
+        return status;
+    }
+    return flash_commit_mount(fc, cfg);
+}
+
+/* Remounts and reads the blob back, the version it holds or UINT32_MAX */
+static uint32_t remount_version(w25n01gv_sim_t* sim, flash_device_t* flash_dev,
+                                flash_commit_t* fc,
+                                const flash_commit_config_t* cfg,
+                                uint8_t* rd_buf, uint8_t* scratch,
+                                uint32_t max_len)
+{
+    uint32_t len;
+
+    if ((remount(sim, flash_dev, fc, cfg) != FLASH_SUCCESS) ||
+        (flash_commit_read(fc, rd_buf, max_len, &len) != FLASH_SUCCESS))
+    {
+        return UINT32_MAX;
+    }
+    return blob_version(rd_buf, len, scratch, max_len);
+}
+
+int8_t commit_bench_run(w25n01gv_sim_t* sim, flash_device_t* flash_dev,
+                        const commit_bench_config_t* cfg)
+{
+    flash_commit_config_t fc_cfg;
+    flash_commit_t fc;
+    uint8_t* page_buf;
+    uint8_t* wr_buf;
+    uint8_t* rd_buf;
+    uint8_t* scratch;
+    uint32_t max_len;
+    uint32_t committed = UINT32_MAX;
+    uint32_t version = 0;
+    uint32_t pages;
+    uint32_t len;
+    uint32_t got;
+    uint32_t ppb = flash_dev->num_of_pages_per_block;
+    uint32_t to_block;
+    uint32_t program_errors;
+    bool written;
+    uint32_t cuts = 0;
+    uint32_t kept_old = 0;
+    uint32_t kept_new = 0;
+    uint32_t failures = 0;
+    uint32_t mount_reads_max = 0;
+    uint64_t mount_reads = 0;
+    uint64_t payload_pages = 0;
+    uint64_t programmed = 0;
+    int8_t status;
+
+    rng_state = (cfg->seed != 0) ? cfg->seed : 1;
+
+    memset(&fc_cfg, 0, sizeof(fc_cfg));
+    fc_cfg.flash_dev = flash_dev;
+    fc_cfg.page_program = w25n01gv_page_program;
+    fc_cfg.page_read = w25n01gv_page_read;
+    fc_cfg.erase = w25n01gc_flash_erase;
+    fc_cfg.first_block = cfg->first_block;
+    fc_cfg.num_blocks = cfg->num_blocks;
+
+    page_buf = malloc(flash_dev->page_size);
+    fc_cfg.page_buf = page_buf;
+
+    status = remount(sim, flash_dev, &fc, &fc_cfg);
+    if ((status != FLASH_SUCCESS) || (page_buf == NULL))
+    {
+        free(page_buf);
+        return FLASH_MISC_FAILURE;
+    }
+
+    /* Keep blobs to a quarter of the limit so rounds stay quick */
+    max_len = flash_commit_max_len(&fc) / 4;
+    wr_buf = malloc(max_len);
+    rd_buf = malloc(max_len);
+    scratch = malloc(max_len);
+    if ((wr_buf == NULL) || (rd_buf == NULL) || (scratch == NULL))
+    {
+        free(page_buf);
+        free(wr_buf);
+        free(rd_buf);
+        free(scratch);
+        return FLASH_MISC_FAILURE;
+    }
+
+    LOG_FLASH(INFO, "commit: blocks %u-%u, %u rounds, blobs up to %u B",
+              cfg->first_block, cfg->first_block + cfg->num_blocks - 1,
+              cfg->rounds, max_len);
+
+    for (uint32_t round = 0; round < cfg->rounds; round++)
+    {
+        version++;
+        len = blob_len(version, max_len);
+        pages = (len + flash_dev->page_size - 1) / flash_dev->page_size;
+        blob_fill(wr_buf, version, len);
+
+        if (rng() & 1)
+        {
+            /* Anywhere from the first page to the commit page */
+            w25n01gv_sim_set_power_cut(sim, rng() % pages,
+                                       rng() % (W25N01GV_SIM_PAGE_TOTAL + 1),
+                                       (rng() % 4) == 0);
+            cuts++;
+        }
+
+        programmed -= fc.counters.pages_programmed;
+        status = flash_commit_write(&fc, wr_buf, len);
+        programmed += fc.counters.pages_programmed;
+        written = (status == FLASH_SUCCESS);
+        if (written)
+        {
+            payload_pages += pages;
+        }
+
+        status = remount(sim, flash_dev, &fc, &fc_cfg);
+        if (status != FLASH_SUCCESS)
+        {
+            failures++;
+            break;
+        }
+        mount_reads += fc.counters.mount_page_reads;
+        if (fc.counters.mount_page_reads > mount_reads_max)
+        {
+            mount_reads_max = fc.counters.mount_page_reads;
+        }
+
+        got = UINT32_MAX;
+        if (flash_commit_read(&fc, rd_buf, max_len, &len) == FLASH_SUCCESS)
+        {
+            got = blob_version(rd_buf, len, scratch, max_len);
+        }
+
+        if (got == version)
+        {
+            kept_new++;
+            committed = version;
+        }
+        else if (!written && (got == committed) && (got != UINT32_MAX))
+        {
+            kept_old++;
+        }
+        else if (!((got == UINT32_MAX) && (committed == UINT32_MAX) &&
+                   !fc.valid))
+        {
+            LOG_FLASH(ERROR, "commit: round %u read version %d, expected %d "
+                             "or %d", round, (int)got, (int)committed,
+                      (int)version);
+            failures++;
+        }
+    }
+
+    /*
+     * P-FAIL on the first page of a block: the transaction goes on in the
+     * next block, and it and the one after must survive a remount. Versions
+     * too short to reach the block start are written as they are.
+     */
+    program_errors = fc.counters.program_errors;
+    for (uint32_t i = 0; (i < ppb) && (failures == 0) &&
+                         (fc.counters.program_errors == program_errors); i++)
+    {
+        version++;
+        len = blob_len(version, max_len);
+        pages = (len + flash_dev->page_size - 1) / flash_dev->page_size;
+        blob_fill(wr_buf, version, len);
+
+        to_block = (ppb - (fc.next_page % ppb)) % ppb;
+        if (pages > to_block)
+        {
+            w25n01gv_sim_set_program_fail(
+                sim, (uint16_t)((fc_cfg.first_block * ppb) + fc.next_page +
+                                to_block));
+        }
+        if (flash_commit_write(&fc, wr_buf, len) != FLASH_SUCCESS)
+        {
+            LOG_FLASH(ERROR, "commit: P-FAIL write of version %u failed",
+                      version);
+            failures++;
+        }
+        sim->program_fail_armed = false;
+    }
+    if (fc.counters.program_errors == program_errors)
+    {
+        LOG_FLASH(ERROR, "commit: no first page P-FAIL in %u versions", ppb);
+        failures++;
+    }
+    for (uint32_t i = 0; (i < 2) && (failures == 0); i++)
+    {
+        if (i != 0)
+        {
+            version++;
+            len = blob_len(version, max_len);
+            blob_fill(wr_buf, version, len);
+            if (flash_commit_write(&fc, wr_buf, len) != FLASH_SUCCESS)
+            {
+                failures++;
+                break;
+            }
+        }
+        got = remount_version(sim, flash_dev, &fc, &fc_cfg, rd_buf, scratch,
+                              max_len);
+        if (got != version)
+        {
+            LOG_FLASH(ERROR, "commit: P-FAIL remount read version %d, "
+                             "expected %d", (int)got, (int)version);
+            failures++;
+        }
+    }
+    LOG_FLASH(INFO, "commit: P-FAIL on a block's first page, remounted %s",
+              (failures == 0) ? "ok" : "FAILED");
+
+    LOG_FLASH(INFO, "commit: power cuts %u, new version %u, old version "
+                    "kept %u, failures %u",
+              cuts, kept_new, kept_old, failures);
+    LOG_FLASH(INFO, "commit: mount page reads avg %u max %u, programmed %u "
+                    "pages for %u payload pages",
+              (uint32_t)(mount_reads / (cfg->rounds ? cfg->rounds : 1)),
+              mount_reads_max, (uint32_t)programmed,
+              (uint32_t)payload_pages);
+
+    free(page_buf);
+    free(wr_buf);
+    free(rd_buf);
+    free(scratch);
+    return (failures == 0) ? FLASH_SUCCESS : FLASH_MISC_FAILURE;
+}
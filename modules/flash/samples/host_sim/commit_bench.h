@@ -0,0 +1,27 @@
+#ifndef _COMMIT_BENCH_H_
+#define _COMMIT_BENCH_H_
+
+#include "ext_flash.h"
+#include "w25n01gv_sim.h"
+
+/*
+ * Power cut torture test for flash_commit. Each round writes a new version
+ * of a blob, about half of them with the power cut somewhere in the middle,
+ * then power cycles, remounts and checks that the blob reads back as either
+ * the old or the new version and never anything in between. A last case
+ * fails the program of a block's first page mid transaction and checks that
+ * it and the next transaction survive a remount.
+ */
+
+typedef struct commit_bench_config
+{
+    uint32_t rounds;
+    uint32_t first_block;
+    uint32_t num_blocks;
+    uint32_t seed;
+} commit_bench_config_t;
+
+int8_t commit_bench_run(w25n01gv_sim_t* sim, flash_device_t* flash_dev,
+                        const commit_bench_config_t* cfg);
+
+#endif
@@ -0,0 +1,411 @@
+#include <stdlib.h>
+
+#include "gc_bench.h"
+#include "flash_gc.h"
+#include "w25n01gv_internal.h"
+
+#define GC_BENCH_NONE   UINT32_MAX
+
+typedef struct gc_bench_state
+{
+    flash_device_t* flash_dev;
+    flash_gc_t gc;
+    uint32_t first_page;
+    uint32_t num_pages;
+    uint32_t logical_pages;
+    /* Logical to absolute page, region page to logical */
+    uint32_t* map;
+    uint32_t* rev;
+    uint32_t* version;
+    uint32_t* free_blocks;
+    uint32_t free_count;
+    /* Separate write frontiers for host writes and GC moves */
+    uint32_t frontier_block[2];
+    uint32_t frontier_page[2];
+    uint16_t* valid;
+    uint32_t* stamp;
+    uint32_t* lat;
+    uint32_t* run_lat;
+    uint8_t* buf;
+} gc_bench_state_t;
+
+typedef struct gc_bench_result
+{
+    uint32_t max_us;
+    uint32_t p99_us;
+    uint32_t p999_us;
+    uint32_t avg_us;
+    /* Budgeted flash_gc_run calls, forced collections not included */
+    uint32_t runs;
+    uint32_t run_p99_us;
+    uint32_t run_max_us;
+    uint32_t forced;
+    uint32_t errors;
+} gc_bench_result_t;
+
+static uint32_t rng_state;
+
+static uint32_t rng(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static int cmp_u32(const void* a, const void* b)
+{
+    uint32_t x = *(const uint32_t*)a;
+    uint32_t y = *(const uint32_t*)b;
+
+    return (x > y) - (x < y);
+}
+
+static bool frontier_full(const gc_bench_state_t* state, uint8_t f)
+{
+    return (state->frontier_block[f] == GC_BENCH_NONE) ||
+           (state->frontier_page[f] ==
+            state->flash_dev->num_of_pages_per_block);
+}
+
+/*
+ * Host writes leave the last free block to GC moves. A victim always has
+ * less than a block of live pages, so that block is enough to finish it.
+ */
+static int8_t ftl_write(gc_bench_state_t* state, uint32_t logical,
+                        const uint8_t* data, bool host)
+{
+    flash_device_t* flash_dev = state->flash_dev;
+    uint8_t f = host ? 0 : 1;
+    uint32_t page;
+    uint32_t old;
+    int8_t status;
+
+    if (frontier_full(state, f))
+    {
+        if (state->free_count < (host ? 2U : 1U))
+        {
+            return FLASH_MISC_FAILURE;
+        }
+        if (state->frontier_block[f] != GC_BENCH_NONE)
+        {
+            flash_gc_block_closed(&state->gc, state->frontier_block[f]);
+        }
+        state->frontier_block[f] = state->free_blocks[--state->free_count];
+        state->frontier_page[f] = 0;
+    }
+
+    page = (state->frontier_block[f] * flash_dev->num_of_pages_per_block) +
+           state->frontier_page[f]++;
+    status = w25n01gv_page_program(flash_dev, page, data,
+                                   flash_dev->page_size, NULL);
+    if (status != FLASH_SUCCESS)
+    {
+        return status;
+    }
+
+    old = state->map[logical];
+    if (old != GC_BENCH_NONE)
+    {
+        state->rev[old - state->first_page] = GC_BENCH_NONE;
+        flash_gc_page_invalidated(&state->gc, old);
+    }
+    state->map[logical] = page;
+    state->rev[page - state->first_page] = logical;
+    flash_gc_page_written(&state->gc, page);
+
+    return FLASH_SUCCESS;
+}
+
+static bool page_valid(void* ctx, uint32_t page)
+{
+    gc_bench_state_t* state = ctx;
+
+    return state->rev[page - state->first_page] != GC_BENCH_NONE;
+}
+
+static int8_t move_page(void* ctx, uint32_t page)
+{
+    gc_bench_state_t* state = ctx;
+    int8_t status;
+
+    status = w25n01gv_page_read(state->flash_dev, page, state->buf,
+                                state->flash_dev->page_size, NULL);
+    if (status != FLASH_SUCCESS)
+    {
+        return status;
+    }
+    return ftl_write(state, state->rev[page - state->first_page], state->buf,
+                     false);
+}
+
+static void block_free(void* ctx, uint32_t block)
+{
+    gc_bench_state_t* state = ctx;
+
+    state->free_blocks[state->free_count++] = block;
+}
+
+static void page_fill(uint8_t* buf, uint32_t len, uint32_t logical,
+                      uint32_t version)
+{
+    memset(buf, (uint8_t)(logical ^ version), len);
+    memcpy(buf, &logical, sizeof(logical));
+    memcpy(buf + sizeof(logical), &version, sizeof(version));
+}
+
+static int8_t host_write(gc_bench_state_t* state, uint32_t logical,
+                         gc_bench_result_t* result)
+{
+    uint32_t reclaimed;
+    int8_t status;
+
+    while (frontier_full(state, 0) && (state->free_count < 2))
+    {
+        /* Out of blocks, the write waits for a whole block to be collected */
+        result->forced++;
+        status = flash_gc_run(&state->gc, 0, &reclaimed);
+        if (status != FLASH_SUCCESS)
+        {
+            return status;
+        }
+        if (reclaimed == 0)
+        {
+            return FLASH_MISC_FAILURE;
+        }
+    }
+
+    state->version[logical]++;
+    page_fill(state->buf, state->flash_dev->page_size, logical,
+              state->version[logical]);
+    return ftl_write(state, logical, state->buf, true);
+}
+
+static int8_t run_once(gc_bench_state_t* state, const gc_bench_config_t* cfg,
+                       bool incremental, gc_bench_result_t* result)
+{
+    flash_device_t* flash_dev = state->flash_dev;
+    flash_gc_config_t gc_cfg;
+    uint32_t block_size = flash_dev->page_size *
+                          flash_dev->num_of_pages_per_block;
+    uint32_t hot_pages = state->logical_pages / 5;
+    uint32_t logical;
+    uint32_t start;
+    uint32_t run_start;
+    uint64_t total_us = 0;
+    int8_t status;
+
+    memset(result, 0, sizeof(*result));
+    rng_state = (cfg->seed != 0) ? cfg->seed : 1;
+
+    memset(&gc_cfg, 0, sizeof(gc_cfg));
+    gc_cfg.flash_dev = flash_dev;
+    gc_cfg.erase = w25n01gc_flash_erase;
+    gc_cfg.page_valid = page_valid;
+    gc_cfg.move_page = move_page;
+    gc_cfg.block_free = block_free;
+    gc_cfg.ctx = state;
+    gc_cfg.time_us = w25n01gv_sim_time_us;
+    gc_cfg.first_block = cfg->first_block;
+    gc_cfg.num_blocks = cfg->num_blocks;
+    gc_cfg.valid = state->valid;
+    gc_cfg.stamp = state->stamp;
+    status = flash_gc_init(&state->gc, &gc_cfg);
+    if (status != FLASH_SUCCESS)
+    {
+        return status;
+    }
+
+    state->free_count = 0;
+    for (uint32_t b = cfg->num_blocks; b-- > 0;)
+    {
+        status = w25n01gc_flash_erase(flash_dev,
+                                      (cfg->first_block + b) * block_size,
+                                      block_size);
+        if (status != FLASH_SUCCESS)
+        {
+            return status;
+        }
+        state->free_blocks[state->free_count++] = cfg->first_block + b;
+    }
+    for (uint32_t p = 0; p < state->num_pages; p++)
+    {
+        state->rev[p] = GC_BENCH_NONE;
+    }
+    for (uint32_t l = 0; l < state->logical_pages; l++)
+    {
+        state->map[l] = GC_BENCH_NONE;
+        state->version[l] = 0;
+    }
+    state->frontier_block[0] = GC_BENCH_NONE;
+    state->frontier_block[1] = GC_BENCH_NONE;
+
+    /* Fill, not timed */
+    for (uint32_t l = 0; l < state->logical_pages; l++)
+    {
+        status = host_write(state, l, result);
+        if (status != FLASH_SUCCESS)
+        {
+            return status;
+        }
+    }
+    memset(&state->gc.counters, 0, sizeof(state->gc.counters));
+    result->forced = 0;
+
+    for (uint32_t w = 0; w < cfg->writes; w++)
+    {
+        if ((rng() % 10) < 8)
+        {
+            logical = rng() % hot_pages;
+        }
+        else
+        {
+            logical = hot_pages + (rng() % (state->logical_pages - hot_pages));
+        }
+
+        start = w25n01gv_sim_time_us();
+        if (incremental && (state->free_count < cfg->reserve))
+        {
+            run_start = w25n01gv_sim_time_us();
+            status = flash_gc_run(&state->gc, cfg->budget_us, NULL);
+            if (status != FLASH_SUCCESS)
+            {
+                return status;
+            }
+            state->run_lat[result->runs++] =
+                w25n01gv_sim_time_us() - run_start;
+        }
+        status = host_write(state, logical, result);
+        if (status != FLASH_SUCCESS)
+        {
+            return status;
+        }
+        state->lat[w] = w25n01gv_sim_time_us() - start;
+        total_us += state->lat[w];
+    }
+
+    /* Every logical page must hold its last version */
+    for (uint32_t l = 0; l < state->logical_pages; l++)
+    {
+        uint32_t hdr[2];
+
+        if (w25n01gv_page_read(flash_dev, state->map[l], (uint8_t*)hdr,
+                               sizeof(hdr), NULL) != FLASH_SUCCESS)
+        {
+            result->errors++;
+            continue;
+        }
+        if ((hdr[0] != l) || (hdr[1] != state->version[l]))
+        {
+            result->errors++;
+        }
+    }
+
+    qsort(state->lat, cfg->writes, sizeof(uint32_t), cmp_u32);
+    result->max_us = state->lat[cfg->writes - 1];
+    result->p99_us = state->lat[(cfg->writes * 99) / 100];
+    result->p999_us = state->lat[(cfg->writes * 999) / 1000];
+    result->avg_us = (uint32_t)(total_us / cfg->writes);
+
+    if (result->runs != 0)
+    {
+        qsort(state->run_lat, result->runs, sizeof(uint32_t), cmp_u32);
+        result->run_p99_us = state->run_lat[(result->runs * 99) / 100];
+        result->run_max_us = state->run_lat[result->runs - 1];
+    }
+
+    return FLASH_SUCCESS;
+}
+
+static void print_result(const char* name, const gc_bench_state_t* state,
+                         const gc_bench_result_t* result)
+{
+    LOG_FLASH(INFO, "gc: %s write us avg %u p99 %u p99.9 %u max %u, "
+                    "forced %u",
+              name, result->avg_us, result->p99_us, result->p999_us,
+              result->max_us, result->forced);
+    LOG_FLASH(INFO, "gc: %s moved %u, reclaimed %u, runs %u, over budget "
+                    "%u, WA x100 %u, errors %u",
+              name, state->gc.counters.pages_moved,
+              state->gc.counters.blocks_reclaimed, state->gc.counters.runs,
+              state->gc.counters.budget_overruns,
+              flash_gc_write_amp(&state->gc), result->errors);
+    if (result->runs != 0)
+    {
+        LOG_FLASH(INFO, "gc: %s budgeted runs %u, run us p99 %u max %u",
+                  name, result->runs, result->run_p99_us, result->run_max_us);
+    }
+}
+
+int8_t gc_bench_run(w25n01gv_sim_t* sim, flash_device_t* flash_dev,
+                    const gc_bench_config_t* cfg)
+{
+    gc_bench_state_t state;
+    gc_bench_result_t result;
+    int8_t status = FLASH_MISC_FAILURE;
+    bool ok = true;
+
+    (void)sim;
+
+    if ((cfg->writes == 0) || (cfg->num_blocks < (cfg->reserve + 4)))
+    {
+        return FLASH_INVALID_PARAMS;
+    }
+
+    memset(&state, 0, sizeof(state));
+    state.flash_dev = flash_dev;
+    state.first_page = cfg->first_block * flash_dev->num_of_pages_per_block;
+    state.num_pages = cfg->num_blocks * flash_dev->num_of_pages_per_block;
+    /* 75% utilisation */
+    state.logical_pages = (state.num_pages * 3) / 4;
+    state.map = malloc(state.logical_pages * sizeof(uint32_t));
+    state.version = malloc(state.logical_pages * sizeof(uint32_t));
+    state.rev = malloc(state.num_pages * sizeof(uint32_t));
+    state.free_blocks = malloc(cfg->num_blocks * sizeof(uint32_t));
+    state.valid = malloc(cfg->num_blocks * sizeof(uint16_t));
+    state.stamp = malloc(cfg->num_blocks * sizeof(uint32_t));
+    state.lat = malloc(cfg->writes * sizeof(uint32_t));
+    state.run_lat = malloc(cfg->writes * sizeof(uint32_t));
+    state.buf = malloc(flash_dev->page_size);
+
+    if ((state.map != NULL) && (state.version != NULL) &&
+        (state.rev != NULL) && (state.free_blocks != NULL) &&
+        (state.valid != NULL) && (state.stamp != NULL) &&
+        (state.lat != NULL) && (state.run_lat != NULL) &&
+        (state.buf != NULL))
+    {
+        LOG_FLASH(INFO, "gc: blocks %u-%u, %u logical pages, %u writes, "
+                        "budget %u us below %u free blocks",
+                  cfg->first_block, cfg->first_block + cfg->num_blocks - 1,
+                  state.logical_pages, cfg->writes, cfg->budget_us,
+                  cfg->reserve);
+
+        status = run_once(&state, cfg, false, &result);
+        if (status == FLASH_SUCCESS)
+        {
+            print_result("block:", &state, &result);
+            ok &= (result.errors == 0);
+            status = run_once(&state, cfg, true, &result);
+        }
+        if (status == FLASH_SUCCESS)
+        {
+            print_result("incr: ", &state, &result);
+            ok &= (result.errors == 0);
+        }
+        if (!ok)
+        {
+            status = FLASH_MISC_FAILURE;
+        }
+    }
+
+    free(state.map);
+    free(state.version);
+    free(state.rev);
+    free(state.free_blocks);
+    free(state.valid);
+    free(state.stamp);
+    free(state.lat);
+    free(state.run_lat);
+    free(state.buf);
+    return status;
+}
@@ -0,0 +1,32 @@
+#ifndef _GC_BENCH_H_
+#define _GC_BENCH_H_
+
+#include "ext_flash.h"
+#include "w25n01gv_sim.h"
+
+/*
+ * Drives flash_gc under a small page mapped FTL. The logical space is
+ * filled once, then overwritten at random with 80% of the writes going to
+ * 20% of the pages. The same workload runs twice: collecting a whole block
+ * only when the FTL runs out of free blocks, and incrementally with a
+ * budget before every write once free blocks run low. Latency of every
+ * foreground write, GC included, the time of each budgeted GC run and GC
+ * write amplification are reported, and the logical space is verified at
+ * the end.
+ */
+
+typedef struct gc_bench_config
+{
+    uint32_t writes;
+    uint32_t budget_us;
+    uint32_t first_block;
+    uint32_t num_blocks;
+    /* Free blocks below which incremental GC runs before every write */
+    uint32_t reserve;
+    uint32_t seed;
+} gc_bench_config_t;
+
+int8_t gc_bench_run(w25n01gv_sim_t* sim, flash_device_t* flash_dev,
+                    const gc_bench_config_t* cfg);
+
+#endif
@@ -0,0 +1,340 @@
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "w25n01gv_internal.h"
+#include "w25n01gv_sim.h"
+#include "flash_bench.h"
+#include "stream_bench.h"
+#include "commit_bench.h"
+#include "scrub_bench.h"
+#include "gc_bench.h"
+
+#define DEFAULT_REGION_LEN  (1024U * 1024U)
+#define DEFAULT_XFER_SIZE   (2048U)
+#define SWEEP_MIN_SIZE      (64U)
+#define SWEEP_MAX_SIZE      (128U * 1024U)
+#define MAX_LAT_SAMPLES     (64U * 1024U)
+#define BENCH_BASE_ADDR     (0U)
+#define DEFAULT_STREAM_MS   (10000U)
+#define DEFAULT_RING_SIZE   (8U * 1024U)
+/* flash_commit log for -P, away from the benchmark region */
+#define COMMIT_FIRST_BLOCK  (512U)
+#define COMMIT_NUM_BLOCKS   (4U)
+/* flash_scrub aging test for -E, 8 data and 8 spare blocks */
+#define SCRUB_FIRST_BLOCK   (640U)
+#define SCRUB_NUM_BLOCKS    (16U)
+#define SCRUB_READS         (4U)
+#define SCRUB_CHECKS        (32U)
+/*
+ * flash_gc workload for -G, 32 blocks at 75% utilisation. It runs at 32 MHz
+ * unless -c is given: at 8 MHz the two 2 KB transfers of a page move alone
+ * take 4 ms. The budget fits two moves there, about what 75% needs per write.
+ */
+#define GC_FIRST_BLOCK      (700U)
+#define GC_NUM_BLOCKS       (32U)
+#define GC_RESERVE          (3U)
+#define GC_SPI_HZ           (32000000U)
+#define DEFAULT_GC_BUDGET   (3000U)
+
+#ifdef EXT_FLASH_NO_STATIC_BUF
+/* Caller arena for -A, what the driver needs with a plain spi_xfer hook */
+static uint8_t spi_scratch[EXT_FLASH_SCRATCH_SIZE(W25N01GV_SIM_PAGE_SIZE,
+                                                  W25N01GV_SIM_SPARE_SIZE)];
+#endif
+
+/* Wall clock for CPU side measurements, the sim clock only moves on SPI */
+static uint32_t host_time_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000);
+}
+
+static void usage(const char* prog)
+{
+    fprintf(stderr,
+            "usage: %s [-c spi_khz] [-r region_kb] [-s xfer_size] [-S] "
+            "[-n max_ops] [-b bad_block] [-e ecc_page] [-g iterations]\n"
+            "       [-I rate_hz [-t ms] [-R ring_size]] [-P rounds] [-E epochs]\n"
+            "       [-G writes [-B budget_us]] [-D image] [-A] [-q]\n"
+            "  -c  SPI clock in kHz (default 8000, 32000 with -G)\n"
+            "  -r  size of the region under test in KB (default 1024)\n"
+            "  -s  bytes per read/program call (default 2048)\n"
+            "  -S  sweep transfer sizes from 64 B to 128 KB instead\n"
+            "  -n  cap on calls per test (default whole region)\n"
+            "  -b  mark a block bad, may be repeated\n"
+            "  -e  report ECC correction on a page, may be repeated\n"
+            "  -g  time address decomposition, div/mod vs shift/mask\n"
+            "  -I  log a 16 B record stream at rate_hz through flash_stream\n"
+            "  -t  stream duration in ms of virtual time (default 10000)\n"
+            "  -R  stream ring size in bytes, power of two (default 8192)\n"
+            "  -P  flash_commit power cut test, rounds of write/cut/remount\n"
+            "  -E  flash_scrub aging test, epochs without and with scrubbing\n"
+            "  -G  flash_gc workload, whole block vs incremental collection\n"
+            "  -B  incremental GC budget per write in us (default 3000)\n"
+            "  -D  write the array to image afterwards, page + spare, for "
+            "nand_dump\n"
+            "  -A  NO_STATIC_BUF build only, stage SPI transfers in a "
+            "scratch arena\n"
+            "      instead of the header/data split hook\n"
+            "  -q  skip the driver stats dump\n",
+            prog);
+}
+
+int main(int argc, char** argv)
+{
+    w25n01gv_sim_timing_t timing;
+    w25n01gv_sim_t* sim;
+    flash_device_t flash_dev;
+    flash_bench_t bench;
+    flash_bench_result_t result;
+    uint32_t xfer_size = DEFAULT_XFER_SIZE;
+    uint32_t region_len = DEFAULT_REGION_LEN;
+    bool dump_stats = true;
+    bool sweep = false;
+    bool spi_set = false;
+    bool use_scratch = false;
+    const char* dump_path = NULL;
+    uint32_t max_ops = 0;
+    uint32_t geometry_iterations = 0;
+    stream_bench_config_t stream_cfg = {0, DEFAULT_STREAM_MS,
+                                        DEFAULT_RING_SIZE, 0};
+    commit_bench_config_t commit_cfg = {0, COMMIT_FIRST_BLOCK,
+                                        COMMIT_NUM_BLOCKS, 1};
+    scrub_bench_config_t scrub_cfg = {0, SCRUB_FIRST_BLOCK, SCRUB_NUM_BLOCKS,
+                                      SCRUB_READS, SCRUB_CHECKS, 1};
+    gc_bench_config_t gc_cfg = {0, DEFAULT_GC_BUDGET, GC_FIRST_BLOCK,
+                                GC_NUM_BLOCKS, GC_RESERVE, 1};
+    int8_t status;
+    int opt;
+
+    w25n01gv_sim_default_timing(&timing);
+
+    sim = w25n01gv_sim_create(&timing);
+    if (sim == NULL)
+    {
+        return EXIT_FAILURE;
+    }
+
+    while ((opt = getopt(argc, argv, "c:r:s:Sn:b:e:g:I:t:R:P:E:G:B:D:Aqh")) != -1)
+    {
+        switch (opt)
+        {
+            case 'c':
+                sim->timing.spi_hz = strtoul(optarg, NULL, 0) * 1000;
+                spi_set = true;
+                break;
+            case 'r':
+                region_len = strtoul(optarg, NULL, 0) * 1024;
+                break;
+            case 's':
+                xfer_size = strtoul(optarg, NULL, 0);
+                break;
+            case 'S':
+                sweep = true;
+                break;
+            case 'n':
+                max_ops = strtoul(optarg, NULL, 0);
+                break;
+            case 'b':
+                w25n01gv_sim_mark_bad_block(sim, strtoul(optarg, NULL, 0));
+                break;
+            case 'e':
+                w25n01gv_sim_set_page_ecc(sim, strtoul(optarg, NULL, 0),
+                                          ECC_SUCCESS_CORRECTION);
+                break;
+            case 'g':
+                geometry_iterations = strtoul(optarg, NULL, 0);
+                break;
+            case 'I':
+                stream_cfg.rate_hz = strtoul(optarg, NULL, 0);
+                break;
+            case 't':
+                stream_cfg.duration_ms = strtoul(optarg, NULL, 0);
+                break;
+            case 'R':
+                stream_cfg.ring_size = strtoul(optarg, NULL, 0);
+                break;
+            case 'P':
+                commit_cfg.rounds = strtoul(optarg, NULL, 0);
+                break;
+            case 'E':
+                scrub_cfg.epochs = strtoul(optarg, NULL, 0);
+                break;
+            case 'G':
+                gc_cfg.writes = strtoul(optarg, NULL, 0);
+                break;
+            case 'B':
+                gc_cfg.budget_us = strtoul(optarg, NULL, 0);
+                break;
+            case 'D':
+                dump_path = optarg;
+                break;
+            case 'A':
+                use_scratch = true;
+                break;
+            case 'q':
+                dump_stats = false;
+                break;
+            default:
+                usage(argv[0]);
+                w25n01gv_sim_destroy(sim);
+                return EXIT_FAILURE;
+        }
+    }
+
+    if ((gc_cfg.writes != 0) && !spi_set)
+    {
+        sim->timing.spi_hz = GC_SPI_HZ;
+    }
+
+    if ((sim->timing.spi_hz == 0) || (xfer_size == 0) || (region_len == 0))
+    {
+        usage(argv[0]);
+        w25n01gv_sim_destroy(sim);
+        return EXIT_FAILURE;
+    }
+
+    memset(&flash_dev, 0, sizeof(flash_dev));
+    flash_dev.spi_xfer = w25n01gv_sim_spi_xfer;
+#ifdef EXT_FLASH_NO_STATIC_BUF
+    if (use_scratch)
+    {
+        flash_dev.scratch = spi_scratch;
+        flash_dev.scratch_len = sizeof(spi_scratch);
+    }
+    else
+    {
+        flash_dev.spi_xfer_seg = w25n01gv_sim_spi_xfer_seg;
+    }
+#else
+    if (use_scratch)
+    {
+        fprintf(stderr, "-A needs a NO_STATIC_BUF=1 build, ignored\n");
+    }
+#endif
+    flash_dev.sleep = w25n01gv_sim_sleep;
+    flash_dev.delay_us = w25n01gv_sim_delay_us;
+#ifdef EXT_FLASH_STATS
+    flash_dev.time_us = w25n01gv_sim_time_us;
+#endif
+    flash_dev.flash_size = W25N01GV_SIM_NUM_BLOCKS *
+                           W25N01GV_SIM_PAGES_PER_BLOCK *
+                           W25N01GV_SIM_PAGE_SIZE;
+    flash_dev.num_of_pages_per_block = W25N01GV_SIM_PAGES_PER_BLOCK;
+    flash_dev.num_of_blocks = W25N01GV_SIM_NUM_BLOCKS;
+    flash_dev.page_size = W25N01GV_SIM_PAGE_SIZE;
+    flash_dev.num_ecc_bytes_per_page = W25N01GV_SIM_SPARE_SIZE;
+
+    status = w25n01gv_init(&flash_dev);
+    if (status != FLASH_SUCCESS)
+    {
+        LOG_FLASH(ERROR, "w25n01gv init fail: %d", status);
+        w25n01gv_sim_destroy(sim);
+        return EXIT_FAILURE;
+    }
+
+    memset(&bench, 0, sizeof(bench));
+    bench.flash_dev = &flash_dev;
+    bench.time_us = w25n01gv_sim_time_us;
+    bench.base_addr = BENCH_BASE_ADDR;
+    bench.region_len = region_len;
+    bench.max_ops = max_ops;
+    bench.buf_len = sweep ? SWEEP_MAX_SIZE : xfer_size;
+    bench.buf = malloc(bench.buf_len);
+    bench.lat_buf_len = MAX_LAT_SAMPLES;
+    bench.lat_buf = malloc(MAX_LAT_SAMPLES * sizeof(uint32_t));
+    if ((bench.buf == NULL) || (bench.lat_buf == NULL))
+    {
+        w25n01gv_sim_destroy(sim);
+        return EXIT_FAILURE;
+    }
+
+    LOG_FLASH(INFO, "W25N01GV sim: SPI %u kHz, tRD %u us, tPP %u us, "
+                    "tBE %u us, region %u KB",
+              sim->timing.spi_hz / 1000, sim->timing.t_rd_us,
+              sim->timing.t_pp_us, sim->timing.t_be_us, region_len / 1024);
+
+    if (geometry_iterations != 0)
+    {
+        bench.time_us = host_time_us;
+        status = flash_bench_geometry(&bench, geometry_iterations);
+        free(bench.buf);
+        free(bench.lat_buf);
+        w25n01gv_sim_destroy(sim);
+        return (status == FLASH_SUCCESS) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    FLASH_STATS_RESET(&flash_dev);
+
+    if (commit_cfg.rounds != 0)
+    {
+        status = commit_bench_run(sim, &flash_dev, &commit_cfg);
+    }
+    else if (scrub_cfg.epochs != 0)
+    {
+        status = scrub_bench_run(sim, &flash_dev, &scrub_cfg);
+    }
+    else if (gc_cfg.writes != 0)
+    {
+        status = gc_bench_run(sim, &flash_dev, &gc_cfg);
+    }
+    else if (stream_cfg.rate_hz != 0)
+    {
+        stream_cfg.region_len = region_len;
+        status = stream_bench_run(sim, &flash_dev, &stream_cfg);
+    }
+    else if (sweep)
+    {
+        flash_bench_print_header();
+        status = flash_bench_sweep(&bench, SWEEP_MIN_SIZE, SWEEP_MAX_SIZE,
+                                   true);
+    }
+    else
+    {
+        flash_bench_print_header();
+        status = flash_bench_erase(&bench, FLASH_BENCH_SEQUENTIAL,
+                                   region_len, &result);
+        flash_bench_print(&result);
+        status |= flash_bench_program(&bench, FLASH_BENCH_SEQUENTIAL,
+                                      xfer_size, &result);
+        flash_bench_print(&result);
+        status |= flash_bench_read(&bench, FLASH_BENCH_SEQUENTIAL, xfer_size,
+                                   true, &result);
+        flash_bench_print(&result);
+    }
+
+    LOG_FLASH(INFO, "sim: xfers %u, status reads %u, page reads %u, "
+                    "programs %u, erases %u, busy rejects %u, WEL rejects %u",
+              sim->counters.xfers, sim->counters.status_reads,
+              sim->counters.page_reads, sim->counters.page_programs,
+              sim->counters.block_erases, sim->counters.busy_rejects,
+              sim->counters.wel_rejects);
+
+    /* Passes on the sim but corrupts pages on a real chip */
+    if (sim->counters.nop_violations != 0)
+    {
+        LOG_FLASH(ERROR, "sim: %u partial program (NOP) violations",
+                  sim->counters.nop_violations);
+        status = FLASH_MISC_FAILURE;
+    }
+
+    if (dump_stats)
+    {
+        FLASH_STATS_DUMP(&flash_dev);
+    }
+
+    if ((dump_path != NULL) && (w25n01gv_sim_dump(sim, dump_path) != 0))
+    {
+        LOG_FLASH(ERROR, "sim: cannot write image %s", dump_path);
+        status = FLASH_MISC_FAILURE;
+    }
+
+    free(bench.buf);
+    free(bench.lat_buf);
+    w25n01gv_sim_destroy(sim);
+
+    return (status == FLASH_SUCCESS) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
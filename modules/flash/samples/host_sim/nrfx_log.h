@@ -0,0 +1,24 @@
+#ifndef _HOST_NRFX_LOG_H_
+#define _HOST_NRFX_LOG_H_
+
+/* Host replacement for the nRF log front end, used by the simulator build */
+
+#include <stdio.h>
+
+#define NRF_LOG_ERROR(...)                  \
+    do {                                    \
+        fprintf(stderr, __VA_ARGS__);       \
+        fprintf(stderr, "\n");              \
+    } while (0)
+
+#define NRF_LOG_INFO(...)                   \
+    do {                                    \
+        printf(__VA_ARGS__);                \
+        printf("\n");                       \
+    } while (0)
+
+#define NRF_LOG_PUSH(str)                   (str)
+#define NRF_LOG_DEBUG(...)                  do { } while (0)
+#define NRF_LOG_HEXDUMP_DEBUG(p_data, len)  do { } while (0)
+
+#endif
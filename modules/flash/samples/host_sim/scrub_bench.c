@@ -0,0 +1,369 @@
+#include <stdlib.h>
+
+#include "scrub_bench.h"
+#include "flash_scrub.h"
+#include "w25n01gv_internal.h"
+
+#define SCRUB_BENCH_QUEUE_SIZE  (16U)
+#define SCRUB_BENCH_NO_PAGE     UINT32_MAX
+
+typedef struct scrub_bench_state
+{
+    w25n01gv_sim_t* sim;
+    flash_device_t* flash_dev;
+    uint32_t first_page;
+    uint32_t num_pages;
+    uint32_t data_pages;
+    /* Logical data page to physical page and back, relative to first_page */
+    uint32_t* map;
+    uint32_t* rev;
+    uint32_t next_spare;
+    uint8_t* buf;
+    uint8_t* expect;
+    uint32_t moved;
+    uint32_t dropped;
+    uint32_t out_of_spare;
+} scrub_bench_state_t;
+
+typedef struct scrub_bench_result
+{
+    uint32_t reads;
+    uint32_t read_corrected;
+    uint32_t read_failed;
+    uint32_t lost;
+    uint32_t addr_mismatch;
+    uint64_t idle_us;
+} scrub_bench_result_t;
+
+static uint32_t rng_state;
+
+static uint32_t rng(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static void page_fill(uint8_t* buf, uint32_t len, uint32_t logical)
+{
+    uint32_t x = (logical + 1) * 2654435761U;
+
+    for (uint32_t i = 0; i < len; i++)
+    {
+        x = x * 1103515245U + 12345U;
+        buf[i] = (uint8_t)(x >> 16);
+    }
+}
+
+static int8_t program_logical(scrub_bench_state_t* state, uint32_t logical,
+                              uint32_t phys)
+{
+    page_fill(state->buf, state->flash_dev->page_size, logical);
+    return w25n01gv_page_program(state->flash_dev, state->first_page + phys,
+                                 state->buf, state->flash_dev->page_size,
+                                 NULL);
+}
+
+/* Owner side of the scrubber: copy a live page to the next spare page */
+static int8_t relocate(void* ctx, uint32_t page, bool uncorrectable)
+{
+    scrub_bench_state_t* state = ctx;
+    uint32_t phys = page - state->first_page;
+    uint32_t logical = state->rev[phys];
+    int8_t status;
+
+    if (logical == SCRUB_BENCH_NO_PAGE)
+    {
+        return FLASH_SUCCESS;
+    }
+
+    if (uncorrectable)
+    {
+        /* Nothing left to copy, the data is gone */
+        state->dropped++;
+        state->rev[phys] = SCRUB_BENCH_NO_PAGE;
+        state->map[logical] = SCRUB_BENCH_NO_PAGE;
+        return FLASH_SUCCESS;
+    }
+
+    if (state->next_spare == state->num_pages)
+    {
+        state->out_of_spare++;
+        return FLASH_MISC_FAILURE;
+    }
+
+    status = w25n01gv_page_read(state->flash_dev, page, state->buf,
+                                state->flash_dev->page_size, NULL);
+    if (status != FLASH_SUCCESS)
+    {
+        return status;
+    }
+    status = w25n01gv_page_program(state->flash_dev,
+                                   state->first_page + state->next_spare,
+                                   state->buf, state->flash_dev->page_size,
+                                   NULL);
+    if (status != FLASH_SUCCESS)
+    {
+        return status;
+    }
+
+    state->rev[phys] = SCRUB_BENCH_NO_PAGE;
+    state->rev[state->next_spare] = logical;
+    state->map[logical] = state->next_spare++;
+    state->moved++;
+
+    return FLASH_SUCCESS;
+}
+
+/* One step down: clean, needs correction, uncorrectable */
+static void age_page(scrub_bench_state_t* state, uint32_t logical)
+{
+    uint32_t phys = state->map[logical];
+    uint8_t ecc;
+
+    if (phys == SCRUB_BENCH_NO_PAGE)
+    {
+        return;
+    }
+
+    ecc = state->sim->page_ecc[state->first_page + phys];
+    if (ecc < ECC_FAIL_SINGLE_PAGE)
+    {
+        w25n01gv_sim_set_page_ecc(state->sim, state->first_page + phys,
+                                  ecc + 1);
+    }
+}
+
+static int8_t app_read(scrub_bench_state_t* state, uint32_t logical,
+                       scrub_bench_result_t* result)
+{
+    uint32_t phys = state->map[logical];
+    uint16_t fail_page;
+    int8_t status;
+
+    if (phys == SCRUB_BENCH_NO_PAGE)
+    {
+        return FLASH_SUCCESS;
+    }
+
+    result->reads++;
+    if (state->sim->page_ecc[state->first_page + phys] ==
+        ECC_SUCCESS_CORRECTION)
+    {
+        result->read_corrected++;
+    }
+
+    status = w25n01gv_page_read(state->flash_dev, state->first_page + phys,
+                                state->buf, state->flash_dev->page_size,
+                                NULL);
+    if (status > FLASH_SUCCESS)
+    {
+        /* Where a real system would go into read retry or recovery */
+        result->read_failed++;
+        status = w25n01gv_last_ecc_failure_addr(state->flash_dev, &fail_page);
+        if ((status == FLASH_SUCCESS) &&
+            (fail_page != state->first_page + phys))
+        {
+            result->addr_mismatch++;
+        }
+    }
+
+    return (status < FLASH_SUCCESS) ? status : FLASH_SUCCESS;
+}
+
+static int8_t run_once(scrub_bench_state_t* state,
+                       const scrub_bench_config_t* cfg, bool scrub_on,
+                       scrub_bench_result_t* result)
+{
+    flash_device_t* flash_dev = state->flash_dev;
+    flash_scrub_config_t scrub_cfg;
+    flash_scrub_t scrub;
+    uint32_t queue[SCRUB_BENCH_QUEUE_SIZE];
+    uint32_t block_size = flash_dev->page_size *
+                          flash_dev->num_of_pages_per_block;
+    uint64_t start_ns;
+    int8_t status;
+
+    memset(result, 0, sizeof(*result));
+    rng_state = (cfg->seed != 0) ? cfg->seed : 1;
+    flash_dev->ecc_corrected = NULL;
+
+    for (uint32_t b = 0; b < cfg->num_blocks; b++)
+    {
+        status = w25n01gc_flash_erase(flash_dev,
+                                      (cfg->first_block + b) * block_size,
+                                      block_size);
+        if (status != FLASH_SUCCESS)
+        {
+            return status;
+        }
+    }
+
+    for (uint32_t p = 0; p < state->num_pages; p++)
+    {
+        state->rev[p] = SCRUB_BENCH_NO_PAGE;
+    }
+    for (uint32_t l = 0; l < state->data_pages; l++)
+    {
+        status = program_logical(state, l, l);
+        if (status != FLASH_SUCCESS)
+        {
+            return status;
+        }
+        state->map[l] = l;
+        state->rev[l] = l;
+    }
+    state->next_spare = state->data_pages;
+    state->moved = 0;
+    state->dropped = 0;
+    state->out_of_spare = 0;
+
+    if (scrub_on)
+    {
+        memset(&scrub_cfg, 0, sizeof(scrub_cfg));
+        scrub_cfg.flash_dev = flash_dev;
+        scrub_cfg.page_check = w25n01gv_page_check;
+        scrub_cfg.relocate = relocate;
+        scrub_cfg.ctx = state;
+        scrub_cfg.first_page = state->first_page;
+        scrub_cfg.num_pages = state->num_pages;
+        scrub_cfg.queue = queue;
+        scrub_cfg.queue_size = SCRUB_BENCH_QUEUE_SIZE;
+        status = flash_scrub_init(&scrub, &scrub_cfg);
+        if (status != FLASH_SUCCESS)
+        {
+            return status;
+        }
+    }
+
+    for (uint32_t epoch = 0; epoch < cfg->epochs; epoch++)
+    {
+        age_page(state, rng() % state->data_pages);
+
+        for (uint32_t r = 0; r < cfg->reads_per_epoch; r++)
+        {
+            status = app_read(state, rng() % state->data_pages, result);
+            if (status != FLASH_SUCCESS)
+            {
+                return status;
+            }
+        }
+
+        if (scrub_on)
+        {
+            start_ns = state->sim->now_ns;
+            status = flash_scrub_step(&scrub, cfg->checks_per_epoch, NULL);
+            result->idle_us += (state->sim->now_ns - start_ns) / 1000;
+            if (status != FLASH_SUCCESS)
+            {
+                return status;
+            }
+        }
+    }
+    flash_dev->ecc_corrected = NULL;
+
+    /* Final read back of every page, lost if dropped, unreadable or wrong */
+    for (uint32_t l = 0; l < state->data_pages; l++)
+    {
+        if ((state->map[l] == SCRUB_BENCH_NO_PAGE) ||
+            (w25n01gv_page_read(flash_dev, state->first_page + state->map[l],
+                                state->buf, flash_dev->page_size,
+                                NULL) != FLASH_SUCCESS))
+        {
+            result->lost++;
+            continue;
+        }
+        page_fill(state->expect, flash_dev->page_size, l);
+        if (memcmp(state->buf, state->expect, flash_dev->page_size) != 0)
+        {
+            result->lost++;
+        }
+    }
+
+    if (scrub_on)
+    {
+        LOG_FLASH(INFO, "scrub: on:  checked %u pages in %u passes, "
+                        "corrected %u, uncorrectable %u",
+                  scrub.counters.pages_checked, scrub.counters.passes,
+                  scrub.counters.corrected, scrub.counters.uncorrectable);
+        LOG_FLASH(INFO, "scrub: on:  queued %u, dropped %u, moved %u pages, "
+                        "idle time %u ms",
+                  scrub.counters.queued, scrub.counters.queue_drops,
+                  state->moved, (uint32_t)(result->idle_us / 1000));
+    }
+
+    return FLASH_SUCCESS;
+}
+
+static void print_result(const char* name, const scrub_bench_result_t* result,
+                         uint32_t data_pages)
+{
+    LOG_FLASH(INFO, "scrub: %s reads %u, needed correction %u, "
+                    "uncorrectable %u, pages lost %u of %u",
+              name, result->reads, result->read_corrected,
+              result->read_failed, result->lost, data_pages);
+}
+
+int8_t scrub_bench_run(w25n01gv_sim_t* sim, flash_device_t* flash_dev,
+                       const scrub_bench_config_t* cfg)
+{
+    scrub_bench_state_t state;
+    scrub_bench_result_t off;
+    scrub_bench_result_t on;
+    int8_t status = FLASH_MISC_FAILURE;
+
+    if ((cfg->num_blocks < 2) || (cfg->epochs == 0))
+    {
+        return FLASH_INVALID_PARAMS;
+    }
+
+    memset(&state, 0, sizeof(state));
+    state.sim = sim;
+    state.flash_dev = flash_dev;
+    state.first_page = cfg->first_block * flash_dev->num_of_pages_per_block;
+    state.num_pages = cfg->num_blocks * flash_dev->num_of_pages_per_block;
+    state.data_pages = (cfg->num_blocks / 2) *
+                       flash_dev->num_of_pages_per_block;
+    state.map = malloc(state.data_pages * sizeof(uint32_t));
+    state.rev = malloc(state.num_pages * sizeof(uint32_t));
+    state.buf = malloc(flash_dev->page_size);
+    state.expect = malloc(flash_dev->page_size);
+
+    if ((state.map != NULL) && (state.rev != NULL) && (state.buf != NULL) &&
+        (state.expect != NULL))
+    {
+        LOG_FLASH(INFO, "scrub: blocks %u-%u, %u epochs, %u reads and %u "
+                        "checks per epoch",
+                  cfg->first_block, cfg->first_block + cfg->num_blocks - 1,
+                  cfg->epochs, cfg->reads_per_epoch, cfg->checks_per_epoch);
+
+        status = run_once(&state, cfg, false, &off);
+        if (status == FLASH_SUCCESS)
+        {
+            status = run_once(&state, cfg, true, &on);
+        }
+    }
+
+    if (status == FLASH_SUCCESS)
+    {
+        print_result("off:", &off, state.data_pages);
+        print_result("on: ", &on, state.data_pages);
+        if ((off.addr_mismatch != 0) || (on.addr_mismatch != 0))
+        {
+            LOG_FLASH(ERROR, "scrub: last ECC failure address mismatch");
+            status = FLASH_MISC_FAILURE;
+        }
+        if (state.out_of_spare != 0)
+        {
+            LOG_FLASH(INFO, "scrub: ran out of spare pages %u times",
+                      state.out_of_spare);
+        }
+    }
+
+    free(state.map);
+    free(state.rev);
+    free(state.buf);
+    free(state.expect);
+    return status;
+}
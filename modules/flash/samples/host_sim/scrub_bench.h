@@ -0,0 +1,30 @@
+#ifndef _SCRUB_BENCH_H_
+#define _SCRUB_BENCH_H_
+
+#include "ext_flash.h"
+#include "w25n01gv_sim.h"
+
+/*
+ * Ages a region of mapped pages and compares running without and with
+ * flash_scrub. Every epoch one random data page degrades a step (clean,
+ * needs correction, uncorrectable), the application reads a few random
+ * pages and, with the scrubber on, the idle loop gets a budget of page
+ * checks. Degrading pages are relocated to spare blocks. At the end every
+ * page is read back and the pages lost to uncorrectable errors are counted.
+ */
+
+typedef struct scrub_bench_config
+{
+    uint32_t epochs;
+    uint32_t first_block;
+    /* Half hold data, half are spare for relocation */
+    uint32_t num_blocks;
+    uint32_t reads_per_epoch;
+    uint32_t checks_per_epoch;
+    uint32_t seed;
+} scrub_bench_config_t;
+
+int8_t scrub_bench_run(w25n01gv_sim_t* sim, flash_device_t* flash_dev,
+                       const scrub_bench_config_t* cfg);
+
+#endif
@@ -0,0 +1,212 @@
+#include <stdlib.h>
+
+#include "stream_bench.h"
+#include "flash_stream.h"
+#include "w25n01gv_internal.h"
+
+#define STREAM_BENCH_BASE_ADDR  (0U)
+
+typedef struct stream_record
+{
+    uint32_t seq;
+    int16_t axes[6];
+} stream_record_t;
+
+typedef struct stream_bench_state
+{
+    flash_stream_t stream;
+    uint32_t seq;
+    uint32_t high_events;
+    uint32_t low_events;
+    uint32_t region_full;
+} stream_bench_state_t;
+
+static void stream_irq(void* ctx)
+{
+    stream_bench_state_t* state = ctx;
+    stream_record_t rec;
+
+    rec.seq = state->seq++;
+    for (uint8_t i = 0; i < 6; i++)
+    {
+        rec.axes[i] = (int16_t)(rec.seq * (i + 1));
+    }
+    flash_stream_push(&state->stream, &rec, sizeof(rec));
+}
+
+static void stream_evt(flash_stream_t* stream, uint8_t event, void* ctx)
+{
+    stream_bench_state_t* state = ctx;
+
+    switch (event)
+    {
+        case FLASH_STREAM_EVT_HIGH_WATERMARK:
+            state->high_events++;
+            break;
+        case FLASH_STREAM_EVT_LOW_WATERMARK:
+            state->low_events++;
+            break;
+        case FLASH_STREAM_EVT_REGION_FULL:
+            state->region_full++;
+            break;
+        default:
+            break;
+    }
+}
+
+/* Records must come back in order, gaps only where the ring overran */
+static uint32_t verify(flash_device_t* flash_dev, uint32_t len,
+                       uint32_t* records, uint32_t* gaps)
+{
+    stream_record_t rec;
+    uint32_t errors = 0;
+    uint32_t next = 0;
+
+    *records = 0;
+    *gaps = 0;
+
+    for (uint32_t addr = STREAM_BENCH_BASE_ADDR; addr + sizeof(rec) <= len;
+         addr += sizeof(rec))
+    {
+        if (w25n01gc_flash_read(flash_dev, addr, (uint8_t*)&rec,
+                                sizeof(rec)) != FLASH_SUCCESS)
+        {
+            errors++;
+            continue;
+        }
+
+        /* Erased tail of a flushed page */
+        if (rec.seq == UINT32_MAX)
+        {
+            continue;
+        }
+
+        if (rec.seq < next)
+        {
+            errors++;
+        }
+        else if (rec.seq > next)
+        {
+            (*gaps)++;
+        }
+
+        for (uint8_t i = 0; i < 6; i++)
+        {
+            if (rec.axes[i] != (int16_t)(rec.seq * (i + 1)))
+            {
+                errors++;
+                break;
+            }
+        }
+
+        next = rec.seq + 1;
+        (*records)++;
+    }
+
+    return errors;
+}
+
+int8_t stream_bench_run(w25n01gv_sim_t* sim, flash_device_t* flash_dev,
+                        const stream_bench_config_t* cfg)
+{
+    stream_bench_state_t* state;
+    flash_stream_config_t stream_cfg;
+    flash_stream_counters_t* counters;
+    uint64_t end_ns;
+    uint32_t pages;
+    uint32_t records;
+    uint32_t gaps;
+    uint32_t errors;
+    uint32_t unwritten;
+    int8_t status;
+
+    if ((cfg->rate_hz == 0) || (cfg->duration_ms == 0))
+    {
+        return FLASH_INVALID_PARAMS;
+    }
+
+    state = calloc(1, sizeof(stream_bench_state_t));
+    if (state == NULL)
+    {
+        return FLASH_MISC_FAILURE;
+    }
+
+    memset(&stream_cfg, 0, sizeof(stream_cfg));
+    stream_cfg.flash_dev = flash_dev;
+    stream_cfg.write = w25n01gc_flash_write;
+    stream_cfg.erase = w25n01gc_flash_erase;
+    stream_cfg.ring = malloc(cfg->ring_size);
+    stream_cfg.ring_size = cfg->ring_size;
+    stream_cfg.base_addr = STREAM_BENCH_BASE_ADDR;
+    stream_cfg.region_len = cfg->region_len;
+    stream_cfg.high_watermark = (cfg->ring_size * 3) / 4;
+    stream_cfg.low_watermark = cfg->ring_size / 4;
+    stream_cfg.evt_handler = stream_evt;
+    stream_cfg.ctx = state;
+
+    status = flash_stream_init(&state->stream, &stream_cfg);
+    if (status != FLASH_SUCCESS)
+    {
+        free(stream_cfg.ring);
+        free(state);
+        return status;
+    }
+
+    LOG_FLASH(INFO, "stream: %u Hz, %u B records, ring %u B, %u ms",
+              cfg->rate_hz, (uint32_t)sizeof(stream_record_t), cfg->ring_size,
+              cfg->duration_ms);
+
+    end_ns = sim->now_ns + (uint64_t)cfg->duration_ms * 1000000;
+    w25n01gv_sim_set_irq(sim, 1000000000ULL / cfg->rate_hz, stream_irq, state);
+
+    /* Background task: drain a page at a time, idle 1 ms when empty */
+    while (sim->now_ns < end_ns)
+    {
+        status = flash_stream_process(&state->stream, 1, &pages);
+        if ((status != FLASH_SUCCESS) && state->stream.region_full)
+        {
+            break;
+        }
+        if (pages == 0)
+        {
+            w25n01gv_sim_sleep(1);
+        }
+    }
+
+    w25n01gv_sim_set_irq(sim, 0, NULL, NULL);
+    status = flash_stream_flush(&state->stream);
+    /* Whatever is still queued when the region fills up never lands */
+    unwritten = flash_stream_fill(&state->stream) / sizeof(stream_record_t);
+    if (state->stream.region_full)
+    {
+        status = FLASH_SUCCESS;
+    }
+
+    counters = &state->stream.counters;
+    LOG_FLASH(INFO, "stream: records %u, overruns %u (%u B), max fill %u B, "
+                    "high/low events %u/%u",
+              counters->pushed_records, counters->overruns,
+              counters->dropped_bytes, counters->max_fill, state->high_events,
+              state->low_events);
+    LOG_FLASH(INFO, "stream: pages %u, erases %u, write errors %u, "
+                    "erase errors %u, region full %u",
+              counters->pages_written, counters->blocks_erased,
+              counters->write_errors, counters->erase_errors,
+              state->region_full);
+
+    errors = verify(flash_dev,
+                    state->stream.write_addr - STREAM_BENCH_BASE_ADDR,
+                    &records, &gaps);
+    LOG_FLASH(INFO, "stream: verify %u records, %u gaps, %u errors, "
+                    "%u left in ring", records, gaps, errors, unwritten);
+
+    if ((errors != 0) ||
+        (records != (counters->pushed_records - unwritten)))
+    {
+        status = FLASH_MISC_FAILURE;
+    }
+
+    free(stream_cfg.ring);
+    free(state);
+    return status;
+}
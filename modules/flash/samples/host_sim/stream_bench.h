@@ -0,0 +1,24 @@
+#ifndef _STREAM_BENCH_H_
+#define _STREAM_BENCH_H_
+
+#include "ext_flash.h"
+#include "w25n01gv_sim.h"
+
+/*
+ * Logs a simulated IMU stream through flash_stream. A sim interrupt pushes
+ * one 16 byte record per period while the main loop drains the ring, then
+ * the region is read back and the record sequence numbers are checked.
+ */
+
+typedef struct stream_bench_config
+{
+    uint32_t rate_hz;
+    uint32_t duration_ms;
+    uint32_t ring_size;
+    uint32_t region_len;
+} stream_bench_config_t;
+
+int8_t stream_bench_run(w25n01gv_sim_t* sim, flash_device_t* flash_dev,
+                        const stream_bench_config_t* cfg);
+
+#endif
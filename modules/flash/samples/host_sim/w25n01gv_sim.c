@@ -0,0 +1,613 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "w25n01gv_sim.h"
+#include "w25n01gv_internal.h"
+
+#define SIM_BLOCK_BYTES     (W25N01GV_SIM_PAGE_TOTAL * \
+                             W25N01GV_SIM_PAGES_PER_BLOCK)
+#define SIM_COLUMN_MASK     (0x0FFFU)
+#define SIM_DEFAULT_PROT    (0x7C)
+#define SIM_DEFAULT_CONF    (0x18)
+
+/* Driver side completion flag, normally owned by the SPI event handler */
+volatile bool spi_xfer_done;
+
+static const uint8_t sim_jedec_id[W25N01GV_JEDEC_ID_SIZE] = {0xEF, 0xAA,
+                                                             0x21};
+
+/* The SPI hooks carry no context, so the simulator is a singleton */
+static w25n01gv_sim_t* cur_sim;
+
+void w25n01gv_sim_default_timing(w25n01gv_sim_timing_t* timing)
+{
+    timing->spi_hz = 8000000;
+    timing->xfer_overhead_ns = 2000;
+    timing->t_rd_us = 60;
+    timing->t_pp_us = 250;
+    timing->t_be_us = 2000;
+    timing->t_rst_us = 5;
+}
+
+w25n01gv_sim_t* w25n01gv_sim_create(const w25n01gv_sim_timing_t* timing)
+{
+    w25n01gv_sim_t* sim = calloc(1, sizeof(w25n01gv_sim_t));
+
+    if (sim == NULL)
+    {
+        return NULL;
+    }
+
+    if (timing != NULL)
+    {
+        sim->timing = *timing;
+    }
+    else
+    {
+        w25n01gv_sim_default_timing(&sim->timing);
+    }
+
+    memset(sim->buf, 0xFF, sizeof(sim->buf));
+    sim->prot_reg = SIM_DEFAULT_PROT;
+    sim->conf_reg = SIM_DEFAULT_CONF;
+    cur_sim = sim;
+
+    return sim;
+}
+
+void w25n01gv_sim_destroy(w25n01gv_sim_t* sim)
+{
+    for (uint32_t i = 0; i < W25N01GV_SIM_NUM_BLOCKS; i++)
+    {
+        free(sim->blocks[i]);
+    }
+
+    if (cur_sim == sim)
+    {
+        cur_sim = NULL;
+    }
+    free(sim);
+}
+
+static uint8_t* sim_block(w25n01gv_sim_t* sim, uint16_t block)
+{
+    if (sim->blocks[block] == NULL)
+    {
+        sim->blocks[block] = malloc(SIM_BLOCK_BYTES);
+        if (sim->blocks[block] == NULL)
+        {
+            abort();
+        }
+        memset(sim->blocks[block], 0xFF, SIM_BLOCK_BYTES);
+    }
+    return sim->blocks[block];
+}
+
+static uint8_t* sim_page(w25n01gv_sim_t* sim, uint16_t page)
+{
+    uint16_t block = page / W25N01GV_SIM_PAGES_PER_BLOCK;
+
+    return sim_block(sim, block) +
+           (page % W25N01GV_SIM_PAGES_PER_BLOCK) * W25N01GV_SIM_PAGE_TOTAL;
+}
+
+void w25n01gv_sim_mark_bad_block(w25n01gv_sim_t* sim, uint16_t block)
+{
+    sim->bad_block[block] = true;
+    /* Factory marker: first spare byte of the first page */
+    sim_page(sim, block * W25N01GV_SIM_PAGES_PER_BLOCK)
+        [W25N01GV_SIM_PAGE_SIZE] = 0x00;
+}
+
+int w25n01gv_sim_dump(const w25n01gv_sim_t* sim, const char* path)
+{
+    uint8_t erased[W25N01GV_SIM_PAGE_TOTAL];
+    FILE* out = fopen(path, "wb");
+    int status = 0;
+
+    if (out == NULL)
+    {
+        return -1;
+    }
+
+    memset(erased, 0xFF, sizeof(erased));
+
+    for (uint32_t i = 0; (i < W25N01GV_SIM_NUM_BLOCKS) && (status == 0); i++)
+    {
+        for (uint32_t p = 0; p < W25N01GV_SIM_PAGES_PER_BLOCK; p++)
+        {
+            /* Blocks never touched are not allocated, they read erased */
+            if (fwrite((sim->blocks[i] != NULL)
+                       ? &sim->blocks[i][p * W25N01GV_SIM_PAGE_TOTAL]
+                       : erased, 1, W25N01GV_SIM_PAGE_TOTAL, out) !=
+                W25N01GV_SIM_PAGE_TOTAL)
+            {
+                status = -1;
+                break;
+            }
+        }
+    }
+
+    if (fclose(out) != 0)
+    {
+        status = -1;
+    }
+    return status;
+}
+
+void w25n01gv_sim_set_page_ecc(w25n01gv_sim_t* sim, uint16_t page,
+                               uint8_t ecc_code)
+{
+    sim->page_ecc[page] = ecc_code;
+}
+
+static bool sim_busy(w25n01gv_sim_t* sim)
+{
+    return sim->now_ns < sim->busy_until_ns;
+}
+
+static void sim_set_busy(w25n01gv_sim_t* sim, uint32_t us)
+{
+    sim->busy_until_ns = sim->now_ns + (uint64_t)us * 1000;
+}
+
+static bool sim_block_protected(w25n01gv_sim_t* sim, uint16_t block)
+{
+    uint8_t bp = (sim->prot_reg & W25N01GV_BP_MASK) >> W25N01GV_BP_OFFSET;
+    uint8_t tb = (sim->prot_reg & W25N01GV_TB_MASK) >> W25N01GV_TB_OFFSET;
+    uint32_t num_protected;
+
+    if (bp == 0)
+    {
+        return false;
+    }
+
+    /* BP=1 protects 256KB (2 blocks), doubling up to 64MB, above that all */
+    if (bp > 9)
+    {
+        return true;
+    }
+    num_protected = 1U << bp;
+
+    if (tb)
+    {
+        return block < num_protected;
+    }
+    return block >= (W25N01GV_SIM_NUM_BLOCKS - num_protected);
+}
+
+static uint16_t sim_addr16(const uint8_t* p)
+{
+    return ((uint16_t)p[0] << 8) | p[1];
+}
+
+static void sim_page_data_read(w25n01gv_sim_t* sim, uint16_t page)
+{
+    uint8_t ecc = sim->page_ecc[page];
+
+    if (sim->blocks[page / W25N01GV_SIM_PAGES_PER_BLOCK] == NULL)
+    {
+        memset(sim->buf, 0xFF, sizeof(sim->buf));
+    }
+    else
+    {
+        memcpy(sim->buf, sim_page(sim, page), W25N01GV_SIM_PAGE_TOTAL);
+    }
+
+    if ((sim->conf_reg & W25N01GV_ECCE_MASK) == 0)
+    {
+        ecc = ECC_SUCCESS_NO_CORRECTION;
+    }
+    if (ecc >= ECC_FAIL_SINGLE_PAGE)
+    {
+        sim->last_ecc_fail_page = page;
+    }
+
+    sim->stat_reg &= ~W25N01GV_ECC_MASK;
+    sim->stat_reg |= (ecc << W25N01GV_ECC_OFFSET) & W25N01GV_ECC_MASK;
+    sim->counters.page_reads++;
+    sim_set_busy(sim, sim->timing.t_rd_us);
+}
+
+/* Sectors of the data buffer a program would change, bit per sector */
+static uint8_t sim_buf_sectors(const w25n01gv_sim_t* sim)
+{
+    uint8_t sectors = 0;
+
+    for (uint32_t i = 0; i < W25N01GV_SIM_PAGE_SIZE; i++)
+    {
+        if (sim->buf[i] != 0xFF)
+        {
+            sectors |= 1U << (i / W25N01GV_SIM_SECTOR_SIZE);
+        }
+    }
+    for (uint32_t i = 0; i < W25N01GV_SIM_SPARE_SIZE; i++)
+    {
+        if (sim->buf[W25N01GV_SIM_PAGE_SIZE + i] != 0xFF)
+        {
+            sectors |= 1U << (i / W25N01GV_SIM_SPARE_SECTOR_SIZE);
+        }
+    }
+    return sectors;
+}
+
+/*
+ * Partial program bookkeeping. A page programmed more than NOP times, or a
+ * sector programmed twice with ECC on, has unreliable data and ECC bytes on
+ * a real chip, so it reads back uncorrectable from then on.
+ */
+static void sim_account_nop(w25n01gv_sim_t* sim, uint16_t page)
+{
+    uint8_t sectors = sim_buf_sectors(sim);
+    bool overlap = ((sim->conf_reg & W25N01GV_ECCE_MASK) != 0) &&
+                   ((sectors & sim->page_sectors[page]) != 0);
+
+    if (sim->page_nop[page] < UINT8_MAX)
+    {
+        sim->page_nop[page]++;
+    }
+    if ((sim->page_nop[page] > W25N01GV_SIM_NOP) || overlap)
+    {
+        sim->counters.nop_violations++;
+        sim->page_ecc[page] = ECC_FAIL_SINGLE_PAGE;
+    }
+    sim->page_sectors[page] |= sectors;
+}
+
+static void sim_program_execute(w25n01gv_sim_t* sim, uint16_t page)
+{
+    uint16_t block = page / W25N01GV_SIM_PAGES_PER_BLOCK;
+    uint32_t len = W25N01GV_SIM_PAGE_TOTAL;
+    uint8_t* dst;
+
+    sim->stat_reg &= ~(W25N01GV_WEL_MASK | W25N01GV_PFAIL_MASK);
+    sim->counters.page_programs++;
+    sim_set_busy(sim, sim->timing.t_pp_us);
+
+    if (sim->bad_block[block] || sim_block_protected(sim, block))
+    {
+        sim->stat_reg |= W25N01GV_PFAIL_MASK;
+        return;
+    }
+
+    sim_account_nop(sim, page);
+
+    if (sim->program_fail_armed && (sim->program_fail_page == page))
+    {
+        sim->program_fail_armed = false;
+        sim->page_ecc[page] = ECC_FAIL_SINGLE_PAGE;
+        sim->stat_reg |= W25N01GV_PFAIL_MASK;
+    }
+
+    if (sim->power_cut_armed && (sim->power_cut_programs-- == 0))
+    {
+        len = (sim->power_cut_tear_len < W25N01GV_SIM_PAGE_TOTAL)
+                  ? sim->power_cut_tear_len
+                  : W25N01GV_SIM_PAGE_TOTAL;
+        if (sim->power_cut_ecc_fail)
+        {
+            sim->page_ecc[page] = ECC_FAIL_SINGLE_PAGE;
+        }
+        sim->power_cut_armed = false;
+        sim->powered_off = true;
+    }
+
+    /* NAND programming can only clear bits */
+    dst = sim_page(sim, page);
+    for (uint32_t i = 0; i < len; i++)
+    {
+        dst[i] &= sim->buf[i];
+    }
+}
+
+static void sim_block_erase(w25n01gv_sim_t* sim, uint16_t page)
+{
+    uint16_t block = page / W25N01GV_SIM_PAGES_PER_BLOCK;
+
+    sim->stat_reg &= ~(W25N01GV_WEL_MASK | W25N01GV_EFAIL_MASK);
+    sim->counters.block_erases++;
+    sim_set_busy(sim, sim->timing.t_be_us);
+
+    if (sim->bad_block[block] || sim_block_protected(sim, block))
+    {
+        sim->stat_reg |= W25N01GV_EFAIL_MASK;
+        return;
+    }
+
+    free(sim->blocks[block]);
+    sim->blocks[block] = NULL;
+    memset(&sim->page_ecc[block * W25N01GV_SIM_PAGES_PER_BLOCK], 0,
+           W25N01GV_SIM_PAGES_PER_BLOCK);
+    memset(&sim->page_nop[block * W25N01GV_SIM_PAGES_PER_BLOCK], 0,
+           W25N01GV_SIM_PAGES_PER_BLOCK);
+    memset(&sim->page_sectors[block * W25N01GV_SIM_PAGES_PER_BLOCK], 0,
+           W25N01GV_SIM_PAGES_PER_BLOCK);
+}
+
+static void sim_load(w25n01gv_sim_t* sim, bool random_load,
+                     const uint8_t* tx, uint32_t tx_len)
+{
+    uint16_t col = sim_addr16(&tx[1]) & SIM_COLUMN_MASK;
+    uint32_t len = tx_len - 3;
+
+    if (!random_load)
+    {
+        memset(sim->buf, 0xFF, sizeof(sim->buf));
+    }
+    if (col >= W25N01GV_SIM_PAGE_TOTAL)
+    {
+        return;
+    }
+    if (len > (W25N01GV_SIM_PAGE_TOTAL - col))
+    {
+        len = W25N01GV_SIM_PAGE_TOTAL - col;
+    }
+    memcpy(&sim->buf[col], &tx[3], len);
+}
+
+static void sim_read(w25n01gv_sim_t* sim, const uint8_t* tx, uint32_t tx_len,
+                     uint8_t* rx, uint32_t rx_len)
+{
+    uint16_t col = sim_addr16(&tx[1]) & SIM_COLUMN_MASK;
+
+    for (uint32_t i = tx_len; i < rx_len; i++, col++)
+    {
+        rx[i] = (col < W25N01GV_SIM_PAGE_TOTAL) ? sim->buf[col] : 0xFF;
+    }
+}
+
+static uint8_t* sim_reg(w25n01gv_sim_t* sim, uint8_t reg_addr)
+{
+    switch (reg_addr & 0xF0)
+    {
+        case W25N01GV_PROTECTION_REG:
+            return &sim->prot_reg;
+        case W25N01GV_CONFIGURATION_REG:
+            return &sim->conf_reg;
+        case W25N01GV_STATUS_REG:
+            return &sim->stat_reg;
+        default:
+            return NULL;
+    }
+}
+
+static bool sim_needs_wel(uint8_t opcode)
+{
+    switch (opcode)
+    {
+        case W25N01GV_PROGRAM_DATA_LOAD:
+        case W25N01GV_RANDOM_PROGRAM_DATA_LOAD:
+        case W25N01GV_QUAD_PROGRAM_DATA_LOAD:
+        case W25N01GV_RANDOM_QUAD_PROGRAM_DATA_LOAD:
+        case W25N01GV_PROGRAM_EXECUTE:
+        case W25N01GV_BLOCK_ERASE:
+        case W25N01GV_BB_MANAGEMENT:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static void sim_command(w25n01gv_sim_t* sim, const uint8_t* tx,
+                        uint32_t tx_len, uint8_t* rx, uint32_t rx_len)
+{
+    uint8_t opcode = tx[0];
+    uint8_t* reg;
+
+    /* Only status reads and reset are accepted while an operation runs */
+    if (sim_busy(sim) && (opcode != W25N01GV_READ_STATUS_REG) &&
+        (opcode != W25N01GV_DEVICE_RESET))
+    {
+        sim->counters.busy_rejects++;
+        return;
+    }
+
+    if (sim_needs_wel(opcode) && ((sim->stat_reg & W25N01GV_WEL_MASK) == 0))
+    {
+        sim->counters.wel_rejects++;
+        return;
+    }
+
+    switch (opcode)
+    {
+        case W25N01GV_DEVICE_RESET:
+            sim->stat_reg = 0;
+            sim->prot_reg = SIM_DEFAULT_PROT;
+            sim->conf_reg = SIM_DEFAULT_CONF;
+            sim_set_busy(sim, sim->timing.t_rst_us);
+            break;
+        case W25N01GV_JEDEC_ID:
+            for (uint32_t i = 2; i < rx_len; i++)
+            {
+                rx[i] = (i - 2 < W25N01GV_JEDEC_ID_SIZE) ? sim_jedec_id[i - 2]
+                                                         : 0xFF;
+            }
+            break;
+        case W25N01GV_READ_STATUS_REG:
+            if ((tx_len < 2) || (rx_len < 3))
+            {
+                break;
+            }
+            reg = sim_reg(sim, tx[1]);
+            rx[2] = (reg != NULL) ? *reg : 0xFF;
+            if (tx[1] == W25N01GV_STATUS_REG)
+            {
+                rx[2] &= ~W25N01GV_BUSY_MASK;
+                rx[2] |= sim_busy(sim) ? W25N01GV_BUSY_MASK : 0;
+                sim->counters.status_reads++;
+            }
+            break;
+        case W25N01GV_WRITE_STATUS_REG:
+            reg = sim_reg(sim, tx[1]);
+            if ((tx_len >= 3) && (reg != NULL) && (reg != &sim->stat_reg))
+            {
+                *reg = tx[2];
+            }
+            break;
+        case W25N01GV_WRITE_ENABLE:
+            sim->stat_reg |= W25N01GV_WEL_MASK;
+            break;
+        case W25N01GV_WRITE_DISABLE:
+            sim->stat_reg &= ~W25N01GV_WEL_MASK;
+            break;
+        case W25N01GV_PAGE_DATA_READ:
+            sim_page_data_read(sim, sim_addr16(&tx[2]));
+            break;
+        case W25N01GV_READ:
+            sim_read(sim, tx, tx_len, rx, rx_len);
+            break;
+        case W25N01GV_PROGRAM_DATA_LOAD:
+        case W25N01GV_RANDOM_PROGRAM_DATA_LOAD:
+            sim_load(sim, (opcode == W25N01GV_RANDOM_PROGRAM_DATA_LOAD), tx,
+                     tx_len);
+            break;
+        case W25N01GV_PROGRAM_EXECUTE:
+            sim_program_execute(sim, sim_addr16(&tx[2]));
+            break;
+        case W25N01GV_BLOCK_ERASE:
+            sim_block_erase(sim, sim_addr16(&tx[2]));
+            break;
+        case W25N01GV_LAST_ECC_FAILURE_PAGE_ADDR:
+            if (rx_len >= 4)
+            {
+                rx[2] = sim->last_ecc_fail_page >> 8;
+                rx[3] = sim->last_ecc_fail_page & 0xFF;
+            }
+            break;
+        default:
+            sim->counters.unknown_cmds++;
+            break;
+    }
+}
+
+void w25n01gv_sim_set_power_cut(w25n01gv_sim_t* sim, uint32_t programs,
+                                uint32_t tear_len, bool ecc_fail)
+{
+    sim->power_cut_armed = true;
+    sim->power_cut_programs = programs;
+    sim->power_cut_tear_len = tear_len;
+    sim->power_cut_ecc_fail = ecc_fail;
+}
+
+void w25n01gv_sim_set_program_fail(w25n01gv_sim_t* sim, uint16_t page)
+{
+    sim->program_fail_armed = true;
+    sim->program_fail_page = page;
+}
+
+void w25n01gv_sim_power_cycle(w25n01gv_sim_t* sim)
+{
+    sim->power_cut_armed = false;
+    sim->powered_off = false;
+    memset(sim->buf, 0xFF, sizeof(sim->buf));
+    sim->stat_reg = 0;
+    sim->prot_reg = SIM_DEFAULT_PROT;
+    sim->conf_reg = SIM_DEFAULT_CONF;
+    sim->busy_until_ns = sim->now_ns;
+}
+
+static void sim_run_irqs(w25n01gv_sim_t* sim)
+{
+    if ((sim->irq_handler == NULL) || (sim->irq_period_ns == 0))
+    {
+        return;
+    }
+
+    while (sim->irq_next_ns <= sim->now_ns)
+    {
+        sim->irq_next_ns += sim->irq_period_ns;
+        sim->irq_handler(sim->irq_ctx);
+    }
+}
+
+void w25n01gv_sim_set_irq(w25n01gv_sim_t* sim, uint64_t period_ns,
+                          void (*handler)(void* ctx), void* ctx)
+{
+    sim->irq_handler = handler;
+    sim->irq_ctx = ctx;
+    sim->irq_period_ns = period_ns;
+    sim->irq_next_ns = sim->now_ns + period_ns;
+}
+
+int32_t w25n01gv_sim_spi_xfer(uint8_t* tx_buf, uint32_t tx_len,
+                              uint8_t* rx_buf, uint32_t rx_len)
+{
+    w25n01gv_sim_t* sim = cur_sim;
+    uint32_t bytes = (tx_len > rx_len) ? tx_len : rx_len;
+
+    if ((sim == NULL) || (tx_len == 0) || sim->powered_off)
+    {
+        return FLASH_TRANSFER_ERROR;
+    }
+
+    memset(rx_buf, 0xFF, rx_len);
+    sim_command(sim, tx_buf, tx_len, rx_buf, rx_len);
+
+    sim->counters.xfers++;
+    sim->counters.xfer_bytes += bytes;
+    sim->now_ns += sim->timing.xfer_overhead_ns +
+                   ((uint64_t)bytes * 8 * 1000000000ULL) / sim->timing.spi_hz;
+    sim_run_irqs(sim);
+
+    spi_xfer_done = true;
+    return FLASH_SUCCESS;
+}
+
+int32_t w25n01gv_sim_spi_xfer_seg(const uint8_t* hdr, uint32_t hdr_len,
+                                  const uint8_t* tx_buf, uint32_t tx_len,
+                                  uint8_t* rx_buf, uint32_t rx_len)
+{
+    /* Stands in for a DMA chain, the chip only ever sees one transfer */
+    uint8_t tx[W25N01GV_SIM_SEG_HDR_MAX + W25N01GV_SIM_PAGE_TOTAL];
+    uint8_t rx[W25N01GV_SIM_SEG_HDR_MAX + W25N01GV_SIM_PAGE_TOTAL];
+    uint32_t len = hdr_len + tx_len;
+    int32_t status;
+
+    if ((hdr_len > W25N01GV_SIM_SEG_HDR_MAX) ||
+        ((tx_len + rx_len) > W25N01GV_SIM_PAGE_TOTAL))
+    {
+        return FLASH_INVALID_PARAMS;
+    }
+
+    memcpy(tx, hdr, hdr_len);
+    if (tx_len != 0)
+    {
+        memcpy(tx + hdr_len, tx_buf, tx_len);
+    }
+
+    status = w25n01gv_sim_spi_xfer(tx, len, rx, (rx_len != 0) ? (len + rx_len)
+                                                              : 0);
+    if ((status == FLASH_SUCCESS) && (rx_len != 0))
+    {
+        memcpy(rx_buf, rx + len, rx_len);
+    }
+    return status;
+}
+
+void w25n01gv_sim_sleep(uint32_t ms)
+{
+    if (cur_sim != NULL)
+    {
+        cur_sim->now_ns += (uint64_t)ms * 1000000;
+        sim_run_irqs(cur_sim);
+    }
+}
+
+void w25n01gv_sim_delay_us(uint32_t us)
+{
+    if (cur_sim != NULL)
+    {
+        cur_sim->now_ns += (uint64_t)us * 1000;
+        sim_run_irqs(cur_sim);
+    }
+}
+
+uint32_t w25n01gv_sim_time_us(void)
+{
+    if (cur_sim == NULL)
+    {
+        return 0;
+    }
+    return (uint32_t)(cur_sim->now_ns / 1000);
+}
@@ -0,0 +1,147 @@
+#ifndef _W25N01GV_SIM_H_
+#define _W25N01GV_SIM_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Host side model of the W25N01GV used to run ext_flash + w25n01gv on Linux.
+ * It decodes the SPI byte stream the driver produces, keeps the 2112 byte
+ * data buffer, the three status registers, the array contents and a virtual
+ * clock. BUSY is held for tRD/tPP/tBE after the matching command and every
+ * SPI transfer, sleep() and delay_us() advances the clock, so latencies
+ * measured with w25n01gv_sim_time_us() reflect what the driver would cost
+ * on a real bus.
+ */
+
+#define W25N01GV_SIM_PAGE_SIZE          2048U
+#define W25N01GV_SIM_SPARE_SIZE         64U
+#define W25N01GV_SIM_PAGE_TOTAL         (W25N01GV_SIM_PAGE_SIZE + \
+                                         W25N01GV_SIM_SPARE_SIZE)
+/* Longest command header w25n01gv_sim_spi_xfer_seg accepts */
+#define W25N01GV_SIM_SEG_HDR_MAX        8U
+#define W25N01GV_SIM_PAGES_PER_BLOCK    64U
+#define W25N01GV_SIM_NUM_BLOCKS         1024U
+#define W25N01GV_SIM_NUM_PAGES          (W25N01GV_SIM_PAGES_PER_BLOCK * \
+                                         W25N01GV_SIM_NUM_BLOCKS)
+/*
+ * Partial programs: at most W25N01GV_SIM_NOP programs per page between
+ * erases, and with ECC enabled each 512 byte sector (and its 16 spare
+ * bytes) programmed once, as its ECC bytes cannot be rewritten.
+ */
+#define W25N01GV_SIM_NOP                4U
+#define W25N01GV_SIM_SECTOR_SIZE        512U
+#define W25N01GV_SIM_SECTORS_PER_PAGE   4U
+#define W25N01GV_SIM_SPARE_SECTOR_SIZE  16U
+
+typedef struct w25n01gv_sim_timing
+{
+    uint32_t spi_hz;
+    /* Fixed cost per transfer: CS toggling, DMA setup, driver overhead */
+    uint32_t xfer_overhead_ns;
+    uint32_t t_rd_us;
+    uint32_t t_pp_us;
+    uint32_t t_be_us;
+    uint32_t t_rst_us;
+} w25n01gv_sim_timing_t;
+
+typedef struct w25n01gv_sim_counters
+{
+    uint32_t xfers;
+    uint64_t xfer_bytes;
+    uint32_t status_reads;
+    uint32_t page_reads;
+    uint32_t page_programs;
+    uint32_t block_erases;
+    uint32_t busy_rejects;
+    uint32_t wel_rejects;
+    /* Programs beyond NOP or into a sector already programmed with ECC */
+    uint32_t nop_violations;
+    uint32_t unknown_cmds;
+} w25n01gv_sim_counters_t;
+
+typedef struct w25n01gv_sim
+{
+    w25n01gv_sim_timing_t timing;
+    w25n01gv_sim_counters_t counters;
+    /* Array contents, a NULL block reads as erased */
+    uint8_t* blocks[W25N01GV_SIM_NUM_BLOCKS];
+    bool bad_block[W25N01GV_SIM_NUM_BLOCKS];
+    /* ECC result reported by PAGE_DATA_READ, see enum ecc_code */
+    uint8_t page_ecc[W25N01GV_SIM_NUM_PAGES];
+    /* Programs since the last erase, and the sectors they wrote */
+    uint8_t page_nop[W25N01GV_SIM_NUM_PAGES];
+    uint8_t page_sectors[W25N01GV_SIM_NUM_PAGES];
+    uint8_t buf[W25N01GV_SIM_PAGE_TOTAL];
+    uint8_t prot_reg;
+    uint8_t conf_reg;
+    uint8_t stat_reg;
+    uint16_t last_ecc_fail_page;
+    uint64_t now_ns;
+    uint64_t busy_until_ns;
+    /* Power cut injection, see w25n01gv_sim_set_power_cut() */
+    bool power_cut_armed;
+    uint32_t power_cut_programs;
+    uint32_t power_cut_tear_len;
+    bool power_cut_ecc_fail;
+    bool powered_off;
+    /* Program failure injection, see w25n01gv_sim_set_program_fail() */
+    bool program_fail_armed;
+    uint16_t program_fail_page;
+    /* Periodic interrupt, fired as the clock passes each period */
+    void (*irq_handler)(void* ctx);
+    void* irq_ctx;
+    uint64_t irq_period_ns;
+    uint64_t irq_next_ns;
+} w25n01gv_sim_t;
+
+/* Default timing: 8 MHz SPI, typical tPP/tBE and max tRD with ECC enabled */
+void w25n01gv_sim_default_timing(w25n01gv_sim_timing_t* timing);
+
+/* Allocates an erased chip and makes it the target of the SPI hooks below */
+w25n01gv_sim_t* w25n01gv_sim_create(const w25n01gv_sim_timing_t* timing);
+void w25n01gv_sim_destroy(w25n01gv_sim_t* sim);
+
+/* Factory bad block: marker byte cleared, erase and program fail */
+void w25n01gv_sim_mark_bad_block(w25n01gv_sim_t* sim, uint16_t block);
+/* ECC status the next PAGE_DATA_READ of the page reports, until erased */
+void w25n01gv_sim_set_page_ecc(w25n01gv_sim_t* sim, uint16_t page,
+                               uint8_t ecc_code);
+
+/*
+ * Cuts power during a page program after programs more complete ones. Only
+ * the first tear_len bytes of the page buffer (spare included, 2112 total)
+ * reach the array, and with ecc_fail the page then reads back uncorrectable.
+ * Every SPI transfer fails until w25n01gv_sim_power_cycle().
+ */
+void w25n01gv_sim_set_power_cut(w25n01gv_sim_t* sim, uint32_t programs,
+                                uint32_t tear_len, bool ecc_fail);
+/*
+ * Fails the next PROGRAM_EXECUTE of page: P-FAIL is reported and the page
+ * reads back uncorrectable until its block is erased.
+ */
+void w25n01gv_sim_set_program_fail(w25n01gv_sim_t* sim, uint16_t page);
+/* Restores power: registers back to defaults, array contents kept */
+void w25n01gv_sim_power_cycle(w25n01gv_sim_t* sim);
+/* Raw image of the array, every page followed by its spare, for nand_dump */
+int w25n01gv_sim_dump(const w25n01gv_sim_t* sim, const char* path);
+
+/*
+ * Calls handler every period_ns of virtual time, from inside the SPI and
+ * sleep hooks, like a sensor interrupt preempting the driver. 0 disables it.
+ */
+void w25n01gv_sim_set_irq(w25n01gv_sim_t* sim, uint64_t period_ns,
+                          void (*handler)(void* ctx), void* ctx);
+
+/* Hooks for flash_device_t */
+int32_t w25n01gv_sim_spi_xfer(uint8_t* tx_buf, uint32_t tx_len,
+                              uint8_t* rx_buf, uint32_t rx_len);
+/* Header/data split hook for EXT_FLASH_NO_STATIC_BUF builds */
+int32_t w25n01gv_sim_spi_xfer_seg(const uint8_t* hdr, uint32_t hdr_len,
+                                  const uint8_t* tx_buf, uint32_t tx_len,
+                                  uint8_t* rx_buf, uint32_t rx_len);
+void w25n01gv_sim_sleep(uint32_t ms);
+void w25n01gv_sim_delay_us(uint32_t us);
+uint32_t w25n01gv_sim_time_us(void);
+
+#endif
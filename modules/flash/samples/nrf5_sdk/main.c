@@ -1,4 +1,5 @@
-#include "nrf_drv_spi.h"
+#include "nrfx_spim.h"
+#include "nrf_timer.h"
 #include "app_util_platform.h"
 #include "nrf_gpio.h"
 #include "nrf_delay.h"
@@ -9,141 +10,239 @@
 #include "nrf_log_ctrl.h"
 #include "nrf_log_default_backends.h"
 #include "w25n01gv_internal.h"
+#include "flash_bench.h"
+
+/*
+ * Flash throughput benchmark. Sweeps transfer sizes from 64 B up to
+ * BENCH_MAX_XFER_SIZE for every SPI clock in bench_freqs, sequential and
+ * random, and prints one row per test over the log backend (RTT/UART).
+ *
+ * Uses SPIM directly since the legacy SPI driver only takes 8-bit lengths,
+ * which cannot carry a 2 KB page. Transfers above 255 bytes need a part with
+ * 16-bit EasyDMA MAXCNT (nRF52840 class).
+ */
+
+#define SPI_INSTANCE        3 /**< SPIM instance index. */
+#define BENCH_TIMER         NRF_TIMER1
+
+#define BENCH_MIN_XFER_SIZE (64U)
+/* Lower this on parts with less RAM, the sweep stops at this size */
+#define BENCH_MAX_XFER_SIZE (128U * 1024U)
+/* Region under test, first 16 blocks of the chip */
+#define BENCH_BASE_ADDR     (0U)
+#define BENCH_REGION_LEN    (16U * 64U * 2048U)
+/* Keeps small transfer sizes from running for minutes */
+#define BENCH_MAX_OPS       (256U)
+#define BENCH_LAT_SAMPLES   BENCH_MAX_OPS
+/* Address decompositions timed by the geometry micro-benchmark */
+#define BENCH_GEOMETRY_OPS  (100000U)
+/* Chip select, driven by hand in EXT_FLASH_NO_STATIC_BUF builds */
+#define FLASH_CS_PIN        13
 
-#define SPI_INSTANCE  0 /**< SPI instance index. */
-#define VECTOR_LENGTH 2200
+static const nrfx_spim_t spi = NRFX_SPIM_INSTANCE(SPI_INSTANCE);  /**< SPI instance. */
 
-uint8_t recv_buf[VECTOR_LENGTH];  
-uint8_t tx_buf[VECTOR_LENGTH];
+static const nrf_spim_frequency_t bench_freqs[] = {
+    NRF_SPIM_FREQ_1M, NRF_SPIM_FREQ_2M, NRF_SPIM_FREQ_4M, NRF_SPIM_FREQ_8M};
+static const uint32_t bench_freqs_khz[] = {1000, 2000, 4000, 8000};
 
-static const nrf_drv_spi_t spi = NRF_DRV_SPI_INSTANCE(SPI_INSTANCE);  /**< SPI instance. */
+static uint8_t bench_buf[BENCH_MAX_XFER_SIZE];
+static uint32_t bench_lat[BENCH_LAT_SAMPLES];
+
+/**< Flag used to indicate that SPI instance completed the transfer. */
+volatile bool spi_xfer_done;
 
 /**
  * @brief SPI user event handler.
  * @param event
  */
-void spi_event_handler(nrf_drv_spi_evt_t const * p_event,
-                       void *                    p_context)
+void spi_event_handler(nrfx_spim_evt_t const * p_event,
+                       void *                  p_context)
 {
     spi_xfer_done = true;
 }
 
-static ret_code_t nrf_drv_spi_transfer_own(uint8_t const * p_tx_buffer,
-                                uint8_t         tx_buffer_length,
-                                uint8_t       * p_rx_buffer,
-                                uint8_t         rx_buffer_length)
+static int32_t spim_transfer(uint8_t* tx_buf, uint32_t tx_len,
+                             uint8_t* rx_buf, uint32_t rx_len)
 {
-  return nrf_drv_spi_transfer(&spi, p_tx_buffer, tx_buffer_length, p_rx_buffer, rx_buffer_length);
+    nrfx_spim_xfer_desc_t xfer = NRFX_SPIM_XFER_TRX(tx_buf, tx_len,
+                                                    rx_buf, rx_len);
+
+    if (nrfx_spim_xfer(&spi, &xfer, 0) != NRFX_SUCCESS)
+    {
+        return FLASH_TRANSFER_ERROR;
+    }
+    return FLASH_SUCCESS;
 }
 
-int main(void)
+#ifdef EXT_FLASH_NO_STATIC_BUF
+/*
+ * Header then data phase as two SPIM transfers under one chip select, so the
+ * driver needs no buffers of its own. EasyDMA only reaches RAM, the data
+ * buffers handed to the driver must not live in flash.
+ */
+static int32_t spim_seg(nrfx_spim_xfer_desc_t const* xfer)
 {
-    int8_t status = FLASH_SUCCESS;
-    nrfx_err_t ret_val;
-    flash_device_t flash_dev;
-
-    APP_ERROR_CHECK(NRF_LOG_INIT(NULL));
-    NRF_LOG_DEFAULT_BACKENDS_INIT();
-
-    nrf_drv_spi_config_t spi_config = NRF_DRV_SPI_DEFAULT_CONFIG;
-    spi_config.ss_pin   = 13;//SPI_SS_PIN
-    spi_config.miso_pin = 21;//SPI_MISO_PIN
-    spi_config.mosi_pin = 15;//SPI_MOSI_PIN
-    spi_config.sck_pin  = 17;//SPI_SCK_PIN
-    APP_ERROR_CHECK(nrf_drv_spi_init(&spi, &spi_config, spi_event_handler, NULL));
-
-    memset(recv_buf, 0, VECTOR_LENGTH);
-    memset(tx_buf, 0, VECTOR_LENGTH);
+    spi_xfer_done = false;
+    if (nrfx_spim_xfer(&spi, xfer, 0) != NRFX_SUCCESS)
+    {
+        return FLASH_TRANSFER_ERROR;
+    }
+    while (spi_xfer_done == false);
+    return FLASH_SUCCESS;
+}
 
-    NRF_LOG_INFO("SPI flash sample started.");
+static int32_t spim_transfer_seg(const uint8_t* hdr, uint32_t hdr_len,
+                                 const uint8_t* tx_buf, uint32_t tx_len,
+                                 uint8_t* rx_buf, uint32_t rx_len)
+{
+    nrfx_spim_xfer_desc_t xfer = NRFX_SPIM_XFER_TX(hdr, hdr_len);
+    int32_t status;
 
-    flash_dev.spi_xfer = nrf_drv_spi_transfer_own;
-    flash_dev.sleep = nrf_delay_ms;
-    flash_dev.flash_size = 128 * 1024 * 1024;
-    uint16_t num_of_pages_per_block = 64;
-    uint16_t num_of_blocks = 1024;
-    uint16_t page_size = 2 * 1024;
-    uint16_t num_ecc_bytes_per_page = 64;
+    nrf_gpio_pin_clear(FLASH_CS_PIN);
 
-    status = w25n01gv_init(&flash_dev);
-    if (status != FLASH_SUCCESS)
+    status = spim_seg(&xfer);
+    if ((status == FLASH_SUCCESS) && (tx_len != 0))
     {
-        NRF_LOG_INFO("winbond init fail");
+        xfer = (nrfx_spim_xfer_desc_t)NRFX_SPIM_XFER_TX(tx_buf, tx_len);
+        status = spim_seg(&xfer);
     }
-    
-    NRF_LOG_INFO("winbond init done");
-
-    for (int i = 0; i < 100; i++)
+    if ((status == FLASH_SUCCESS) && (rx_len != 0))
     {
-        tx_buf[i] = i;
+        xfer = (nrfx_spim_xfer_desc_t)NRFX_SPIM_XFER_RX(rx_buf, rx_len);
+        status = spim_seg(&xfer);
     }
 
-    while (1)
-    {
+    nrf_gpio_pin_set(FLASH_CS_PIN);
 
-        memset(recv_buf, 0, 2200);
+    /* The driver waits on this once the hook returns */
+    spi_xfer_done = true;
+    return status;
+}
+#endif
 
-        NRF_LOG_INFO("winbond read start##############");
-        status = w25n01gc_flash_read(&flash_dev, 10, recv_buf, 100);
-        if (status != FLASH_SUCCESS)
-        {
-            NRF_LOG_INFO("winbond read fail");
-        }
-        NRF_LOG_INFO("winbond read end##############");
+static void spim_init(nrf_spim_frequency_t frequency)
+{
+    nrfx_spim_config_t spi_config = NRFX_SPIM_DEFAULT_CONFIG;
+#ifdef EXT_FLASH_NO_STATIC_BUF
+    spi_config.ss_pin    = NRFX_SPIM_PIN_NOT_USED;
+    nrf_gpio_pin_set(FLASH_CS_PIN);
+    nrf_gpio_cfg_output(FLASH_CS_PIN);
+#else
+    spi_config.ss_pin    = FLASH_CS_PIN;//SPI_SS_PIN
+#endif
+    spi_config.miso_pin  = 21;//SPI_MISO_PIN
+    spi_config.mosi_pin  = 15;//SPI_MOSI_PIN
+    spi_config.sck_pin   = 17;//SPI_SCK_PIN
+    spi_config.frequency = frequency;
+    APP_ERROR_CHECK(nrfx_spim_init(&spi, &spi_config, spi_event_handler, NULL));
+}
 
+/* Free running 1 MHz TIMER, 32 bit, wraps after ~71 minutes */
+static void bench_timer_init(void)
+{
+    nrf_timer_mode_set(BENCH_TIMER, NRF_TIMER_MODE_TIMER);
+    nrf_timer_bit_width_set(BENCH_TIMER, NRF_TIMER_BIT_WIDTH_32);
+    nrf_timer_frequency_set(BENCH_TIMER, NRF_TIMER_FREQ_1MHz);
+    nrf_timer_task_trigger(BENCH_TIMER, NRF_TIMER_TASK_CLEAR);
+    nrf_timer_task_trigger(BENCH_TIMER, NRF_TIMER_TASK_START);
+}
 
-        NRF_LOG_INFO("winbond ERASE");
+static uint32_t bench_time_us(void)
+{
+    nrf_timer_task_trigger(BENCH_TIMER, NRF_TIMER_TASK_CAPTURE0);
+    return nrf_timer_cc_read(BENCH_TIMER, NRF_TIMER_CC_CHANNEL0);
+}
+
+static void bench_log_flush(void)
+{
+    NRF_LOG_FLUSH();
+}
 
-        status = w25n01gc_flash_erase(&flash_dev, 10, 10000);
+int main(void)
+{
+    int8_t status = FLASH_SUCCESS;
+    flash_device_t flash_dev;
+    flash_bench_t bench;
+
+    APP_ERROR_CHECK(NRF_LOG_INIT(NULL));
+    NRF_LOG_DEFAULT_BACKENDS_INIT();
+
+    bench_timer_init();
+
+    memset(&flash_dev, 0, sizeof(flash_dev));
+    flash_dev.spi_xfer = spim_transfer;
+#ifdef EXT_FLASH_NO_STATIC_BUF
+    flash_dev.spi_xfer_seg = spim_transfer_seg;
+#endif
+    flash_dev.sleep = nrf_delay_ms;
+    flash_dev.delay_us = nrf_delay_us;
+    flash_dev.flash_size = 128 * 1024 * 1024;
+    flash_dev.num_of_pages_per_block = 64;
+    flash_dev.num_of_blocks = 1024;
+    flash_dev.page_size = 2 * 1024;
+    flash_dev.num_ecc_bytes_per_page = 64;
+#ifdef EXT_FLASH_STATS
+    flash_dev.time_us = bench_time_us;
+#endif
+
+    memset(&bench, 0, sizeof(bench));
+    bench.flash_dev = &flash_dev;
+    bench.time_us = bench_time_us;
+    bench.base_addr = BENCH_BASE_ADDR;
+    bench.region_len = BENCH_REGION_LEN;
+    bench.max_ops = BENCH_MAX_OPS;
+    bench.buf = bench_buf;
+    bench.buf_len = sizeof(bench_buf);
+    bench.lat_buf = bench_lat;
+    bench.lat_buf_len = BENCH_LAT_SAMPLES;
+    bench.flush = bench_log_flush;
+
+    NRF_LOG_INFO("SPI flash benchmark started.");
+    NRF_LOG_FLUSH();
+
+    for (uint32_t f = 0; f < ARRAY_SIZE(bench_freqs); f++)
+    {
+        spim_init(bench_freqs[f]);
+
+        status = w25n01gv_init(&flash_dev);
         if (status != FLASH_SUCCESS)
         {
-            NRF_LOG_INFO("winbond erase fail");
+            NRF_LOG_INFO("winbond init fail");
+            NRF_LOG_FLUSH();
+            nrfx_spim_uninit(&spi);
+            continue;
         }
 
-        NRF_LOG_INFO("winbond read after erase##############");
-        status = w25n01gc_flash_read(&flash_dev, 10, recv_buf, 100);
-        if (status != FLASH_SUCCESS)
+        /* CPU only, once is enough */
+        if (f == 0)
         {
-            NRF_LOG_INFO("winbond read fail");
+            flash_bench_geometry(&bench, BENCH_GEOMETRY_OPS);
         }
-        NRF_LOG_INFO("winbond read erase end##############");
 
-        NRF_LOG_INFO("winbond WRITE");
+        NRF_LOG_INFO("SPI %u kHz", bench_freqs_khz[f]);
+        flash_bench_print_header();
+        NRF_LOG_FLUSH();
 
-        status = w25n01gc_flash_write(&flash_dev, 10, tx_buf, 100);
+        status = flash_bench_sweep(&bench, BENCH_MIN_XFER_SIZE,
+                                   BENCH_MAX_XFER_SIZE, true);
         if (status != FLASH_SUCCESS)
         {
-            NRF_LOG_INFO("winbond write fail");
+            NRF_LOG_INFO("sweep reported errors");
         }
 
-        NRF_LOG_INFO("winbond WRITE end");
+#ifdef EXT_FLASH_STATS
+        flash_stats_dump(&flash_dev);
+#endif
+        NRF_LOG_FLUSH();
 
+        nrfx_spim_uninit(&spi);
+    }
 
-        memset(recv_buf, 0, 2200);
-
-        NRF_LOG_INFO("winbond read after write##############");
-        status = w25n01gc_flash_read(&flash_dev, 10, recv_buf, 100);
-        if (status != FLASH_SUCCESS)
-        {
-            NRF_LOG_INFO("winbond read fail");
-        }
-        NRF_LOG_INFO("winbond read wr end##############");
+    NRF_LOG_INFO("SPI flash benchmark done.");
+    NRF_LOG_FLUSH();
 
-        int status = memcmp (tx_buf, recv_buf, 100);
-        if (status == 0)
-        {
-             NRF_LOG_INFO("********MATCH*********");
-        }
-        else
-        {
-             NRF_LOG_INFO("********:(:( nnnooooooo*********");
-        }
-        NRF_LOG_INFO("");
-        for (int i = 0; i < 100; i++)
-        {
-            tx_buf[i]++;
-        }
-        nrf_delay_ms(2000);
+    while (1)
+    {
+        __WFE();
     }
 }
-
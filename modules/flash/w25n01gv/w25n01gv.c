@@ -1,80 +1,44 @@
 #include "w25n01gv_internal.h"
 
 /* static function declaration */
-static int8_t w25n01gv_device_reset(flash_device_t* w25n01gc_flash);
-static int8_t w25n01gv_read_jedec_id(flash_device_t* w25n01gc_flash,
-                                     uint8_t* jedec_id, uint32_t len);
-static int8_t w25n01gv_read_status_reg(flash_device_t* w25n01gc_flash,
-                                       uint8_t reg_addr, uint8_t* reg_read);
-static int8_t w25n01gv_write_status_reg(flash_device_t* w25n01gc_flash,
-                                        uint8_t reg_addr, uint8_t* reg_write);
-static int8_t w25n01gv_write_enable(flash_device_t* w25n01gc_flash);
-static int8_t w25n01gv_write_disable(flash_device_t* w25n01gc_flash);
-static int8_t w25n01gv_bad_block_mgmt(flash_device_t* w25n01gc_flash);
-static int8_t w25n01gv_read_bbm_lut(flash_device_t* w25n01gc_flash);
-static int8_t w25n01gv_last_ecc_failure_addr(flash_device_t* w25n01gc_flash);
-static int8_t w25n01gv_block_erase(flash_device_t* w25n01gc_flash,
-                                   uint16_t page_addr);
-static int8_t w25n01gv_load_program_data(flash_device_t* w25n01gc_flash,
-                                         bool random_load, uint16_t col_addr,
-                                         uint8_t* buf, uint16_t buf_len);
-static int8_t w25n01gv_quad_load_program_data(flash_device_t* w25n01gc_flash,
-                                              bool random_load,
-                                              uint16_t col_addr, uint8_t* buf,
-                                              uint16_t buf_len);
-static int8_t w25n01gv_program_execute(flash_device_t* w25n01gc_flash,
-                                       uint16_t page_addr);
-static int8_t w25n01gv_page_data_read(flash_device_t* w25n01gc_flash,
-                                      uint16_t page_addr);
-static int8_t w25n01gv_read_data(flash_device_t* w25n01gc_flash,
-                                 uint16_t col_addr, uint8_t* buf,
-                                 uint16_t buf_len);
-static int8_t w25n01gv_fast_read(flash_device_t* w25n01gc_flash);
-static int8_t w25n01gv_fast_read_4byte_addr(flash_device_t* w25n01gc_flash);
-static int8_t w25n01gv_fast_read_dual_output(flash_device_t* w25n01gc_flash);
-static int8_t w25n01gv_fast_read_dual_output_4byte_addr(
-    flash_device_t* w25n01gc_flash);
-static int8_t w25n01gv_fast_read_quad_output(flash_device_t* w25n01gc_flash);
-static int8_t w25n01gv_fast_read_quad_output_4byte_addr(
-    flash_device_t* w25n01gc_flash);
-static int8_t w25n01gv_fast_read_dual_io(flash_device_t* w25n01gc_flash);
-static int8_t w25n01gv_fast_read_dual_io_4byte_addr(
-    flash_device_t* w25n01gc_flash);
-static int8_t w25n01gv_fast_read_quad_io(flash_device_t* w25n01gc_flash);
-static int8_t w25n01gv_fast_read_quad_io_4byte_addr(
-    flash_device_t* w25n01gc_flash);
-static int8_t check_ecc(flash_device_t* w25n01gc_flash);
-static int8_t check_fail(flash_device_t* w25n01gc_flash);
-static int8_t check_busy(flash_device_t* w25n01gc_flash);
+static int8_t w25n01gv_exec(flash_device_t* w25n01gc_flash, uint8_t cmd_id,
+                            uint16_t addr, uint8_t* buf, uint32_t len,
+                            w25n01gv_status_t* flash_status);
+static void decode_status(uint8_t reg_val, w25n01gv_status_t* flash_status);
+static int8_t read_status(flash_device_t* w25n01gc_flash,
+                          w25n01gv_status_t* flash_status);
+static int8_t check_fail(const w25n01gv_status_t* flash_status,
+                         uint8_t fail_mask);
+static int8_t read_protection_reg(flash_device_t* w25n01gc_flash);
 static int8_t set_block_protect(flash_device_t* w25n01gc_flash,
-                                uint8_t block_protect_mode);
+                                uint8_t block_protect_mode, bool wp_enable);
 static int8_t wait_if_busy(flash_device_t* w25n01gc_flash,
-                           uint32_t busy_timeout);
+                           const w25n01gv_wait_t* wait,
+                           w25n01gv_status_t* flash_status);
+static int8_t load_page(flash_device_t* w25n01gc_flash, uint16_t page_addr);
 
-static int8_t check_ecc(flash_device_t* w25n01gc_flash)
+static void decode_status(uint8_t reg_val, w25n01gv_status_t* flash_status)
 {
-    uint8_t reg_val;
-    int8_t status = FLASH_SUCCESS;
-
-    status =
-        w25n01gv_read_status_reg(w25n01gc_flash, W25N01GV_STATUS_REG, &reg_val);
-    if (status != FLASH_SUCCESS)
-    {
-        LOG_FLASH(ERROR, "W25N01GV: %s, %d: read_status_reg fail!", __func__,
-                  __LINE__);
-        return status;
-    }
-
-    return ((reg_val & W25N01GV_ECC_MASK) >> W25N01GV_ECC_OFFSET);
+    flash_status->raw = reg_val;
+    flash_status->busy = (reg_val & W25N01GV_BUSY_MASK) >> W25N01GV_BUSY_OFFSET;
+    flash_status->wel = (reg_val & W25N01GV_WEL_MASK) >> W25N01GV_WEL_OFFSET;
+    flash_status->efail =
+        (reg_val & W25N01GV_EFAIL_MASK) >> W25N01GV_EFAIL_OFFSET;
+    flash_status->pfail =
+        (reg_val & W25N01GV_PFAIL_MASK) >> W25N01GV_PFAIL_OFFSET;
+    flash_status->ecc = (reg_val & W25N01GV_ECC_MASK) >> W25N01GV_ECC_OFFSET;
+    flash_status->lutf = (reg_val & W25N01GV_LUTF_MASK) >> W25N01GV_LUTF_OFFSET;
 }
 
-static int8_t check_fail(flash_device_t* w25n01gc_flash)
+/* Single READ_STATUS_REG of register 0xC0, decoded */
+static int8_t read_status(flash_device_t* w25n01gc_flash,
+                          w25n01gv_status_t* flash_status)
 {
     uint8_t reg_val;
     int8_t status = FLASH_SUCCESS;
 
-    status =
-        w25n01gv_read_status_reg(w25n01gc_flash, W25N01GV_STATUS_REG, &reg_val);
+    status = w25n01gv_exec(w25n01gc_flash, W25N01GV_CMD_READ_STATUS_REG,
+                           W25N01GV_STATUS_REG, &reg_val, 1, NULL);
     if (status != FLASH_SUCCESS)
     {
         LOG_FLASH(ERROR, "W25N01GV: %s, %d: read_status_reg fail!", __func__,
@@ -82,13 +46,30 @@ static int8_t check_fail(flash_device_t* w25n01gc_flash)
         return status;
     }
 
-    if (((reg_val & W25N01GV_EFAIL_MASK) >> W25N01GV_EFAIL_OFFSET) == 0x01)
+    FLASH_STATS_STATUS_POLL(w25n01gc_flash);
+    decode_status(reg_val, flash_status);
+
+    w25n01gc_flash->dev_state &= ~(W25N01GV_STATE_WEL | W25N01GV_STATE_BUSY);
+    w25n01gc_flash->dev_state |= flash_status->wel ? W25N01GV_STATE_WEL : 0;
+    w25n01gc_flash->dev_state |= flash_status->busy ? W25N01GV_STATE_BUSY : 0;
+    return FLASH_SUCCESS;
+}
+
+/*
+ * Fail bit of the operation that just ended, fail_mask W25N01GV_EFAIL_MASK
+ * or W25N01GV_PFAIL_MASK. Each bit is only cleared by the next operation of
+ * its own kind, the other one may be left over from an earlier failure.
+ */
+static int8_t check_fail(const w25n01gv_status_t* flash_status,
+                         uint8_t fail_mask)
+{
+    if ((fail_mask & W25N01GV_EFAIL_MASK) && flash_status->efail)
     {
         LOG_FLASH(INFO, "W25N01GV: %s, %d: erase fail bit set!", __func__,
                   __LINE__);
         return ERASE_FAIL_CODE;
     }
-    else if (((reg_val & W25N01GV_PFAIL_MASK) >> W25N01GV_PFAIL_OFFSET) == 0x01)
+    else if ((fail_mask & W25N01GV_PFAIL_MASK) && flash_status->pfail)
     {
         LOG_FLASH(INFO, "W25N01GV: %s, %d: program fail bit set!", __func__,
                   __LINE__);
@@ -97,49 +78,53 @@ static int8_t check_fail(flash_device_t* w25n01gc_flash)
     return ERASE_PROGRAM_SUCESS;
 }
 
-static int8_t check_busy(flash_device_t* w25n01gc_flash)
+static int8_t read_protection_reg(flash_device_t* w25n01gc_flash)
 {
-    uint8_t reg_val;
-    int8_t status = FLASH_SUCCESS;
+    int8_t status;
 
-    status =
-        w25n01gv_read_status_reg(w25n01gc_flash, W25N01GV_STATUS_REG, &reg_val);
+    status = w25n01gv_exec(w25n01gc_flash, W25N01GV_CMD_READ_STATUS_REG,
+                           W25N01GV_PROTECTION_REG, &w25n01gc_flash->prot_reg,
+                           1, NULL);
     if (status != FLASH_SUCCESS)
     {
         LOG_FLASH(ERROR, "W25N01GV: %s, %d: read_status_reg fail!", __func__,
                   __LINE__);
-        return status;
     }
-
-    return ((reg_val & W25N01GV_BUSY_MASK) >> W25N01GV_BUSY_OFFSET);
+    return status;
 }
 
+/*
+ * Writes BP/TB and WP-E if they differ from the cached register, SRP bits
+ * are kept. The read back only happens on a real change.
+ */
 static int8_t set_block_protect(flash_device_t* w25n01gc_flash,
-                                uint8_t block_protect_mode)
+                                uint8_t block_protect_mode, bool wp_enable)
 {
-    uint8_t reg_val;
+    uint8_t reg_val = w25n01gc_flash->prot_reg;
     uint8_t reg_write;
     int8_t status = FLASH_SUCCESS;
 
-    status =
-        w25n01gv_read_status_reg(w25n01gc_flash, W25N01GV_PROTECTION_REG, &reg_val);
-    if (status != FLASH_SUCCESS)
+    reg_val &= ~(W25N01GV_BP_MASK | W25N01GV_TB_MASK | W25N01GV_WPE_MASK);
+    reg_val |= (block_protect_mode & W25N01GV_PROTECT_BP_MASK)
+               << W25N01GV_BP_OFFSET;
+    if (block_protect_mode & W25N01GV_PROTECT_TB_MASK)
     {
-        LOG_FLASH(ERROR, "W25N01GV: %s, %d: read_status_reg fail!", __func__,
-                  __LINE__);
-        return status;
+        reg_val |= W25N01GV_TB_MASK;
+    }
+    if (wp_enable)
+    {
+        reg_val |= W25N01GV_WPE_MASK;
     }
 
-    reg_val &= ~W25N01GV_BP_MASK;
-    reg_val &= ~W25N01GV_TB_MASK;
-
-    reg_val |= ((block_protect_mode & 0x0F) << W25N01GV_BP_OFFSET);
-    reg_val |= ((block_protect_mode & 0x10) << W25N01GV_TB_OFFSET);
+    if (reg_val == w25n01gc_flash->prot_reg)
+    {
+        return FLASH_SUCCESS;
+    }
 
     reg_write = reg_val;
 
-    status = w25n01gv_write_status_reg(w25n01gc_flash, W25N01GV_PROTECTION_REG,
-                                       &reg_val);
+    status = w25n01gv_exec(w25n01gc_flash, W25N01GV_CMD_WRITE_STATUS_REG,
+                           W25N01GV_PROTECTION_REG, &reg_val, 1, NULL);
     if (status != FLASH_SUCCESS)
     {
         LOG_FLASH(ERROR, "W25N01GV: %s, %d: write_status_reg fail!", __func__,
@@ -147,58 +132,80 @@ static int8_t set_block_protect(flash_device_t* w25n01gc_flash,
         return status;
     }
 
-    /* Recheck if the value is correct */
-    status =
-        w25n01gv_read_status_reg(w25n01gc_flash, W25N01GV_PROTECTION_REG, &reg_val);
+    /* Recheck if the value is correct, SRP and /WP can block the write */
+    status = read_protection_reg(w25n01gc_flash);
     if (status != FLASH_SUCCESS)
     {
-        LOG_FLASH(ERROR, "W25N01GV: %s, %d: read_status_reg fail!", __func__,
-                  __LINE__);
         return status;
     }
 
-    if (reg_write != reg_val)
+    if (reg_write != w25n01gc_flash->prot_reg)
     {
         LOG_FLASH(ERROR, "W25N01GV: %s, %d:written value mismatch!", __func__,
                   __LINE__);
-        return status;
+        return FLASH_MISC_FAILURE;
     }
 
     return FLASH_SUCCESS;
 }
 
-static int8_t wait_if_busy(flash_device_t* w25n01gc_flash, uint32_t busy_timeout)
+/*
+ * Polls the status register until BUSY clears. The last snapshot read is
+ * returned in flash_status, so callers get EFAIL/PFAIL/ECC of the operation
+ * they waited for without another status transaction.
+ */
+static int8_t wait_if_busy(flash_device_t* w25n01gc_flash,
+                           const w25n01gv_wait_t* wait,
+                           w25n01gv_status_t* flash_status)
 {
     uint32_t iter = 0;
+    uint32_t waited_us = 0;
     int8_t status = FLASH_SUCCESS;
-    /* TODO Implement custom timeout */
-    while (status == 1)
+    uint32_t start_us = FLASH_STATS_NOW(w25n01gc_flash);
+
+    /* Operations known to outlast a status read are not polled right away */
+    if (wait->settle_ms != 0)
+    {
+        w25n01gc_flash->sleep(wait->settle_ms);
+    }
+    else if (wait->settle_us != 0)
     {
-        if (iter == busy_timeout)
+        if (w25n01gc_flash->delay_us != NULL)
         {
-            return FLASH_TIMEOUT;
+            w25n01gc_flash->delay_us(wait->settle_us);
+        }
+        else
+        {
+            w25n01gc_flash->sleep(1);
         }
-        w25n01gc_flash->sleep(W25N01GV_BUSY_SLEEP_TIME_MS);
-        iter++;
-        status = check_busy(w25n01gc_flash);
     }
-    return status;
-}
-
-static int8_t w25n01gv_write_enable(flash_device_t* w25n01gc_flash)
-{
-    spi_transfer_t spi_xfer_data;
-    int8_t status;
 
-    memset(&spi_xfer_data, 0, sizeof(spi_transfer_t));
+    status = read_status(w25n01gc_flash, flash_status);
+    /* TODO Implement custom timeout */
+    while ((status == FLASH_SUCCESS) && flash_status->busy)
+    {
+        /* Short polls over the window, known by the delays spent */
+        if ((waited_us < wait->poll_window_us) &&
+            (w25n01gc_flash->delay_us != NULL))
+        {
+            w25n01gc_flash->delay_us(wait->poll_us);
+            waited_us += wait->poll_us;
+        }
+        else if (iter == wait->timeout)
+        {
+            status = FLASH_TIMEOUT;
+            break;
+        }
+        else
+        {
+            w25n01gc_flash->sleep(wait->sleep_ms);
+            iter++;
+        }
+        status = read_status(w25n01gc_flash, flash_status);
+    }
 
-    spi_xfer_data.opcode = W25N01GV_WRITE_ENABLE;
-    spi_xfer_data.dummy_cycles = W25N01GV_WRITE_ENABLE_DUMMY_CYCLES;
-    spi_xfer_data.rx_len = 0;
-    spi_xfer_data.tx_len = 0;
+    FLASH_STATS_BUSY_WAIT(w25n01gc_flash, start_us);
 
-    /* Wait for busy bit */
-    status = wait_if_busy(w25n01gc_flash, W25N01GV_BUSY_DEFAULT_TIMEOUT_MS);
     if (status != FLASH_SUCCESS)
     {
         if (status == FLASH_TIMEOUT)
@@ -211,705 +218,1036 @@ static int8_t w25n01gv_write_enable(flash_device_t* w25n01gc_flash)
             LOG_FLASH(ERROR, "W25N01GV: %s, %d: wait if busy fail!", __func__,
                       __LINE__);
         }
-        return status;
-    }
-
-    status = flash_spi_transfer(w25n01gc_flash, &spi_xfer_data);
-    if (status != FLASH_SUCCESS)
-    {
-        LOG_FLASH(ERROR, "W25N01GV: %s, %d: spi transfer failed", __func__,
-                  __LINE__);
-        return status;
     }
-
     return status;
 }
 
-static int8_t w25n01gv_write_disable(flash_device_t* w25n01gc_flash)
+/*
+ * Command sequences. Each entry describes the wire format of one instruction
+ * and what has to happen around it, w25n01gv_exec() runs them. Supporting a
+ * sibling part is a matter of a new table, not new functions.
+ */
+static const w25n01gv_instr_t w25n01gv_instr_table[W25N01GV_CMD_MAX] = {
+    [W25N01GV_CMD_DEVICE_RESET] =
+        {W25N01GV_DEVICE_RESET, 0, 0,
+         W25N01GV_INSTR_CLEARS_WEL | W25N01GV_INSTR_WAIT(W25N01GV_WAIT_READ)},
+    [W25N01GV_CMD_JEDEC_ID] =
+        {W25N01GV_JEDEC_ID, 0, W25N01GV_JEDEC_ID_DUMMY_CYCLES,
+         W25N01GV_INSTR_RX},
+    [W25N01GV_CMD_READ_STATUS_REG] =
+        {W25N01GV_READ_STATUS_REG, W25N01GV_SR_ADDR_SIZE,
+         W25N01GV_READ_STATUS_REG_DUMMY_CYCLES, W25N01GV_INSTR_RX},
+    [W25N01GV_CMD_WRITE_STATUS_REG] =
+        {W25N01GV_WRITE_STATUS_REG, W25N01GV_SR_ADDR_SIZE,
+         W25N01GV_WRITE_STATUS_REG_DUMMY_CYCLES, W25N01GV_INSTR_TX},
+    [W25N01GV_CMD_WRITE_ENABLE] =
+        {W25N01GV_WRITE_ENABLE, 0, W25N01GV_WRITE_ENABLE_DUMMY_CYCLES, 0},
+    [W25N01GV_CMD_WRITE_DISABLE] =
+        {W25N01GV_WRITE_DISABLE, 0, W25N01GV_WRITE_DISABLE_DUMMY_CYCLES,
+         W25N01GV_INSTR_CLEARS_WEL},
+    [W25N01GV_CMD_BB_MANAGEMENT] =
+        {W25N01GV_BB_MANAGEMENT, 0, W25N01GV_BB_MANAGEMENT_DUMMY_CYCLES,
+         W25N01GV_INSTR_WREN | W25N01GV_INSTR_CLEARS_WEL | W25N01GV_INSTR_TX},
+    [W25N01GV_CMD_READ_BBM_LUT] =
+        {W25N01GV_READ_BBM_LUT, 0, W25N01GV_READ_BBM_LUT_DUMMY_CYCLES,
+         W25N01GV_INSTR_RX},
+    [W25N01GV_CMD_LAST_ECC_FAILURE_PAGE_ADDR] =
+        {W25N01GV_LAST_ECC_FAILURE_PAGE_ADDR, 0,
+         W25N01GV_LAST_ECC_FAILURE_PAGE_ADDR_DUMMY_CYCLES, W25N01GV_INSTR_RX},
+    [W25N01GV_CMD_BLOCK_ERASE] =
+        {W25N01GV_BLOCK_ERASE, W25N01GV_PAGE_ADDR_SIZE,
+         W25N01GV_BLOCK_ERASE_DUMMY_CYCLES,
+         W25N01GV_INSTR_WREN | W25N01GV_INSTR_CLEARS_WEL |
+         W25N01GV_INSTR_WAIT(W25N01GV_WAIT_ERASE)},
+    [W25N01GV_CMD_PROGRAM_DATA_LOAD] =
+        {W25N01GV_PROGRAM_DATA_LOAD, W25N01GV_COLUMN_ADDR_SIZE,
+         W25N01GV_PROGRAM_DATA_LOAD_DUMMY_CYCLES,
+         W25N01GV_INSTR_WREN | W25N01GV_INSTR_TX},
+    [W25N01GV_CMD_RANDOM_PROGRAM_DATA_LOAD] =
+        {W25N01GV_RANDOM_PROGRAM_DATA_LOAD, W25N01GV_COLUMN_ADDR_SIZE,
+         W25N01GV_RANDOM_PROGRAM_DATA_LOAD_DUMMY_CYCLES,
+         W25N01GV_INSTR_WREN | W25N01GV_INSTR_TX},
+    [W25N01GV_CMD_PROGRAM_EXECUTE] =
+        {W25N01GV_PROGRAM_EXECUTE, W25N01GV_PAGE_ADDR_SIZE,
+         W25N01GV_PROGRAM_EXECUTE_DUMMY_CYCLES,
+         W25N01GV_INSTR_CLEARS_WEL | W25N01GV_INSTR_WAIT(W25N01GV_WAIT_PROGRAM)},
+    [W25N01GV_CMD_PAGE_DATA_READ] =
+        {W25N01GV_PAGE_DATA_READ, W25N01GV_PAGE_ADDR_SIZE,
+         W25N01GV_PAGE_DATA_READ_DUMMY_CYCLES,
+         W25N01GV_INSTR_WAIT(W25N01GV_WAIT_READ)},
+    [W25N01GV_CMD_READ] =
+        {W25N01GV_READ, W25N01GV_COLUMN_ADDR_SIZE, W25N01GV_READ_DUMMY_CYCLES,
+         W25N01GV_INSTR_RX | W25N01GV_INSTR_DUMMY_AFTER_ADDR},
+};
+
+static const w25n01gv_wait_t w25n01gv_wait[] = {
+    [W25N01GV_WAIT_NONE] = {0, 0, 0, 0, 0, 0},
+    [W25N01GV_WAIT_DEFAULT] = {W25N01GV_BUSY_DEFAULT_TIMEOUT_MS,
+                               W25N01GV_BUSY_SLEEP_TIME_MS, 0, 0, 0, 0},
+    [W25N01GV_WAIT_ERASE] = {W25N01GV_BUSY_ERASE_TIMEOUT_MS,
+                             W25N01GV_BUSY_ERASE_SLEEP_MS,
+                             W25N01GV_BUSY_ERASE_SETTLE_MS, 0, 0, 0},
+    [W25N01GV_WAIT_PROGRAM] = {W25N01GV_BUSY_PROGRAM_TIMEOUT_MS,
+                               W25N01GV_BUSY_PROGRAM_SLEEP_MS, 0,
+                               W25N01GV_BUSY_PROGRAM_SETTLE_US,
+                               W25N01GV_BUSY_PROGRAM_POLL_US,
+                               W25N01GV_BUSY_PROGRAM_WINDOW_US},
+    [W25N01GV_WAIT_READ] = {W25N01GV_BUSY_READ_TIMEOUT_MS,
+                            W25N01GV_BUSY_READ_SLEEP_MS, 0,
+                            W25N01GV_BUSY_READ_SETTLE_US,
+                            W25N01GV_BUSY_READ_POLL_US,
+                            W25N01GV_BUSY_READ_WINDOW_US},
+};
+
+/*
+ * Runs one table entry: optional WRITE_ENABLE, the instruction with addr
+ * encoded big endian over the entry's address width and buf as the data
+ * phase, then the post-wait. When the entry waits, the final status snapshot
+ * is returned in flash_status (may be NULL).
+ *
+ * dev_state mirrors WEL and BUSY so WRITE_ENABLE is only sent when the latch
+ * is clear and the chip is only polled before a command when an earlier one
+ * was left running. A failed transfer leaves both unknown, taken as WEL
+ * clear and BUSY set.
+ */
+static int8_t w25n01gv_exec(flash_device_t* w25n01gc_flash, uint8_t cmd_id,
+                            uint16_t addr, uint8_t* buf, uint32_t len,
+                            w25n01gv_status_t* flash_status)
 {
+    const w25n01gv_instr_t* instr = &w25n01gv_instr_table[cmd_id];
+    uint8_t wait_class = W25N01GV_INSTR_WAIT_CLASS(instr->flags);
+    w25n01gv_status_t local_status;
     spi_transfer_t spi_xfer_data;
+    uint8_t send_addr[2];
     int8_t status;
 
-    memset(&spi_xfer_data, 0, sizeof(spi_transfer_t));
-
-    spi_xfer_data.opcode = W25N01GV_WRITE_DISABLE;
-    spi_xfer_data.dummy_cycles = W25N01GV_WRITE_DISABLE_DUMMY_CYCLES;
-    spi_xfer_data.rx_len = 0;
-    spi_xfer_data.tx_len = 0;
-
-    /* Wait for busy bit */
-    status = wait_if_busy(w25n01gc_flash, W25N01GV_BUSY_DEFAULT_TIMEOUT_MS);
-    if (status != FLASH_SUCCESS)
+    if ((w25n01gc_flash->dev_state & W25N01GV_STATE_BUSY) &&
+        (cmd_id != W25N01GV_CMD_READ_STATUS_REG) &&
+        (cmd_id != W25N01GV_CMD_DEVICE_RESET))
     {
-        if (status == FLASH_TIMEOUT)
+        status = wait_if_busy(w25n01gc_flash,
+                              &w25n01gv_wait[W25N01GV_WAIT_DEFAULT],
+                              &local_status);
+        if (status != FLASH_SUCCESS)
         {
-            LOG_FLASH(ERROR, "W25N01GV: %s, %d: wait if busy timeout!",
-                      __func__, __LINE__);
+            return status;
         }
-        else
+    }
+
+    if ((instr->flags & W25N01GV_INSTR_WREN) &&
+        !(w25n01gc_flash->dev_state & W25N01GV_STATE_WEL))
+    {
+        status = w25n01gv_exec(w25n01gc_flash, W25N01GV_CMD_WRITE_ENABLE, 0,
+                               NULL, 0, NULL);
+        if (status != FLASH_SUCCESS)
         {
-            LOG_FLASH(ERROR, "W25N01GV: %s, %d: wait if busy fail!", __func__,
-                      __LINE__);
+            return status;
         }
-        return status;
     }
 
+    send_addr[0] = (addr >> 8) & 0xFF;
+    send_addr[1] = addr & 0xFF;
+
+    spi_xfer_data.opcode = instr->opcode;
+    spi_xfer_data.dummy_cycles = instr->dummy_cycles;
+    spi_xfer_data.dummy_cyles_pos =
+        (instr->flags & W25N01GV_INSTR_DUMMY_AFTER_ADDR) ? 1 : 0;
+    spi_xfer_data.addr_len = instr->addr_len;
+    spi_xfer_data.addr = &send_addr[sizeof(send_addr) - instr->addr_len];
+    spi_xfer_data.tx_buf = buf;
+    spi_xfer_data.tx_len = (instr->flags & W25N01GV_INSTR_TX) ? len : 0;
+    spi_xfer_data.rx_buf = buf;
+    spi_xfer_data.rx_len = (instr->flags & W25N01GV_INSTR_RX) ? len : 0;
+
     status = flash_spi_transfer(w25n01gc_flash, &spi_xfer_data);
     if (status != FLASH_SUCCESS)
     {
-        LOG_FLASH(ERROR, "W25N01GV: %s, %d:  spi transfer failed", __func__,
-                  __LINE__);
+        LOG_FLASH(ERROR, "W25N01GV: %s, %d: opcode 0x%02X spi transfer failed",
+                  __func__, __LINE__, instr->opcode);
+        w25n01gc_flash->dev_state = W25N01GV_STATE_BUSY;
         return status;
     }
 
-    return status;
-}
-
-static int8_t w25n01gv_read_status_reg(flash_device_t* w25n01gc_flash,
-                                       uint8_t reg_addr, uint8_t* reg_read)
-{
-    spi_transfer_t spi_xfer_data;
-    int8_t status;
-
-    memset(&spi_xfer_data, 0, sizeof(spi_transfer_t));
-
-    spi_xfer_data.opcode = W25N01GV_READ_STATUS_REG;
-    spi_xfer_data.dummy_cycles = W25N01GV_READ_STATUS_REG_DUMMY_CYCLES;
-    spi_xfer_data.rx_buf = reg_read;
-    spi_xfer_data.rx_len = 1;
-    spi_xfer_data.tx_len = 0;
-    spi_xfer_data.addr = &reg_addr;
-    spi_xfer_data.addr_len = W25N01GV_SR_ADDR_SIZE;
+    if (cmd_id == W25N01GV_CMD_WRITE_ENABLE)
+    {
+        w25n01gc_flash->dev_state |= W25N01GV_STATE_WEL;
+    }
+    else if (instr->flags & W25N01GV_INSTR_CLEARS_WEL)
+    {
+        w25n01gc_flash->dev_state &= ~W25N01GV_STATE_WEL;
+    }
 
-    status = flash_spi_transfer(w25n01gc_flash, &spi_xfer_data);
-    if (status != FLASH_SUCCESS)
+    if (wait_class != W25N01GV_WAIT_NONE)
     {
-        LOG_FLASH(ERROR, "W25N01GV: %s, %d:  spi transfer failed", __func__,
-                  __LINE__);
-        return status;
+        w25n01gc_flash->dev_state |= W25N01GV_STATE_BUSY;
+        status = wait_if_busy(w25n01gc_flash, &w25n01gv_wait[wait_class],
+                              (flash_status != NULL) ? flash_status
+                                                     : &local_status);
     }
 
     return status;
 }
 
-static int8_t w25n01gv_write_status_reg(flash_device_t* w25n01gc_flash,
-                                        uint8_t reg_addr, uint8_t* reg_write)
+#ifndef W25N01GV_FIXED_GEOMETRY
+static int8_t geometry_shift(uint32_t val, uint8_t* shift)
 {
-    spi_transfer_t spi_xfer_data;
-    int8_t status;
-
-    memset(&spi_xfer_data, 0, sizeof(spi_transfer_t));
-
-    spi_xfer_data.opcode = W25N01GV_WRITE_STATUS_REG;
-    spi_xfer_data.dummy_cycles = W25N01GV_WRITE_STATUS_REG_DUMMY_CYCLES;
-    spi_xfer_data.rx_len = 0;
-    spi_xfer_data.tx_buf = reg_write;
-    spi_xfer_data.tx_len = 1;
-    spi_xfer_data.addr = &reg_addr;
-    spi_xfer_data.addr_len = W25N01GV_SR_ADDR_SIZE;
+    uint8_t bits = 0;
 
-    /* Wait for busy bit */
-    status = wait_if_busy(w25n01gc_flash, W25N01GV_BUSY_DEFAULT_TIMEOUT_MS);
-    if (status != FLASH_SUCCESS)
+    if ((val == 0) || ((val & (val - 1)) != 0))
     {
-        if (status == FLASH_TIMEOUT)
-        {
-            LOG_FLASH(ERROR, "W25N01GV: %s, %d: wait if busy timeout!",
-                      __func__, __LINE__);
-        }
-        else
-        {
-            LOG_FLASH(ERROR, "W25N01GV: %s, %d: wait if busy fail!", __func__,
-                      __LINE__);
-        }
-        return status;
+        return FLASH_INVALID_PARAMS;
     }
 
-    status = flash_spi_transfer(w25n01gc_flash, &spi_xfer_data);
-    if (status != FLASH_SUCCESS)
+    while ((val >>= 1) != 0)
     {
-        LOG_FLASH(ERROR, "W25N01GV: %s, %d:  spi transfer failed", __func__,
-                  __LINE__);
-        return status;
+        bits++;
     }
-
-    return status;
+    *shift = bits;
+    return FLASH_SUCCESS;
 }
+#endif
 
-static int8_t w25n01gv_block_erase(flash_device_t* w25n01gc_flash,
-                                   uint16_t page_addr)
+static int8_t init_geometry(flash_device_t* w25n01gc_flash)
 {
-    spi_transfer_t spi_xfer_data;
-    int8_t status = FLASH_SUCCESS;
-    uint8_t send_addr[2];
-
-    memset(&spi_xfer_data, 0, sizeof(spi_transfer_t));
-
-    status = w25n01gv_write_enable(w25n01gc_flash);
-    if (status != FLASH_SUCCESS)
+#ifdef W25N01GV_FIXED_GEOMETRY
+    w25n01gc_flash->flash_size = W25N01GV_FLASH_SIZE;
+    w25n01gc_flash->num_of_pages_per_block = W25N01GV_PAGES_PER_BLOCK;
+    w25n01gc_flash->num_of_blocks = W25N01GV_NUM_BLOCKS;
+    w25n01gc_flash->page_size = W25N01GV_PAGE_SIZE;
+    w25n01gc_flash->num_ecc_bytes_per_page = W25N01GV_SPARE_SIZE;
+    w25n01gc_flash->page_shift = W25N01GV_PAGE_SHIFT;
+    w25n01gc_flash->block_shift = W25N01GV_PAGES_PER_BLOCK_SHIFT;
+    return FLASH_SUCCESS;
+#else
+    if ((geometry_shift(w25n01gc_flash->page_size,
+                        &w25n01gc_flash->page_shift) != FLASH_SUCCESS) ||
+        (geometry_shift(w25n01gc_flash->num_of_pages_per_block,
+                        &w25n01gc_flash->block_shift) != FLASH_SUCCESS))
     {
-        return status;
+        LOG_FLASH(ERROR, "W25N01GV: %s, %d: geometry not a power of two",
+                  __func__, __LINE__);
+        return FLASH_INVALID_PARAMS;
     }
+    return FLASH_SUCCESS;
+#endif
+}
 
-    send_addr[0] = (page_addr >> 8) & 0xFF;
-    send_addr[1] = page_addr & 0xFF;
-
-    /* Wait for busy bit */
-    status = wait_if_busy(w25n01gc_flash, W25N01GV_BUSY_DEFAULT_TIMEOUT_MS);
-    if (status != FLASH_SUCCESS)
+static int8_t check_jedec_id(uint8_t* jedec_id, const uint8_t* cmp_id, uint16_t len)
+{
+    for (int32_t i = 0; i < len; i++)
     {
-        if (status == FLASH_TIMEOUT)
-        {
-            LOG_FLASH(ERROR, "W25N01GV: %s, %d: wait if busy timeout!",
-                      __func__, __LINE__);
-        }
-        else
+        if (jedec_id[i] != cmp_id[i])
         {
-            LOG_FLASH(ERROR, "W25N01GV: %s, %d: wait if busy fail!", __func__,
+            LOG_FLASH(ERROR, "W25N01GV: %s, %d: JEDEC ID mismatch", __func__,
                       __LINE__);
+            return FLASH_DETECT_FAIL;
         }
-        return status;
     }
+    return FLASH_SUCCESS;
+}
 
-    spi_xfer_data.opcode = W25N01GV_BLOCK_ERASE;
-    spi_xfer_data.dummy_cycles = W25N01GV_BLOCK_ERASE_DUMMY_CYCLES;
-    spi_xfer_data.dummy_cyles_pos = 0;
-    spi_xfer_data.rx_len = 0;
-    spi_xfer_data.tx_len = 0;
-    spi_xfer_data.addr_len = W25N01GV_PAGE_ADDR_SIZE;
-    spi_xfer_data.addr = send_addr;
-
-    status = flash_spi_transfer(w25n01gc_flash, &spi_xfer_data);
+int8_t detect_w25n01gv(flash_device_t* w25n01gc_flash)
+{
+    int8_t status = FLASH_SUCCESS;
+    uint8_t jedec_id[W25N01GV_JEDEC_ID_SIZE];
+    status = w25n01gv_exec(w25n01gc_flash, W25N01GV_CMD_JEDEC_ID, 0, jedec_id,
+                           W25N01GV_JEDEC_ID_SIZE, NULL);
     if (status != FLASH_SUCCESS)
     {
-        LOG_FLASH(ERROR, "W25N01GV: %s, %d:  spi transfer failed", __func__,
+        LOG_FLASH(ERROR, "W25N01GV: %s, %d: Read jedec id fail", __func__,
                   __LINE__);
         return status;
     }
 
-    return status;
+    if (check_jedec_id(jedec_id, flash_list[0].flash_dev_id,
+                       W25N01GV_JEDEC_ID_SIZE) != FLASH_SUCCESS)
+    {
+        LOG_FLASH(ERROR, "W25N01GV: %s, %d: Check jedec_id fail", __func__,
+                  __LINE__);
+        return FLASH_DETECT_FAIL;
+    }
+    return FLASH_SUCCESS;
 }
 
-static int8_t w25n01gv_load_program_data(flash_device_t* w25n01gc_flash,
-                                         bool random_load, uint16_t col_addr,
-                                         uint8_t* buf, uint16_t buf_len)
+int8_t w25n01gv_init(flash_device_t* w25n01gc_flash)
 {
-    spi_transfer_t spi_xfer_data;
-    int8_t status = FLASH_SUCCESS;
-    uint8_t send_addr[2];
+    w25n01gv_status_t flash_status;
 
-    memset(&spi_xfer_data, 0, sizeof(spi_transfer_t));
-
-    status = w25n01gv_write_enable(w25n01gc_flash);
-    if (status != FLASH_SUCCESS)
+    if (w25n01gc_flash->spi_xfer == NULL)
     {
-        return status;
+        LOG_FLASH(ERROR, "W25N01GV: %s, %d: spi_xfer NULL", __func__,
+                  __LINE__);
+        return FLASH_INVALID_PARAMS;
     }
 
-    send_addr[0] = (col_addr >> 8) & 0xFF;
-    send_addr[1] = col_addr & 0xFF;
-
-    /* Wait for busy bit */
-    status = wait_if_busy(w25n01gc_flash, W25N01GV_BUSY_DEFAULT_TIMEOUT_MS);
-    if (status != FLASH_SUCCESS)
+    if (init_geometry(w25n01gc_flash) != FLASH_SUCCESS)
     {
-        if (status == FLASH_TIMEOUT)
-        {
-            LOG_FLASH(ERROR, "W25N01GV: %s, %d: wait if busy timeout!",
-                      __func__, __LINE__);
-        }
-        else
-        {
-            LOG_FLASH(ERROR, "W25N01GV: %s, %d: wait if busy fail!", __func__,
-                      __LINE__);
-        }
-        return status;
+        return FLASH_INVALID_PARAMS;
     }
 
-    if (random_load)
+#ifdef EXT_FLASH_STATS
+    flash_stats_reset(w25n01gc_flash);
+#endif
+
+    /* Device may still be busy with power-up page 0 load */
+    w25n01gc_flash->dev_state = 0;
+    if (wait_if_busy(w25n01gc_flash, &w25n01gv_wait[W25N01GV_WAIT_DEFAULT],
+                     &flash_status) != FLASH_SUCCESS)
     {
-        spi_xfer_data.opcode = W25N01GV_RANDOM_PROGRAM_DATA_LOAD;
+        return FLASH_TIMEOUT;
     }
-    else
+
+    if (detect_w25n01gv(w25n01gc_flash) != FLASH_SUCCESS)
     {
-        spi_xfer_data.opcode = W25N01GV_PROGRAM_DATA_LOAD;
+        LOG_FLASH(ERROR, "W25N01GV: %s, %d: Detect Flash fail", __func__,
+                  __LINE__);
+        return FLASH_DETECT_FAIL;
     }
-    spi_xfer_data.dummy_cycles = W25N01GV_PROGRAM_DATA_LOAD_DUMMY_CYCLES;
-    spi_xfer_data.rx_len = 0;
-    spi_xfer_data.tx_len = buf_len;
-    spi_xfer_data.tx_buf = buf;
-    spi_xfer_data.addr_len = W25N01GV_COLUMN_ADDR_SIZE;
-    spi_xfer_data.addr = send_addr;
 
-    status = flash_spi_transfer(w25n01gc_flash, &spi_xfer_data);
-    if (status != FLASH_SUCCESS)
+    /* Protection the board asked for, the register is only written if off */
+    if ((read_protection_reg(w25n01gc_flash) != FLASH_SUCCESS) ||
+        (set_block_protect(w25n01gc_flash, w25n01gc_flash->prot_init_mode,
+                           w25n01gc_flash->prot_reg & W25N01GV_WPE_MASK) !=
+         FLASH_SUCCESS))
     {
-        LOG_FLASH(ERROR, "W25N01GV: %s, %d:  spi transfer failed", __func__,
+        LOG_FLASH(ERROR, "W25N01GV: %s, %d: Set block protect fail", __func__,
                   __LINE__);
-        return status;
+        return FLASH_MISC_FAILURE;
     }
 
-    return status;
+    return FLASH_SUCCESS;
 }
 
-static int8_t w25n01gv_program_execute(flash_device_t* w25n01gc_flash,
-                                       uint16_t page_addr)
+/*
+ * PAGE_DATA_READ into the data buffer, waiting for tRD. Returns the ECC code
+ * if the page could not be corrected.
+ */
+static int8_t load_page(flash_device_t* w25n01gc_flash, uint16_t page_addr)
 {
-    spi_transfer_t spi_xfer_data;
-    int8_t status = FLASH_SUCCESS;
-    uint8_t send_addr[2];
-
-    send_addr[0] = (page_addr >> 8) & 0xFF;
-    send_addr[1] = page_addr & 0xFF;
-
-    memset(&spi_xfer_data, 0, sizeof(spi_transfer_t));
+    w25n01gv_status_t flash_status;
+    int8_t status;
 
-    /* Wait for busy bit */
-    status = wait_if_busy(w25n01gc_flash, W25N01GV_BUSY_DEFAULT_TIMEOUT_MS);
+    status = w25n01gv_exec(w25n01gc_flash, W25N01GV_CMD_PAGE_DATA_READ,
+                           page_addr, NULL, 0, &flash_status);
     if (status != FLASH_SUCCESS)
     {
-        if (status == FLASH_TIMEOUT)
-        {
-            LOG_FLASH(ERROR, "W25N01GV: %s, %d: wait if busy timeout!",
-                      __func__, __LINE__);
-        }
-        else
-        {
-            LOG_FLASH(ERROR, "W25N01GV: %s, %d: wait if busy fail!", __func__,
-                      __LINE__);
-        }
+        LOG_FLASH(ERROR, "W25N01GV: %s, %d:  page data read fail", __func__,
+                  __LINE__);
         return status;
     }
 
-    spi_xfer_data.opcode = W25N01GV_PROGRAM_EXECUTE;
-    spi_xfer_data.dummy_cycles = W25N01GV_PROGRAM_EXECUTE_DUMMY_CYCLES;
-    spi_xfer_data.dummy_cyles_pos = 0;
-    spi_xfer_data.rx_len = 0;
-    spi_xfer_data.tx_len = 0;
-    spi_xfer_data.addr_len = W25N01GV_PAGE_ADDR_SIZE;
-    spi_xfer_data.addr = send_addr;
-
-    status = flash_spi_transfer(w25n01gc_flash, &spi_xfer_data);
-    if (status != FLASH_SUCCESS)
+    FLASH_STATS_ECC(w25n01gc_flash,
+                    (flash_status.ecc == ECC_SUCCESS_CORRECTION),
+                    ((flash_status.ecc == ECC_FAIL_SINGLE_PAGE) ||
+                     (flash_status.ecc == ECC_FAIL_MULTIPLE)));
+    /* Data is good this time, let the owner move it while it still is */
+    if ((flash_status.ecc == ECC_SUCCESS_CORRECTION) &&
+        (w25n01gc_flash->ecc_corrected != NULL))
+    {
+        w25n01gc_flash->ecc_corrected(w25n01gc_flash->ecc_ctx, page_addr);
+    }
+    if ((flash_status.ecc != ECC_SUCCESS_NO_CORRECTION) &&
+        (flash_status.ecc != ECC_SUCCESS_CORRECTION))
     {
-        LOG_FLASH(ERROR, "W25N01GV: %s, %d:  spi transfer failed", __func__,
+        LOG_FLASH(ERROR, "W25N01GV: %s, %d:  read data ECC error", __func__,
                   __LINE__);
-        return status;
+        return flash_status.ecc;
     }
 
-    return status;
+    return FLASH_SUCCESS;
 }
 
-static int8_t w25n01gv_page_data_read(flash_device_t* w25n01gc_flash,
-                                      uint16_t page_addr)
+int8_t w25n01gc_flash_read(flash_device_t* w25n01gc_flash, uint32_t addr,
+                  uint8_t* read_buf, uint32_t read_len)
 {
-    spi_transfer_t spi_xfer_data;
     int8_t status = FLASH_SUCCESS;
-    uint8_t send_addr[2];
+    uint16_t page_addr;
+    uint16_t col_addr;
+    uint32_t rem_len = read_len;
+    uint32_t read_len_page = 0;
 
-    send_addr[0] = (page_addr >> 8) & 0xFF;
-    send_addr[1] = page_addr & 0xFF;
+    if ((addr + read_len) > w25n01gc_flash->flash_size)
+    {
+        LOG_FLASH(ERROR, "W25N01GV: %s, %d: Invalid read addr", __func__,
+                  __LINE__);
+        return FLASH_INVALID_PARAMS;
+    }
 
-    memset(&spi_xfer_data, 0, sizeof(spi_transfer_t));
+    page_addr = W25N01GV_ADDR_TO_PAGE(w25n01gc_flash, addr);
+    col_addr = W25N01GV_ADDR_TO_COL(w25n01gc_flash, addr);
 
-    /* Wait for busy bit */
-    status = wait_if_busy(w25n01gc_flash, W25N01GV_BUSY_DEFAULT_TIMEOUT_MS);
-    if (status != FLASH_SUCCESS)
+    while (rem_len > 0)
     {
-        if (status == FLASH_TIMEOUT)
+        if (rem_len > (W25N01GV_DEV_PAGE_SIZE(w25n01gc_flash) - col_addr))
         {
-            LOG_FLASH(ERROR, "W25N01GV: %s, %d: wait if busy timeout!",
-                      __func__, __LINE__);
+            read_len_page = W25N01GV_DEV_PAGE_SIZE(w25n01gc_flash) - col_addr;
         }
         else
         {
-            LOG_FLASH(ERROR, "W25N01GV: %s, %d: wait if busy fail!", __func__,
+            read_len_page = rem_len;
+        }
+
+        FLASH_STATS_OP_BEGIN(w25n01gc_flash, FLASH_STATS_OP_READ);
+
+        status = load_page(w25n01gc_flash, page_addr);
+        if (status != FLASH_SUCCESS)
+        {
+            return status;
+        }
+
+        status = w25n01gv_exec(w25n01gc_flash, W25N01GV_CMD_READ, col_addr,
+                               read_buf + (read_len - rem_len), read_len_page,
+                               NULL);
+        if (status != FLASH_SUCCESS)
+        {
+            LOG_FLASH(ERROR, "W25N01GV: %s, %d:  read data read fail", __func__,
                       __LINE__);
+            return status;
         }
-        return status;
-    }
 
-    spi_xfer_data.opcode = W25N01GV_PAGE_DATA_READ;
-    spi_xfer_data.dummy_cycles = W25N01GV_PAGE_DATA_READ_DUMMY_CYCLES;
-    spi_xfer_data.dummy_cyles_pos = 0;
-    spi_xfer_data.rx_len = 0;
-    spi_xfer_data.tx_len = 0;
-    spi_xfer_data.addr_len = W25N01GV_COLUMN_ADDR_SIZE;
-    spi_xfer_data.addr = send_addr;
+        FLASH_STATS_OP_END(w25n01gc_flash);
 
-    status = flash_spi_transfer(w25n01gc_flash, &spi_xfer_data);
-    if (status != FLASH_SUCCESS)
-    {
-        LOG_FLASH(ERROR, "W25N01GV: %s, %d:  spi transfer failed", __func__,
-                  __LINE__);
-        return status;
+        rem_len -= read_len_page;
+        col_addr = 0;
+        page_addr++;
     }
 
     return status;
 }
 
-static int8_t w25n01gv_read_data(flash_device_t* w25n01gc_flash,
-                                 uint16_t col_addr, uint8_t* buf,
-                                 uint16_t buf_len)
+int8_t w25n01gc_flash_write(flash_device_t* w25n01gc_flash, uint32_t addr,
+                   uint8_t* write_buf, uint32_t write_len)
 {
-    spi_transfer_t spi_xfer_data;
     int8_t status = FLASH_SUCCESS;
-    uint8_t send_addr[2];
+    w25n01gv_status_t flash_status;
+    uint16_t page_addr;
+    uint16_t col_addr;
+    uint32_t rem_len = write_len;
+    uint32_t write_len_page = 0;
 
-    send_addr[0] = (col_addr >> 8) & 0xFF;
-    send_addr[1] = col_addr & 0xFF;
+    if ((addr + write_len) > w25n01gc_flash->flash_size)
+    {
+        LOG_FLASH(ERROR, "W25N01GV: %s, %d: Invalid read addr", __func__,
+                  __LINE__);
+        return FLASH_INVALID_PARAMS;
+    }
 
-    memset(&spi_xfer_data, 0, sizeof(spi_transfer_t));
+    page_addr = W25N01GV_ADDR_TO_PAGE(w25n01gc_flash, addr);
+    col_addr = W25N01GV_ADDR_TO_COL(w25n01gc_flash, addr);
 
-    /* Wait for busy bit */
-    status = wait_if_busy(w25n01gc_flash, W25N01GV_BUSY_DEFAULT_TIMEOUT_MS);
-    if (status != FLASH_SUCCESS)
+    while (rem_len > 0)
     {
-        if (status == FLASH_TIMEOUT)
+        if (w25n01gv_block_protected(
+                w25n01gc_flash, W25N01GV_PAGE_TO_BLOCK(w25n01gc_flash,
+                                                       page_addr)))
         {
-            LOG_FLASH(ERROR, "W25N01GV: %s, %d: wait if busy timeout!",
-                      __func__, __LINE__);
+            LOG_FLASH(ERROR, "W25N01GV: %s, %d: page %u is protected",
+                      __func__, __LINE__, page_addr);
+            return FLASH_INVALID_PARAMS;
+        }
+
+        if (rem_len > (W25N01GV_DEV_PAGE_SIZE(w25n01gc_flash) - col_addr))
+        {
+            write_len_page = W25N01GV_DEV_PAGE_SIZE(w25n01gc_flash) - col_addr;
         }
         else
         {
-            LOG_FLASH(ERROR, "W25N01GV: %s, %d: wait if busy fail!", __func__,
+            write_len_page = rem_len;
+        }
+
+        FLASH_STATS_OP_BEGIN(w25n01gc_flash, FLASH_STATS_OP_PROGRAM);
+
+        /*
+         * Plain load so the columns outside the written range are reset to
+         * 0xFF, a random load would program stale buffer contents over them.
+         */
+        status = w25n01gv_exec(w25n01gc_flash, W25N01GV_CMD_PROGRAM_DATA_LOAD,
+                               col_addr, write_buf + (write_len - rem_len),
+                               write_len_page, NULL);
+        if (status != FLASH_SUCCESS)
+        {
+            LOG_FLASH(ERROR, "W25N01GV: %s, %d: load program data fail",
+                      __func__, __LINE__);
+            return status;
+        }
+
+        /* Waits for tPP, the final snapshot carries P-FAIL */
+        status = w25n01gv_exec(w25n01gc_flash, W25N01GV_CMD_PROGRAM_EXECUTE,
+                               page_addr, NULL, 0, &flash_status);
+        if (status != FLASH_SUCCESS)
+        {
+            LOG_FLASH(ERROR, "W25N01GV: %s, %d: program execute fail", __func__,
                       __LINE__);
+            return status;
         }
-        return status;
-    }
 
-    spi_xfer_data.opcode = W25N01GV_READ;
-    spi_xfer_data.dummy_cycles = W25N01GV_READ_DUMMY_CYCLES;
-    spi_xfer_data.dummy_cyles_pos = 1;
-    spi_xfer_data.tx_len = 0;
-    spi_xfer_data.rx_len = buf_len;
-    spi_xfer_data.rx_buf = buf;
-    spi_xfer_data.addr_len = W25N01GV_COLUMN_ADDR_SIZE;
-    spi_xfer_data.addr = send_addr;
+        status = check_fail(&flash_status, W25N01GV_PFAIL_MASK);
+        if (status != ERASE_PROGRAM_SUCESS)
+        {
+            LOG_FLASH(ERROR, "W25N01GV: %s, %d: program data operation error",
+                      __func__, __LINE__);
+            return status;
+        }
 
-    status = flash_spi_transfer(w25n01gc_flash, &spi_xfer_data);
-    if (status != FLASH_SUCCESS)
-    {
-        LOG_FLASH(ERROR, "W25N01GV: %s, %d:  spi transfer failed", __func__,
-                  __LINE__);
-        return status;
+        FLASH_STATS_OP_END(w25n01gc_flash);
+
+        rem_len -= write_len_page;
+        col_addr = 0;
+        page_addr++;
     }
 
     return status;
 }
 
-static int8_t w25n01gv_read_jedec_id(flash_device_t* w25n01gc_flash,
-                                     uint8_t* jedec_id, uint32_t len)
+int8_t w25n01gc_flash_erase(flash_device_t* w25n01gc_flash, uint32_t addr,
+                   uint32_t erase_len)
 {
-    spi_transfer_t spi_xfer_data;
-    int8_t status;
-
-    memset(&spi_xfer_data, 0, sizeof(spi_transfer_t));
-
-    spi_xfer_data.opcode = W25N01GV_JEDEC_ID;
-    spi_xfer_data.dummy_cycles = W25N01GV_JEDEC_ID_DUMMY_CYCLES;
-    spi_xfer_data.dummy_cyles_pos = 0;
-    spi_xfer_data.rx_buf = jedec_id;
-    spi_xfer_data.rx_len = len;
-    spi_xfer_data.tx_len = 0;
+    int8_t status = FLASH_SUCCESS;
+    w25n01gv_status_t flash_status;
+    uint16_t page_addr;
+    uint32_t rem_len = erase_len;
+    uint32_t erase_len_block = 0;
+    uint32_t block_size = W25N01GV_DEV_BLOCK_SIZE(w25n01gc_flash);
 
-    status = flash_spi_transfer(w25n01gc_flash, &spi_xfer_data);
-    if (status != FLASH_SUCCESS)
+    if ((addr + erase_len) > w25n01gc_flash->flash_size)
     {
-        LOG_FLASH(ERROR, "W25N01GV: %s, %d:  spi transfer failed", __func__,
+        LOG_FLASH(ERROR, "W25N01GV: %s, %d: Invalid read addr", __func__,
                   __LINE__);
-        return status;
+        return FLASH_INVALID_PARAMS;
     }
 
-    return status;
-}
+    /* Erase is per block, every block touched by the range gets erased */
+    page_addr = W25N01GV_BLOCK_TO_PAGE(
+        w25n01gc_flash,
+        W25N01GV_PAGE_TO_BLOCK(w25n01gc_flash,
+                               W25N01GV_ADDR_TO_PAGE(w25n01gc_flash, addr)));
+    erase_len_block = block_size - (addr & (block_size - 1));
 
-static int8_t check_jedec_id(uint8_t* jedec_id, const uint8_t* cmp_id, uint16_t len)
-{
-    for (int32_t i = 0; i < len; i++)
+    while (rem_len > 0)
     {
-        if (jedec_id[i] != cmp_id[i])
+        if (w25n01gv_block_protected(
+                w25n01gc_flash, W25N01GV_PAGE_TO_BLOCK(w25n01gc_flash,
+                                                       page_addr)))
         {
-            LOG_FLASH(ERROR, "W25N01GV: %s, %d: JEDEC ID mismatch", __func__,
-                      __LINE__);
-            return FLASH_DETECT_FAIL;
+            LOG_FLASH(ERROR, "W25N01GV: %s, %d: block at page %u is protected",
+                      __func__, __LINE__, page_addr);
+            return FLASH_INVALID_PARAMS;
         }
+
+        FLASH_STATS_OP_BEGIN(w25n01gc_flash, FLASH_STATS_OP_ERASE);
+
+        /* Waits for tBE, the final snapshot carries E-FAIL */
+        status = w25n01gv_exec(w25n01gc_flash, W25N01GV_CMD_BLOCK_ERASE,
+                               page_addr, NULL, 0, &flash_status);
+        if (status != FLASH_SUCCESS)
+        {
+            LOG_FLASH(ERROR, "W25N01GV: %s, %d: block_erase fail",
+                      __func__, __LINE__);
+            return status;
+        }
+
+        status = check_fail(&flash_status, W25N01GV_EFAIL_MASK);
+        if (status != ERASE_PROGRAM_SUCESS)
+        {
+            LOG_FLASH(ERROR, "W25N01GV: %s, %d: erase operation error",
+                      __func__, __LINE__);
+            return status;
+        }
+
+        FLASH_STATS_OP_END(w25n01gc_flash);
+
+        if (rem_len <= erase_len_block)
+        {
+            break;
+        }
+        rem_len -= erase_len_block;
+        erase_len_block = block_size;
+        page_addr += W25N01GV_BLOCK_TO_PAGE(w25n01gc_flash, 1);
     }
-    return FLASH_SUCCESS;
+
+    return status;
 }
 
-int8_t detect_w25n01gv(flash_device_t* w25n01gc_flash)
+static bool page_valid(flash_device_t* w25n01gc_flash, uint32_t page,
+                       uint32_t len)
+{
+    return (page < ((uint32_t)w25n01gc_flash->num_of_blocks
+                    << W25N01GV_DEV_BLOCK_SHIFT(w25n01gc_flash))) &&
+           (len <= W25N01GV_DEV_PAGE_SIZE(w25n01gc_flash));
+}
+
+int8_t w25n01gv_page_program(flash_device_t* w25n01gc_flash, uint32_t page,
+                             const uint8_t* data, uint32_t len,
+                             const uint8_t* user_spare)
 {
     int8_t status = FLASH_SUCCESS;
-    uint8_t jedec_id[W25N01GV_JEDEC_ID_SIZE];
-    status = w25n01gv_read_jedec_id(w25n01gc_flash, jedec_id, W25N01GV_JEDEC_ID_SIZE);
-    if (status != FLASH_SUCCESS)
+    w25n01gv_status_t flash_status;
+    uint16_t col_addr;
+
+    if ((data == NULL) || (len == 0) ||
+        !page_valid(w25n01gc_flash, page, len))
     {
-        LOG_FLASH(ERROR, "W25N01GV: %s, %d: Read jedec id fail", __func__,
+        LOG_FLASH(ERROR, "W25N01GV: %s, %d: Invalid page program", __func__,
                   __LINE__);
-        return status;
+        return FLASH_INVALID_PARAMS;
     }
 
-    if (check_jedec_id(jedec_id, flash_list[0].flash_dev_id,
-                       W25N01GV_JEDEC_ID_SIZE) != FLASH_SUCCESS)
+    if (w25n01gv_block_protected(w25n01gc_flash,
+                                 W25N01GV_PAGE_TO_BLOCK(w25n01gc_flash, page)))
     {
-        LOG_FLASH(ERROR, "W25N01GV: %s, %d: Check jedec_id fail", __func__,
-                  __LINE__);
-        return FLASH_DETECT_FAIL;
+        LOG_FLASH(ERROR, "W25N01GV: %s, %d: page %u is protected", __func__,
+                  __LINE__, page);
+        return FLASH_INVALID_PARAMS;
     }
-    return FLASH_SUCCESS;
-}
 
-int8_t w25n01gv_init(flash_device_t* w25n01gc_flash)
-{
-    if (w25n01gc_flash->spi_xfer == NULL)
+    FLASH_STATS_OP_BEGIN(w25n01gc_flash, FLASH_STATS_OP_PROGRAM);
+
+    /* Resets the whole buffer, spare included, to 0xFF */
+    status = w25n01gv_exec(w25n01gc_flash, W25N01GV_CMD_PROGRAM_DATA_LOAD, 0,
+                           (uint8_t*)data, len, NULL);
+    if (status != FLASH_SUCCESS)
     {
-        LOG_FLASH(ERROR, "W25N01GV: %s, %d: spi_xfer NULL", __func__,
-                  __LINE__);
-        return FLASH_INVALID_PARAMS;
+        LOG_FLASH(ERROR, "W25N01GV: %s, %d: load program data fail",
+                  __func__, __LINE__);
+        return status;
     }
 
-    if (detect_w25n01gv(w25n01gc_flash) != FLASH_SUCCESS)
+    /* User bytes go in one run per sector, the ECC bytes stay untouched */
+    for (uint8_t sect = 0;
+         (user_spare != NULL) && (sect < W25N01GV_SECTORS_PER_PAGE); sect++)
     {
-        LOG_FLASH(ERROR, "W25N01GV: %s, %d: Detect Flash fail", __func__,
-                  __LINE__);
-        return FLASH_DETECT_FAIL;
+        col_addr = W25N01GV_DEV_PAGE_SIZE(w25n01gc_flash) +
+                   (sect * W25N01GV_SPARE_SECTOR_SIZE) +
+                   W25N01GV_SPARE_USER_OFFSET;
+        status = w25n01gv_exec(
+            w25n01gc_flash, W25N01GV_CMD_RANDOM_PROGRAM_DATA_LOAD, col_addr,
+            (uint8_t*)&user_spare[sect * W25N01GV_SPARE_USER_PER_SECTOR],
+            W25N01GV_SPARE_USER_PER_SECTOR, NULL);
+        if (status != FLASH_SUCCESS)
+        {
+            LOG_FLASH(ERROR, "W25N01GV: %s, %d: load spare data fail",
+                      __func__, __LINE__);
+            return status;
+        }
     }
 
-    if (set_block_protect(w25n01gc_flash, BLOCK_PROTECT_NONE) != FLASH_SUCCESS)
+    status = w25n01gv_exec(w25n01gc_flash, W25N01GV_CMD_PROGRAM_EXECUTE,
+                           (uint16_t)page, NULL, 0, &flash_status);
+    if (status != FLASH_SUCCESS)
     {
-        LOG_FLASH(ERROR, "W25N01GV: %s, %d: Set block protect fail", __func__,
+        LOG_FLASH(ERROR, "W25N01GV: %s, %d: program execute fail", __func__,
                   __LINE__);
-        return FLASH_MISC_FAILURE;
+        return status;
+    }
+
+    status = check_fail(&flash_status, W25N01GV_PFAIL_MASK);
+    if (status != ERASE_PROGRAM_SUCESS)
+    {
+        LOG_FLASH(ERROR, "W25N01GV: %s, %d: program data operation error",
+                  __func__, __LINE__);
+        return status;
     }
+
+    FLASH_STATS_OP_END(w25n01gc_flash);
+
+    return FLASH_SUCCESS;
 }
 
-int8_t w25n01gc_flash_read(flash_device_t* w25n01gc_flash, uint32_t addr,
-                  uint8_t* read_buf, uint32_t read_len)
+int8_t w25n01gv_program_pages(flash_device_t* w25n01gc_flash,
+                              uint32_t first_page, const uint8_t* data,
+                              uint32_t num_pages, uint32_t* pages_done)
 {
+    uint32_t total_pages = (uint32_t)w25n01gc_flash->num_of_blocks
+                           << W25N01GV_DEV_BLOCK_SHIFT(w25n01gc_flash);
+    uint32_t page_size = W25N01GV_DEV_PAGE_SIZE(w25n01gc_flash);
+    w25n01gv_status_t flash_status;
+    uint32_t done = 0;
     int8_t status = FLASH_SUCCESS;
-    uint16_t page_addr;
-    uint16_t col_addr;
-    uint32_t rem_len = read_len;
-    uint32_t read_len_page = 0;
 
-    if ((addr + read_len) > w25n01gc_flash->flash_size)
+    if (pages_done != NULL)
     {
-        LOG_FLASH(ERROR, "W25N01GV: %s, %d: Invalid read addr", __func__,
+        *pages_done = 0;
+    }
+
+    if ((data == NULL) || (num_pages == 0) || (num_pages > total_pages) ||
+        (first_page > (total_pages - num_pages)))
+    {
+        LOG_FLASH(ERROR, "W25N01GV: %s, %d: Invalid page range", __func__,
                   __LINE__);
         return FLASH_INVALID_PARAMS;
     }
 
-    page_addr = addr / w25n01gc_flash->page_size;
-    col_addr = addr % w25n01gc_flash->page_size;
-
-    while (rem_len > 0)
+    /* The whole batch is refused up front rather than failing half way */
+    for (uint32_t block = W25N01GV_PAGE_TO_BLOCK(w25n01gc_flash, first_page);
+         block <= W25N01GV_PAGE_TO_BLOCK(w25n01gc_flash,
+                                         first_page + num_pages - 1);
+         block++)
     {
-        if (rem_len > (w25n01gc_flash->page_size - col_addr))
+        if (w25n01gv_block_protected(w25n01gc_flash, block))
         {
-            read_len_page = w25n01gc_flash->page_size - col_addr;
-        }
-        else
-        {
-            read_len_page = rem_len;
+            LOG_FLASH(ERROR, "W25N01GV: %s, %d: block %u is protected",
+                      __func__, __LINE__, block);
+            return FLASH_INVALID_PARAMS;
         }
+    }
+
+    for (; done < num_pages; done++)
+    {
+        FLASH_STATS_OP_BEGIN(w25n01gc_flash, FLASH_STATS_OP_PROGRAM);
 
-        status = w25n01gv_page_data_read(w25n01gc_flash, page_addr);
+        /* WEL was cleared by the previous execute, exec sets it again */
+        status = w25n01gv_exec(w25n01gc_flash, W25N01GV_CMD_PROGRAM_DATA_LOAD,
+                               0, (uint8_t*)&data[done * page_size],
+                               page_size, NULL);
         if (status != FLASH_SUCCESS)
         {
-            LOG_FLASH(ERROR, "W25N01GV: %s, %d:  page data read fail", __func__,
-                      __LINE__);
-            return status;
+            LOG_FLASH(ERROR, "W25N01GV: %s, %d: load program data fail",
+                      __func__, __LINE__);
+            break;
         }
 
-        status =
-            w25n01gv_read_data(w25n01gc_flash, col_addr,
-                               read_buf + (read_len - rem_len), read_len_page);
+        status = w25n01gv_exec(w25n01gc_flash, W25N01GV_CMD_PROGRAM_EXECUTE,
+                               (uint16_t)(first_page + done), NULL, 0,
+                               &flash_status);
         if (status != FLASH_SUCCESS)
         {
-            LOG_FLASH(ERROR, "W25N01GV: %s, %d:  read data read fail", __func__,
-                      __LINE__);
-            return status;
+            LOG_FLASH(ERROR, "W25N01GV: %s, %d: program execute fail",
+                      __func__, __LINE__);
+            break;
         }
 
-        status = check_ecc(w25n01gc_flash);
-        if ((status != ECC_SUCCESS_NO_CORRECTION) &&
-            (status != ECC_SUCCESS_CORRECTION))
+        status = check_fail(&flash_status, W25N01GV_PFAIL_MASK);
+        if (status != ERASE_PROGRAM_SUCESS)
         {
-            LOG_FLASH(ERROR, "W25N01GV: %s, %d:  read data ECC error", __func__,
-                      __LINE__);
-            return status;
+            LOG_FLASH(ERROR, "W25N01GV: %s, %d: page %u program error",
+                      __func__, __LINE__, first_page + done);
+            break;
         }
 
-        rem_len -= read_len_page;
-        col_addr = 0;
-        page_addr++;
+        FLASH_STATS_OP_END(w25n01gc_flash);
+    }
+
+    if (pages_done != NULL)
+    {
+        *pages_done = done;
     }
 
     return status;
 }
 
-int8_t w25n01gc_flash_write(flash_device_t* w25n01gc_flash, uint32_t addr,
-                   uint8_t* write_buf, uint32_t write_len)
+int8_t w25n01gv_page_read(flash_device_t* w25n01gc_flash, uint32_t page,
+                          uint8_t* data, uint32_t len, uint8_t* user_spare)
 {
+    uint8_t spare[W25N01GV_SPARE_SIZE];
     int8_t status = FLASH_SUCCESS;
-    uint16_t page_addr;
-    uint16_t col_addr;
-    uint32_t rem_len = write_len;
-    uint32_t write_len_page = 0;
 
-    if ((addr + write_len) > w25n01gc_flash->flash_size)
+    if (((data == NULL) && (len != 0)) ||
+        !page_valid(w25n01gc_flash, page, len))
     {
-        LOG_FLASH(ERROR, "W25N01GV: %s, %d: Invalid read addr", __func__,
+        LOG_FLASH(ERROR, "W25N01GV: %s, %d: Invalid page read", __func__,
                   __LINE__);
         return FLASH_INVALID_PARAMS;
     }
 
-    /* Checking fail incase there was a previous error. Not returning from this error. */
-    status = check_fail(w25n01gc_flash);
-    if (status != ERASE_PROGRAM_SUCESS)
+    FLASH_STATS_OP_BEGIN(w25n01gc_flash, FLASH_STATS_OP_READ);
+
+    status = load_page(w25n01gc_flash, (uint16_t)page);
+    if (status != FLASH_SUCCESS)
     {
-        LOG_FLASH(ERROR, "W25N01GV: %s, %d: previous operation error",
-                  __func__, __LINE__);
+        return status;
     }
 
-    page_addr = addr / w25n01gc_flash->page_size;
-    col_addr = addr % w25n01gc_flash->page_size;
-
-    while (rem_len > 0)
+    if (len != 0)
     {
-        if (rem_len > (w25n01gc_flash->page_size - col_addr))
-        {
-            write_len_page = w25n01gc_flash->page_size - col_addr;
-        }
-        else
-        {
-            write_len_page = rem_len;
-        }
-
-        status = w25n01gv_load_program_data(w25n01gc_flash, true, col_addr,
-                                            write_buf + (write_len - rem_len),
-                                            write_len_page);
+        status = w25n01gv_exec(w25n01gc_flash, W25N01GV_CMD_READ, 0, data, len,
+                               NULL);
         if (status != FLASH_SUCCESS)
         {
-            LOG_FLASH(ERROR, "W25N01GV: %s, %d: load program data fail",
+            LOG_FLASH(ERROR, "W25N01GV: %s, %d:  read data read fail",
                       __func__, __LINE__);
             return status;
         }
+    }
 
-        status = w25n01gv_program_execute(w25n01gc_flash, page_addr);
+    if (user_spare != NULL)
+    {
+        status = w25n01gv_exec(w25n01gc_flash, W25N01GV_CMD_READ,
+                               W25N01GV_DEV_PAGE_SIZE(w25n01gc_flash), spare,
+                               sizeof(spare), NULL);
         if (status != FLASH_SUCCESS)
         {
-            LOG_FLASH(ERROR, "W25N01GV: %s, %d: program execute fail", __func__,
+            LOG_FLASH(ERROR, "W25N01GV: %s, %d:  read spare fail", __func__,
                       __LINE__);
             return status;
         }
 
-        /* 
-         * FIXME Double wait here and in program func, mostly it wont affect since we
-         * wait here, the above wait is resolved immediately after single status reg read.
-         */
-
-        /* Wait for busy bit */
-        status = wait_if_busy(w25n01gc_flash, W25N01GV_BUSY_DEFAULT_TIMEOUT_MS);
-        if (status != FLASH_SUCCESS)
+        for (uint8_t sect = 0; sect < W25N01GV_SECTORS_PER_PAGE; sect++)
         {
-            if (status == FLASH_TIMEOUT)
-            {
-                LOG_FLASH(ERROR, "W25N01GV: %s, %d: wait if busy timeout!",
-                          __func__, __LINE__);
-            }
-            else
-            {
-                LOG_FLASH(ERROR, "W25N01GV: %s, %d: wait if busy fail!",
-                          __func__, __LINE__);
-            }
-            return status;
+            memcpy(&user_spare[sect * W25N01GV_SPARE_USER_PER_SECTOR],
+                   &spare[(sect * W25N01GV_SPARE_SECTOR_SIZE) +
+                          W25N01GV_SPARE_USER_OFFSET],
+                   W25N01GV_SPARE_USER_PER_SECTOR);
         }
+    }
 
-        status = check_fail(w25n01gc_flash);
-        if (status != ERASE_PROGRAM_SUCESS)
+    FLASH_STATS_OP_END(w25n01gc_flash);
+
+    return FLASH_SUCCESS;
+}
+
+int8_t w25n01gv_page_check(flash_device_t* w25n01gc_flash, uint32_t page,
+                           uint8_t* ecc)
+{
+    w25n01gv_status_t flash_status;
+    int8_t status;
+
+    if ((ecc == NULL) || !page_valid(w25n01gc_flash, page, 0))
+    {
+        LOG_FLASH(ERROR, "W25N01GV: %s, %d: Invalid page check", __func__,
+                  __LINE__);
+        return FLASH_INVALID_PARAMS;
+    }
+
+    status = w25n01gv_exec(w25n01gc_flash, W25N01GV_CMD_PAGE_DATA_READ,
+                           (uint16_t)page, NULL, 0, &flash_status);
+    if (status != FLASH_SUCCESS)
+    {
+        LOG_FLASH(ERROR, "W25N01GV: %s, %d:  page data read fail", __func__,
+                  __LINE__);
+        return status;
+    }
+
+    FLASH_STATS_ECC(w25n01gc_flash,
+                    (flash_status.ecc == ECC_SUCCESS_CORRECTION),
+                    ((flash_status.ecc == ECC_FAIL_SINGLE_PAGE) ||
+                     (flash_status.ecc == ECC_FAIL_MULTIPLE)));
+    *ecc = flash_status.ecc;
+
+    return FLASH_SUCCESS;
+}
+
+int8_t w25n01gv_last_ecc_failure_addr(flash_device_t* w25n01gc_flash,
+                                      uint16_t* page_addr)
+{
+    uint8_t addr[W25N01GV_PAGE_ADDR_SIZE];
+    int8_t status;
+
+    if (page_addr == NULL)
+    {
+        return FLASH_INVALID_PARAMS;
+    }
+
+    status = w25n01gv_exec(w25n01gc_flash,
+                           W25N01GV_CMD_LAST_ECC_FAILURE_PAGE_ADDR, 0, addr,
+                           sizeof(addr), NULL);
+    if (status != FLASH_SUCCESS)
+    {
+        LOG_FLASH(ERROR, "W25N01GV: %s, %d: read ECC failure addr fail",
+                  __func__, __LINE__);
+        return status;
+    }
+
+    *page_addr = ((uint16_t)addr[0] << 8) | addr[1];
+
+    return FLASH_SUCCESS;
+}
+
+/* Blocks covered by BP3..0, 256KB at 0001b doubling up to 64MB */
+static uint32_t protect_blocks(const flash_device_t* w25n01gc_flash,
+                               uint8_t bp)
+{
+    if (bp == 0)
+    {
+        return 0;
+    }
+    if (bp >= W25N01GV_PROTECT_BP_ALL)
+    {
+        return w25n01gc_flash->num_of_blocks;
+    }
+    return (W25N01GV_PROTECT_MIN_SIZE << (bp - 1)) >>
+           (W25N01GV_DEV_PAGE_SHIFT(w25n01gc_flash) +
+            W25N01GV_DEV_BLOCK_SHIFT(w25n01gc_flash));
+}
+
+int8_t w25n01gv_set_protection(flash_device_t* w25n01gc_flash, uint8_t mode,
+                               bool wp_enable)
+{
+    if ((w25n01gc_flash == NULL) ||
+        ((mode & ~(W25N01GV_PROTECT_BP_MASK | W25N01GV_PROTECT_TB_MASK)) != 0))
+    {
+        return FLASH_INVALID_PARAMS;
+    }
+
+    return set_block_protect(w25n01gc_flash, mode, wp_enable);
+}
+
+void w25n01gv_get_protection(const flash_device_t* w25n01gc_flash,
+                             uint8_t* mode, bool* wp_enable)
+{
+    uint8_t reg_val = w25n01gc_flash->prot_reg;
+
+    if (mode != NULL)
+    {
+        *mode = (reg_val & W25N01GV_BP_MASK) >> W25N01GV_BP_OFFSET;
+        if (reg_val & W25N01GV_TB_MASK)
         {
-            LOG_FLASH(ERROR, "W25N01GV: %s, %d: program data operation error",
-                      __func__, __LINE__);
-            return status;
+            *mode |= W25N01GV_PROTECT_TB_MASK;
         }
+    }
+    if (wp_enable != NULL)
+    {
+        *wp_enable = (reg_val & W25N01GV_WPE_MASK) != 0;
+    }
+}
 
-        rem_len -= write_len_page;
-        col_addr = 0;
-        page_addr++;
+/* Whether mode (BP3..0 and TB) covers block */
+static bool mode_protects(const flash_device_t* w25n01gc_flash, uint8_t mode,
+                          uint32_t block)
+{
+    uint32_t num_protected = protect_blocks(w25n01gc_flash,
+                                            mode & W25N01GV_PROTECT_BP_MASK);
+
+    if (mode & W25N01GV_PROTECT_TB_MASK)
+    {
+        return block < num_protected;
     }
+    return block >= (uint32_t)(w25n01gc_flash->num_of_blocks - num_protected);
 }
 
-int8_t w25n01gc_flash_erase(flash_device_t* w25n01gc_flash, uint32_t addr,
-                   uint32_t erase_len)
+bool w25n01gv_block_protected(const flash_device_t* w25n01gc_flash,
+                              uint32_t block)
 {
-    int8_t status = FLASH_SUCCESS;
-    uint16_t page_addr;
-    uint32_t rem_len = erase_len;
-    uint32_t erase_len_page = 0;
+    uint8_t mode;
 
-    if ((addr + erase_len) > w25n01gc_flash->flash_size)
+    w25n01gv_get_protection(w25n01gc_flash, &mode, NULL);
+    return mode_protects(w25n01gc_flash, mode, block);
+}
+
+int8_t w25n01gv_protect_mode(const flash_device_t* w25n01gc_flash,
+                             uint32_t first_block, uint32_t num_blocks,
+                             uint8_t* mode)
+{
+    uint32_t num = w25n01gc_flash->num_of_blocks;
+    uint32_t covered;
+
+    if ((mode == NULL) || (first_block >= num) ||
+        (num_blocks > (num - first_block)))
     {
-        LOG_FLASH(ERROR, "W25N01GV: %s, %d: Invalid read addr", __func__,
-                  __LINE__);
         return FLASH_INVALID_PARAMS;
     }
 
-    /* Checking fail incase there was a previous error. Not returning from this error. */
-    status = check_fail(w25n01gc_flash);
-    if (status != ERASE_PROGRAM_SUCESS)
+    if (num_blocks == 0)
     {
-        LOG_FLASH(ERROR, "W25N01GV: %s, %d: previous operation error",
-                  __func__, __LINE__);
+        *mode = BLOCK_PROTECT_NONE;
+        return FLASH_SUCCESS;
     }
 
-    page_addr = addr / w25n01gc_flash->page_size;
-    erase_len_page = w25n01gc_flash->page_size - (addr % w25n01gc_flash->page_size);
+    /* Ranges only grow with BP, the first one that fits either side wins */
+    for (uint8_t bp = 1; bp < W25N01GV_PROTECT_BP_ALL; bp++)
+    {
+        covered = protect_blocks(w25n01gc_flash, bp);
+        if ((first_block + num_blocks) <= covered)
+        {
+            *mode = bp | W25N01GV_PROTECT_TB_MASK;
+            return FLASH_SUCCESS;
+        }
+        if (first_block >= (num - covered))
+        {
+            *mode = bp;
+            return FLASH_SUCCESS;
+        }
+    }
 
-    while (rem_len > 0)
+    *mode = BLOCK_PROTECT_ALL;
+    return FLASH_SUCCESS;
+}
+
+int8_t w25n01gv_protect_regions(flash_device_t* w25n01gc_flash,
+                                const w25n01gv_prot_region_t* regions,
+                                uint8_t num_regions)
+{
+    uint32_t first = UINT32_MAX;
+    uint32_t end = 0;
+    uint8_t mode = BLOCK_PROTECT_NONE;
+    uint8_t cur_mode;
+    bool wp_enable;
+    int8_t status;
+
+    if ((w25n01gc_flash == NULL) || ((regions == NULL) && (num_regions != 0)))
     {
-        status = w25n01gv_block_erase(w25n01gc_flash, page_addr);
-        if (status != FLASH_SUCCESS)
+        return FLASH_INVALID_PARAMS;
+    }
+
+    for (uint8_t i = 0; i < num_regions; i++)
+    {
+        if (!regions[i].locked || (regions[i].num_blocks == 0))
         {
-            LOG_FLASH(ERROR, "W25N01GV: %s, %d: block_erase fail",
-                      __func__, __LINE__);
-            return status;
+            continue;
+        }
+        if (regions[i].first_block < first)
+        {
+            first = regions[i].first_block;
+        }
+        if ((regions[i].first_block + regions[i].num_blocks) > end)
+        {
+            end = regions[i].first_block + regions[i].num_blocks;
         }
+    }
 
-        /* Wait for busy bit */
-        status = wait_if_busy(w25n01gc_flash, W25N01GV_BUSY_ERASE_TIMEOUT_MS);
+    if (end != 0)
+    {
+        status = w25n01gv_protect_mode(w25n01gc_flash, first, end - first,
+                                       &mode);
         if (status != FLASH_SUCCESS)
         {
-            if (status == FLASH_TIMEOUT)
-            {
-                LOG_FLASH(ERROR, "W25N01GV: %s, %d: wait if busy timeout!",
-                          __func__, __LINE__);
-            }
-            else
-            {
-                LOG_FLASH(ERROR, "W25N01GV: %s, %d: wait if busy fail!",
-                          __func__, __LINE__);
-            }
+            LOG_FLASH(ERROR, "W25N01GV: %s, %d: blocks %u..%u out of range",
+                      __func__, __LINE__, first, end - 1);
             return status;
         }
+    }
 
-        status = check_fail(w25n01gc_flash);
-        if (status != ERASE_PROGRAM_SUCESS)
+    /* Ranges cover a whole end of the array, check both ends of the rest */
+    for (uint8_t i = 0; i < num_regions; i++)
+    {
+        if (regions[i].locked || (regions[i].num_blocks == 0))
         {
-            LOG_FLASH(ERROR, "W25N01GV: %s, %d: erase operation error",
-                      __func__, __LINE__);
-            return status;
+            continue;
+        }
+        if (mode_protects(w25n01gc_flash, mode, regions[i].first_block) ||
+            mode_protects(w25n01gc_flash, mode, regions[i].first_block +
+                                                regions[i].num_blocks - 1))
+        {
+            LOG_FLASH(ERROR, "W25N01GV: %s, %d: mode 0x%02X locks %s too",
+                      __func__, __LINE__, mode, regions[i].name);
+            return FLASH_INVALID_PARAMS;
         }
+    }
+
+    w25n01gv_get_protection(w25n01gc_flash, &cur_mode, &wp_enable);
+    if (mode == cur_mode)
+    {
+        return FLASH_SUCCESS;
+    }
+
+    status = set_block_protect(w25n01gc_flash, mode, wp_enable);
+    if (status != FLASH_SUCCESS)
+    {
+        LOG_FLASH(ERROR, "W25N01GV: %s, %d: protection mode 0x%02X fail",
+                  __func__, __LINE__, mode);
+        return status;
+    }
 
-        if (rem_len < erase_len_page)
+    for (uint8_t i = 0; i < num_regions; i++)
+    {
+        if (regions[i].num_blocks == 0)
         {
-            break;
+            continue;
         }
-        rem_len -= erase_len_page;
-        erase_len_page = w25n01gc_flash->page_size;
-        page_addr++;
+        LOG_FLASH(INFO, "W25N01GV: %s %s, blocks %u..%u", regions[i].name,
+                  regions[i].locked ? "locked" : "unlocked",
+                  regions[i].first_block,
+                  regions[i].first_block + regions[i].num_blocks - 1);
     }
 
-    return status;
+    return FLASH_SUCCESS;
 }
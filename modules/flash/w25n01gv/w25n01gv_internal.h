@@ -3,12 +3,80 @@
 
 #include "ext_flash.h"
 
+/* Instruction descriptor flags */
+#define W25N01GV_INSTR_WREN                           (0x01)
+#define W25N01GV_INSTR_TX                             (0x02)
+#define W25N01GV_INSTR_RX                             (0x04)
+#define W25N01GV_INSTR_DUMMY_AFTER_ADDR               (0x08)
+#define W25N01GV_INSTR_WAIT_OFFSET                    (4)
+#define W25N01GV_INSTR_WAIT_MASK                      (0x70)
+#define W25N01GV_INSTR_WAIT(wait_class) \
+    (((wait_class) << W25N01GV_INSTR_WAIT_OFFSET) & W25N01GV_INSTR_WAIT_MASK)
+#define W25N01GV_INSTR_WAIT_CLASS(flags) \
+    (((flags) & W25N01GV_INSTR_WAIT_MASK) >> W25N01GV_INSTR_WAIT_OFFSET)
+/* Write enable latch is reset once the instruction has run */
+#define W25N01GV_INSTR_CLEARS_WEL                     (0x80)
+
+/* Driver side copy of WEL/BUSY in flash_device_t dev_state */
+#define W25N01GV_STATE_WEL                            (0x01)
+#define W25N01GV_STATE_BUSY                           (0x02)
+
+/* Busy wait issued after an instruction */
+enum w25n01gv_wait_class
+{
+    W25N01GV_WAIT_NONE = 0,
+    W25N01GV_WAIT_DEFAULT,
+    W25N01GV_WAIT_ERASE,
+    W25N01GV_WAIT_PROGRAM,
+    /* Microsecond scale operations, page data read and reset */
+    W25N01GV_WAIT_READ
+};
+
+/* Index into the instruction table */
+enum w25n01gv_cmd_id
+{
+    W25N01GV_CMD_DEVICE_RESET = 0,
+    W25N01GV_CMD_JEDEC_ID,
+    W25N01GV_CMD_READ_STATUS_REG,
+    W25N01GV_CMD_WRITE_STATUS_REG,
+    W25N01GV_CMD_WRITE_ENABLE,
+    W25N01GV_CMD_WRITE_DISABLE,
+    W25N01GV_CMD_BB_MANAGEMENT,
+    W25N01GV_CMD_READ_BBM_LUT,
+    W25N01GV_CMD_LAST_ECC_FAILURE_PAGE_ADDR,
+    W25N01GV_CMD_BLOCK_ERASE,
+    W25N01GV_CMD_PROGRAM_DATA_LOAD,
+    W25N01GV_CMD_RANDOM_PROGRAM_DATA_LOAD,
+    W25N01GV_CMD_PROGRAM_EXECUTE,
+    W25N01GV_CMD_PAGE_DATA_READ,
+    W25N01GV_CMD_READ,
+    W25N01GV_CMD_MAX
+};
+
 typedef struct w25n01gv_instr
 {
     uint8_t opcode;
+    uint8_t addr_len;
     uint8_t dummy_cycles;
+    uint8_t flags;
 } w25n01gv_instr_t;
 
+/*
+ * Status polling of a wait class. The first poll follows a settle time,
+ * then polls go poll_us apart until those delays add up to poll_window_us,
+ * and sleep_ms apart after that, at most timeout sleeps. Without a delay_us
+ * hook settle_us becomes a 1 ms sleep and the window is left out.
+ */
+typedef struct w25n01gv_wait
+{
+    uint8_t timeout;
+    uint8_t sleep_ms;
+    uint8_t settle_ms;
+    uint16_t settle_us;
+    uint16_t poll_us;
+    uint16_t poll_window_us;
+} w25n01gv_wait_t;
+
 /* Utility macros */
 #define W25N01GV_OPCODE_SIZE                          1U
 #define W25N01GV_SR_ADDR_SIZE                         1U
@@ -17,9 +85,81 @@ typedef struct w25n01gv_instr
 #define W25N01GV_COLUMN_ADDR_SIZE                     2U
 #define W25N01GV_JEDEC_ID_SIZE                        3U
 
+/* Geometry */
+#define W25N01GV_PAGE_SHIFT                           11U
+#define W25N01GV_PAGES_PER_BLOCK_SHIFT                6U
+#define W25N01GV_NUM_BLOCKS_SHIFT                     10U
+#define W25N01GV_PAGE_SIZE                            (1U << W25N01GV_PAGE_SHIFT)
+#define W25N01GV_PAGES_PER_BLOCK                      (1U << W25N01GV_PAGES_PER_BLOCK_SHIFT)
+#define W25N01GV_NUM_BLOCKS                           (1U << W25N01GV_NUM_BLOCKS_SHIFT)
+#define W25N01GV_SPARE_SIZE                           64U
+
+/*
+ * Spare area: 16 bytes per 512 byte sector. Bytes 0-1 are the bad block
+ * marker, 2-3 user data II (no ECC), 4-7 user data I (ECC protected) and
+ * 8-15 the ECC bytes. Only user data I is handed out through the page API.
+ */
+#define W25N01GV_SECTORS_PER_PAGE                     4U
+#define W25N01GV_SPARE_SECTOR_SIZE                    16U
+#define W25N01GV_SPARE_USER_OFFSET                    4U
+#define W25N01GV_SPARE_USER_PER_SECTOR                4U
+#define W25N01GV_SPARE_USER_SIZE                      (W25N01GV_SECTORS_PER_PAGE * \
+                                                       W25N01GV_SPARE_USER_PER_SECTOR)
+#define W25N01GV_FLASH_SIZE                           (W25N01GV_NUM_BLOCKS << \
+                                                       (W25N01GV_PAGE_SHIFT + \
+                                                        W25N01GV_PAGES_PER_BLOCK_SHIFT))
+
+/*
+ * Address decomposition. Geometry is kept as shifts so page, column and
+ * block come out of shifts and masks, no division (a library call on
+ * Cortex-M0). Define W25N01GV_FIXED_GEOMETRY to make them compile time
+ * constants for the W25N01GV instead of reading them from the device.
+ */
+#ifdef W25N01GV_FIXED_GEOMETRY
+#define W25N01GV_DEV_PAGE_SHIFT(dev)                  W25N01GV_PAGE_SHIFT
+#define W25N01GV_DEV_BLOCK_SHIFT(dev)                 W25N01GV_PAGES_PER_BLOCK_SHIFT
+#else
+#define W25N01GV_DEV_PAGE_SHIFT(dev)                  ((dev)->page_shift)
+#define W25N01GV_DEV_BLOCK_SHIFT(dev)                 ((dev)->block_shift)
+#endif
+
+#define W25N01GV_ADDR_TO_PAGE(dev, addr) \
+    ((uint32_t)(addr) >> W25N01GV_DEV_PAGE_SHIFT(dev))
+#define W25N01GV_ADDR_TO_COL(dev, addr) \
+    ((uint32_t)(addr) & ((1UL << W25N01GV_DEV_PAGE_SHIFT(dev)) - 1))
+#define W25N01GV_PAGE_TO_BLOCK(dev, page) \
+    ((uint32_t)(page) >> W25N01GV_DEV_BLOCK_SHIFT(dev))
+#define W25N01GV_BLOCK_TO_PAGE(dev, block) \
+    ((uint32_t)(block) << W25N01GV_DEV_BLOCK_SHIFT(dev))
+#define W25N01GV_DEV_PAGE_SIZE(dev) \
+    (1UL << W25N01GV_DEV_PAGE_SHIFT(dev))
+#define W25N01GV_DEV_BLOCK_SIZE(dev) \
+    (1UL << (W25N01GV_DEV_PAGE_SHIFT(dev) + W25N01GV_DEV_BLOCK_SHIFT(dev)))
+
 #define W25N01GV_BUSY_SLEEP_TIME_MS                   (15U)
 #define W25N01GV_BUSY_DEFAULT_TIMEOUT_MS              (10U)
+/* tBE is 2 ms typical, 10 ms max: sleep the typical time, then poll each ms */
+#define W25N01GV_BUSY_ERASE_SETTLE_MS                 (2U)
+#define W25N01GV_BUSY_ERASE_SLEEP_MS                  (1U)
 #define W25N01GV_BUSY_ERASE_TIMEOUT_MS                (10U)
+/*
+ * tPP is 250 us typical, 700 us max: wait the typical time, poll every
+ * 50 us up to 750 us, then each ms.
+ */
+#define W25N01GV_BUSY_PROGRAM_SETTLE_US               (250U)
+#define W25N01GV_BUSY_PROGRAM_POLL_US                 (50U)
+#define W25N01GV_BUSY_PROGRAM_WINDOW_US               (500U)
+#define W25N01GV_BUSY_PROGRAM_SLEEP_MS                (1U)
+#define W25N01GV_BUSY_PROGRAM_TIMEOUT_MS              (10U)
+/*
+ * tRD is 60 us max with ECC, tRST 5 us idle and up to 500 us into an erase:
+ * wait 50 us, poll every 10 us up to 100 us, then each ms.
+ */
+#define W25N01GV_BUSY_READ_SETTLE_US                  (50U)
+#define W25N01GV_BUSY_READ_POLL_US                    (10U)
+#define W25N01GV_BUSY_READ_WINDOW_US                  (50U)
+#define W25N01GV_BUSY_READ_SLEEP_MS                   (1U)
+#define W25N01GV_BUSY_READ_TIMEOUT_MS                 (2U)
 
 /* Commands */
 #define W25N01GV_DEVICE_RESET                         (0xFF)
@@ -137,30 +277,65 @@ enum fail_code
     PROGRAM_FAIL_CODE
 };
 
+/*
+ * Block protection modes as written to the protection register: BP3..0 in
+ * bits 3:0 and TB in bit 4. TB clear protects from the top of the array, set
+ * from the bottom. BP3..0 of 1010b and above protect the whole array.
+ */
+#define W25N01GV_PROTECT_BP_MASK                      (0x0F)
+#define W25N01GV_PROTECT_TB_MASK                      (0x10)
+#define W25N01GV_PROTECT_BP_ALL                       (0x0A)
+/* Range protected by BP3..0 = 0001b, doubling with each step */
+#define W25N01GV_PROTECT_MIN_SIZE                     (256UL * 1024UL)
+
 enum block_protection_mode
 {
-    BLOCK_PROTECT_NONE = 0x00000,
-    BLOCK_PROTECT_U_256K = 0x00001,
-    BLOCK_PROTECT_U_512K = 0x00010,
-    BLOCK_PROTECT_U_1M = 0x00011,
-    BLOCK_PROTECT_U_2M = 0x00100,
-    BLOCK_PROTECT_U_4M = 0x00101,
-    BLOCK_PROTECT_U_8M = 0x00110,
-    BLOCK_PROTECT_U_16M = 0x00111,
-    BLOCK_PROTECT_U_32M = 0x01000,
-    BLOCK_PROTECT_U_64M = 0x01001,
-    BLOCK_PROTECT_L_256K = 0x10001,
-    BLOCK_PROTECT_L_512K = 0x10010,
-    BLOCK_PROTECT_L_1M = 0x10011,
-    BLOCK_PROTECT_L_2M = 0x10100,
-    BLOCK_PROTECT_L_4M = 0x10101,
-    BLOCK_PROTECT_L_8M = 0x10110,
-    BLOCK_PROTECT_L_16M = 0x10111,
-    BLOCK_PROTECT_L_32M = 0x11000,
-    BLOCK_PROTECT_L_64M = 0x11001,
-    BLOCK_PROTECT_ALL = 0x01100,
+    BLOCK_PROTECT_NONE = 0x00,
+    BLOCK_PROTECT_U_256K = 0x01,
+    BLOCK_PROTECT_U_512K = 0x02,
+    BLOCK_PROTECT_U_1M = 0x03,
+    BLOCK_PROTECT_U_2M = 0x04,
+    BLOCK_PROTECT_U_4M = 0x05,
+    BLOCK_PROTECT_U_8M = 0x06,
+    BLOCK_PROTECT_U_16M = 0x07,
+    BLOCK_PROTECT_U_32M = 0x08,
+    BLOCK_PROTECT_U_64M = 0x09,
+    BLOCK_PROTECT_L_256K = 0x11,
+    BLOCK_PROTECT_L_512K = 0x12,
+    BLOCK_PROTECT_L_1M = 0x13,
+    BLOCK_PROTECT_L_2M = 0x14,
+    BLOCK_PROTECT_L_4M = 0x15,
+    BLOCK_PROTECT_L_8M = 0x16,
+    BLOCK_PROTECT_L_16M = 0x17,
+    BLOCK_PROTECT_L_32M = 0x18,
+    BLOCK_PROTECT_L_64M = 0x19,
+    BLOCK_PROTECT_ALL = 0x0C,
 };
 
+/*
+ * Named block range for w25n01gv_protect_regions(), e.g. bootloader or
+ * calibration data. Only locked regions are protected.
+ */
+typedef struct w25n01gv_prot_region
+{
+    const char* name;
+    uint32_t first_block;
+    uint32_t num_blocks;
+    bool locked;
+} w25n01gv_prot_region_t;
+
+/* Decoded snapshot of the status register (0xC0) */
+typedef struct w25n01gv_status
+{
+    uint8_t raw;
+    uint8_t ecc;
+    bool busy;
+    bool wel;
+    bool efail;
+    bool pfail;
+    bool lutf;
+} w25n01gv_status_t;
+
 /* Function declarations */
 int8_t detect_w25n01gv(flash_device_t* w25n01gc_flash);
 int8_t w25n01gv_init(flash_device_t* w25n01gc_flash);
@@ -170,5 +345,57 @@ int8_t w25n01gc_flash_write(flash_device_t* w25n01gc_flash, uint32_t addr,
                    uint8_t* write_buf, uint32_t write_len);
 int8_t w25n01gc_flash_erase(flash_device_t* w25n01gc_flash, uint32_t addr,
                    uint32_t erase_len);
+/*
+ * Single page access with the ECC protected spare bytes. user_spare is
+ * W25N01GV_SPARE_USER_SIZE bytes or NULL; data is programmed from column 0
+ * and the rest of the page is left erased.
+ */
+int8_t w25n01gv_page_program(flash_device_t* w25n01gc_flash, uint32_t page,
+                             const uint8_t* data, uint32_t len,
+                             const uint8_t* user_spare);
+/*
+ * Programs num_pages whole pages from first_page, data holding them back to
+ * back. Per page only WRITE_ENABLE, PROGRAM_DATA_LOAD, PROGRAM_EXECUTE and
+ * the status polls of tPP go out, the first one after the typical tPP.
+ * pages_done (may be NULL) gets the number of pages programmed when it fails
+ * part way.
+ */
+int8_t w25n01gv_program_pages(flash_device_t* w25n01gc_flash,
+                              uint32_t first_page, const uint8_t* data,
+                              uint32_t num_pages, uint32_t* pages_done);
+int8_t w25n01gv_page_read(flash_device_t* w25n01gc_flash, uint32_t page,
+                          uint8_t* data, uint32_t len, uint8_t* user_spare);
+/*
+ * Loads the page into the data buffer and returns its ECC code (enum
+ * ecc_code) in ecc without moving any data over the bus. An uncorrectable
+ * page is not an error here, the code is the answer.
+ */
+int8_t w25n01gv_page_check(flash_device_t* w25n01gc_flash, uint32_t page,
+                           uint8_t* ecc);
+/* Page address of the last uncorrectable read (0xA9) */
+int8_t w25n01gv_last_ecc_failure_addr(flash_device_t* w25n01gc_flash,
+                                      uint16_t* page_addr);
+/*
+ * Block protection, served from the register copy cached in the device at
+ * init. The register is only written when BP/TB or WP-E actually change.
+ */
+int8_t w25n01gv_set_protection(flash_device_t* w25n01gc_flash, uint8_t mode,
+                               bool wp_enable);
+void w25n01gv_get_protection(const flash_device_t* w25n01gc_flash,
+                             uint8_t* mode, bool* wp_enable);
+bool w25n01gv_block_protected(const flash_device_t* w25n01gc_flash,
+                              uint32_t block);
+/* Smallest mode protecting all of the blocks, from the top or the bottom */
+int8_t w25n01gv_protect_mode(const flash_device_t* w25n01gc_flash,
+                             uint32_t first_block, uint32_t num_blocks,
+                             uint8_t* mode);
+/*
+ * Protects the locked regions with one covering mode, NONE if none are.
+ * FLASH_INVALID_PARAMS, and nothing changed, when that mode would also
+ * cover an unlocked region.
+ */
+int8_t w25n01gv_protect_regions(flash_device_t* w25n01gc_flash,
+                                const w25n01gv_prot_region_t* regions,
+                                uint8_t num_regions);
 
 #endif
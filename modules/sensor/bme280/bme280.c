@@ -57,6 +57,18 @@
 /* To identify filter and standby settings selected by user */
 #define FILTER_STANDBY_SETTINGS UINT8_C(0x18)
 
+/* Below table follows the enum bme280_wait: time in us for delay_us, and
+ * in ms for delay_ms
+ */
+static const struct
+{
+    uint32_t us;
+    uint8_t ms;
+} wait_table[BME280_WAIT_COUNT] = {
+    { BME280_STARTUP_DELAY_US, BME280_STARTUP_DELAY_MS },
+    { BME280_INIT_RETRY_DELAY_US, BME280_INIT_RETRY_DELAY_MS }
+};
+
 /*!
  * @brief This internal API puts the device to sleep mode.
  *
@@ -67,6 +79,15 @@
  */
 static int8_t put_device_to_sleep(const struct bme280_dev *dev);
 
+/*!
+ * @brief This internal API waits, through delay_us when set and delay_ms
+ * otherwise.
+ *
+ * @param[in] wait : Wait from enum bme280_wait.
+ * @param[in] dev  : Structure instance of bme280_dev.
+ */
+static void delay_wait(enum bme280_wait wait, const struct bme280_dev *dev);
+
 /*!
  * @brief This internal API writes the power mode in the sensor.
  *
@@ -389,7 +410,7 @@ int8_t bme280_init(struct bme280_dev *dev)
             }
 
             /* Wait for 1 ms */
-            dev->delay_ms(1);
+            delay_wait(BME280_WAIT_INIT_RETRY, dev);
             --try_count;
         }
 
@@ -653,7 +674,7 @@ int8_t bme280_soft_reset(const struct bme280_dev *dev)
             do
             {
                 /* As per data sheet - Table 1, startup time is 2 ms. */
-                dev->delay_ms(2);
+                delay_wait(BME280_WAIT_STARTUP, dev);
                 rslt = bme280_get_regs(BME280_STATUS_REG_ADDR, &status_reg, 1, dev);
             } while ((rslt == BME280_OK) && (try_run--) && (status_reg & BME280_STATUS_IM_UPDATE));
 
@@ -1451,3 +1472,19 @@ static int8_t null_ptr_check(const struct bme280_dev *dev)
 
     return rslt;
 }
+
+/*!
+ * @brief This internal API waits, through delay_us when set and delay_ms
+ * otherwise.
+ */
+static void delay_wait(enum bme280_wait wait, const struct bme280_dev *dev)
+{
+    if (dev->delay_us != NULL)
+    {
+        dev->delay_us(wait_table[wait].us);
+    }
+    else
+    {
+        dev->delay_ms(wait_table[wait].ms);
+    }
+}
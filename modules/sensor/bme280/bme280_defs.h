@@ -242,6 +242,27 @@
 #define BME280_SOFT_RESET_COMMAND   (0xB6)
 #define BME280_STATUS_IM_UPDATE     (0x01)
 
+/**\name Delay settings, see enum bme280_wait */
+#define BME280_STARTUP_DELAY_MS     UINT8_C(2)
+#define BME280_STARTUP_DELAY_US     UINT32_C(2000)
+#define BME280_INIT_RETRY_DELAY_MS  UINT8_C(1)
+#define BME280_INIT_RETRY_DELAY_US  UINT32_C(1000)
+
+/*!
+ * @brief Waits of the driver, each has a time in us for delay_us and in ms
+ * for delay_ms
+ */
+enum bme280_wait {
+    /*! Start-up after soft reset, datasheet table 1 */
+    BME280_WAIT_STARTUP,
+
+    /*! Chip id read retry */
+    BME280_WAIT_INIT_RETRY,
+
+    /*! Number of waits */
+    BME280_WAIT_COUNT
+};
+
 /*!
  * @brief Interface selection Enums
  */
@@ -383,6 +404,9 @@ struct bme280_dev
     /*! Delay function pointer */
     bme280_delay_fptr_t delay_ms;
 
+    /*! Delay function pointer in us, NULL to wait with delay_ms */
+    bme280_delay_fptr_t delay_us;
+
     /*! Trim data */
     struct bme280_calib_data calib_data;
 
@@ -49,6 +49,17 @@
  @brief Sensor driver for BME680 sensor */
 #include "bme680.h"
 
+/* Below table follows the enum bme680_wait: time in us for delay_us, and
+ * in ms for delay_ms
+ */
+static const struct {
+	uint32_t us;
+	uint8_t ms;
+} wait_table[BME680_WAIT_COUNT] = {
+	{ BME680_RESET_PERIOD_US, BME680_RESET_PERIOD },
+	{ BME680_POLL_PERIOD_US, BME680_POLL_PERIOD_MS }
+};
+
 /*!
  * @brief This internal API is used to read the calibrated data from the sensor.
  *
@@ -279,6 +290,15 @@ static int8_t null_ptr_check(const struct bme680_dev *dev);
  */
 static int8_t boundary_check(uint8_t *value, uint8_t min, uint8_t max, struct bme680_dev *dev);
 
+/*!
+ * @brief This internal API waits, through delay_us when set and delay_ms
+ * otherwise.
+ *
+ * @param[in] wait	:Wait from enum bme680_wait.
+ * @param[in] dev	:Structure instance of bme680_dev.
+ */
+static void delay_wait(enum bme680_wait wait, const struct bme680_dev *dev);
+
 /****************** Global Function Definitions *******************************/
 /*!
  *@brief This API is the entry point.
@@ -393,7 +413,7 @@ int8_t bme680_soft_reset(struct bme680_dev *dev)
 		if (rslt == BME680_OK) {
 			rslt = bme680_set_regs(&reg_addr, &soft_rst_cmd, 1, dev);
 			/* Wait for 5ms */
-			dev->delay_ms(BME680_RESET_PERIOD);
+			delay_wait(BME680_WAIT_RESET, dev);
 
 			if (rslt == BME680_OK) {
 				/* After reset get the memory page */
@@ -606,7 +626,7 @@ int8_t bme680_set_sensor_mode(struct bme680_dev *dev)
 				if (pow_mode != BME680_SLEEP_MODE) {
 					tmp_pow_mode = tmp_pow_mode & (~BME680_MODE_MSK); /* Set to sleep */
 					rslt = bme680_set_regs(&reg_addr, &tmp_pow_mode, 1, dev);
-					dev->delay_ms(BME680_POLL_PERIOD_MS);
+					delay_wait(BME680_WAIT_POLL, dev);
 				}
 			}
 		} while (pow_mode != BME680_SLEEP_MODE);
@@ -1215,10 +1235,15 @@ static int8_t read_field_data(struct bme680_field_data *data, struct bme680_dev
 	uint32_t adc_pres;
 	uint16_t adc_hum;
 	uint16_t adc_gas_res;
-	uint8_t tries = 10;
+	uint8_t tries = BME680_POLL_TIMEOUT_MS / BME680_POLL_PERIOD_MS;
 
 	/* Check for null pointer in the device structure*/
 	rslt = null_ptr_check(dev);
+
+	/* Same time budget with the shorter polling period */
+	if ((rslt == BME680_OK) && (dev->delay_us != NULL))
+		tries = (BME680_POLL_TIMEOUT_MS * 1000) / BME680_POLL_PERIOD_US;
+
 	do {
 		if (rslt == BME680_OK) {
 			rslt = bme680_get_regs(((uint8_t) (BME680_FIELD0_ADDR)), buff, (uint16_t) BME680_FIELD_LENGTH,
@@ -1248,7 +1273,7 @@ static int8_t read_field_data(struct bme680_field_data *data, struct bme680_dev
 				break;
 			}
 			/* Delay to poll the data */
-			dev->delay_ms(BME680_POLL_PERIOD_MS);
+			delay_wait(BME680_WAIT_POLL, dev);
 		}
 		tries--;
 	} while (tries);
@@ -1365,3 +1390,15 @@ static int8_t null_ptr_check(const struct bme680_dev *dev)
 
 	return rslt;
 }
+
+/*!
+ * @brief This internal API waits, through delay_us when set and delay_ms
+ * otherwise.
+ */
+static void delay_wait(enum bme680_wait wait, const struct bme680_dev *dev)
+{
+	if (dev->delay_us != NULL)
+		dev->delay_us(wait_table[wait].us);
+	else
+		dev->delay_ms(wait_table[wait].ms);
+}
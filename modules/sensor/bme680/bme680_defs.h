@@ -108,6 +108,8 @@
 
 /** BME680 General config */
 #define BME680_POLL_PERIOD_MS		UINT8_C(10)
+#define BME680_POLL_PERIOD_US		UINT32_C(1000)
+#define BME680_POLL_TIMEOUT_MS		UINT32_C(100)
 
 /** BME680 I2C addresses */
 #define BME680_I2C_ADDR_PRIMARY		UINT8_C(0x76)
@@ -209,6 +211,7 @@
 
 /** Delay related macro declaration */
 #define BME680_RESET_PERIOD	UINT32_C(10)
+#define BME680_RESET_PERIOD_US	UINT32_C(10000)
 
 /** SPI memory page settings */
 #define BME680_MEM_PAGE0	UINT8_C(0x10)
@@ -359,6 +362,19 @@ typedef int8_t (*bme680_com_fptr_t)(uint8_t dev_id, uint8_t reg_addr, uint8_t *d
  */
 typedef void (*bme680_delay_fptr_t)(uint32_t period);
 
+/*!
+ * @brief Waits of the driver, each has a time in us for delay_us and in ms
+ * for delay_ms
+ */
+enum bme680_wait {
+	/*! Soft reset */
+	BME680_WAIT_RESET,
+	/*! Sleep mode and new data polling */
+	BME680_WAIT_POLL,
+	/*! Number of waits */
+	BME680_WAIT_COUNT
+};
+
 /*!
  * @brief Interface selection Enumerations
  */
@@ -534,6 +550,8 @@ struct	bme680_dev {
 	bme680_com_fptr_t write;
 	/*! delay function pointer */
 	bme680_delay_fptr_t delay_ms;
+	/*! delay function pointer in us, NULL to wait with delay_ms */
+	bme680_delay_fptr_t delay_us;
 	/*! Communication function result */
 	int8_t com_rslt;
 };
@@ -53,6 +53,28 @@
 
 #include "bmi160.h"
 
+/* Below table follows the enum bmi160_wait: time in us for delay_us, and
+ * in ms for delay_ms
+ */
+static const struct
+{
+    uint32_t us;
+    uint8_t ms;
+} wait_table[BMI160_WAIT_COUNT] = {
+    { BMI160_WRITE_IDLE_NORMAL_US, BMI160_ONE_MS_DELAY },
+    { BMI160_WRITE_IDLE_SUSPEND_US, BMI160_ONE_MS_DELAY },
+    { BMI160_SOFT_RESET_DELAY_US, BMI160_SOFT_RESET_DELAY_MS },
+    { BMI160_ACCEL_DELAY_US, BMI160_ACCEL_DELAY_MS },
+    { BMI160_GYRO_DELAY_US, BMI160_GYRO_DELAY_MS },
+    { BMI160_GYRO_FSU_DELAY_US, BMI160_GYRO_FSU_DELAY_MS },
+    { BMI160_AUX_DELAY_US, BMI160_ONE_MS_DELAY },
+    { BMI160_AUX_COM_DELAY_US, BMI160_AUX_COM_DELAY },
+    { BMI160_ACCEL_SELF_TEST_DELAY_US, BMI160_ACCEL_SELF_TEST_DELAY },
+    { BMI160_GYRO_SELF_TEST_DELAY_US, BMI160_GYRO_SELF_TEST_DELAY_MS },
+    { BMI160_NVM_DELAY_US, BMI160_NVM_DELAY_MS },
+    { BMI160_FOC_DELAY_US, BMI160_FOC_DELAY_MS }
+};
+
 /* Below look up table follows the enum bmi160_int_types.
  * Hence any change should match to the enum bmi160_int_types
  */
@@ -1298,6 +1320,57 @@ static void unpack_sensortime_frame(uint16_t *data_index, const struct bmi160_de
  */
 static void unpack_skipped_frame(uint16_t *data_index, const struct bmi160_dev *dev);
 
+/*!
+ *  @brief This API is used to get the contents of the next FIFO frame for
+ *  bmi160_fifo_batch_parse, parsing the non data frames of header mode on
+ *  the way.
+ *
+ *  @param[in,out] data_index  : Index of the next FIFO frame, moved past
+ *                               the header of a data frame.
+ *  @param[in] read_end        : End of the FIFO read data_index is in.
+ *  @param[in,out] batch       : Structure instance of bmi160_fifo_batch.
+ *  @param[in] dev             : Structure instance of bmi160_dev.
+ *
+ *  @return Frame contents, BMI160_FIFO_FRAME_A/G/M bits, or 0 for a frame
+ *  without sensor data
+ */
+static uint8_t batch_next_frame(size_t *data_index,
+                                size_t read_end,
+                                struct bmi160_fifo_batch *batch,
+                                const struct bmi160_dev *dev);
+
+/*!
+ *  @brief This API is used to unpack the x, y and z axes of an accel or
+ *  gyro FIFO frame.
+ *
+ *  @param[out] data   : Structure instance of bmi160_sensor_data.
+ *  @param[in] frame   : Pointer to the first byte of the axes in the FIFO.
+ *
+ *  @return None
+ */
+static void unpack_fifo_xyz(struct bmi160_sensor_data *data, const uint8_t *frame);
+
+/*!
+ *  @brief This API is used to append the x, y and z axes of an accel or
+ *  gyro FIFO frame to per axis arrays.
+ *
+ *  @param[in,out] soa : Structure instance of bmi160_sensor_soa.
+ *  @param[in] frame   : Pointer to the first byte of the axes in the FIFO.
+ *
+ *  @return None
+ */
+static void append_fifo_xyz(struct bmi160_sensor_soa *soa, const uint8_t *frame);
+
+/*!
+ *  @brief This API is used to append a sample to per axis arrays.
+ *
+ *  @param[in,out] soa : Structure instance of bmi160_sensor_soa.
+ *  @param[in] data    : Structure instance of bmi160_sensor_data.
+ *
+ *  @return None
+ */
+static void append_sample(struct bmi160_sensor_soa *soa, const struct bmi160_sensor_data *data);
+
 /*!
  *  @brief This API is used to get the FOC status from the sensor
  *
@@ -1361,6 +1434,109 @@ static int8_t map_hardware_interrupt(const struct bmi160_int_settg *int_config,
  */
 static int8_t map_feature_interrupt(const struct bmi160_int_settg *int_config, const struct bmi160_dev *dev);
 
+/*!
+ *  @brief This API writes registers on the bus, bursts in normal mode and
+ *  single bytes otherwise, each followed by the write idle time.
+ *
+ *  @param[in] reg_addr : Register address to write to.
+ *  @param[in] data     : Data to write.
+ *  @param[in] len      : No of bytes to write.
+ *  @param[in] dev      : Structure instance of bmi160_dev.
+ *
+ *  @return Result of API execution status
+ *  @retval zero -> Success  / -ve value -> Error
+ */
+static int8_t write_regs(uint8_t reg_addr, uint8_t *data, uint16_t len, const struct bmi160_dev *dev);
+
+/*!
+ *  @brief This API waits, through delay_us when set and delay_ms otherwise.
+ *
+ *  @param[in] wait : Wait from enum bmi160_wait.
+ *  @param[in] dev  : Structure instance of bmi160_dev.
+ *
+ *  @return None
+ */
+static void delay_wait(enum bmi160_wait wait, const struct bmi160_dev *dev);
+
+/*!
+ *  @brief This API checks if registers are all held in the shadow.
+ *
+ *  @param[in] reg_addr : First register.
+ *  @param[in] len      : No of registers.
+ *
+ *  @return 1 if they are, 0 otherwise
+ */
+static uint8_t shadow_covers(uint8_t reg_addr, uint16_t len);
+
+/*!
+ *  @brief This API reads the shadow window from the sensor.
+ *
+ *  @param[in] dev : Structure instance of bmi160_dev.
+ *
+ *  @return Result of API execution status
+ *  @retval zero -> Success  / -ve value -> Error
+ */
+static int8_t shadow_load(const struct bmi160_dev *dev);
+
+/*!
+ *  @brief This API writes the pending shadow registers to the sensor, as
+ *  few bursts as possible.
+ *
+ *  @param[in] dev : Structure instance of bmi160_dev.
+ *
+ *  @return Result of API execution status
+ *  @retval zero -> Success  / -ve value -> Error
+ */
+static int8_t shadow_flush(const struct bmi160_dev *dev);
+
+/*!
+ *  @brief This API updates the shadow after registers were written through
+ *  to the sensor.
+ *
+ *  @param[in] reg_addr : Register address written to.
+ *  @param[in] data     : Data written.
+ *  @param[in] len      : No of bytes written.
+ *  @param[in] dev      : Structure instance of bmi160_dev.
+ *
+ *  @return None
+ */
+static void shadow_write_through(uint8_t reg_addr, const uint8_t *data, uint16_t len, const struct bmi160_dev *dev);
+
+/*!
+ *  @brief This API computes the CRC-8 of a configuration image.
+ *
+ *  @param[in] data : Image bytes.
+ *  @param[in] len  : No of bytes.
+ *
+ *  @return CRC-8 of the bytes
+ */
+static uint8_t image_crc(const uint8_t *data, uint16_t len);
+
+/*!
+ *  @brief This API sets the driver state of dev from a configuration image.
+ *
+ *  @param[in] image : Image from bmi160_config_snapshot.
+ *  @param[in] dev   : Structure instance of bmi160_dev.
+ *
+ *  @return Result of API execution status
+ *  @retval zero -> Success  / -ve value -> Error
+ */
+static int8_t image_load_state(const uint8_t *image, struct bmi160_dev *dev);
+
+/*!
+ *  @brief This API writes the registers of a configuration image that
+ *  differ from the sensor through dev->shadow, with a sensor in normal
+ *  mode for burst writes whenever that is quicker, then sets the power
+ *  modes of the image.
+ *
+ *  @param[in] image : Image from bmi160_config_snapshot.
+ *  @param[in] dev   : Structure instance of bmi160_dev.
+ *
+ *  @return Result of API execution status
+ *  @retval zero -> Success  / -ve value -> Error
+ */
+static int8_t image_replay(const uint8_t *image, struct bmi160_dev *dev);
+
 /*********************** User function definitions ****************************/
 
 /*!
@@ -1376,18 +1552,38 @@ int8_t bmi160_get_regs(uint8_t reg_addr, uint8_t *data, uint16_t len, const stru
     {
         rslt = BMI160_E_NULL_PTR;
     }
+    else if ((dev->shadow != NULL) && (dev->shadow->depth != 0) && shadow_covers(reg_addr, len))
+    {
+        /* Inside a transaction, with the pending writes */
+        if (!dev->shadow->valid)
+        {
+            rslt = shadow_load(dev);
+        }
+        if (rslt == BMI160_OK)
+        {
+            memcpy(data, &dev->shadow->regs[reg_addr - BMI160_SHADOW_START_ADDR], len);
+        }
+    }
     else
     {
+        /* Anything else sees the pending writes done */
+        if ((dev->shadow != NULL) && (dev->shadow->depth != 0))
+        {
+            rslt = shadow_flush(dev);
+        }
+
         /* Configuring reg_addr for SPI Interface */
         if (dev->interface == BMI160_SPI_INTF)
         {
             reg_addr = (reg_addr | BMI160_SPI_RD_MASK);
         }
-        rslt = dev->read(dev->id, reg_addr, data, len);
-
-        if (rslt != BMI160_OK)
+        if (rslt == BMI160_OK)
         {
-            rslt = BMI160_E_COM_FAIL;
+            rslt = dev->read(dev->id, reg_addr, data, len);
+            if (rslt != BMI160_OK)
+            {
+                rslt = BMI160_E_COM_FAIL;
+            }
         }
     }
 
@@ -1401,46 +1597,275 @@ int8_t bmi160_get_regs(uint8_t reg_addr, uint8_t *data, uint16_t len, const stru
 int8_t bmi160_set_regs(uint8_t reg_addr, uint8_t *data, uint16_t len, const struct bmi160_dev *dev)
 {
     int8_t rslt = BMI160_OK;
-    uint8_t count = 0;
 
     /* Null-pointer check */
     if ((dev == NULL) || (dev->write == NULL))
     {
         rslt = BMI160_E_NULL_PTR;
     }
+    else if ((dev->shadow != NULL) && (dev->shadow->depth != 0) && shadow_covers(reg_addr, len))
+    {
+        /* Inside a transaction, written on commit */
+        if (!dev->shadow->valid)
+        {
+            rslt = shadow_load(dev);
+        }
+        if (rslt == BMI160_OK)
+        {
+            memcpy(&dev->shadow->regs[reg_addr - BMI160_SHADOW_START_ADDR], data, len);
+        }
+    }
     else
     {
-        /* Configuring reg_addr for SPI Interface */
-        if (dev->interface == BMI160_SPI_INTF)
+        /* Pending writes go first, in order */
+        if ((dev->shadow != NULL) && (dev->shadow->depth != 0))
         {
-            reg_addr = (reg_addr & BMI160_SPI_WR_MASK);
+            rslt = shadow_flush(dev);
         }
-        if ((dev->prev_accel_cfg.power == BMI160_ACCEL_NORMAL_MODE) ||
-            (dev->prev_gyro_cfg.power == BMI160_GYRO_NORMAL_MODE))
+        if (rslt == BMI160_OK)
+        {
+            rslt = write_regs(reg_addr, data, len, dev);
+        }
+        if (dev->shadow != NULL)
         {
-            rslt = dev->write(dev->id, reg_addr, data, len);
+            if (rslt == BMI160_OK)
+            {
+                shadow_write_through(reg_addr, data, len, dev);
+            }
+            else
+            {
+                dev->shadow->valid = 0;
+            }
+        }
+    }
 
-            /* Kindly refer bmi160 data sheet section 3.2.4 */
-            dev->delay_ms(1);
+    return rslt;
+}
 
+/*!
+ * @brief This API opens a configuration transaction on the register
+ * shadow.
+ */
+int8_t bmi160_config_begin(const struct bmi160_dev *dev)
+{
+    int8_t rslt = BMI160_OK;
+
+    /* Null-pointer check */
+    if ((dev == NULL) || (dev->read == NULL) || (dev->write == NULL) || (dev->shadow == NULL))
+    {
+        rslt = BMI160_E_NULL_PTR;
+    }
+    else if (dev->shadow->depth == UINT8_MAX)
+    {
+        rslt = BMI160_E_OUT_OF_RANGE;
+    }
+    else
+    {
+        if (dev->shadow->depth == 0)
+        {
+            dev->shadow->writes = 0;
+            dev->shadow->bytes = 0;
+            if (!dev->shadow->valid)
+            {
+                rslt = shadow_load(dev);
+            }
+        }
+        if (rslt == BMI160_OK)
+        {
+            dev->shadow->depth++;
+        }
+    }
+
+    return rslt;
+}
+
+/*!
+ * @brief This API closes a configuration transaction and writes the
+ * changed registers.
+ */
+int8_t bmi160_config_commit(const struct bmi160_dev *dev)
+{
+    int8_t rslt = BMI160_OK;
+
+    /* Null-pointer check */
+    if ((dev == NULL) || (dev->write == NULL) || (dev->shadow == NULL))
+    {
+        rslt = BMI160_E_NULL_PTR;
+    }
+    else if (dev->shadow->depth == 0)
+    {
+        rslt = BMI160_E_INVALID_INPUT;
+    }
+    else
+    {
+        dev->shadow->depth--;
+        if (dev->shadow->depth == 0)
+        {
+            rslt = shadow_flush(dev);
+        }
+    }
+
+    return rslt;
+}
+
+/*!
+ * @brief This API drops the pending writes and closes all open
+ * configuration transactions.
+ */
+int8_t bmi160_config_abort(const struct bmi160_dev *dev)
+{
+    int8_t rslt = BMI160_OK;
+
+    /* Null-pointer check */
+    if ((dev == NULL) || (dev->shadow == NULL))
+    {
+        rslt = BMI160_E_NULL_PTR;
+    }
+    else
+    {
+        memcpy(dev->shadow->regs, dev->shadow->chip, BMI160_SHADOW_LEN);
+        dev->shadow->depth = 0;
+    }
+
+    return rslt;
+}
+
+/*!
+ * @brief This API saves the configuration of the sensor into an image.
+ */
+int8_t bmi160_config_snapshot(uint8_t *image, uint16_t *len, const struct bmi160_dev *dev)
+{
+    int8_t rslt;
+    uint8_t regs[BMI160_SHADOW_LEN];
+    uint8_t idx = 0;
+    uint8_t reg;
+
+    /* Null-pointer check */
+    rslt = null_ptr_check(dev);
+    if ((rslt == BMI160_OK) && ((image == NULL) || (len == NULL)))
+    {
+        rslt = BMI160_E_NULL_PTR;
+    }
+    else if ((rslt == BMI160_OK) && (*len < BMI160_CONFIG_IMAGE_LEN))
+    {
+        rslt = BMI160_E_OUT_OF_RANGE;
+    }
+    else if (rslt == BMI160_OK)
+    {
+        if ((dev->shadow != NULL) && dev->shadow->valid)
+        {
+            /* Pending writes of an open transaction included */
+            memcpy(regs, dev->shadow->regs, BMI160_SHADOW_LEN);
         }
         else
         {
-            /*Burst write is not allowed in
-             * suspend & low power mode */
-            for (; count < len; count++)
+            rslt = bmi160_get_regs(BMI160_SHADOW_START_ADDR, regs, BMI160_SHADOW_LEN, dev);
+        }
+    }
+
+    if (rslt == BMI160_OK)
+    {
+        image[idx++] = BMI160_CONFIG_IMAGE_MAGIC;
+        image[idx++] = BMI160_CONFIG_IMAGE_VERSION;
+        image[idx++] = dev->accel_cfg.power;
+        image[idx++] = dev->accel_cfg.odr;
+        image[idx++] = dev->accel_cfg.range;
+        image[idx++] = dev->accel_cfg.bw;
+        image[idx++] = dev->gyro_cfg.power;
+        image[idx++] = dev->gyro_cfg.odr;
+        image[idx++] = dev->gyro_cfg.range;
+        image[idx++] = dev->gyro_cfg.bw;
+
+        /* Aux bit fields packed as they are declared */
+        image[idx++] = (uint8_t)(dev->aux_cfg.aux_sensor_enable | (dev->aux_cfg.manual_enable << 1) |
+                                 (dev->aux_cfg.aux_rd_burst_len << 2) | (dev->aux_cfg.aux_odr << 4));
+        image[idx++] = dev->aux_cfg.aux_i2c_addr;
+        image[idx++] = (uint8_t)dev->any_sig_sel;
+        image[idx++] = (dev->fifo != NULL) ? dev->fifo->fifo_header_enable : 0;
+        image[idx++] = (dev->fifo != NULL) ? dev->fifo->fifo_time_enable : 0;
+        image[idx++] = (dev->fifo != NULL) ? dev->fifo->fifo_data_enable : 0;
+        for (reg = 0; reg < BMI160_SHADOW_LEN; reg++)
+        {
+            if ((BMI160_SHADOW_REG_MASK >> reg) & 1)
             {
-                rslt = dev->write(dev->id, reg_addr, &data[count], 1);
-                reg_addr++;
+                image[idx++] = regs[reg];
+            }
+        }
+        image[idx] = image_crc(image, idx);
+        idx++;
+        *len = idx;
+    }
 
-                /* Kindly refer bmi160 data sheet section 3.2.4 */
-                dev->delay_ms(1);
+    return rslt;
+}
 
-            }
+/*!
+ * @brief This API brings the sensor back to the configuration of an image.
+ */
+int8_t bmi160_config_restore(const uint8_t *image, uint16_t len, struct bmi160_dev *dev)
+{
+    int8_t rslt;
+    struct bmi160_shadow local;
+    uint8_t data = 0;
+    uint8_t try = 3;
+
+    /* Null-pointer check */
+    rslt = null_ptr_check(dev);
+    if ((rslt == BMI160_OK) && (image == NULL))
+    {
+        rslt = BMI160_E_NULL_PTR;
+    }
+    else if ((rslt == BMI160_OK) &&
+             ((len != BMI160_CONFIG_IMAGE_LEN) || (image[0] != BMI160_CONFIG_IMAGE_MAGIC) ||
+              (image[1] != BMI160_CONFIG_IMAGE_VERSION) || (image_crc(image, len - 1) != image[len - 1]) ||
+              ((dev->shadow != NULL) && (dev->shadow->depth != 0))))
+    {
+        rslt = BMI160_E_INVALID_INPUT;
+    }
+
+    /* Dummy read of 0x7F register to enable SPI Interface
+     * if SPI is used */
+    if ((rslt == BMI160_OK) && (dev->interface == BMI160_SPI_INTF))
+    {
+        rslt = bmi160_get_regs(BMI160_SPI_COMM_TEST_ADDR, &data, 1, dev);
+    }
+    if (rslt == BMI160_OK)
+    {
+        dev->chip_id = 0;
+        while ((try--) && (dev->chip_id != BMI160_CHIP_ID))
+        {
+            rslt = bmi160_get_regs(BMI160_CHIP_ID_ADDR, &dev->chip_id, 1, dev);
         }
-        if (rslt != BMI160_OK)
+        if ((rslt == BMI160_OK) && (dev->chip_id != BMI160_CHIP_ID))
         {
-            rslt = BMI160_E_COM_FAIL;
+            rslt = BMI160_E_DEV_NOT_FOUND;
+        }
+    }
+    if (rslt == BMI160_OK)
+    {
+        /* Power modes the sensor is in, not the ones dev remembers */
+        rslt = bmi160_get_regs(BMI160_PMU_STATUS_ADDR, &data, 1, dev);
+    }
+    if (rslt == BMI160_OK)
+    {
+        rslt = image_load_state(image, dev);
+        dev->prev_accel_cfg.power = BMI160_ACCEL_SUSPEND_MODE + BMI160_GET_BITS(data, BMI160_ACCEL_POWER_MODE);
+        dev->prev_gyro_cfg.power = BMI160_GYRO_SUSPEND_MODE + BMI160_GET_BITS(data, BMI160_GYRO_POWER_MODE);
+    }
+    if (rslt == BMI160_OK)
+    {
+        if (dev->shadow == NULL)
+        {
+            memset(&local, 0, sizeof(local));
+            dev->shadow = &local;
+            rslt = image_replay(image, dev);
+            dev->shadow = NULL;
+        }
+        else
+        {
+            /* The sensor may have lost power since the shadow was read */
+            dev->shadow->valid = 0;
+            rslt = image_replay(image, dev);
         }
     }
 
@@ -1510,7 +1935,7 @@ int8_t bmi160_soft_reset(struct bmi160_dev *dev)
     {
         /* Reset the device */
         rslt = bmi160_set_regs(BMI160_COMMAND_REG_ADDR, &data, 1, dev);
-        dev->delay_ms(BMI160_SOFT_RESET_DELAY_MS);
+        delay_wait(BMI160_WAIT_SOFT_RESET, dev);
         if ((rslt == BMI160_OK) && (dev->interface == BMI160_SPI_INTF))
         {
             /* Dummy read of 0x7F register to enable SPI Interface
@@ -1690,6 +2115,51 @@ int8_t bmi160_get_sensor_data(uint8_t select_sensor,
     return rslt;
 }
 
+/*!
+ * @brief This API reads sensor data and appends it to per axis arrays.
+ */
+int8_t bmi160_get_sensor_data_soa(uint8_t select_sensor,
+                                  struct bmi160_sensor_soa *accel,
+                                  struct bmi160_sensor_soa *gyro,
+                                  const struct bmi160_dev *dev)
+{
+    int8_t rslt;
+    uint8_t sen_sel = select_sensor & (BMI160_ACCEL_SEL | BMI160_GYRO_SEL);
+    struct bmi160_sensor_data accel_data = { 0 };
+    struct bmi160_sensor_data gyro_data = { 0 };
+
+    if (((sen_sel & BMI160_ACCEL_SEL) && ((accel == NULL) || (accel->x == NULL) || (accel->y == NULL) ||
+                                          (accel->z == NULL))) ||
+        ((sen_sel & BMI160_GYRO_SEL) && ((gyro == NULL) || (gyro->x == NULL) || (gyro->y == NULL) ||
+                                         (gyro->z == NULL))))
+    {
+        rslt = BMI160_E_NULL_PTR;
+    }
+    else if (((sen_sel & BMI160_ACCEL_SEL) && (accel->count >= accel->capacity)) ||
+             ((sen_sel & BMI160_GYRO_SEL) && (gyro->count >= gyro->capacity)))
+    {
+        rslt = BMI160_E_OUT_OF_RANGE;
+    }
+    else
+    {
+        /* One burst for both sensors, then spread over the axes */
+        rslt = bmi160_get_sensor_data(select_sensor, &accel_data, &gyro_data, dev);
+        if (rslt == BMI160_OK)
+        {
+            if (sen_sel & BMI160_ACCEL_SEL)
+            {
+                append_sample(accel, &accel_data);
+            }
+            if (sen_sel & BMI160_GYRO_SEL)
+            {
+                append_sample(gyro, &gyro_data);
+            }
+        }
+    }
+
+    return rslt;
+}
+
 /*!
  * @brief This API configures the necessary interrupt based on
  *  the user settings in the bmi160_int_settg structure instance.
@@ -1892,12 +2362,12 @@ int8_t bmi160_aux_write(uint8_t reg_addr, uint8_t *aux_data, uint16_t len, const
         {
             /* set data to write */
             rslt = bmi160_set_regs(BMI160_AUX_IF_4_ADDR, aux_data, 1, dev);
-            dev->delay_ms(BMI160_AUX_COM_DELAY);
+            delay_wait(BMI160_WAIT_AUX_COM, dev);
             if (rslt == BMI160_OK)
             {
                 /* set address to write */
                 rslt = bmi160_set_regs(BMI160_AUX_IF_3_ADDR, &reg_addr, 1, dev);
-                dev->delay_ms(BMI160_AUX_COM_DELAY);
+                delay_wait(BMI160_WAIT_AUX_COM, dev);
                 if (rslt == BMI160_OK && (count < len - 1))
                 {
                     aux_data++;
@@ -1961,7 +2431,7 @@ int8_t bmi160_set_aux_auto_mode(uint8_t *data_addr, struct bmi160_dev *dev)
         {
             /* Write the aux. address to read in 0x4D of BMI160*/
             rslt = bmi160_set_regs(BMI160_AUX_IF_2_ADDR, data_addr, 1, dev);
-            dev->delay_ms(BMI160_AUX_COM_DELAY);
+            delay_wait(BMI160_WAIT_AUX_COM, dev);
             if (rslt == BMI160_OK)
             {
                 /* Configure the polling ODR for
@@ -2009,7 +2479,7 @@ int8_t bmi160_config_aux_mode(const struct bmi160_dev *dev)
         /* Set the secondary interface address and manual mode
          * along with burst read length */
         rslt = bmi160_set_regs(BMI160_AUX_IF_0_ADDR, &aux_if[0], 2, dev);
-        dev->delay_ms(BMI160_AUX_COM_DELAY);
+        delay_wait(BMI160_WAIT_AUX_COM, dev);
     }
 
     return rslt;
@@ -2417,17 +2887,243 @@ int8_t bmi160_extract_aux(struct bmi160_aux_data *aux_data, uint8_t *aux_len, st
                 unpack_aux_frame(aux_data, &data_index, &aux_index, fifo_data_enable, dev);
             }
 
-            /* update number of aux data read */
-            *aux_len = aux_index;
-
-            /* update the aux byte index */
-            dev->fifo->aux_byte_start_idx = data_index;
-        }
-        else
-        {
-            /* Parsing the FIFO data in header mode */
-            extract_aux_header_mode(aux_data, aux_len, dev);
+            /* update number of aux data read */
+            *aux_len = aux_index;
+
+            /* update the aux byte index */
+            dev->fifo->aux_byte_start_idx = data_index;
+        }
+        else
+        {
+            /* Parsing the FIFO data in header mode */
+            extract_aux_header_mode(aux_data, aux_len, dev);
+        }
+    }
+
+    return rslt;
+}
+
+/*!
+ *  @brief This API parses the FIFO data read by the "bmi160_get_fifo_data"
+ *  API in a single pass into accel, gyro, aux, sensor time and skipped
+ *  frame count.
+ */
+int8_t bmi160_fifo_demux(struct bmi160_fifo_demux *demux, struct bmi160_dev const *dev)
+{
+    int8_t rslt;
+    struct bmi160_fifo_batch batch;
+
+    if ((dev == NULL) || (dev->fifo == NULL) || (dev->fifo->data == NULL) || (demux == NULL))
+    {
+        rslt = BMI160_E_NULL_PTR;
+    }
+    else
+    {
+        /* A single read, resumed at the common byte index */
+        batch.data = dev->fifo->data;
+        batch.length = dev->fifo->length;
+        batch.read_len = NULL;
+        batch.read_count = 0;
+        batch.accel = demux->accel;
+        batch.gyro = demux->gyro;
+        batch.aux = demux->aux;
+        batch.accel_soa = NULL;
+        batch.gyro_soa = NULL;
+        batch.frames = NULL;
+        batch.accel_len = demux->accel_len;
+        batch.gyro_len = demux->gyro_len;
+        batch.aux_len = demux->aux_len;
+        batch.frames_len = 0;
+        batch.data_index = dev->fifo->accel_byte_start_idx;
+        batch.read_index = 0;
+
+        rslt = bmi160_fifo_batch_parse(&batch, dev);
+
+        /* Counts are bounded by the uint8_t buffer sizes */
+        demux->accel_len = (uint8_t)batch.accel_len;
+        demux->gyro_len = (uint8_t)batch.gyro_len;
+        demux->aux_len = (uint8_t)batch.aux_len;
+        demux->sensor_time = batch.sensor_time;
+        demux->sensor_time_valid = batch.sensor_time_valid;
+        demux->skipped_frame_count = (batch.skipped_frames > UINT8_MAX) ? UINT8_MAX : (uint8_t)batch.skipped_frames;
+        if (batch.sensor_time_valid)
+        {
+            dev->fifo->sensor_time = batch.sensor_time;
+        }
+        if (batch.skipped_frames != 0)
+        {
+            dev->fifo->skipped_frame_count = demux->skipped_frame_count;
+        }
+
+        /* Keep the per sensor cursors in step */
+        dev->fifo->accel_byte_start_idx = (uint16_t)batch.data_index;
+        dev->fifo->gyro_byte_start_idx = (uint16_t)batch.data_index;
+        dev->fifo->aux_byte_start_idx = (uint16_t)batch.data_index;
+    }
+
+    return rslt;
+}
+
+/*!
+ *  @brief This API parses any number of concatenated FIFO reads in a single
+ *  pass into accel, gyro, aux, sensor time and skipped frame count.
+ */
+int8_t bmi160_fifo_batch_parse(struct bmi160_fifo_batch *batch, struct bmi160_dev const *dev)
+{
+    /* Frame length by contents, BMI160_FIFO_FRAME_A/G/M bits */
+    static const uint8_t frame_len[] = {
+        0, BMI160_FIFO_A_LENGTH, BMI160_FIFO_G_LENGTH, BMI160_FIFO_GA_LENGTH, BMI160_FIFO_M_LENGTH,
+        BMI160_FIFO_MA_LENGTH, BMI160_FIFO_MG_LENGTH, BMI160_FIFO_MGA_LENGTH
+    };
+    int8_t rslt = BMI160_OK;
+    size_t data_index;
+    size_t frame_start;
+    size_t read_end;
+    size_t read;
+    size_t total;
+    uint8_t frame;
+    uint8_t full = 0;
+    const uint8_t *data;
+    size_t accel_index = 0;
+    size_t gyro_index = 0;
+    size_t aux_index = 0;
+    size_t frame_index = 0;
+
+    if ((dev == NULL) || (dev->fifo == NULL) || (batch == NULL) || ((batch->data == NULL) && (batch->length != 0)) ||
+        ((batch->accel_soa != NULL) &&
+         ((batch->accel_soa->x == NULL) || (batch->accel_soa->y == NULL) || (batch->accel_soa->z == NULL))) ||
+        ((batch->gyro_soa != NULL) &&
+         ((batch->gyro_soa->x == NULL) || (batch->gyro_soa->y == NULL) || (batch->gyro_soa->z == NULL))))
+    {
+        rslt = BMI160_E_NULL_PTR;
+    }
+
+    /* Find the end of the read to resume in, the reads must cover data */
+    read_end = (rslt == BMI160_OK) ? batch->length : 0;
+    if ((rslt == BMI160_OK) && (batch->read_len != NULL))
+    {
+        total = 0;
+        for (read = 0; read < batch->read_count; read++)
+        {
+            total += batch->read_len[read];
+            if (read == batch->read_index)
+            {
+                read_end = total;
+            }
+        }
+        if (total != batch->length)
+        {
+            rslt = BMI160_E_INVALID_INPUT;
+        }
+    }
+    if ((rslt == BMI160_OK) && (batch->data_index > read_end))
+    {
+        rslt = BMI160_E_OUT_OF_RANGE;
+    }
+
+    if (rslt == BMI160_OK)
+    {
+        batch->sensor_time_valid = 0;
+        batch->skipped_frames = 0;
+        batch->frames_end = batch->data_index;
+        data_index = batch->data_index;
+        read = batch->read_index;
+
+        while ((data_index < batch->length) && ((batch->read_len == NULL) || (read < batch->read_count)))
+        {
+            while (data_index < read_end)
+            {
+                frame_start = data_index;
+                frame = batch_next_frame(&data_index, read_end, batch, dev);
+                if (frame == 0)
+                {
+                    continue;
+                }
+
+                /* Partial read, then skip the data */
+                if ((data_index + frame_len[frame]) > read_end)
+                {
+                    data_index = read_end;
+                    break;
+                }
+
+                /* Output full, leave the frame for the next call */
+                if (((frame & BMI160_FIFO_FRAME_A) && (batch->accel != NULL) && (accel_index == batch->accel_len)) ||
+                    ((frame & BMI160_FIFO_FRAME_G) && (batch->gyro != NULL) && (gyro_index == batch->gyro_len)) ||
+                    ((frame & BMI160_FIFO_FRAME_M) && (batch->aux != NULL) && (aux_index == batch->aux_len)) ||
+                    ((frame & BMI160_FIFO_FRAME_A) && (batch->accel_soa != NULL) &&
+                     (batch->accel_soa->count >= batch->accel_soa->capacity)) ||
+                    ((frame & BMI160_FIFO_FRAME_G) && (batch->gyro_soa != NULL) &&
+                     (batch->gyro_soa->count >= batch->gyro_soa->capacity)) ||
+                    ((batch->frames != NULL) && (frame_index == batch->frames_len)))
+                {
+                    data_index = frame_start;
+                    full = 1;
+                    break;
+                }
+
+                if (batch->frames != NULL)
+                {
+                    batch->frames[frame_index++] = frame;
+                }
+
+                /* Aux, gyro and accel parts follow each other in that order */
+                data = &batch->data[data_index];
+                if (frame & BMI160_FIFO_FRAME_M)
+                {
+                    if (batch->aux != NULL)
+                    {
+                        memcpy(batch->aux[aux_index++].data, data, BMI160_FIFO_M_LENGTH);
+                    }
+                    data += BMI160_FIFO_M_LENGTH;
+                }
+                if (frame & BMI160_FIFO_FRAME_G)
+                {
+                    if (batch->gyro != NULL)
+                    {
+                        unpack_fifo_xyz(&batch->gyro[gyro_index++], data);
+                    }
+                    if (batch->gyro_soa != NULL)
+                    {
+                        append_fifo_xyz(batch->gyro_soa, data);
+                    }
+                    data += BMI160_FIFO_G_LENGTH;
+                }
+                if (frame & BMI160_FIFO_FRAME_A)
+                {
+                    if (batch->accel != NULL)
+                    {
+                        unpack_fifo_xyz(&batch->accel[accel_index++], data);
+                    }
+                    if (batch->accel_soa != NULL)
+                    {
+                        append_fifo_xyz(batch->accel_soa, data);
+                    }
+                }
+                data_index += frame_len[frame];
+                batch->frames_end = data_index;
+            }
+
+            if (full || (batch->read_len == NULL))
+            {
+                break;
+            }
+
+            /* The rest of the read is over-read, go on with the next one */
+            data_index = read_end;
+            read++;
+            if (read < batch->read_count)
+            {
+                read_end += batch->read_len[read];
+            }
         }
+
+        batch->accel_len = accel_index;
+        batch->gyro_len = gyro_index;
+        batch->aux_len = aux_index;
+        batch->frames_len = frame_index;
+        batch->data_index = data_index;
+        batch->read_index = read;
     }
 
     return rslt;
@@ -2627,7 +3323,7 @@ int8_t bmi160_update_nvm(struct bmi160_dev const *dev)
                     if (data != BMI160_ENABLE)
                     {
                         /* Delay to update NVM */
-                        dev->delay_ms(25);
+                        delay_wait(BMI160_WAIT_NVM_POLL, dev);
                     }
                 }
             }
@@ -3430,7 +4126,7 @@ static int8_t set_accel_pwr(struct bmi160_dev *dev)
                 /* Add delay of 3.8 ms - refer data sheet table 24*/
                 if (dev->prev_accel_cfg.power == BMI160_ACCEL_SUSPEND_MODE)
                 {
-                    dev->delay_ms(BMI160_ACCEL_DELAY_MS);
+                    delay_wait(BMI160_WAIT_ACCEL_STARTUP, dev);
                 }
                 dev->prev_accel_cfg.power = dev->accel_cfg.power;
             }
@@ -3451,7 +4147,7 @@ static int8_t process_under_sampling(uint8_t *data, const struct bmi160_dev *dev
 {
     int8_t rslt;
     uint8_t temp = 0;
-    uint8_t pre_filter = 0;
+    uint8_t pre_filter[2] = { 0 };
 
     rslt = bmi160_get_regs(BMI160_ACCEL_CONFIG_ADDR, data, 1, dev);
     if (rslt == BMI160_OK)
@@ -3471,7 +4167,7 @@ static int8_t process_under_sampling(uint8_t *data, const struct bmi160_dev *dev
             if (rslt == BMI160_OK)
             {
                 /* Disable the Pre-filter data*/
-                rslt = bmi160_set_regs(BMI160_INT_DATA_0_ADDR, &pre_filter, 2, dev);
+                rslt = bmi160_set_regs(BMI160_INT_DATA_0_ADDR, pre_filter, 2, dev);
             }
         }
         else
@@ -3510,14 +4206,14 @@ static int8_t set_gyro_pwr(struct bmi160_dev *dev)
             if (dev->prev_gyro_cfg.power == BMI160_GYRO_SUSPEND_MODE)
             {
                 /* Delay of 80 ms - datasheet Table 24 */
-                dev->delay_ms(BMI160_GYRO_DELAY_MS);
+                delay_wait(BMI160_WAIT_GYRO_STARTUP, dev);
             }
             else if ((dev->prev_gyro_cfg.power == BMI160_GYRO_FASTSTARTUP_MODE) &&
                      (dev->gyro_cfg.power == BMI160_GYRO_NORMAL_MODE))
             {
                 /* This delay is required for transition from
                  * fast-startup mode to normal mode - datasheet Table 3 */
-                dev->delay_ms(10);
+                delay_wait(BMI160_WAIT_GYRO_FSU_NORMAL, dev);
             }
             else
             {
@@ -4529,7 +5225,7 @@ static int8_t config_sec_if(const struct bmi160_dev *dev)
     if (rslt == BMI160_OK)
     {
         /* 0.5ms delay - refer datasheet table 24*/
-        dev->delay_ms(1);
+        delay_wait(BMI160_WAIT_AUX_STARTUP, dev);
         rslt = bmi160_get_regs(BMI160_IF_CONF_ADDR, &if_conf, 1, dev);
         if_conf |= (uint8_t)(1 << 5);
         if (rslt == BMI160_OK)
@@ -4558,7 +5254,7 @@ static int8_t config_aux_odr(const struct bmi160_dev *dev)
         /* Set the secondary interface ODR
          * i.e polling rate of secondary sensor */
         rslt = bmi160_set_regs(BMI160_AUX_ODR_ADDR, &aux_odr, 1, dev);
-        dev->delay_ms(BMI160_AUX_COM_DELAY);
+        delay_wait(BMI160_WAIT_AUX_COM, dev);
     }
 
     return rslt;
@@ -4630,7 +5326,7 @@ static int8_t extract_aux_read(uint16_t map_len,
     {
         /* set address to read */
         rslt = bmi160_set_regs(BMI160_AUX_IF_2_ADDR, &reg_addr, 1, dev);
-        dev->delay_ms(BMI160_AUX_COM_DELAY);
+        delay_wait(BMI160_WAIT_AUX_COM, dev);
         if (rslt == BMI160_OK)
         {
             rslt = bmi160_get_regs(read_addr, data, map_len, dev);
@@ -5151,7 +5847,7 @@ static int8_t accel_self_test_positive_excitation(struct bmi160_sensor_data *acc
     if (rslt == BMI160_OK)
     {
         /* Read the data after a delay of 50ms - refer datasheet  2.8.1 accel self test*/
-        dev->delay_ms(BMI160_ACCEL_SELF_TEST_DELAY);
+        delay_wait(BMI160_WAIT_ACCEL_SELF_TEST, dev);
         rslt = bmi160_get_sensor_data(BMI160_ACCEL_ONLY, accel_pos, NULL, dev);
     }
 
@@ -5173,7 +5869,7 @@ static int8_t accel_self_test_negative_excitation(struct bmi160_sensor_data *acc
     if (rslt == BMI160_OK)
     {
         /* Read the data after a delay of 50ms */
-        dev->delay_ms(BMI160_ACCEL_SELF_TEST_DELAY);
+        delay_wait(BMI160_WAIT_ACCEL_SELF_TEST, dev);
         rslt = bmi160_get_sensor_data(BMI160_ACCEL_ONLY, accel_neg, NULL, dev);
     }
 
@@ -5239,7 +5935,7 @@ static int8_t enable_gyro_self_test(const struct bmi160_dev *dev)
         if (rslt == BMI160_OK)
         {
             /* Delay to enable gyro self test */
-            dev->delay_ms(15);
+            delay_wait(BMI160_WAIT_GYRO_SELF_TEST, dev);
         }
     }
 
@@ -5914,7 +6610,7 @@ static void get_aux_len_to_parse(uint16_t *data_index,
                                  const struct bmi160_dev *dev)
 {
     /* Data start index */
-    *data_index = dev->fifo->gyro_byte_start_idx;
+    *data_index = dev->fifo->aux_byte_start_idx;
     if (dev->fifo->fifo_data_enable == BMI160_FIFO_M_ENABLE)
     {
         *data_read_length = (*aux_frame_count) * BMI160_FIFO_M_LENGTH;
@@ -6234,6 +6930,147 @@ static void unpack_skipped_frame(uint16_t *data_index, const struct bmi160_dev *
     }
 }
 
+/*!
+ *  @brief This API is used to get the contents of the next FIFO frame for
+ *  bmi160_fifo_batch_parse, parsing the non data frames of header mode on
+ *  the way.
+ */
+static uint8_t batch_next_frame(size_t *data_index,
+                                size_t read_end,
+                                struct bmi160_fifo_batch *batch,
+                                const struct bmi160_dev *dev)
+{
+    const uint8_t *data = batch->data;
+    uint8_t frame_header;
+    uint8_t frame = 0;
+
+    /* Header-less mode, every frame has the enabled sensors */
+    if (dev->fifo->fifo_header_enable == 0)
+    {
+        /* Check if FIFO is empty */
+        if (((*data_index + 2) < read_end) && (data[*data_index] == FIFO_CONFIG_MSB_CHECK) &&
+            (data[*data_index + 1] == FIFO_CONFIG_LSB_CHECK))
+        {
+            *data_index = read_end;
+
+            return 0;
+        }
+        frame = ((dev->fifo->fifo_data_enable & BMI160_FIFO_A_ENABLE) ? BMI160_FIFO_FRAME_A : 0) |
+                ((dev->fifo->fifo_data_enable & BMI160_FIFO_G_ENABLE) ? BMI160_FIFO_FRAME_G : 0) |
+                ((dev->fifo->fifo_data_enable & BMI160_FIFO_M_ENABLE) ? BMI160_FIFO_FRAME_M : 0);
+        if (frame == 0)
+        {
+            /* Nothing enabled, nothing to parse */
+            *data_index = read_end;
+        }
+
+        return frame;
+    }
+
+    /* extracting Frame header */
+    frame_header = (data[*data_index] & BMI160_FIFO_TAG_INTR_MASK);
+
+    /* Index is moved to next byte where the data is starting */
+    (*data_index)++;
+    if ((frame_header & BMI160_FIFO_HEAD_DATA_MASK) == BMI160_FIFO_HEAD_DATA)
+    {
+        frame = (frame_header >> BMI160_FIFO_HEAD_FRAME_POS) & BMI160_FIFO_FRAME_MGA;
+    }
+
+    if (frame != 0)
+    {
+        return frame;
+    }
+
+    switch (frame_header)
+    {
+        /* Sensor time frame */
+        case BMI160_FIFO_HEAD_SENSOR_TIME:
+            if ((*data_index + BMI160_SENSOR_TIME_LENGTH) <= read_end)
+            {
+                batch->sensor_time = ((uint32_t)data[*data_index + BMI160_SENSOR_TIME_MSB_BYTE] << 16) |
+                                     ((uint32_t)data[*data_index + BMI160_SENSOR_TIME_XLSB_BYTE] << 8) |
+                                     data[*data_index];
+                batch->sensor_time_valid = 1;
+                *data_index += BMI160_SENSOR_TIME_LENGTH;
+                batch->frames_end = *data_index;
+            }
+            else
+            {
+                /* Partial read */
+                *data_index = read_end;
+            }
+            break;
+
+        /* Skip frame */
+        case BMI160_FIFO_HEAD_SKIP_FRAME:
+            if (*data_index < read_end)
+            {
+                batch->skipped_frames += data[*data_index];
+                (*data_index)++;
+                batch->frames_end = *data_index;
+            }
+            break;
+
+        /* Input config frame */
+        case BMI160_FIFO_HEAD_INPUT_CONFIG:
+            if (*data_index < read_end)
+            {
+                (*data_index)++;
+                batch->frames_end = *data_index;
+            }
+            break;
+        default:
+
+            /* Update the data index as complete in case of over read or
+             * getting other headers like 0x00 */
+            *data_index = read_end;
+            break;
+    }
+
+    return 0;
+}
+
+/*!
+ *  @brief This API is used to unpack the x, y and z axes of an accel or
+ *  gyro FIFO frame.
+ */
+static void unpack_fifo_xyz(struct bmi160_sensor_data *data, const uint8_t *frame)
+{
+    data->x = (int16_t)(((uint16_t)frame[1] << 8) | frame[0]);
+    data->y = (int16_t)(((uint16_t)frame[3] << 8) | frame[2]);
+    data->z = (int16_t)(((uint16_t)frame[5] << 8) | frame[4]);
+}
+
+/*!
+ *  @brief This API is used to append the x, y and z axes of an accel or
+ *  gyro FIFO frame to per axis arrays.
+ */
+static void append_fifo_xyz(struct bmi160_sensor_soa *soa, const uint8_t *frame)
+{
+    size_t idx = soa->count++;
+
+    soa->x[idx] = (int16_t)(((uint16_t)frame[1] << 8) | frame[0]);
+    soa->y[idx] = (int16_t)(((uint16_t)frame[3] << 8) | frame[2]);
+    soa->z[idx] = (int16_t)(((uint16_t)frame[5] << 8) | frame[4]);
+}
+
+/*!
+ *  @brief This API is used to append a sample to per axis arrays.
+ */
+static void append_sample(struct bmi160_sensor_soa *soa, const struct bmi160_sensor_data *data)
+{
+    size_t idx = soa->count++;
+
+    soa->x[idx] = data->x;
+    soa->y[idx] = data->y;
+    soa->z[idx] = data->z;
+    if (soa->t != NULL)
+    {
+        soa->t[idx] = data->sensortime;
+    }
+}
+
 /*!
  *  @brief This API is used to get the FOC status from the sensor
  */
@@ -6306,7 +7143,7 @@ static int8_t trigger_foc(struct bmi160_offsets *offset, struct bmi160_dev const
             {
                 /* Maximum time of 250ms is given in 10
                  * steps of 25ms each - 250ms refer datasheet 2.9.1 */
-                dev->delay_ms(25);
+                delay_wait(BMI160_WAIT_FOC_POLL, dev);
 
                 /* Check the FOC status*/
                 rslt = get_foc_status(&foc_status, dev);
@@ -6333,4 +7170,359 @@ static int8_t trigger_foc(struct bmi160_offsets *offset, struct bmi160_dev const
     return rslt;
 }
 
+/*!
+ *  @brief This API writes registers on the bus.
+ */
+static int8_t write_regs(uint8_t reg_addr, uint8_t *data, uint16_t len, const struct bmi160_dev *dev)
+{
+    int8_t rslt = BMI160_OK;
+    uint16_t count = 0;
+    uint8_t normal_mode;
+
+    /* Configuring reg_addr for SPI Interface */
+    if (dev->interface == BMI160_SPI_INTF)
+    {
+        reg_addr = (reg_addr & BMI160_SPI_WR_MASK);
+    }
+    normal_mode = (dev->prev_accel_cfg.power == BMI160_ACCEL_NORMAL_MODE) ||
+                  (dev->prev_gyro_cfg.power == BMI160_GYRO_NORMAL_MODE);
+    if (normal_mode)
+    {
+        rslt = dev->write(dev->id, reg_addr, data, len);
+
+        /* Kindly refer bmi160 data sheet section 3.2.4 */
+        delay_wait(BMI160_WAIT_WRITE_NORMAL, dev);
+    }
+    else
+    {
+        /*Burst write is not allowed in
+         * suspend & low power mode */
+        for (; (count < len) && (rslt == BMI160_OK); count++)
+        {
+            rslt = dev->write(dev->id, reg_addr, &data[count], 1);
+            reg_addr++;
+
+            /* Kindly refer bmi160 data sheet section 3.2.4 */
+            delay_wait(BMI160_WAIT_WRITE_SUSPEND, dev);
+        }
+    }
+    if (rslt != BMI160_OK)
+    {
+        rslt = BMI160_E_COM_FAIL;
+    }
+
+    return rslt;
+}
+
+/*!
+ *  @brief This API waits, through delay_us when set and delay_ms otherwise.
+ */
+static void delay_wait(enum bmi160_wait wait, const struct bmi160_dev *dev)
+{
+    if (dev->delay_us != NULL)
+    {
+        dev->delay_us(wait_table[wait].us);
+    }
+    else
+    {
+        dev->delay_ms(wait_table[wait].ms);
+    }
+}
+
+/*!
+ *  @brief This API checks if registers are all held in the shadow.
+ */
+static uint8_t shadow_covers(uint8_t reg_addr, uint16_t len)
+{
+    uint64_t mask;
+    uint8_t covers = 0;
+
+    if ((len != 0) && (reg_addr >= BMI160_SHADOW_START_ADDR) &&
+        ((reg_addr + len) <= (BMI160_SHADOW_START_ADDR + BMI160_SHADOW_LEN)))
+    {
+        mask = ((UINT64_C(1) << len) - 1) << (reg_addr - BMI160_SHADOW_START_ADDR);
+        covers = ((BMI160_SHADOW_REG_MASK & mask) == mask);
+    }
+
+    return covers;
+}
+
+/*!
+ *  @brief This API reads the shadow window from the sensor.
+ */
+static int8_t shadow_load(const struct bmi160_dev *dev)
+{
+    int8_t rslt;
+    uint8_t reg_addr = BMI160_SHADOW_START_ADDR;
+
+    /* Configuring reg_addr for SPI Interface */
+    if (dev->interface == BMI160_SPI_INTF)
+    {
+        reg_addr = (reg_addr | BMI160_SPI_RD_MASK);
+    }
+    rslt = dev->read(dev->id, reg_addr, dev->shadow->chip, BMI160_SHADOW_LEN);
+    if (rslt == BMI160_OK)
+    {
+        memcpy(dev->shadow->regs, dev->shadow->chip, BMI160_SHADOW_LEN);
+        dev->shadow->valid = 1;
+    }
+    else
+    {
+        rslt = BMI160_E_COM_FAIL;
+    }
+
+    return rslt;
+}
+
+/*!
+ *  @brief This API writes the pending shadow registers to the sensor.
+ */
+static int8_t shadow_flush(const struct bmi160_dev *dev)
+{
+    int8_t rslt = BMI160_OK;
+    struct bmi160_shadow *shadow = dev->shadow;
+    uint8_t normal_mode;
+    uint8_t max_gap;
+    uint8_t start;
+    uint8_t end;
+    uint8_t idx = 0;
+    uint8_t next;
+
+    /* Every burst costs an address byte and the idle time, a few clean
+     * registers are cheaper to rewrite. Not so when writes go byte by byte */
+    normal_mode = (dev->prev_accel_cfg.power == BMI160_ACCEL_NORMAL_MODE) ||
+                  (dev->prev_gyro_cfg.power == BMI160_GYRO_NORMAL_MODE);
+    max_gap = normal_mode ? BMI160_SHADOW_MAX_GAP : 0;
+
+    while ((idx < BMI160_SHADOW_LEN) && (rslt == BMI160_OK))
+    {
+        if (shadow->regs[idx] == shadow->chip[idx])
+        {
+            idx++;
+            continue;
+        }
+
+        /* Grow the burst over dirty registers, and gaps short enough */
+        start = idx;
+        end = idx;
+        for (next = idx + 1;
+             (next < BMI160_SHADOW_LEN) && ((next - end - 1) <= max_gap) &&
+             ((BMI160_SHADOW_REG_MASK >> next) & 1);
+             next++)
+        {
+            if (shadow->regs[next] != shadow->chip[next])
+            {
+                end = next;
+            }
+        }
+
+        rslt = write_regs(BMI160_SHADOW_START_ADDR + start, &shadow->regs[start], end - start + 1, dev);
+        if (rslt == BMI160_OK)
+        {
+            memcpy(&shadow->chip[start], &shadow->regs[start], end - start + 1);
+            shadow->writes += normal_mode ? 1 : (end - start + 1);
+            shadow->bytes += end - start + 1;
+        }
+        else
+        {
+            shadow->valid = 0;
+        }
+        idx = end + 1;
+    }
+
+    return rslt;
+}
+
+/*!
+ *  @brief This API updates the shadow after registers were written through.
+ */
+static void shadow_write_through(uint8_t reg_addr, const uint8_t *data, uint16_t len, const struct bmi160_dev *dev)
+{
+    struct bmi160_shadow *shadow = dev->shadow;
+    uint16_t count;
+    uint8_t idx;
+
+    for (count = 0; count < len; count++)
+    {
+        if ((reg_addr + count) == BMI160_COMMAND_REG_ADDR)
+        {
+            /* Soft reset and FOC change registers behind the shadow */
+            if ((data[count] == BMI160_SOFT_RESET_CMD) || (data[count] == BMI160_START_FOC_CMD))
+            {
+                shadow->valid = 0;
+            }
+        }
+        else if (((reg_addr + count) >= BMI160_SHADOW_START_ADDR) &&
+                 ((reg_addr + count) < (BMI160_SHADOW_START_ADDR + BMI160_SHADOW_LEN)))
+        {
+            idx = (uint8_t)(reg_addr + count - BMI160_SHADOW_START_ADDR);
+            if ((BMI160_SHADOW_REG_MASK >> idx) & 1)
+            {
+                shadow->chip[idx] = data[count];
+                shadow->regs[idx] = data[count];
+            }
+        }
+    }
+}
+
+/*!
+ *  @brief This API computes the CRC-8 of a configuration image.
+ */
+static uint8_t image_crc(const uint8_t *data, uint16_t len)
+{
+    uint8_t crc = BMI160_CONFIG_IMAGE_CRC_INIT;
+    uint16_t count;
+    uint8_t bit;
+
+    for (count = 0; count < len; count++)
+    {
+        crc ^= data[count];
+        for (bit = 0; bit < 8; bit++)
+        {
+            crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ BMI160_CONFIG_IMAGE_CRC_POLY) : (uint8_t)(crc << 1);
+        }
+    }
+
+    return crc;
+}
+
+/*!
+ *  @brief This API sets the driver state of dev from a configuration image.
+ */
+static int8_t image_load_state(const uint8_t *image, struct bmi160_dev *dev)
+{
+    int8_t rslt = BMI160_OK;
+    uint8_t idx = BMI160_CONFIG_IMAGE_HDR_LEN;
+    int8_t any_sig_sel;
+
+    dev->accel_cfg.power = image[idx++];
+    dev->accel_cfg.odr = image[idx++];
+    dev->accel_cfg.range = image[idx++];
+    dev->accel_cfg.bw = image[idx++];
+    dev->gyro_cfg.power = image[idx++];
+    dev->gyro_cfg.odr = image[idx++];
+    dev->gyro_cfg.range = image[idx++];
+    dev->gyro_cfg.bw = image[idx++];
+    dev->aux_cfg.aux_sensor_enable = image[idx] & 0x01;
+    dev->aux_cfg.manual_enable = (image[idx] >> 1) & 0x01;
+    dev->aux_cfg.aux_rd_burst_len = (image[idx] >> 2) & 0x03;
+    dev->aux_cfg.aux_odr = (image[idx] >> 4) & 0x0F;
+    idx++;
+    dev->aux_cfg.aux_i2c_addr = image[idx++];
+    any_sig_sel = (int8_t)image[idx++];
+    if ((any_sig_sel >= BMI160_BOTH_ANY_SIG_MOTION_DISABLED) && (any_sig_sel <= BMI160_SIG_MOTION_ENABLED))
+    {
+        dev->any_sig_sel = (enum bmi160_any_sig_motion_active_interrupt_state)any_sig_sel;
+    }
+    else
+    {
+        rslt = BMI160_E_INVALID_INPUT;
+    }
+    if (dev->fifo != NULL)
+    {
+        dev->fifo->fifo_header_enable = image[idx++];
+        dev->fifo->fifo_time_enable = image[idx++];
+        dev->fifo->fifo_data_enable = image[idx++];
+    }
+
+    /* The registers will hold these once the image is written */
+    dev->prev_accel_cfg.odr = dev->accel_cfg.odr;
+    dev->prev_accel_cfg.range = dev->accel_cfg.range;
+    dev->prev_accel_cfg.bw = dev->accel_cfg.bw;
+    dev->prev_gyro_cfg.odr = dev->gyro_cfg.odr;
+    dev->prev_gyro_cfg.range = dev->gyro_cfg.range;
+    dev->prev_gyro_cfg.bw = dev->gyro_cfg.bw;
+
+    return rslt;
+}
+
+/*!
+ *  @brief This API writes the registers of a configuration image that
+ *  differ from the sensor, then sets the power modes of the image.
+ */
+static int8_t image_replay(const uint8_t *image, struct bmi160_dev *dev)
+{
+    int8_t rslt;
+    struct bmi160_shadow *shadow = dev->shadow;
+    uint8_t accel_power = dev->accel_cfg.power;
+    uint8_t idx = BMI160_CONFIG_IMAGE_HDR_LEN + BMI160_CONFIG_IMAGE_STATE_LEN;
+    uint8_t dirty = 0;
+    uint8_t wake;
+    uint8_t reg;
+
+    /* One burst read of the window */
+    rslt = bmi160_config_begin(dev);
+    if (rslt == BMI160_OK)
+    {
+        for (reg = 0; reg < BMI160_SHADOW_LEN; reg++)
+        {
+            if (((BMI160_SHADOW_REG_MASK >> reg) & 1) && (shadow->chip[reg] != image[idx++]))
+            {
+                dirty++;
+            }
+        }
+
+        /* Byte writes in suspend cost the idle time each, more than the
+         * accel start up for a handful of registers */
+        if (dev->delay_us != NULL)
+        {
+            wake = (dirty * wait_table[BMI160_WAIT_WRITE_SUSPEND].us) > wait_table[BMI160_WAIT_ACCEL_STARTUP].us;
+        }
+        else
+        {
+            wake = (dirty * wait_table[BMI160_WAIT_WRITE_SUSPEND].ms) > wait_table[BMI160_WAIT_ACCEL_STARTUP].ms;
+        }
+
+        /* Start what runs in normal mode anyway, gyro only if accel does
+         * not, or the accel for the writes if it is quicker */
+        if ((dev->prev_accel_cfg.power == BMI160_ACCEL_NORMAL_MODE) ||
+            (dev->prev_gyro_cfg.power == BMI160_GYRO_NORMAL_MODE) || (dirty == 0))
+        {
+            /* Writes can burst already, or there are none */
+        }
+        else if (accel_power == BMI160_ACCEL_NORMAL_MODE)
+        {
+            rslt = set_accel_pwr(dev);
+        }
+        else if (dev->gyro_cfg.power == BMI160_GYRO_NORMAL_MODE)
+        {
+            rslt = set_gyro_pwr(dev);
+        }
+        else if (wake)
+        {
+            dev->accel_cfg.power = BMI160_ACCEL_NORMAL_MODE;
+            rslt = set_accel_pwr(dev);
+            dev->accel_cfg.power = accel_power;
+        }
+        else
+        {
+            /* Byte writes are quicker */
+        }
+
+        /* Over what the power mode change wrote to the shadow */
+        idx = BMI160_CONFIG_IMAGE_HDR_LEN + BMI160_CONFIG_IMAGE_STATE_LEN;
+        for (reg = 0; reg < BMI160_SHADOW_LEN; reg++)
+        {
+            if ((BMI160_SHADOW_REG_MASK >> reg) & 1)
+            {
+                shadow->regs[reg] = image[idx++];
+            }
+        }
+        if (rslt == BMI160_OK)
+        {
+            rslt = bmi160_config_commit(dev);
+        }
+        else
+        {
+            (void)bmi160_config_abort(dev);
+        }
+    }
+    if (rslt == BMI160_OK)
+    {
+        rslt = bmi160_set_power_mode(dev);
+    }
+
+    return rslt;
+}
+
 /** @}*/
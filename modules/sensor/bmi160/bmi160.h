@@ -115,6 +115,92 @@ int8_t bmi160_get_regs(uint8_t reg_addr, uint8_t *data, uint16_t len, const stru
  */
 int8_t bmi160_set_regs(uint8_t reg_addr, uint8_t *data, uint16_t len, const struct bmi160_dev *dev);
 
+/*!
+ * @brief This API opens a configuration transaction on dev->shadow.
+ * Until the matching commit, writes to the configuration registers
+ * (0x40 to 0x7B, aux interface and self test excepted) only update the
+ * shadow and reads of them are served from it, so the read-modify-write
+ * sequences of the config APIs cost no bus traffic. Any other register
+ * access writes the pending registers first. Transactions nest.
+ *
+ * The shadow is read from the sensor in one burst when it is not valid
+ * yet, and is kept up to date by later writes. Soft reset and FOC
+ * invalidate it.
+ *
+ * @param[in] dev  : Structure instance of bmi160_dev.
+ *
+ * @return Result of API execution status
+ * @retval zero -> Success / -ve value -> Error
+ */
+int8_t bmi160_config_begin(const struct bmi160_dev *dev);
+
+/*!
+ * @brief This API closes a configuration transaction. Closing the
+ * outermost one writes the registers that differ from the sensor, in as
+ * few bursts as possible, short clean gaps included, each followed by
+ * the write idle time through delay_us when set.
+ *
+ * @param[in] dev  : Structure instance of bmi160_dev.
+ *
+ * @note dev->shadow->writes and dev->shadow->bytes give the bus writes
+ * and bytes of the transaction.
+ *
+ * @return Result of API execution status
+ * @retval zero -> Success / -ve value -> Error
+ */
+int8_t bmi160_config_commit(const struct bmi160_dev *dev);
+
+/*!
+ * @brief This API drops the pending writes and closes all open
+ * configuration transactions. Driver state such as dev->accel_cfg is not
+ * rolled back.
+ *
+ * @param[in] dev  : Structure instance of bmi160_dev.
+ *
+ * @return Result of API execution status
+ * @retval zero -> Success / -ve value -> Error
+ */
+int8_t bmi160_config_abort(const struct bmi160_dev *dev);
+
+/*!
+ * @brief This API saves the configuration of the sensor into an image of
+ * BMI160_CONFIG_IMAGE_LEN bytes, to keep across system off: the accel,
+ * gyro and aux settings and FIFO flags of dev, and every register of the
+ * shadow window, interrupts, FIFO and FOC/NVM offsets included. The
+ * registers come from dev->shadow when it is valid, pending writes of an
+ * open transaction included, else from one burst read.
+ *
+ * @param[out] image    : Buffer for the image.
+ * @param[in,out] len   : Size of the buffer, bytes of the image on return.
+ * @param[in] dev       : Structure instance of bmi160_dev.
+ *
+ * @return Result of API execution status
+ * @retval zero -> Success / -ve value -> Error
+ */
+int8_t bmi160_config_snapshot(uint8_t *image, uint16_t *len, const struct bmi160_dev *dev);
+
+/*!
+ * @brief This API brings the sensor back to the configuration of an image
+ * from bmi160_config_snapshot, in place of bmi160_init and the config
+ * calls. It checks the chip id once, starts the sensors the image runs
+ * in normal mode first so the registers can be written in bursts, writes
+ * only the registers that differ from the sensor in as few bursts as
+ * possible, then sets the remaining power modes. A sensor that kept its
+ * configuration costs one burst read.
+ *
+ * Uses dev->shadow when set, a temporary one otherwise. No soft reset is
+ * done. The aux sensor itself is not set up again, call
+ * bmi160_aux_init and bmi160_config_aux_mode for it.
+ *
+ * @param[in] image     : Image from bmi160_config_snapshot.
+ * @param[in] len       : Bytes of the image.
+ * @param[in,out] dev   : Structure instance of bmi160_dev.
+ *
+ * @return Result of API execution status
+ * @retval zero -> Success / -ve value -> Error
+ */
+int8_t bmi160_config_restore(const uint8_t *image, uint16_t len, struct bmi160_dev *dev);
+
 /*!
  * @brief This API resets and restarts the device.
  * All register values are overwritten with default parameters.
@@ -194,6 +280,26 @@ int8_t bmi160_get_sensor_data(uint8_t select_sensor,
                               struct bmi160_sensor_data *gyro,
                               const struct bmi160_dev *dev);
 
+/*!
+ * @brief This API reads sensor data as bmi160_get_sensor_data does and
+ * appends it to the per axis arrays of accel and gyro.
+ *
+ * @param[in] select_sensor    : enum to choose accel,gyro or both sensor data
+ * @param[in,out] accel : Structure pointer of the accel arrays
+ * @param[in,out] gyro  : Structure pointer of the gyro arrays
+ * @param[in] dev       : Structure instance of bmi160_dev.
+ *
+ * @note The sensor time is 0 unless select_sensor has BMI160_TIME_SEL.
+ *
+ * @return Result of API execution status
+ * @retval zero -> Success  / -ve value -> Error
+ * @retval BMI160_E_OUT_OF_RANGE -> No room left, nothing read
+ */
+int8_t bmi160_get_sensor_data_soa(uint8_t select_sensor,
+                                  struct bmi160_sensor_soa *accel,
+                                  struct bmi160_sensor_soa *gyro,
+                                  const struct bmi160_dev *dev);
+
 /*!
  * @brief This API configures the necessary interrupt based on
  *  the user settings in the bmi160_int_settg structure instance.
@@ -572,6 +678,65 @@ int8_t bmi160_extract_gyro(struct bmi160_sensor_data *gyro_data, uint8_t *gyro_l
  */
 int8_t bmi160_extract_aux(struct bmi160_aux_data *aux_data, uint8_t *aux_len, struct bmi160_dev const *dev);
 
+/*!
+ *  @brief This API parses the FIFO data read by the "bmi160_get_fifo_data"
+ *  API in a single pass and sorts the accel, gyro and aux frames, the
+ *  sensor time and the skipped frame count into "demux". It replaces
+ *  calling bmi160_extract_accel/gyro/aux one after the other, which walks
+ *  the buffer once per sensor.
+ *
+ *  @note Parsing stops before the first frame whose accel, gyro or aux
+ *  part no longer fits its buffer. The next call resumes there, through
+ *  the byte indexes of dev->fifo, which are all left at that point.
+ *  Do not mix with bmi160_extract_accel/gyro/aux on the same FIFO read.
+ *
+ *  @param[in,out] demux  : Structure instance of bmi160_fifo_demux with
+ *                          the output buffers and their sizes. Lengths are
+ *                          updated with the number of frames stored.
+ *  @param[in] dev        : Structure instance of bmi160_dev.
+ *
+ *  @note dev->fifo->sensor_time and skipped_frame_count are updated as
+ *  well, as the extract APIs do, the latter with the saturated sum of
+ *  demux->skipped_frame_count.
+ *
+ *  @return Result of API execution status
+ *  @retval 0 -> Success
+ *  @retval Any non zero value -> Fail
+ *
+ */
+int8_t bmi160_fifo_demux(struct bmi160_fifo_demux *demux, struct bmi160_dev const *dev);
+
+/*!
+ *  @brief This API parses any number of FIFO reads, concatenated in
+ *  "batch", in a single pass into accel, gyro and aux frames, the sensor
+ *  time and the skipped frame count. Counts are size_t, so host side
+ *  buffers of many reads are parsed in one call instead of one
+ *  bmi160_fifo_demux call per read.
+ *
+ *  @note Every read ends at its over-read frame, empty frame or partial
+ *  frame, frames_end tells where; the next read starts at the following
+ *  read_len boundary. The FIFO mode is taken from
+ *  dev->fifo->fifo_header_enable and fifo_data_enable, dev->fifo->data
+ *  and length are not used.
+ *
+ *  @note Parsing stops before the first frame whose accel, gyro or aux
+ *  part no longer fits its buffer or per axis arrays, data_index and
+ *  read_index are left there for the next call. With frames set, also
+ *  before the first frame once it is full.
+ *
+ *  @param[in,out] batch  : Structure instance of bmi160_fifo_batch with
+ *                          the FIFO reads, the output buffers and their
+ *                          sizes. Lengths are updated with the number of
+ *                          frames stored.
+ *  @param[in] dev        : Structure instance of bmi160_dev.
+ *
+ *  @return Result of API execution status
+ *  @retval 0 -> Success
+ *  @retval Any non zero value -> Fail
+ *
+ */
+int8_t bmi160_fifo_batch_parse(struct bmi160_fifo_batch *batch, struct bmi160_dev const *dev);
+
 /*!
  *  @brief This API starts the FOC of accel and gyro
  *
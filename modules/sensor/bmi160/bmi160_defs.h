@@ -383,6 +383,47 @@
 #define BMI160_AUX_COM_DELAY                 UINT8_C(10)
 #define BMI160_GYRO_SELF_TEST_DELAY          UINT8_C(20)
 #define BMI160_ACCEL_SELF_TEST_DELAY         UINT8_C(50)
+#define BMI160_GYRO_FSU_DELAY_MS             UINT8_C(10)
+#define BMI160_GYRO_SELF_TEST_DELAY_MS       UINT8_C(15)
+#define BMI160_NVM_DELAY_MS                  UINT8_C(25)
+#define BMI160_FOC_DELAY_MS                  UINT8_C(25)
+
+/* Delay in us settings, see enum bmi160_wait */
+#define BMI160_WRITE_IDLE_NORMAL_US          UINT32_C(2)
+#define BMI160_WRITE_IDLE_SUSPEND_US         UINT32_C(450)
+#define BMI160_SOFT_RESET_DELAY_US           UINT32_C(1000)
+#define BMI160_ACCEL_DELAY_US                UINT32_C(3800)
+#define BMI160_GYRO_DELAY_US                 UINT32_C(80000)
+#define BMI160_GYRO_FSU_DELAY_US             UINT32_C(10000)
+#define BMI160_AUX_DELAY_US                  UINT32_C(500)
+#define BMI160_AUX_COM_DELAY_US              UINT32_C(10000)
+#define BMI160_GYRO_SELF_TEST_DELAY_US       UINT32_C(15000)
+#define BMI160_ACCEL_SELF_TEST_DELAY_US      UINT32_C(50000)
+#define BMI160_NVM_DELAY_US                  UINT32_C(25000)
+#define BMI160_FOC_DELAY_US                  UINT32_C(25000)
+
+/** Configuration shadow, registers 0x40 to 0x7B */
+#define BMI160_SHADOW_START_ADDR             BMI160_ACCEL_CONFIG_ADDR
+#define BMI160_SHADOW_LEN                    UINT8_C(60)
+
+/* Registers of the window held in the shadow, bit n for 0x40 + n. Left
+ * out: reserved, aux interface (writes start aux transfers), self test,
+ * step counter (read only) */
+#define BMI160_SHADOW_REG_MASK               UINT64_C(0x0CFF1FFFFFFF00FF)
+
+/* Clean registers a burst may rewrite to join two dirty ranges */
+#define BMI160_SHADOW_MAX_GAP                UINT8_C(2)
+
+/** Configuration image, see bmi160_config_snapshot. Header, driver state,
+ * the registers of the shadow mask in address order and a CRC-8 */
+#define BMI160_CONFIG_IMAGE_MAGIC            UINT8_C(0xB1)
+#define BMI160_CONFIG_IMAGE_VERSION          UINT8_C(1)
+#define BMI160_CONFIG_IMAGE_HDR_LEN          UINT8_C(2)
+#define BMI160_CONFIG_IMAGE_STATE_LEN        UINT8_C(14)
+#define BMI160_CONFIG_IMAGE_REGS             UINT8_C(47)
+#define BMI160_CONFIG_IMAGE_LEN              UINT8_C(64)
+#define BMI160_CONFIG_IMAGE_CRC_POLY         UINT8_C(0x1D)
+#define BMI160_CONFIG_IMAGE_CRC_INIT         UINT8_C(0xFF)
 
 /** Self test configurations */
 #define BMI160_ACCEL_SELF_TEST_CONFIG        UINT8_C(0x2C)
@@ -532,6 +573,15 @@
 /** FIFO sensor time length definitions */
 #define BMI160_SENSOR_TIME_LENGTH            UINT8_C(3)
 
+/** FIFO data frame contents, as used by bmi160_fifo_demux */
+#define BMI160_FIFO_FRAME_A                  UINT8_C(0x01)
+#define BMI160_FIFO_FRAME_G                  UINT8_C(0x02)
+#define BMI160_FIFO_FRAME_M                  UINT8_C(0x04)
+#define BMI160_FIFO_FRAME_MGA                UINT8_C(0x07)
+#define BMI160_FIFO_HEAD_DATA_MASK           UINT8_C(0xE3)
+#define BMI160_FIFO_HEAD_DATA                UINT8_C(0x80)
+#define BMI160_FIFO_HEAD_FRAME_POS           UINT8_C(2)
+
 /** FIFO DOWN selection */
 /* Accel fifo down-sampling values*/
 #define  BMI160_ACCEL_FIFO_DOWN_ZERO         UINT8_C(0x00)
@@ -856,6 +906,28 @@ struct bmi160_sensor_data
     uint32_t sensortime;
 };
 
+/*!
+ * @brief Accel or gyro samples as one array per axis, for filters and
+ * transforms working on one axis at a time. Samples are appended at count.
+ */
+struct bmi160_sensor_soa
+{
+    /*! X, Y and Z axis arrays of capacity entries */
+    int16_t *x;
+    int16_t *y;
+    int16_t *z;
+
+    /*! Time array of capacity entries, NULL to drop it. Raw sensor time
+     *  from bmi160_get_sensor_data_soa, ns from bmi160_ts_stamp */
+    uint64_t *t;
+
+    /*! Number of entries of the arrays */
+    size_t capacity;
+
+    /*! Samples stored, where the next sample goes */
+    size_t count;
+};
+
 /*!
  * @brief bmi160 aux data structure which comprises of 8 bytes of accel data
  */
@@ -1043,6 +1115,46 @@ enum bmi160_int_channel {
     /*! Map both channels */
     BMI160_INT_CHANNEL_BOTH
 };
+
+/*!
+ * @brief Waits of the driver, each has a time in us for delay_us and the
+ * time in ms it was rounded up to for delay_ms
+ */
+enum bmi160_wait {
+    /*! Idle time after a write, normal mode / suspend and low power mode */
+    BMI160_WAIT_WRITE_NORMAL,
+    BMI160_WAIT_WRITE_SUSPEND,
+
+    /*! Soft reset */
+    BMI160_WAIT_SOFT_RESET,
+
+    /*! Accel suspend to normal / low power mode, 3.8 ms */
+    BMI160_WAIT_ACCEL_STARTUP,
+
+    /*! Gyro suspend to normal mode, 80 ms */
+    BMI160_WAIT_GYRO_STARTUP,
+
+    /*! Gyro fast start-up to normal mode, 10 ms */
+    BMI160_WAIT_GYRO_FSU_NORMAL,
+
+    /*! Aux suspend to normal mode, 0.5 ms */
+    BMI160_WAIT_AUX_STARTUP,
+
+    /*! Aux interface transfer */
+    BMI160_WAIT_AUX_COM,
+
+    /*! Accel and gyro self test */
+    BMI160_WAIT_ACCEL_SELF_TEST,
+    BMI160_WAIT_GYRO_SELF_TEST,
+
+    /*! NVM write and FOC status polling */
+    BMI160_WAIT_NVM_POLL,
+    BMI160_WAIT_FOC_POLL,
+
+    /*! Number of waits */
+    BMI160_WAIT_COUNT
+};
+
 enum bmi160_int_types {
     /*! Slope/Any-motion interrupt */
     BMI160_ACC_ANY_MOTION_INT,
@@ -1618,6 +1730,132 @@ struct bmi160_fifo_frame
     /*! Value of Skipped frame counts */
     uint8_t skipped_frame_count;
 };
+
+/*!
+ *  @brief This structure holds the outputs of a single pass over the
+ *  FIFO data, see bmi160_fifo_demux.
+ */
+struct bmi160_fifo_demux
+{
+    /*! Accel frames, NULL to drop accel data */
+    struct bmi160_sensor_data *accel;
+
+    /*! Gyro frames, NULL to drop gyro data */
+    struct bmi160_sensor_data *gyro;
+
+    /*! Aux frames, NULL to drop aux data */
+    struct bmi160_aux_data *aux;
+
+    /*! Size of the accel buffer on input, frames stored on output */
+    uint8_t accel_len;
+
+    /*! Size of the gyro buffer on input, frames stored on output */
+    uint8_t gyro_len;
+
+    /*! Size of the aux buffer on input, frames stored on output */
+    uint8_t aux_len;
+
+    /*! Last sensor time frame seen, valid if sensor_time_valid is set */
+    uint32_t sensor_time;
+
+    /*! Set when a sensor time frame was parsed */
+    uint8_t sensor_time_valid;
+
+    /*! Sum of the skipped frame counts of all skip frames parsed,
+     *  saturated at 255, 0 if none */
+    uint8_t skipped_frame_count;
+};
+
+/*!
+ *  @brief This structure holds any number of concatenated FIFO reads and
+ *  the outputs of parsing them, see bmi160_fifo_batch_parse.
+ */
+struct bmi160_fifo_batch
+{
+    /*! FIFO reads, back to back */
+    const uint8_t *data;
+
+    /*! Total number of bytes in data */
+    size_t length;
+
+    /*! Number of bytes of each FIFO read, NULL if data is a single read */
+    const uint16_t *read_len;
+
+    /*! Number of entries in read_len */
+    size_t read_count;
+
+    /*! Accel frames, NULL to drop accel data */
+    struct bmi160_sensor_data *accel;
+
+    /*! Gyro frames, NULL to drop gyro data */
+    struct bmi160_sensor_data *gyro;
+
+    /*! Aux frames, NULL to drop aux data */
+    struct bmi160_aux_data *aux;
+
+    /*! Accel and gyro frames appended per axis, NULL if not wanted. Frames
+     *  carry no time, t is left alone. Filled along with accel and gyro */
+    struct bmi160_sensor_soa *accel_soa;
+    struct bmi160_sensor_soa *gyro_soa;
+
+    /*! Contents of each data frame in FIFO order, BMI160_FIFO_FRAME_A/G/M
+     *  bits, NULL if not wanted. Lines the per sensor outputs up again */
+    uint8_t *frames;
+
+    /*! Size of the accel buffer on input, frames stored on output */
+    size_t accel_len;
+
+    /*! Size of the gyro buffer on input, frames stored on output */
+    size_t gyro_len;
+
+    /*! Size of the aux buffer on input, frames stored on output */
+    size_t aux_len;
+
+    /*! Size of the frames buffer on input, entries stored on output */
+    size_t frames_len;
+
+    /*! Last sensor time frame seen, valid if sensor_time_valid is set */
+    uint32_t sensor_time;
+
+    /*! Set when a sensor time frame was parsed */
+    uint8_t sensor_time_valid;
+
+    /*! Sum of the skipped frame counts of all skip frames */
+    size_t skipped_frames;
+
+    /*! Byte and read to resume parsing at, both 0 for a new batch. Set to
+     *  where parsing stopped; data_index equals length once all is parsed */
+    size_t data_index;
+    size_t read_index;
+
+    /*! Byte after the last complete frame parsed, where the over-read or
+     *  partial frame ending a read starts. data_index on input if none */
+    size_t frames_end;
+};
+
+/*!
+ *  @brief This structure holds the shadow of the configuration registers,
+ *  see bmi160_config_begin.
+ */
+struct bmi160_shadow
+{
+    /*! Register values with the pending writes applied */
+    uint8_t regs[BMI160_SHADOW_LEN];
+
+    /*! Register values as last read from or written to the sensor */
+    uint8_t chip[BMI160_SHADOW_LEN];
+
+    /*! Set while chip matches the sensor, cleared by soft reset and FOC */
+    uint8_t valid;
+
+    /*! Nesting depth of open transactions, 0 when none is open */
+    uint8_t depth;
+
+    /*! Bus writes and bytes written by the last commit */
+    uint8_t writes;
+    uint8_t bytes;
+};
+
 struct bmi160_dev
 {
     /*! Chip Id */
@@ -1669,6 +1907,13 @@ struct bmi160_dev
 
     /*!  Delay function pointer */
     bmi160_delay_fptr_t delay_ms;
+
+    /*! Delay function pointer in us, NULL to round waits up to delay_ms.
+     *  See enum bmi160_wait */
+    bmi160_delay_fptr_t delay_us;
+
+    /*! Configuration shadow, NULL to write every register through */
+    struct bmi160_shadow *shadow;
 };
 
 #endif /* BMI160_DEFS_H_ */
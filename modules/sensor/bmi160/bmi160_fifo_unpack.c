@@ -0,0 +1,571 @@
+/*!
+ * @file    bmi160_fifo_unpack.c
+ * @brief   Bulk unpacking of header-less BMI160 FIFO data
+ */
+
+#include "bmi160_fifo_unpack.h"
+
+#if (BMI160_FIFO_UNPACK_KERNEL == BMI160_FIFO_UNPACK_AVX2)
+#include <immintrin.h>
+#elif (BMI160_FIFO_UNPACK_KERNEL == BMI160_FIFO_UNPACK_SSE2)
+#include <emmintrin.h>
+#elif (BMI160_FIFO_UNPACK_KERNEL == BMI160_FIFO_UNPACK_NEON)
+#include <arm_neon.h>
+#endif
+
+/*! Axis columns of a frame after the aux part: gyro x, y, z, accel x, y, z */
+#define UNPACK_MAX_COLS    UINT8_C(6)
+#define UNPACK_AXES        UINT8_C(3)
+
+/*! Bytes a vector load of one frame covers */
+#define UNPACK_ROW_BYTES   UINT8_C(16)
+
+/*********************** Static function declarations ************************/
+
+/*!
+ *  @brief This API assembles a little endian int16 from the FIFO.
+ *
+ *  @param[in] p : Pointer to the low byte.
+ *
+ *  @return Value
+ */
+static inline int16_t get_le16(const uint8_t *p);
+
+/*!
+ *  @brief This API unpacks the axis columns of frames first to frames one
+ *  frame at a time. Any byte order.
+ *
+ *  @param[in] data   : First axis byte of the first frame.
+ *  @param[in] first  : First frame to unpack.
+ *  @param[in] frames : End of the frames to unpack.
+ *  @param[in] stride : Frame length.
+ *  @param[in] cols   : Number of columns.
+ *  @param[out] dst   : Array per column, NULL entries are dropped.
+ *
+ *  @return None
+ */
+static void soa_scalar(const uint8_t *data,
+                       size_t first,
+                       size_t frames,
+                       uint8_t stride,
+                       uint8_t cols,
+                       int16_t *const dst[]);
+
+#if (BMI160_FIFO_UNPACK_KERNEL != BMI160_FIFO_UNPACK_SCALAR)
+
+/*!
+ *  @brief This API unpacks the axis columns of as many leading frames as
+ *  the kernel handles in blocks, without reading past avail bytes.
+ *
+ *  @param[in] data   : First axis byte of the first frame.
+ *  @param[in] avail  : Bytes readable from data on.
+ *  @param[in] frames : Number of frames.
+ *  @param[in] stride : Frame length.
+ *  @param[in] cols   : Number of columns.
+ *  @param[out] dst   : Array per column, NULL entries are dropped.
+ *
+ *  @return Number of frames unpacked, the rest is left to soa_scalar
+ */
+static size_t soa_blocks(const uint8_t *data,
+                         size_t avail,
+                         size_t frames,
+                         uint8_t stride,
+                         uint8_t cols,
+                         int16_t *const dst[]);
+#endif
+
+/*********************** User function definitions ****************************/
+
+/*!
+ *  @brief This API gives the length of a header-less FIFO frame.
+ */
+uint8_t bmi160_fifo_unpack_frame_len(uint8_t data_enable)
+{
+    return ((data_enable & BMI160_FIFO_M_ENABLE) ? BMI160_FIFO_M_LENGTH : 0) +
+           ((data_enable & BMI160_FIFO_G_ENABLE) ? BMI160_FIFO_G_LENGTH : 0) +
+           ((data_enable & BMI160_FIFO_A_ENABLE) ? BMI160_FIFO_A_LENGTH : 0);
+}
+
+/*!
+ *  @brief This API counts the whole frames of a header-less FIFO read.
+ */
+size_t bmi160_fifo_unpack_count(const uint8_t *data, size_t length, uint8_t data_enable)
+{
+    uint8_t stride = bmi160_fifo_unpack_frame_len(data_enable);
+    size_t idx = 0;
+    size_t frames = 0;
+
+    if ((data == NULL) || (stride == 0))
+    {
+        return 0;
+    }
+
+    while ((idx + stride) <= length)
+    {
+        /* Reads past the fill level return the empty marker */
+        if (((idx + 2) < length) && (data[idx] == FIFO_CONFIG_MSB_CHECK) && (data[idx + 1] == FIFO_CONFIG_LSB_CHECK))
+        {
+            break;
+        }
+        idx += stride;
+        frames++;
+    }
+
+    return frames;
+}
+
+/*!
+ *  @brief This API unpacks header-less FIFO frames into sensor data
+ *  structures.
+ */
+int8_t bmi160_fifo_unpack_aos(const uint8_t *data,
+                              size_t frames,
+                              uint8_t data_enable,
+                              struct bmi160_sensor_data *accel,
+                              struct bmi160_sensor_data *gyro,
+                              struct bmi160_aux_data *aux)
+{
+    uint8_t stride = bmi160_fifo_unpack_frame_len(data_enable);
+    uint8_t gyro_off = (data_enable & BMI160_FIFO_M_ENABLE) ? BMI160_FIFO_M_LENGTH : 0;
+    uint8_t accel_off = gyro_off + ((data_enable & BMI160_FIFO_G_ENABLE) ? BMI160_FIFO_G_LENGTH : 0);
+    const uint8_t *p;
+    size_t i;
+
+    if ((data == NULL) && (frames != 0))
+    {
+        return BMI160_E_NULL_PTR;
+    }
+
+    if ((stride == 0) || ((accel != NULL) && !(data_enable & BMI160_FIFO_A_ENABLE)) ||
+        ((gyro != NULL) && !(data_enable & BMI160_FIFO_G_ENABLE)) ||
+        ((aux != NULL) && !(data_enable & BMI160_FIFO_M_ENABLE)))
+    {
+        return BMI160_E_INVALID_INPUT;
+    }
+
+    /* One loop per output keeps the stores sequential */
+    if (aux != NULL)
+    {
+        for (i = 0, p = data; i < frames; i++, p += stride)
+        {
+            memcpy(aux[i].data, p, BMI160_FIFO_M_LENGTH);
+        }
+    }
+    if (gyro != NULL)
+    {
+        for (i = 0, p = data + gyro_off; i < frames; i++, p += stride)
+        {
+            gyro[i].x = get_le16(p);
+            gyro[i].y = get_le16(p + 2);
+            gyro[i].z = get_le16(p + 4);
+        }
+    }
+    if (accel != NULL)
+    {
+        for (i = 0, p = data + accel_off; i < frames; i++, p += stride)
+        {
+            accel[i].x = get_le16(p);
+            accel[i].y = get_le16(p + 2);
+            accel[i].z = get_le16(p + 4);
+        }
+    }
+
+    return BMI160_OK;
+}
+
+/*!
+ *  @brief This API unpacks header-less FIFO frames into one array per axis.
+ */
+int8_t bmi160_fifo_unpack_soa(const uint8_t *data,
+                              size_t frames,
+                              uint8_t data_enable,
+                              struct bmi160_sensor_soa *accel,
+                              struct bmi160_sensor_soa *gyro,
+                              struct bmi160_aux_data *aux)
+{
+    uint8_t stride = bmi160_fifo_unpack_frame_len(data_enable);
+    uint8_t off = (data_enable & BMI160_FIFO_M_ENABLE) ? BMI160_FIFO_M_LENGTH : 0;
+    int16_t *dst[UNPACK_MAX_COLS] = { NULL };
+    uint8_t cols = 0;
+    size_t done = 0;
+    size_t i;
+
+    if (((data == NULL) && (frames != 0)) ||
+        ((accel != NULL) && ((accel->x == NULL) || (accel->y == NULL) || (accel->z == NULL))) ||
+        ((gyro != NULL) && ((gyro->x == NULL) || (gyro->y == NULL) || (gyro->z == NULL))))
+    {
+        return BMI160_E_NULL_PTR;
+    }
+
+    if ((stride == 0) || ((accel != NULL) && !(data_enable & BMI160_FIFO_A_ENABLE)) ||
+        ((gyro != NULL) && !(data_enable & BMI160_FIFO_G_ENABLE)) ||
+        ((aux != NULL) && !(data_enable & BMI160_FIFO_M_ENABLE)))
+    {
+        return BMI160_E_INVALID_INPUT;
+    }
+
+    if (((accel != NULL) && ((accel->count > accel->capacity) || (frames > (accel->capacity - accel->count)))) ||
+        ((gyro != NULL) && ((gyro->count > gyro->capacity) || (frames > (gyro->capacity - gyro->count)))))
+    {
+        return BMI160_E_OUT_OF_RANGE;
+    }
+
+    if (aux != NULL)
+    {
+        for (i = 0; i < frames; i++)
+        {
+            memcpy(aux[i].data, &data[i * stride], BMI160_FIFO_M_LENGTH);
+        }
+    }
+
+    /* Gyro then accel columns, as they follow each other in the frame */
+    if (data_enable & BMI160_FIFO_G_ENABLE)
+    {
+        if (gyro != NULL)
+        {
+            dst[cols] = gyro->x + gyro->count;
+            dst[cols + 1] = gyro->y + gyro->count;
+            dst[cols + 2] = gyro->z + gyro->count;
+        }
+        cols += UNPACK_AXES;
+    }
+    if (data_enable & BMI160_FIFO_A_ENABLE)
+    {
+        if (accel != NULL)
+        {
+            dst[cols] = accel->x + accel->count;
+            dst[cols + 1] = accel->y + accel->count;
+            dst[cols + 2] = accel->z + accel->count;
+        }
+        cols += UNPACK_AXES;
+    }
+
+    if ((frames == 0) || (cols == 0) || ((accel == NULL) && (gyro == NULL)))
+    {
+        return BMI160_OK;
+    }
+
+#if (BMI160_FIFO_UNPACK_KERNEL != BMI160_FIFO_UNPACK_SCALAR)
+    done = soa_blocks(data + off, frames * stride - off, frames, stride, cols, dst);
+#endif
+    soa_scalar(data + off, done, frames, stride, cols, dst);
+
+    if (accel != NULL)
+    {
+        accel->count += frames;
+    }
+    if (gyro != NULL)
+    {
+        gyro->count += frames;
+    }
+
+    return BMI160_OK;
+}
+
+/*********************** Static function definitions ****************************/
+
+/*!
+ *  @brief This API assembles a little endian int16 from the FIFO.
+ */
+static inline int16_t get_le16(const uint8_t *p)
+{
+    return (int16_t)(((uint16_t)p[1] << 8) | p[0]);
+}
+
+/*!
+ *  @brief This API unpacks the axis columns one frame at a time.
+ */
+static void soa_scalar(const uint8_t *data,
+                       size_t first,
+                       size_t frames,
+                       uint8_t stride,
+                       uint8_t cols,
+                       int16_t *const dst[])
+{
+    const uint8_t *p;
+    size_t i;
+    uint8_t c;
+
+    for (c = 0; c < cols; c++)
+    {
+        if (dst[c] == NULL)
+        {
+            continue;
+        }
+        for (i = first, p = data + first * stride + 2 * c; i < frames; i++, p += stride)
+        {
+            dst[c][i] = get_le16(p);
+        }
+    }
+}
+
+#if (BMI160_FIFO_UNPACK_KERNEL == BMI160_FIFO_UNPACK_PAIR)
+
+/*
+ * Cortex-M4: two frames per step with 32-bit unaligned loads. Axes x and y
+ * of one frame share a word, PKHBT/PKHTB regroup the halfwords of the two
+ * frames into x0x1, y0y1 and z0z1 words, stored as pairs.
+ */
+#if defined(__ARM_FEATURE_DSP)
+static inline uint32_t pack_bottom(uint32_t lo, uint32_t hi)
+{
+    uint32_t r;
+
+    __asm("pkhbt %0, %1, %2, lsl #16" : "=r" (r) : "r" (lo), "r" (hi));
+
+    return r;
+}
+
+static inline uint32_t pack_top(uint32_t hi, uint32_t lo)
+{
+    uint32_t r;
+
+    __asm("pkhtb %0, %1, %2, asr #16" : "=r" (r) : "r" (hi), "r" (lo));
+
+    return r;
+}
+#else
+
+/* Same results in C, for checking the kernel on a little endian host */
+static inline uint32_t pack_bottom(uint32_t lo, uint32_t hi)
+{
+    return (lo & 0xFFFFU) | (hi << 16);
+}
+
+static inline uint32_t pack_top(uint32_t hi, uint32_t lo)
+{
+    return (hi & 0xFFFF0000U) | (lo >> 16);
+}
+#endif
+
+static inline uint32_t load_u32(const uint8_t *p)
+{
+    uint32_t v;
+
+    memcpy(&v, p, sizeof(v));
+
+    return v;
+}
+
+static inline uint32_t load_u16(const uint8_t *p)
+{
+    uint16_t v;
+
+    memcpy(&v, p, sizeof(v));
+
+    return v;
+}
+
+static inline void store_pair(int16_t *dst, uint32_t v)
+{
+    memcpy(dst, &v, sizeof(v));
+}
+
+/*!
+ *  @brief This API unpacks the axis columns two frames at a time.
+ */
+static size_t soa_blocks(const uint8_t *data,
+                         size_t avail,
+                         size_t frames,
+                         uint8_t stride,
+                         uint8_t cols,
+                         int16_t *const dst[])
+{
+    const uint8_t *p;
+    uint32_t a0, a1;
+    size_t i;
+    uint8_t c;
+
+    (void)avail;
+    for (i = 0; (i + 2) <= frames; i += 2)
+    {
+        p = data + i * stride;
+        for (c = 0; c < cols; c += UNPACK_AXES)
+        {
+            if (dst[c] == NULL)
+            {
+                continue;
+            }
+            a0 = load_u32(p + 2 * c);
+            a1 = load_u32(p + stride + 2 * c);
+            store_pair(&dst[c][i], pack_bottom(a0, a1));
+            store_pair(&dst[c + 1][i], pack_top(a1, a0));
+            store_pair(&dst[c + 2][i], pack_bottom(load_u16(p + 2 * c + 4), load_u16(p + stride + 2 * c + 4)));
+        }
+    }
+
+    return i;
+}
+
+#elif (BMI160_FIFO_UNPACK_KERNEL == BMI160_FIFO_UNPACK_SSE2) || (BMI160_FIFO_UNPACK_KERNEL == BMI160_FIFO_UNPACK_AVX2)
+
+/*
+ * x86: each frame is loaded as one 16 byte row of 8 halfwords, 8 rows are
+ * transposed with unpack instructions and the first cols rows of the
+ * result are the axis columns of 8 frames. AVX2 does the same on two
+ * blocks of 8 frames at once, one per 128-bit lane.
+ */
+#define TRANSPOSE_8X16(T, unpacklo16, unpackhi16, unpacklo32, unpackhi32, unpacklo64, unpackhi64, r, col) \
+    do \
+    { \
+        T t0 = unpacklo16(r[0], r[1]), t1 = unpackhi16(r[0], r[1]); \
+        T t2 = unpacklo16(r[2], r[3]), t3 = unpackhi16(r[2], r[3]); \
+        T t4 = unpacklo16(r[4], r[5]), t5 = unpackhi16(r[4], r[5]); \
+        T t6 = unpacklo16(r[6], r[7]), t7 = unpackhi16(r[6], r[7]); \
+        T u0 = unpacklo32(t0, t2), u1 = unpackhi32(t0, t2), u2 = unpacklo32(t1, t3); \
+        T u4 = unpacklo32(t4, t6), u5 = unpackhi32(t4, t6), u6 = unpacklo32(t5, t7); \
+        col[0] = unpacklo64(u0, u4); \
+        col[1] = unpackhi64(u0, u4); \
+        col[2] = unpacklo64(u1, u5); \
+        col[3] = unpackhi64(u1, u5); \
+        col[4] = unpacklo64(u2, u6); \
+        col[5] = unpackhi64(u2, u6); \
+    } while (0)
+
+/*!
+ *  @brief This API unpacks the axis columns in blocks of 8 or 16 frames.
+ */
+static size_t soa_blocks(const uint8_t *data,
+                         size_t avail,
+                         size_t frames,
+                         uint8_t stride,
+                         uint8_t cols,
+                         int16_t *const dst[])
+{
+    const uint8_t *p;
+    size_t i = 0;
+    uint8_t c;
+    uint8_t k;
+
+    (void)frames;
+
+#if (BMI160_FIFO_UNPACK_KERNEL == BMI160_FIFO_UNPACK_AVX2)
+    for (; ((i + 15) * stride + UNPACK_ROW_BYTES) <= avail; i += 16)
+    {
+        __m256i r[8];
+        __m256i col[UNPACK_MAX_COLS];
+
+        p = data + i * stride;
+        for (k = 0; k < 8; k++)
+        {
+            r[k] =
+                _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)(p + k * stride))),
+                                        _mm_loadu_si128((const __m128i *)(p + (k + 8) * stride)),
+                                        1);
+        }
+        TRANSPOSE_8X16(__m256i,
+                       _mm256_unpacklo_epi16,
+                       _mm256_unpackhi_epi16,
+                       _mm256_unpacklo_epi32,
+                       _mm256_unpackhi_epi32,
+                       _mm256_unpacklo_epi64,
+                       _mm256_unpackhi_epi64,
+                       r,
+                       col);
+        for (c = 0; c < cols; c++)
+        {
+            if (dst[c] != NULL)
+            {
+                _mm256_storeu_si256((__m256i *)&dst[c][i], col[c]);
+            }
+        }
+    }
+#endif
+
+    for (; ((i + 7) * stride + UNPACK_ROW_BYTES) <= avail; i += 8)
+    {
+        __m128i r[8];
+        __m128i col[UNPACK_MAX_COLS];
+
+        p = data + i * stride;
+        for (k = 0; k < 8; k++)
+        {
+            r[k] = _mm_loadu_si128((const __m128i *)(p + k * stride));
+        }
+        TRANSPOSE_8X16(__m128i,
+                       _mm_unpacklo_epi16,
+                       _mm_unpackhi_epi16,
+                       _mm_unpacklo_epi32,
+                       _mm_unpackhi_epi32,
+                       _mm_unpacklo_epi64,
+                       _mm_unpackhi_epi64,
+                       r,
+                       col);
+        for (c = 0; c < cols; c++)
+        {
+            if (dst[c] != NULL)
+            {
+                _mm_storeu_si128((__m128i *)&dst[c][i], col[c]);
+            }
+        }
+    }
+
+    return i;
+}
+
+#elif (BMI160_FIFO_UNPACK_KERNEL == BMI160_FIFO_UNPACK_NEON)
+
+/*
+ * NEON: the same 8 by 8 halfword transpose as on x86, with zips for the
+ * 16 and 32-bit steps and half register combines for the 64-bit step.
+ */
+
+/*!
+ *  @brief This API unpacks the axis columns in blocks of 8 frames.
+ */
+static size_t soa_blocks(const uint8_t *data,
+                         size_t avail,
+                         size_t frames,
+                         uint8_t stride,
+                         uint8_t cols,
+                         int16_t *const dst[])
+{
+    const uint8_t *p;
+    int16x8_t r[8];
+    int16x8_t col[UNPACK_MAX_COLS];
+    int16x8x2_t t01, t23, t45, t67;
+    int32x4x2_t u0, u1, v0, v1;
+    size_t i;
+    uint8_t c;
+    uint8_t k;
+
+    (void)frames;
+    for (i = 0; ((i + 7) * stride + UNPACK_ROW_BYTES) <= avail; i += 8)
+    {
+        p = data + i * stride;
+        for (k = 0; k < 8; k++)
+        {
+            r[k] = vreinterpretq_s16_u8(vld1q_u8(p + k * stride));
+        }
+        t01 = vzipq_s16(r[0], r[1]);
+        t23 = vzipq_s16(r[2], r[3]);
+        t45 = vzipq_s16(r[4], r[5]);
+        t67 = vzipq_s16(r[6], r[7]);
+        u0 = vzipq_s32(vreinterpretq_s32_s16(t01.val[0]), vreinterpretq_s32_s16(t23.val[0]));
+        u1 = vzipq_s32(vreinterpretq_s32_s16(t01.val[1]), vreinterpretq_s32_s16(t23.val[1]));
+        v0 = vzipq_s32(vreinterpretq_s32_s16(t45.val[0]), vreinterpretq_s32_s16(t67.val[0]));
+        v1 = vzipq_s32(vreinterpretq_s32_s16(t45.val[1]), vreinterpretq_s32_s16(t67.val[1]));
+        col[0] = vcombine_s16(vget_low_s16(vreinterpretq_s16_s32(u0.val[0])),
+                              vget_low_s16(vreinterpretq_s16_s32(v0.val[0])));
+        col[1] = vcombine_s16(vget_high_s16(vreinterpretq_s16_s32(u0.val[0])),
+                              vget_high_s16(vreinterpretq_s16_s32(v0.val[0])));
+        col[2] = vcombine_s16(vget_low_s16(vreinterpretq_s16_s32(u0.val[1])),
+                              vget_low_s16(vreinterpretq_s16_s32(v0.val[1])));
+        col[3] = vcombine_s16(vget_high_s16(vreinterpretq_s16_s32(u0.val[1])),
+                              vget_high_s16(vreinterpretq_s16_s32(v0.val[1])));
+        col[4] = vcombine_s16(vget_low_s16(vreinterpretq_s16_s32(u1.val[0])),
+                              vget_low_s16(vreinterpretq_s16_s32(v1.val[0])));
+        col[5] = vcombine_s16(vget_high_s16(vreinterpretq_s16_s32(u1.val[0])),
+                              vget_high_s16(vreinterpretq_s16_s32(v1.val[0])));
+        for (c = 0; c < cols; c++)
+        {
+            if (dst[c] != NULL)
+            {
+                vst1q_s16(&dst[c][i], col[c]);
+            }
+        }
+    }
+
+    return i;
+}
+#endif
@@ -0,0 +1,124 @@
+/*!
+ * @file    bmi160_fifo_unpack.h
+ * @brief   Bulk unpacking of header-less BMI160 FIFO data
+ *
+ * In header-less mode every FIFO frame has the same layout, aux (8 bytes),
+ * gyro and accel (3 little endian int16 each) for the enabled sensors, so a
+ * read of n frames is an n by stride byte matrix. These APIs convert a whole
+ * read at once instead of frame by frame:
+ *  - bmi160_fifo_unpack_aos() : into bmi160_sensor_data arrays, as the
+ *                               extract APIs do
+ *  - bmi160_fifo_unpack_soa() : into one int16_t array per axis, the layout
+ *                               filters and codecs want
+ *
+ * The SoA kernel transposes blocks of 8 frames (16 with AVX2) in vector
+ * registers, or pairs of frames with the Cortex-M4 halfword pack
+ * instructions. BMI160_FIFO_UNPACK_KERNEL overrides the choice.
+ */
+
+#ifndef BMI160_FIFO_UNPACK_H_
+#define BMI160_FIFO_UNPACK_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "bmi160.h"
+
+/*! SoA kernels */
+#define BMI160_FIFO_UNPACK_SCALAR  1
+#define BMI160_FIFO_UNPACK_PAIR    2
+#define BMI160_FIFO_UNPACK_SSE2    3
+#define BMI160_FIFO_UNPACK_AVX2    4
+#define BMI160_FIFO_UNPACK_NEON    5
+
+#ifndef BMI160_FIFO_UNPACK_KERNEL
+#if defined(__AVX2__)
+#define BMI160_FIFO_UNPACK_KERNEL  BMI160_FIFO_UNPACK_AVX2
+#elif defined(__SSE2__)
+#define BMI160_FIFO_UNPACK_KERNEL  BMI160_FIFO_UNPACK_SSE2
+#elif defined(__ARM_NEON) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define BMI160_FIFO_UNPACK_KERNEL  BMI160_FIFO_UNPACK_NEON
+#elif defined(__ARM_FEATURE_DSP) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define BMI160_FIFO_UNPACK_KERNEL  BMI160_FIFO_UNPACK_PAIR
+#else
+#define BMI160_FIFO_UNPACK_KERNEL  BMI160_FIFO_UNPACK_SCALAR
+#endif
+#endif
+
+/*!
+ *  @brief This API gives the length of a header-less FIFO frame.
+ *
+ *  @param[in] data_enable : BMI160_FIFO_A/G/M_ENABLE bits, as in
+ *                           bmi160_fifo_frame.fifo_data_enable.
+ *
+ *  @return Frame length in bytes, 0 when no sensor is enabled
+ */
+uint8_t bmi160_fifo_unpack_frame_len(uint8_t data_enable);
+
+/*!
+ *  @brief This API counts the whole frames of a header-less FIFO read,
+ *  up to the empty FIFO marker or a partial frame, as the extract APIs
+ *  parse them.
+ *
+ *  @note bmi160_get_fifo_data reads no more than the fill level, the count
+ *  is then length / frame length and the scan can be skipped. It matters
+ *  for fixed size reads.
+ *
+ *  @param[in] data        : FIFO data.
+ *  @param[in] length      : Number of bytes in data.
+ *  @param[in] data_enable : BMI160_FIFO_A/G/M_ENABLE bits.
+ *
+ *  @return Number of frames
+ */
+size_t bmi160_fifo_unpack_count(const uint8_t *data, size_t length, uint8_t data_enable);
+
+/*!
+ *  @brief This API unpacks "frames" header-less FIFO frames into sensor data
+ *  structures. The sensortime members are left alone.
+ *
+ *  @param[in] data        : FIFO data, frames * frame length bytes.
+ *  @param[in] frames      : Number of frames, see bmi160_fifo_unpack_count.
+ *  @param[in] data_enable : BMI160_FIFO_A/G/M_ENABLE bits.
+ *  @param[out] accel      : "frames" accel samples, NULL to drop them.
+ *  @param[out] gyro       : "frames" gyro samples, NULL to drop them.
+ *  @param[out] aux        : "frames" aux samples, NULL to drop them.
+ *
+ *  @return Result of API execution status
+ *  @retval zero -> Success / -ve value -> Error
+ */
+int8_t bmi160_fifo_unpack_aos(const uint8_t *data,
+                              size_t frames,
+                              uint8_t data_enable,
+                              struct bmi160_sensor_data *accel,
+                              struct bmi160_sensor_data *gyro,
+                              struct bmi160_aux_data *aux);
+
+/*!
+ *  @brief This API appends "frames" header-less FIFO frames to per axis
+ *  arrays. Frames carry no time, the t arrays are left alone.
+ *
+ *  @param[in] data        : FIFO data, frames * frame length bytes.
+ *  @param[in] frames      : Number of frames, see bmi160_fifo_unpack_count.
+ *  @param[in] data_enable : BMI160_FIFO_A/G/M_ENABLE bits.
+ *  @param[in,out] accel   : Accel arrays, NULL to drop accel data.
+ *  @param[in,out] gyro    : Gyro arrays, NULL to drop gyro data.
+ *  @param[out] aux        : "frames" aux samples, NULL to drop them.
+ *
+ *  @return Result of API execution status
+ *  @retval zero -> Success / -ve value -> Error
+ *  @retval BMI160_E_OUT_OF_RANGE -> Not enough room for all frames,
+ *  nothing unpacked
+ */
+int8_t bmi160_fifo_unpack_soa(const uint8_t *data,
+                              size_t frames,
+                              uint8_t data_enable,
+                              struct bmi160_sensor_soa *accel,
+                              struct bmi160_sensor_soa *gyro,
+                              struct bmi160_aux_data *aux);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BMI160_FIFO_UNPACK_H_ */
@@ -0,0 +1,386 @@
+/*!
+ * @file    bmi160_stream.c
+ * @brief   Watermark interrupt driven FIFO streaming for the BMI160
+ */
+
+#include "bmi160_stream.h"
+
+/*********************** Static function declarations ************************/
+
+/*!
+ *  @brief This API reads the streaming clock, 0 without one.
+ *
+ *  @param[in] stream : Structure instance of bmi160_stream.
+ *
+ *  @return Time in microseconds
+ */
+static uint32_t stream_time_us(const struct bmi160_stream *stream);
+
+/*!
+ *  @brief This API enables or disables the FIFO watermark interrupt on the
+ *  configured pin.
+ *
+ *  @param[in] stream : Structure instance of bmi160_stream.
+ *  @param[in] enable : BMI160_ENABLE or BMI160_DISABLE.
+ *
+ *  @return Result of API execution status
+ *  @retval zero -> Success / -ve value -> Error
+ */
+static int8_t set_wtm_int(const struct bmi160_stream *stream, uint8_t enable);
+
+/*!
+ *  @brief This API starts a FIFO read into the free buffer. It runs from
+ *  the watermark interrupt and from the task, whoever claims the read flag
+ *  first starts the read.
+ *
+ *  @param[in,out] stream : Structure instance of bmi160_stream.
+ *
+ *  @return None
+ */
+static void start_read(struct bmi160_stream *stream);
+
+/*!
+ *  @brief This API parses one filled buffer and hands its frames to the
+ *  consumer.
+ *
+ *  @param[in,out] stream  : Structure instance of bmi160_stream.
+ *  @param[in] idx         : Buffer to parse.
+ *  @param[in,out] batches : Number of batches delivered.
+ *
+ *  @return Result of API execution status
+ *  @retval zero -> Success / -ve value -> Error
+ */
+static int8_t parse_buf(struct bmi160_stream *stream, uint8_t idx, uint32_t *batches);
+
+/*********************** User function definitions ****************************/
+
+/*!
+ *  @brief This API sets up the FIFO in header mode with sensor time, sets
+ *  the watermark, flushes the FIFO and enables the watermark interrupt.
+ */
+int8_t bmi160_stream_start(struct bmi160_stream *stream, const struct bmi160_stream_cfg *cfg)
+{
+    int8_t rslt;
+    struct bmi160_dev *dev;
+
+    if ((stream == NULL) || (cfg == NULL) || (cfg->dev == NULL) || (cfg->dev->fifo == NULL) ||
+        (cfg->buf[0] == NULL) || (cfg->buf[1] == NULL) || (cfg->read_async == NULL) || (cfg->on_batch == NULL))
+    {
+        return BMI160_E_NULL_PTR;
+    }
+
+    /* The read must hold the watermark and the sensor time frame */
+    if ((cfg->frames_len == 0) || (cfg->watermark < BMI160_STREAM_WM_UNIT) ||
+        ((cfg->watermark / BMI160_STREAM_WM_UNIT) > UINT8_MAX) ||
+        (cfg->buf_len < (cfg->watermark + BMI160_STREAM_TIME_FRAME_LEN)))
+    {
+        return BMI160_E_OUT_OF_RANGE;
+    }
+
+    memset(stream, 0, sizeof(*stream));
+    stream->cfg = *cfg;
+    dev = cfg->dev;
+
+    rslt = set_wtm_int(stream, BMI160_DISABLE);
+    if (rslt == BMI160_OK)
+    {
+        rslt = bmi160_set_fifo_config(BMI160_FIFO_CONFIG_1_MASK, BMI160_DISABLE, dev);
+    }
+    if (rslt == BMI160_OK)
+    {
+        rslt = bmi160_set_fifo_config(cfg->fifo_config | BMI160_FIFO_HEADER | BMI160_FIFO_TIME, BMI160_ENABLE, dev);
+    }
+    if (rslt == BMI160_OK)
+    {
+        rslt = bmi160_set_fifo_wm((uint8_t)(cfg->watermark / BMI160_STREAM_WM_UNIT), dev);
+    }
+    if (rslt == BMI160_OK)
+    {
+        rslt = bmi160_set_fifo_flush(dev);
+    }
+    if (rslt == BMI160_OK)
+    {
+        stream->running = 1;
+        rslt = set_wtm_int(stream, BMI160_ENABLE);
+        if (rslt != BMI160_OK)
+        {
+            stream->running = 0;
+        }
+    }
+
+    return rslt;
+}
+
+/*!
+ *  @brief This API disables the watermark interrupt.
+ */
+int8_t bmi160_stream_stop(struct bmi160_stream *stream)
+{
+    if ((stream == NULL) || (stream->cfg.dev == NULL))
+    {
+        return BMI160_E_NULL_PTR;
+    }
+
+    stream->running = 0;
+
+    return set_wtm_int(stream, BMI160_DISABLE);
+}
+
+/*!
+ *  @brief This API is called from the watermark interrupt handler.
+ */
+void bmi160_stream_irq(struct bmi160_stream *stream)
+{
+    if ((stream == NULL) || (stream->running == 0))
+    {
+        return;
+    }
+
+    stream->stats.irqs++;
+    start_read(stream);
+}
+
+/*!
+ *  @brief This API is called when the read started by read_async completes.
+ */
+void bmi160_stream_read_done(struct bmi160_stream *stream, int8_t rslt)
+{
+    uint8_t idx;
+
+    if (stream == NULL)
+    {
+        return;
+    }
+
+    idx = stream->fill_idx;
+    if (rslt == BMI160_OK)
+    {
+        /* Data before state, the task parses on READY */
+        BMI160_STREAM_BARRIER();
+        stream->buf_state[idx] = BMI160_STREAM_BUF_READY;
+        stream->fill_idx = (uint8_t)((idx + 1) % BMI160_STREAM_NUM_BUFS);
+    }
+    else
+    {
+        stream->stats.read_errors++;
+        stream->buf_state[idx] = BMI160_STREAM_BUF_FREE;
+    }
+
+    BMI160_STREAM_BARRIER();
+    stream->reading = 0;
+}
+
+/*!
+ *  @brief This API parses the filled buffers and hands their frames to the
+ *  consumer.
+ */
+int8_t bmi160_stream_process(struct bmi160_stream *stream, uint32_t *batches)
+{
+    int8_t rslt = BMI160_OK;
+    uint32_t count = 0;
+    uint8_t idx;
+
+    if ((stream == NULL) || (stream->cfg.dev == NULL))
+    {
+        return BMI160_E_NULL_PTR;
+    }
+
+    while (stream->buf_state[stream->parse_idx] == BMI160_STREAM_BUF_READY)
+    {
+        idx = stream->parse_idx;
+        BMI160_STREAM_BARRIER();
+
+        rslt = parse_buf(stream, idx, &count);
+
+        /* Buffer is handed back even if parsing failed, the data is gone */
+        BMI160_STREAM_BARRIER();
+        stream->buf_state[idx] = BMI160_STREAM_BUF_FREE;
+        stream->parse_idx = (uint8_t)((idx + 1) % BMI160_STREAM_NUM_BUFS);
+        if (rslt != BMI160_OK)
+        {
+            break;
+        }
+    }
+
+    /* A watermark interrupt found no free buffer or a read was short */
+    if (stream->irq_pending && stream->running)
+    {
+        start_read(stream);
+    }
+
+    if (batches != NULL)
+    {
+        *batches = count;
+    }
+
+    return rslt;
+}
+
+/*********************** Static function definitions ****************************/
+
+/*!
+ *  @brief This API reads the streaming clock, 0 without one.
+ */
+static uint32_t stream_time_us(const struct bmi160_stream *stream)
+{
+    return (stream->cfg.time_us != NULL) ? stream->cfg.time_us() : 0;
+}
+
+/*!
+ *  @brief This API enables or disables the FIFO watermark interrupt.
+ */
+static int8_t set_wtm_int(const struct bmi160_stream *stream, uint8_t enable)
+{
+    struct bmi160_int_settg int_config;
+
+    memset(&int_config, 0, sizeof(int_config));
+    int_config.int_channel = stream->cfg.int_channel;
+    int_config.int_type = BMI160_ACC_GYRO_FIFO_WATERMARK_INT;
+    int_config.int_pin_settg = stream->cfg.int_pin_settg;
+    int_config.fifo_WTM_int_en = enable;
+
+    return bmi160_set_int_config(&int_config, stream->cfg.dev);
+}
+
+/*!
+ *  @brief This API starts a FIFO read into the free buffer.
+ */
+static void start_read(struct bmi160_stream *stream)
+{
+    const struct bmi160_dev *dev = stream->cfg.dev;
+    uint8_t reg_addr = BMI160_FIFO_DATA_ADDR;
+    uint8_t idx;
+    int8_t rslt;
+
+    if (!BMI160_STREAM_CLAIM(&stream->reading))
+    {
+        /* The read in flight drains the FIFO, look again after parsing */
+        stream->irq_pending = 1;
+
+        return;
+    }
+
+    idx = stream->fill_idx;
+    if (stream->buf_state[idx] != BMI160_STREAM_BUF_FREE)
+    {
+        /* Both buffers wait for the consumer, the FIFO keeps filling */
+        stream->stats.overruns++;
+        stream->irq_pending = 1;
+        BMI160_STREAM_BARRIER();
+        stream->reading = 0;
+
+        return;
+    }
+
+    stream->irq_pending = 0;
+    stream->buf_state[idx] = BMI160_STREAM_BUF_READING;
+    stream->buf_irq_time[idx] = stream_time_us(stream);
+    stream->stats.reads++;
+
+    if (dev->interface == BMI160_SPI_INTF)
+    {
+        /* SPI read mask */
+        reg_addr = reg_addr | BMI160_SPI_RD_MASK;
+    }
+
+    rslt = stream->cfg.read_async(dev->id, reg_addr, stream->cfg.buf[idx], stream->cfg.buf_len, stream->cfg.ctx);
+    if (rslt != BMI160_OK)
+    {
+        stream->stats.read_errors++;
+        stream->buf_state[idx] = BMI160_STREAM_BUF_FREE;
+        BMI160_STREAM_BARRIER();
+        stream->reading = 0;
+    }
+}
+
+/*!
+ *  @brief This API parses one filled buffer and hands its frames to the
+ *  consumer, in as many batches as the output arrays need.
+ */
+static int8_t parse_buf(struct bmi160_stream *stream, uint8_t idx, uint32_t *batches)
+{
+    struct bmi160_fifo_frame *fifo = stream->cfg.dev->fifo;
+    struct bmi160_stream_batch batch;
+    uint32_t frames;
+    uint32_t latency;
+    uint8_t first = 1;
+    uint8_t drained = 0;
+    int8_t rslt = BMI160_OK;
+
+    fifo->data = stream->cfg.buf[idx];
+    fifo->length = stream->cfg.buf_len;
+    fifo->accel_byte_start_idx = 0;
+    fifo->gyro_byte_start_idx = 0;
+    fifo->aux_byte_start_idx = 0;
+    fifo->skipped_frame_count = 0;
+
+    batch.irq_time_us = stream->buf_irq_time[idx];
+    batch.read_seq = stream->read_seq++;
+
+    while (fifo->accel_byte_start_idx < fifo->length)
+    {
+        batch.frames.accel = stream->cfg.accel;
+        batch.frames.gyro = stream->cfg.gyro;
+        batch.frames.aux = stream->cfg.aux;
+        batch.frames.accel_len = stream->cfg.frames_len;
+        batch.frames.gyro_len = stream->cfg.frames_len;
+        batch.frames.aux_len = stream->cfg.frames_len;
+
+        rslt = bmi160_fifo_demux(&batch.frames, stream->cfg.dev);
+        if (rslt != BMI160_OK)
+        {
+            break;
+        }
+
+        /* Lengths of dropped sensors are meaningless, clear them */
+        if (batch.frames.accel == NULL)
+        {
+            batch.frames.accel_len = 0;
+        }
+        if (batch.frames.gyro == NULL)
+        {
+            batch.frames.gyro_len = 0;
+        }
+        if (batch.frames.aux == NULL)
+        {
+            batch.frames.aux_len = 0;
+        }
+
+        frames = (uint32_t)batch.frames.accel_len + batch.frames.gyro_len + batch.frames.aux_len;
+        stream->stats.skipped_frames += batch.frames.skipped_frame_count;
+        drained |= batch.frames.sensor_time_valid;
+        if ((frames == 0) && (batch.frames.sensor_time_valid == 0))
+        {
+            break;
+        }
+
+        if (first)
+        {
+            latency = stream_time_us(stream) - batch.irq_time_us;
+            stream->stats.latency_last_us = latency;
+            stream->stats.latency_sum_us += latency;
+            if (latency > stream->stats.latency_max_us)
+            {
+                stream->stats.latency_max_us = latency;
+            }
+            first = 0;
+        }
+
+        stream->stats.batches++;
+        stream->stats.accel_frames += batch.frames.accel_len;
+        stream->stats.gyro_frames += batch.frames.gyro_len;
+        stream->stats.aux_frames += batch.frames.aux_len;
+        (*batches)++;
+
+        stream->cfg.on_batch(stream, &batch, stream->cfg.ctx);
+    }
+
+    if ((rslt == BMI160_OK) && (drained == 0))
+    {
+        /* More in the FIFO, read again from bmi160_stream_process */
+        stream->stats.undrained_reads++;
+        stream->irq_pending = 1;
+    }
+
+    return rslt;
+}
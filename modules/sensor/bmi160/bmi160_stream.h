@@ -0,0 +1,242 @@
+/*!
+ * @file    bmi160_stream.h
+ * @brief   Watermark interrupt driven FIFO streaming for the BMI160
+ *
+ * The FIFO runs in header mode with sensor time. Every watermark interrupt
+ * starts one asynchronous burst read of the FIFO into the free half of a
+ * double buffer, without reading the fill level first. Bytes past the fill
+ * level read as over-read frames and are ignored, and partially read frames
+ * are repeated by the sensor on the next read. The task side parses filled
+ * buffers with bmi160_fifo_demux() and hands the frames to the consumer in
+ * batches, so the CPU only wakes for the interrupt, the DMA completion and
+ * the parsing.
+ *
+ * bmi160_stream_irq() and bmi160_stream_read_done() run in interrupt
+ * context; bmi160_stream_process() and everything else belong to the task.
+ */
+
+#ifndef BMI160_STREAM_H_
+#define BMI160_STREAM_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "bmi160.h"
+
+/*! Halves of the read buffer */
+#define BMI160_STREAM_NUM_BUFS        UINT8_C(2)
+
+/*! FIFO_CONFIG_0 counts the watermark in 4 byte words */
+#define BMI160_STREAM_WM_UNIT         UINT8_C(4)
+
+/*! Header and data of the sensor time frame ending every read */
+#define BMI160_STREAM_TIME_FRAME_LEN  UINT8_C(4)
+
+/*! Buffer states */
+#define BMI160_STREAM_BUF_FREE        UINT8_C(0)
+#define BMI160_STREAM_BUF_READING     UINT8_C(1)
+#define BMI160_STREAM_BUF_READY       UINT8_C(2)
+
+/*! Claims a flag shared between interrupt and task, 1 on success */
+#ifndef BMI160_STREAM_CLAIM
+#define BMI160_STREAM_CLAIM(flag)     __sync_bool_compare_and_swap((flag), 0, 1)
+#endif
+
+/*! Ordering between buffer contents and state updates */
+#ifndef BMI160_STREAM_BARRIER
+#define BMI160_STREAM_BARRIER()       __sync_synchronize()
+#endif
+
+/*!
+ * @brief Starts an asynchronous burst read of len bytes from reg_addr into
+ * data. Completion is reported through bmi160_stream_read_done().
+ */
+typedef int8_t (*bmi160_stream_read_fptr_t)(uint8_t dev_id, uint8_t reg_addr, uint8_t *data, uint16_t len, void *ctx);
+
+/*!
+ * @brief Batch of frames handed to the consumer
+ */
+struct bmi160_stream_batch
+{
+    /*! Frames, sensor time and skipped frame count of the batch */
+    struct bmi160_fifo_demux frames;
+
+    /*! Time of the watermark interrupt that drained these frames */
+    uint32_t irq_time_us;
+
+    /*! Number of the FIFO read, a read larger than the output arrays is
+     *  delivered as several batches with the same number */
+    uint32_t read_seq;
+};
+
+struct bmi160_stream;
+
+/*!
+ * @brief Consumer callback, runs in bmi160_stream_process()
+ */
+typedef void (*bmi160_stream_batch_fptr_t)(struct bmi160_stream *stream, const struct bmi160_stream_batch *batch,
+                                           void *ctx);
+
+/*!
+ * @brief Streaming configuration
+ */
+struct bmi160_stream_cfg
+{
+    /*! Sensor, its fifo structure is used for parsing */
+    struct bmi160_dev *dev;
+
+    /*! BMI160_FIFO_ACCEL, BMI160_FIFO_GYRO and/or BMI160_FIFO_AUX, header
+     *  and time are always enabled */
+    uint8_t fifo_config;
+
+    /*! Watermark in bytes, rounded down to whole words */
+    uint16_t watermark;
+
+    /*! Interrupt pin carrying the watermark interrupt */
+    enum bmi160_int_channel int_channel;
+    struct bmi160_int_pin_settg int_pin_settg;
+
+    /*! Read buffers. Each read fetches buf_len bytes: the watermark, what
+     *  arrives until the read starts, and the sensor time frame */
+    uint8_t *buf[BMI160_STREAM_NUM_BUFS];
+    uint16_t buf_len;
+
+    /*! Output arrays of frames_len entries, NULL for a disabled sensor */
+    struct bmi160_sensor_data *accel;
+    struct bmi160_sensor_data *gyro;
+    struct bmi160_aux_data *aux;
+    uint8_t frames_len;
+
+    /*! Asynchronous FIFO read */
+    bmi160_stream_read_fptr_t read_async;
+
+    /*! Microsecond clock for the latency statistics, may be NULL */
+    uint32_t (*time_us)(void);
+
+    /*! Consumer */
+    bmi160_stream_batch_fptr_t on_batch;
+
+    /*! Passed to read_async and on_batch */
+    void *ctx;
+};
+
+/*!
+ * @brief Streaming statistics
+ */
+struct bmi160_stream_stats
+{
+    /*! Interrupt side */
+    uint32_t irqs;
+    uint32_t reads;
+    uint32_t read_errors;
+
+    /*! Interrupts that found both buffers waiting for the consumer */
+    uint32_t overruns;
+
+    /*! Task side */
+    uint32_t batches;
+    uint32_t accel_frames;
+    uint32_t gyro_frames;
+    uint32_t aux_frames;
+
+    /*! Frames the sensor dropped on a full FIFO, from its skip frames */
+    uint32_t skipped_frames;
+
+    /*! Reads without the sensor time frame, which the sensor only appends
+     *  once the FIFO is empty: buf_len is short for the interrupt latency */
+    uint32_t undrained_reads;
+
+    /*! Watermark interrupt to the first batch of its read */
+    uint32_t latency_last_us;
+    uint32_t latency_max_us;
+    uint64_t latency_sum_us;
+};
+
+/*!
+ * @brief Streaming engine state
+ */
+struct bmi160_stream
+{
+    struct bmi160_stream_cfg cfg;
+
+    /*! BMI160_STREAM_BUF_* per buffer */
+    volatile uint8_t buf_state[BMI160_STREAM_NUM_BUFS];
+    volatile uint32_t buf_irq_time[BMI160_STREAM_NUM_BUFS];
+
+    /*! Buffer the next read goes to, and the next one to parse */
+    volatile uint8_t fill_idx;
+    uint8_t parse_idx;
+
+    /*! Set while a read is in flight */
+    volatile uint8_t reading;
+
+    /*! A watermark interrupt could not start a read, or the last read left
+     *  data behind; an edge triggered pin would not fire again */
+    volatile uint8_t irq_pending;
+
+    volatile uint8_t running;
+    uint32_t read_seq;
+    struct bmi160_stream_stats stats;
+};
+
+/*!
+ *  @brief This API sets up the FIFO in header mode with sensor time, sets
+ *  the watermark, flushes the FIFO and enables the watermark interrupt.
+ *
+ *  @param[in,out] stream : Structure instance of bmi160_stream.
+ *  @param[in] cfg        : Structure instance of bmi160_stream_cfg.
+ *
+ *  @return Result of API execution status
+ *  @retval zero -> Success / -ve value -> Error
+ */
+int8_t bmi160_stream_start(struct bmi160_stream *stream, const struct bmi160_stream_cfg *cfg);
+
+/*!
+ *  @brief This API disables the watermark interrupt. A read in flight still
+ *  completes and its data can be processed.
+ *
+ *  @param[in,out] stream : Structure instance of bmi160_stream.
+ *
+ *  @return Result of API execution status
+ *  @retval zero -> Success / -ve value -> Error
+ */
+int8_t bmi160_stream_stop(struct bmi160_stream *stream);
+
+/*!
+ *  @brief This API is called from the watermark interrupt handler. It
+ *  starts a FIFO read into the free buffer, if there is one.
+ *
+ *  @param[in,out] stream : Structure instance of bmi160_stream.
+ *
+ *  @return None
+ */
+void bmi160_stream_irq(struct bmi160_stream *stream);
+
+/*!
+ *  @brief This API is called when the read started by read_async completes.
+ *
+ *  @param[in,out] stream : Structure instance of bmi160_stream.
+ *  @param[in] rslt       : Result of the read, BMI160_OK on success.
+ *
+ *  @return None
+ */
+void bmi160_stream_read_done(struct bmi160_stream *stream, int8_t rslt);
+
+/*!
+ *  @brief This API parses the filled buffers and hands their frames to the
+ *  consumer, then restarts a read a watermark interrupt had to leave out.
+ *
+ *  @param[in,out] stream : Structure instance of bmi160_stream.
+ *  @param[out] batches   : Number of batches delivered, may be NULL.
+ *
+ *  @return Result of API execution status
+ *  @retval zero -> Success / -ve value -> Error
+ */
+int8_t bmi160_stream_process(struct bmi160_stream *stream, uint32_t *batches);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BMI160_STREAM_H_ */
@@ -0,0 +1,307 @@
+/*!
+ * @file    bmi160_ts.c
+ * @brief   Per sample timestamps for BMI160 FIFO data
+ */
+
+#include "bmi160_ts.h"
+
+/*********************** Static function declarations ************************/
+
+/*!
+ *  @brief This API converts sensor ticks to nanoseconds.
+ *
+ *  @param[in] ticks : Sensor time in ticks.
+ *
+ *  @return Sensor time in ns
+ */
+static inline uint64_t ticks_to_ns(uint64_t ticks);
+
+/*!
+ *  @brief This API gives the sample period of an ODR register code.
+ *
+ *  @param[in] odr     : ODR code, 0 for a sensor that is off.
+ *  @param[out] period : Period in ticks, 0 for a sensor that is off.
+ *
+ *  @return Result of API execution status
+ *  @retval zero -> Success / -ve value -> Error
+ */
+static int8_t odr_period(uint8_t odr, uint32_t *period);
+
+/*!
+ *  @brief This API stamps the samples of one sensor in a batch.
+ *
+ *  @param[in,out] ts     : Structure instance of bmi160_ts.
+ *  @param[in,out] sensor : Structure instance of bmi160_ts_sensor.
+ *  @param[in] len        : Samples of the sensor in the batch.
+ *  @param[out] out       : Timestamps, may be NULL.
+ *  @param[in] anchored   : The batch has a sensor time frame.
+ *  @param[in] skip_ticks : Time of the frames skipped ahead of the batch.
+ *
+ *  @return None
+ */
+static void stamp_sensor(struct bmi160_ts *ts,
+                         struct bmi160_ts_sensor *sensor,
+                         size_t len,
+                         uint64_t *out,
+                         uint8_t anchored,
+                         uint64_t skip_ticks);
+
+/*!
+ *  @brief This API updates the drift estimate with the host time of a read
+ *  and its sensor time frame.
+ *
+ *  @param[in,out] ts   : Structure instance of bmi160_ts.
+ *  @param[in] host_ns  : Host time of the read.
+ *
+ *  @return None
+ */
+static void update_drift(struct bmi160_ts *ts, uint64_t host_ns);
+
+/*********************** User function definitions ****************************/
+
+/*!
+ *  @brief This API sets up the timestamp stage for the ODRs configured in
+ *  dev.
+ */
+int8_t bmi160_ts_init(struct bmi160_ts *ts, const struct bmi160_dev *dev)
+{
+    int8_t rslt;
+
+    if ((ts == NULL) || (dev == NULL))
+    {
+        return BMI160_E_NULL_PTR;
+    }
+
+    memset(ts, 0, sizeof(*ts));
+    ts->drift_span_ns = (uint64_t)BMI160_TS_DRIFT_SPAN_MS * 1000000ULL;
+
+    rslt = odr_period(dev->accel_cfg.odr, &ts->accel.period);
+    if (rslt == BMI160_OK)
+    {
+        rslt = odr_period(dev->gyro_cfg.odr, &ts->gyro.period);
+    }
+    if (rslt == BMI160_OK)
+    {
+        rslt = odr_period(dev->aux_cfg.aux_odr, &ts->aux.period);
+    }
+
+    return rslt;
+}
+
+/*!
+ *  @brief This API stamps the samples of one batch and updates the drift
+ *  estimate.
+ */
+int8_t bmi160_ts_stamp(struct bmi160_ts *ts, struct bmi160_ts_batch *batch)
+{
+    uint32_t raw;
+    uint32_t min_period = 0;
+    uint64_t skip_ticks;
+
+    if ((ts == NULL) || (batch == NULL))
+    {
+        return BMI160_E_NULL_PTR;
+    }
+
+    if (((batch->accel_len != 0) && (ts->accel.period == 0)) || ((batch->gyro_len != 0) && (ts->gyro.period == 0)) ||
+        ((batch->aux_len != 0) && (ts->aux.period == 0)))
+    {
+        return BMI160_E_INVALID_INPUT;
+    }
+
+    if (batch->sensor_time_valid)
+    {
+        raw = batch->sensor_time & BMI160_TS_TICK_MASK;
+        if (ts->ticks_valid)
+        {
+            ts->ticks += (raw - ts->last_raw) & BMI160_TS_TICK_MASK;
+        }
+        else
+        {
+            ts->ticks = raw;
+            ts->ticks_valid = 1;
+        }
+        ts->last_raw = raw;
+    }
+
+    /* Skip frames count frames of the fastest sensor */
+    if (ts->accel.period != 0)
+    {
+        min_period = ts->accel.period;
+    }
+    if ((ts->gyro.period != 0) && ((min_period == 0) || (ts->gyro.period < min_period)))
+    {
+        min_period = ts->gyro.period;
+    }
+    if ((ts->aux.period != 0) && ((min_period == 0) || (ts->aux.period < min_period)))
+    {
+        min_period = ts->aux.period;
+    }
+    skip_ticks = (uint64_t)batch->skipped_frames * min_period;
+
+    stamp_sensor(ts, &ts->accel, batch->accel_len, batch->accel_t, batch->sensor_time_valid, skip_ticks);
+    stamp_sensor(ts, &ts->gyro, batch->gyro_len, batch->gyro_t, batch->sensor_time_valid, skip_ticks);
+    stamp_sensor(ts, &ts->aux, batch->aux_len, batch->aux_t, batch->sensor_time_valid, skip_ticks);
+
+    if (batch->sensor_time_valid && (batch->host_time_ns != 0))
+    {
+        update_drift(ts, batch->host_time_ns);
+    }
+
+    return BMI160_OK;
+}
+
+/*!
+ *  @brief This API converts a timestamp on the sensor clock to the host
+ *  clock.
+ */
+uint64_t bmi160_ts_to_host(const struct bmi160_ts *ts, uint64_t sensor_ns)
+{
+    int64_t delta;
+
+    if ((ts == NULL) || !ts->ref_valid)
+    {
+        return sensor_ns;
+    }
+
+    /* Microseconds first, keeps the product in range for hours of delta */
+    delta = (int64_t)(sensor_ns - ts->ref_sensor_ns);
+
+    return ts->ref_host_ns + (uint64_t)(delta + (delta / 1000) * ts->drift_ppb / 1000000);
+}
+
+/*********************** Static function definitions ****************************/
+
+/*!
+ *  @brief This API converts sensor ticks to nanoseconds.
+ */
+static inline uint64_t ticks_to_ns(uint64_t ticks)
+{
+    return ticks * BMI160_TS_TICK_NS_NUM / BMI160_TS_TICK_NS_DEN;
+}
+
+/*!
+ *  @brief This API gives the sample period of an ODR register code.
+ */
+static int8_t odr_period(uint8_t odr, uint32_t *period)
+{
+    int8_t rslt = BMI160_OK;
+
+    if (odr == 0)
+    {
+        *period = 0;
+    }
+    else if (odr < BMI160_TS_ODR_TICK_CODE)
+    {
+        *period = UINT32_C(1) << (BMI160_TS_ODR_TICK_CODE - odr);
+    }
+    else
+    {
+        rslt = BMI160_E_INVALID_INPUT;
+    }
+
+    return rslt;
+}
+
+/*!
+ *  @brief This API stamps the samples of one sensor in a batch.
+ */
+static void stamp_sensor(struct bmi160_ts *ts,
+                         struct bmi160_ts_sensor *sensor,
+                         size_t len,
+                         uint64_t *out,
+                         uint8_t anchored,
+                         uint64_t skip_ticks)
+{
+    uint64_t expected = 0;
+    uint64_t first;
+    uint64_t back;
+    size_t i;
+
+    if (len == 0)
+    {
+        return;
+    }
+
+    /* Where the batch starts if nothing was lost on the way */
+    if (sensor->started)
+    {
+        expected = sensor->last + sensor->period + (skip_ticks / sensor->period) * sensor->period;
+    }
+    else if (ts->ticks_valid)
+    {
+        expected = (ts->ticks / sensor->period) * sensor->period;
+    }
+    first = expected;
+
+    /* The last sample sits on the sensor time, rounded down to the period */
+    back = (uint64_t)(len - 1) * sensor->period;
+    if (anchored && (((ts->ticks / sensor->period) * sensor->period) >= back))
+    {
+        first = (ts->ticks / sensor->period) * sensor->period - back;
+        if (sensor->started && (first <= sensor->last))
+        {
+            /* Time would run backwards, keep counting instead */
+            ts->resyncs++;
+            first = expected;
+        }
+        else if (sensor->started && (first > expected))
+        {
+            ts->lost_samples += (uint32_t)((first - expected) / sensor->period);
+        }
+    }
+
+    if (out != NULL)
+    {
+        for (i = 0; i < len; i++)
+        {
+            out[i] = ticks_to_ns(first + (uint64_t)i * sensor->period);
+        }
+    }
+    sensor->last = first + back;
+    sensor->started = 1;
+}
+
+/*!
+ *  @brief This API updates the drift estimate with the host time of a read.
+ */
+static void update_drift(struct bmi160_ts *ts, uint64_t host_ns)
+{
+    uint64_t sensor_ns = ticks_to_ns(ts->ticks);
+    uint64_t span;
+    uint64_t predicted;
+    int64_t measured;
+
+    if (!ts->ref_valid)
+    {
+        ts->ref_sensor_ns = sensor_ns;
+        ts->ref_host_ns = host_ns;
+        ts->ref_valid = 1;
+
+        return;
+    }
+
+    span = sensor_ns - ts->ref_sensor_ns;
+    if ((span < ts->drift_span_ns) || (span < 1000))
+    {
+        return;
+    }
+
+    /* Host ns gained per sensor s, in ppb, over the span */
+    measured = ((int64_t)(host_ns - ts->ref_host_ns) - (int64_t)span) * 1000000 / (int64_t)(span / 1000);
+    predicted = bmi160_ts_to_host(ts, sensor_ns);
+    if (ts->drift_valid)
+    {
+        ts->drift_ppb += (int32_t)((measured - ts->drift_ppb) / (1 << BMI160_TS_DRIFT_IIR_SHIFT));
+
+        /* Move the reference along the prediction, read jitter averages out */
+        ts->ref_host_ns = predicted + (uint64_t)((int64_t)(host_ns - predicted) / (1 << BMI160_TS_DRIFT_IIR_SHIFT));
+    }
+    else
+    {
+        ts->drift_ppb = (int32_t)measured;
+        ts->drift_valid = 1;
+        ts->ref_host_ns = host_ns;
+    }
+    ts->ref_sensor_ns = sensor_ns;
+}
@@ -0,0 +1,157 @@
+/*!
+ * @file    bmi160_ts.h
+ * @brief   Per sample timestamps for BMI160 FIFO data
+ *
+ * FIFO frames carry no time. A drained FIFO read ends with a sensor time
+ * frame, 24 bits of 39.0625 us ticks, and samples of a sensor running at
+ * some ODR are taken on multiples of its period in ticks. The stage keeps
+ * a 64-bit unwrapped sensor time and, per batch:
+ *  - anchors the last sample of every sensor on the sensor time frame,
+ *    rounded down to its period, and counts back from there
+ *  - without a sensor time frame, the read left data behind, continues
+ *    from the previous batch, over the frames the sensor skipped
+ *  - keeps every sensor monotonic, and counts the samples it finds lost
+ *
+ * Timestamps are nanoseconds on the sensor clock. Given the host time of
+ * each FIFO read, the stage also tracks the drift between the host and
+ * the sensor clock, and bmi160_ts_to_host() moves timestamps to the host
+ * clock, to line them up with other sensors.
+ */
+
+#ifndef BMI160_TS_H_
+#define BMI160_TS_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "bmi160.h"
+
+/*! Sensor time: 24 bits of 39.0625 us, 25.6 kHz */
+#define BMI160_TS_TICK_MASK          UINT32_C(0x00FFFFFF)
+#define BMI160_TS_TICK_NS_NUM        UINT32_C(78125)
+#define BMI160_TS_TICK_NS_DEN        UINT32_C(2)
+
+/*! ODR code with a period of one tick, period = 1 << (16 - code) ticks */
+#define BMI160_TS_ODR_TICK_CODE      UINT8_C(16)
+
+/*! Default span between two drift measurements */
+#define BMI160_TS_DRIFT_SPAN_MS      UINT32_C(10000)
+
+/*! Weight of a new drift measurement, 1 / (1 << shift) */
+#define BMI160_TS_DRIFT_IIR_SHIFT    UINT8_C(2)
+
+/*!
+ * @brief Timing of one sensor
+ */
+struct bmi160_ts_sensor
+{
+    /*! Sample period in ticks, 0 for a sensor that is off */
+    uint32_t period;
+
+    /*! Tick of the last sample stamped */
+    uint64_t last;
+
+    /*! Set once a sample was stamped */
+    uint8_t started;
+};
+
+/*!
+ * @brief One batch of FIFO samples to stamp
+ */
+struct bmi160_ts_batch
+{
+    /*! Samples per sensor in the batch */
+    size_t accel_len;
+    size_t gyro_len;
+    size_t aux_len;
+
+    /*! Timestamps out, NULL if not wanted */
+    uint64_t *accel_t;
+    uint64_t *gyro_t;
+    uint64_t *aux_t;
+
+    /*! Sensor time frame of the batch, as bmi160_fifo_demux/batch_parse
+     *  give it */
+    uint32_t sensor_time;
+    uint8_t sensor_time_valid;
+
+    /*! Frames the sensor dropped ahead of the batch */
+    size_t skipped_frames;
+
+    /*! Host clock in ns when the FIFO read started, 0 if not known */
+    uint64_t host_time_ns;
+};
+
+/*!
+ * @brief Timestamp stage state
+ */
+struct bmi160_ts
+{
+    struct bmi160_ts_sensor accel;
+    struct bmi160_ts_sensor gyro;
+    struct bmi160_ts_sensor aux;
+
+    /*! Unwrapped sensor time of the last sensor time frame */
+    uint64_t ticks;
+    uint32_t last_raw;
+    uint8_t ticks_valid;
+
+    /*! Drift reference point and estimate, host = sensor * (1 + ppb / 1e9) */
+    uint64_t ref_sensor_ns;
+    uint64_t ref_host_ns;
+    uint8_t ref_valid;
+    int32_t drift_ppb;
+    uint8_t drift_valid;
+
+    /*! Sensor time between two drift measurements */
+    uint64_t drift_span_ns;
+
+    /*! Samples missing between batches, by the sensor time */
+    uint32_t lost_samples;
+
+    /*! Batches whose sensor time would have made time run backwards */
+    uint32_t resyncs;
+};
+
+/*!
+ *  @brief This API sets up the timestamp stage for the accel, gyro and aux
+ *  ODRs configured in dev. Call again after changing an ODR.
+ *
+ *  @param[out] ts : Structure instance of bmi160_ts.
+ *  @param[in] dev : Structure instance of bmi160_dev.
+ *
+ *  @return Result of API execution status
+ *  @retval zero -> Success / -ve value -> Error
+ */
+int8_t bmi160_ts_init(struct bmi160_ts *ts, const struct bmi160_dev *dev);
+
+/*!
+ *  @brief This API stamps the samples of one batch, in FIFO order, and
+ *  updates the drift estimate.
+ *
+ *  @param[in,out] ts    : Structure instance of bmi160_ts.
+ *  @param[in,out] batch : Structure instance of bmi160_ts_batch.
+ *
+ *  @return Result of API execution status
+ *  @retval zero -> Success / -ve value -> Error
+ */
+int8_t bmi160_ts_stamp(struct bmi160_ts *ts, struct bmi160_ts_batch *batch);
+
+/*!
+ *  @brief This API converts a timestamp on the sensor clock to the host
+ *  clock, with the drift estimate. Without a host time yet, the timestamp
+ *  is returned as is.
+ *
+ *  @param[in] ts        : Structure instance of bmi160_ts.
+ *  @param[in] sensor_ns : Timestamp from bmi160_ts_stamp.
+ *
+ *  @return Host clock in ns
+ */
+uint64_t bmi160_ts_to_host(const struct bmi160_ts *ts, uint64_t sensor_ns);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BMI160_TS_H_ */
@@ -0,0 +1,633 @@
+/*!
+ * @file    bmm150.c
+ * @brief   BMM150 magnetometer driver on the BMI160 auxiliary interface
+ */
+
+#include "bmm150.h"
+
+/* Below table follows the enum bmm150_wait: time in us for delay_us, and
+ * in ms for delay_ms of the BMI160
+ */
+static const struct
+{
+    uint32_t us;
+    uint8_t ms;
+} wait_table[BMM150_WAIT_COUNT] = {
+    { BMM150_START_UP_DELAY_US, BMM150_START_UP_DELAY_MS },
+    { BMM150_SOFT_RESET_DELAY_US, BMM150_SOFT_RESET_DELAY_MS }
+};
+
+/*********************** Static function declarations ************************/
+
+/*!
+ *  @brief This API checks the device structure and the BMI160 it uses for
+ *  null pointers.
+ *
+ *  @param[in] dev : Structure instance of bmm150_dev.
+ *
+ *  @return Result of API execution status
+ *  @retval zero -> Success / -ve value -> Error
+ */
+static int8_t null_ptr_check(const struct bmm150_dev *dev);
+
+/*!
+ *  @brief This API reads BMM150 registers through the BMI160 manual mode.
+ *
+ *  @param[in] reg_addr : BMM150 register address.
+ *  @param[out] data    : Data read.
+ *  @param[in] len      : No of bytes to read.
+ *  @param[in] dev      : Structure instance of bmm150_dev.
+ *
+ *  @return Result of API execution status
+ *  @retval zero -> Success / -ve value -> Error
+ */
+static int8_t aux_read(uint8_t reg_addr, uint8_t *data, uint16_t len, const struct bmm150_dev *dev);
+
+/*!
+ *  @brief This API writes BMM150 registers through the BMI160 manual mode.
+ *
+ *  @param[in] reg_addr : BMM150 register address.
+ *  @param[in] data     : Data to write.
+ *  @param[in] len      : No of bytes to write.
+ *  @param[in] dev      : Structure instance of bmm150_dev.
+ *
+ *  @return Result of API execution status
+ *  @retval zero -> Success / -ve value -> Error
+ */
+static int8_t aux_write(uint8_t reg_addr, uint8_t *data, uint16_t len, const struct bmm150_dev *dev);
+
+/*!
+ *  @brief This API waits, through delay_us of the BMI160 when set and
+ *  delay_ms otherwise.
+ *
+ *  @param[in] wait : Wait from enum bmm150_wait.
+ *  @param[in] dev  : Structure instance of bmm150_dev.
+ *
+ *  @return None
+ */
+static void delay_wait(enum bmm150_wait wait, const struct bmm150_dev *dev);
+
+/*!
+ *  @brief This API reads the trim registers.
+ *
+ *  @param[in,out] dev : Structure instance of bmm150_dev.
+ *
+ *  @return Result of API execution status
+ *  @retval zero -> Success / -ve value -> Error
+ */
+static int8_t read_trim(struct bmm150_dev *dev);
+
+/*!
+ *  @brief This API writes the repetition registers.
+ *
+ *  @param[in] rep_xy : XY repetition register value.
+ *  @param[in] rep_z  : Z repetition register value.
+ *  @param[in] dev    : Structure instance of bmm150_dev.
+ *
+ *  @return Result of API execution status
+ *  @retval zero -> Success / -ve value -> Error
+ */
+static int8_t write_rep(uint8_t rep_xy, uint8_t rep_z, const struct bmm150_dev *dev);
+
+/*!
+ *  @brief This API gives the period of a BMI160 aux ODR code.
+ *
+ *  @param[in] aux_odr : BMI160_AUX_ODR_0_78HZ to BMI160_AUX_ODR_800HZ.
+ *
+ *  @return Period in us, 0 for a reserved code
+ */
+static uint32_t aux_odr_period(uint8_t aux_odr);
+
+/*!
+ *  @brief This API compensates the X or Y axis.
+ *
+ *  @param[in] raw   : Raw axis data.
+ *  @param[in] rhall : Raw hall resistance.
+ *  @param[in] dig_1 : dig_x1 or dig_y1.
+ *  @param[in] dig_2 : dig_x2 or dig_y2.
+ *  @param[in] trim  : Structure instance of bmm150_trim.
+ *
+ *  @return Field in 1 / BMM150_LSB_PER_UT uT
+ */
+static int16_t compensate_xy(int16_t raw,
+                             uint16_t rhall,
+                             int8_t dig_1,
+                             int8_t dig_2,
+                             const struct bmm150_trim *trim);
+
+/*!
+ *  @brief This API compensates the Z axis.
+ *
+ *  @param[in] raw   : Raw axis data.
+ *  @param[in] rhall : Raw hall resistance.
+ *  @param[in] trim  : Structure instance of bmm150_trim.
+ *
+ *  @return Field in 1 / BMM150_LSB_PER_UT uT
+ */
+static int16_t compensate_z(int16_t raw, uint16_t rhall, const struct bmm150_trim *trim);
+
+/*********************** User function definitions ****************************/
+
+/*!
+ *  @brief This API sets up the auxiliary interface, powers the BMM150 on,
+ *  checks its chip id, reads the trim registers and selects the regular
+ *  preset.
+ */
+int8_t bmm150_init(struct bmm150_dev *dev)
+{
+    int8_t rslt;
+    uint8_t data = BMM150_POWER_ON;
+
+    rslt = null_ptr_check(dev);
+    if (rslt == BMM150_OK)
+    {
+        dev->bmi->aux_cfg.aux_sensor_enable = BMI160_ENABLE;
+        dev->bmi->aux_cfg.manual_enable = BMI160_ENABLE;
+        dev->bmi->aux_cfg.aux_rd_burst_len = BMI160_AUX_READ_LEN_3;
+        if (dev->bmi->aux_cfg.aux_i2c_addr == 0)
+        {
+            dev->bmi->aux_cfg.aux_i2c_addr = BMM150_I2C_ADDR;
+        }
+        rslt = (bmi160_aux_init(dev->bmi) == BMI160_OK) ? BMM150_OK : BMM150_E_COM_FAIL;
+    }
+    if (rslt == BMM150_OK)
+    {
+        /* Suspend to sleep mode */
+        rslt = aux_write(BMM150_POWER_CONTROL_ADDR, &data, 1, dev);
+        delay_wait(BMM150_WAIT_START_UP, dev);
+    }
+    if (rslt == BMM150_OK)
+    {
+        dev->chip_id = 0;
+        rslt = aux_read(BMM150_CHIP_ID_ADDR, &dev->chip_id, 1, dev);
+        if ((rslt == BMM150_OK) && (dev->chip_id != BMM150_CHIP_ID))
+        {
+            rslt = BMM150_E_DEV_NOT_FOUND;
+        }
+    }
+    if (rslt == BMM150_OK)
+    {
+        rslt = read_trim(dev);
+    }
+    if (rslt == BMM150_OK)
+    {
+        rslt = bmm150_set_preset(BMM150_PRESET_REGULAR, dev);
+    }
+
+    return rslt;
+}
+
+/*!
+ *  @brief This API resets the BMM150 and powers it on again.
+ */
+int8_t bmm150_soft_reset(struct bmm150_dev *dev)
+{
+    int8_t rslt;
+    uint8_t data = BMM150_SOFT_RESET;
+
+    rslt = null_ptr_check(dev);
+    if ((rslt == BMM150_OK) && (dev->bmi->aux_cfg.manual_enable != BMI160_ENABLE))
+    {
+        rslt = BMM150_E_INVALID_CONFIG;
+    }
+    if (rslt == BMM150_OK)
+    {
+        rslt = aux_write(BMM150_POWER_CONTROL_ADDR, &data, 1, dev);
+        delay_wait(BMM150_WAIT_SOFT_RESET, dev);
+    }
+    if (rslt == BMM150_OK)
+    {
+        rslt = write_rep(dev->rep_xy, dev->rep_z, dev);
+    }
+
+    return rslt;
+}
+
+/*!
+ *  @brief This API sets the repetitions of a preset.
+ */
+int8_t bmm150_set_preset(uint8_t preset, struct bmm150_dev *dev)
+{
+    int8_t rslt;
+    uint8_t rep_xy = 0;
+    uint8_t rep_z = 0;
+
+    rslt = null_ptr_check(dev);
+    if (rslt == BMM150_OK)
+    {
+        switch (preset)
+        {
+            case BMM150_PRESET_LOWPOWER:
+                rep_xy = BMM150_LOWPOWER_REPXY;
+                rep_z = BMM150_LOWPOWER_REPZ;
+                break;
+            case BMM150_PRESET_REGULAR:
+                rep_xy = BMM150_REGULAR_REPXY;
+                rep_z = BMM150_REGULAR_REPZ;
+                break;
+            case BMM150_PRESET_ENHANCED:
+                rep_xy = BMM150_ENHANCED_REPXY;
+                rep_z = BMM150_ENHANCED_REPZ;
+                break;
+            case BMM150_PRESET_HIGHACCURACY:
+                rep_xy = BMM150_HIGHACCURACY_REPXY;
+                rep_z = BMM150_HIGHACCURACY_REPZ;
+                break;
+            default:
+                rslt = BMM150_E_INVALID_CONFIG;
+                break;
+        }
+    }
+
+    /* Auto mode owns the auxiliary interface */
+    if ((rslt == BMM150_OK) && (dev->bmi->aux_cfg.manual_enable != BMI160_ENABLE))
+    {
+        rslt = BMM150_E_INVALID_CONFIG;
+    }
+    if (rslt == BMM150_OK)
+    {
+        rslt = write_rep(rep_xy, rep_z, dev);
+    }
+    if (rslt == BMM150_OK)
+    {
+        dev->rep_xy = rep_xy;
+        dev->rep_z = rep_z;
+    }
+
+    return rslt;
+}
+
+/*!
+ *  @brief This API hands the BMM150 to the BMI160 auto mode.
+ */
+int8_t bmm150_start_auto_mode(const struct bmm150_dev *dev)
+{
+    int8_t rslt;
+    uint32_t meas_us;
+    uint32_t period_us;
+    uint8_t data = BMM150_OP_MODE_FORCED;
+    uint8_t data_addr = BMM150_DATA_X_LSB_ADDR;
+
+    rslt = null_ptr_check(dev);
+    if ((rslt == BMM150_OK) && (dev->bmi->aux_cfg.manual_enable != BMI160_ENABLE))
+    {
+        rslt = BMM150_E_INVALID_CONFIG;
+    }
+    if (rslt == BMM150_OK)
+    {
+        /* Every forced measurement must be done by the next read */
+        meas_us = BMM150_MEAS_XY_US * (1 + 2 * (uint32_t)dev->rep_xy) + BMM150_MEAS_Z_US * (1 + (uint32_t)dev->rep_z) +
+                  BMM150_MEAS_BASE_US;
+        period_us = aux_odr_period(dev->bmi->aux_cfg.aux_odr);
+        if ((period_us == 0) || (meas_us > period_us))
+        {
+            rslt = BMM150_E_INVALID_CONFIG;
+        }
+    }
+    if (rslt == BMM150_OK)
+    {
+        /* The last write stays in the BMI160 write registers, auto mode
+         * sends it after every read to start the next measurement */
+        rslt = aux_write(BMM150_OP_MODE_ADDR, &data, 1, dev);
+    }
+    if (rslt == BMM150_OK)
+    {
+        rslt = (bmi160_set_aux_auto_mode(&data_addr, dev->bmi) == BMI160_OK) ? BMM150_OK : BMM150_E_COM_FAIL;
+    }
+
+    return rslt;
+}
+
+/*!
+ *  @brief This API takes the auxiliary interface back to manual mode and
+ *  puts the BMM150 to sleep.
+ */
+int8_t bmm150_stop_auto_mode(const struct bmm150_dev *dev)
+{
+    int8_t rslt;
+    uint8_t data = BMM150_OP_MODE_SLEEP;
+
+    rslt = null_ptr_check(dev);
+    if (rslt == BMM150_OK)
+    {
+        dev->bmi->aux_cfg.manual_enable = BMI160_ENABLE;
+        rslt = (bmi160_config_aux_mode(dev->bmi) == BMI160_OK) ? BMM150_OK : BMM150_E_COM_FAIL;
+    }
+    if (rslt == BMM150_OK)
+    {
+        rslt = aux_write(BMM150_OP_MODE_ADDR, &data, 1, dev);
+    }
+
+    return rslt;
+}
+
+/*!
+ *  @brief This API reads the latest mag data of auto mode and compensates
+ *  it.
+ */
+int8_t bmm150_read_mag_data(struct bmm150_mag_data *mag, const struct bmm150_dev *dev)
+{
+    int8_t rslt;
+    uint8_t raw[BMM150_DATA_LEN];
+
+    rslt = null_ptr_check(dev);
+    if ((rslt == BMM150_OK) && (mag == NULL))
+    {
+        rslt = BMM150_E_NULL_PTR;
+    }
+    if (rslt == BMM150_OK)
+    {
+        rslt = (bmi160_read_aux_data_auto_mode(raw, dev->bmi) == BMI160_OK) ? BMM150_OK : BMM150_E_COM_FAIL;
+    }
+    if (rslt == BMM150_OK)
+    {
+        rslt = bmm150_compensate(raw, mag, dev);
+    }
+
+    return rslt;
+}
+
+/*!
+ *  @brief This API compensates one raw frame.
+ */
+int8_t bmm150_compensate(const uint8_t *raw, struct bmm150_mag_data *mag, const struct bmm150_dev *dev)
+{
+    int16_t x;
+    int16_t y;
+    int16_t z;
+    uint16_t rhall;
+
+    if ((raw == NULL) || (mag == NULL) || (dev == NULL))
+    {
+        return BMM150_E_NULL_PTR;
+    }
+
+    /* Signed MSB, then the LSB bits above the status bits */
+    x = (int16_t)((int16_t)((int8_t)raw[1]) * (1 << (8 - BMM150_XY_SHIFT)) | (raw[0] >> BMM150_XY_SHIFT));
+    y = (int16_t)((int16_t)((int8_t)raw[3]) * (1 << (8 - BMM150_XY_SHIFT)) | (raw[2] >> BMM150_XY_SHIFT));
+    z = (int16_t)((int16_t)((int8_t)raw[5]) * (1 << (8 - BMM150_Z_SHIFT)) | (raw[4] >> BMM150_Z_SHIFT));
+    rhall = (uint16_t)(((uint16_t)raw[7] << (8 - BMM150_RHALL_SHIFT)) | (raw[6] >> BMM150_RHALL_SHIFT));
+
+    mag->x = compensate_xy(x, rhall, dev->trim.dig_x1, dev->trim.dig_x2, &dev->trim);
+    mag->y = compensate_xy(y, rhall, dev->trim.dig_y1, dev->trim.dig_y2, &dev->trim);
+    mag->z = compensate_z(z, rhall, &dev->trim);
+
+    return BMM150_OK;
+}
+
+/*!
+ *  @brief This API turns a parsed batch into 9-axis samples.
+ */
+int8_t bmm150_fifo_9axis(struct bmm150_fifo_9axis *out,
+                         const struct bmi160_fifo_batch *batch,
+                         const struct bmm150_dev *dev)
+{
+    struct bmm150_9axis *last;
+    size_t accel_index = 0;
+    size_t gyro_index = 0;
+    size_t aux_index = 0;
+    size_t count = 0;
+    size_t idx;
+    uint8_t frame;
+
+    if ((out == NULL) || (out->samples == NULL) || (batch == NULL) || (dev == NULL) ||
+        ((batch->frames == NULL) && (batch->frames_len != 0)))
+    {
+        return BMM150_E_NULL_PTR;
+    }
+    if (out->len < batch->frames_len)
+    {
+        return BMM150_E_OUT_OF_RANGE;
+    }
+
+    last = &out->last;
+    for (idx = 0; idx < batch->frames_len; idx++)
+    {
+        frame = batch->frames[idx];
+
+        /* Parts of dropped sensors stay as they were */
+        if ((frame & BMI160_FIFO_FRAME_A) && (batch->accel != NULL) && (accel_index < batch->accel_len))
+        {
+            last->accel = batch->accel[accel_index++];
+            last->fresh |= BMI160_FIFO_FRAME_A;
+        }
+        if ((frame & BMI160_FIFO_FRAME_G) && (batch->gyro != NULL) && (gyro_index < batch->gyro_len))
+        {
+            last->gyro = batch->gyro[gyro_index++];
+            last->fresh |= BMI160_FIFO_FRAME_G;
+        }
+        if ((frame & BMI160_FIFO_FRAME_M) && (batch->aux != NULL) && (aux_index < batch->aux_len))
+        {
+            (void)bmm150_compensate(batch->aux[aux_index++].data, &last->mag, dev);
+            last->fresh |= BMI160_FIFO_FRAME_M;
+        }
+        last->valid |= last->fresh;
+
+        /* A mag only frame waits for the next accel or gyro frame */
+        if (frame & (BMI160_FIFO_FRAME_A | BMI160_FIFO_FRAME_G))
+        {
+            out->samples[count++] = *last;
+            last->fresh = 0;
+        }
+    }
+    out->len = count;
+
+    return BMM150_OK;
+}
+
+/*********************** Static function definitions ****************************/
+
+/*!
+ *  @brief This API checks the device structure and the BMI160 it uses for
+ *  null pointers.
+ */
+static int8_t null_ptr_check(const struct bmm150_dev *dev)
+{
+    int8_t rslt;
+
+    if ((dev == NULL) || (dev->bmi == NULL) || (dev->bmi->read == NULL) || (dev->bmi->write == NULL) ||
+        (dev->bmi->delay_ms == NULL))
+    {
+        rslt = BMM150_E_NULL_PTR;
+    }
+    else
+    {
+        rslt = BMM150_OK;
+    }
+
+    return rslt;
+}
+
+/*!
+ *  @brief This API reads BMM150 registers through the BMI160 manual mode.
+ */
+static int8_t aux_read(uint8_t reg_addr, uint8_t *data, uint16_t len, const struct bmm150_dev *dev)
+{
+    return (bmi160_aux_read(reg_addr, data, len, dev->bmi) == BMI160_OK) ? BMM150_OK : BMM150_E_COM_FAIL;
+}
+
+/*!
+ *  @brief This API writes BMM150 registers through the BMI160 manual mode.
+ */
+static int8_t aux_write(uint8_t reg_addr, uint8_t *data, uint16_t len, const struct bmm150_dev *dev)
+{
+    return (bmi160_aux_write(reg_addr, data, len, dev->bmi) == BMI160_OK) ? BMM150_OK : BMM150_E_COM_FAIL;
+}
+
+/*!
+ *  @brief This API waits, through delay_us when set and delay_ms otherwise.
+ */
+static void delay_wait(enum bmm150_wait wait, const struct bmm150_dev *dev)
+{
+    if (dev->bmi->delay_us != NULL)
+    {
+        dev->bmi->delay_us(wait_table[wait].us);
+    }
+    else
+    {
+        dev->bmi->delay_ms(wait_table[wait].ms);
+    }
+}
+
+/*!
+ *  @brief This API reads the trim registers.
+ */
+static int8_t read_trim(struct bmm150_dev *dev)
+{
+    int8_t rslt;
+    uint8_t x1y1[BMM150_DIG_X1_LEN];
+    uint8_t z4x2y2[BMM150_DIG_Z4_LEN];
+    uint8_t z2xy1[BMM150_DIG_Z2_LEN];
+
+    rslt = aux_read(BMM150_DIG_X1_ADDR, x1y1, BMM150_DIG_X1_LEN, dev);
+    if (rslt == BMM150_OK)
+    {
+        rslt = aux_read(BMM150_DIG_Z4_LSB_ADDR, z4x2y2, BMM150_DIG_Z4_LEN, dev);
+    }
+    if (rslt == BMM150_OK)
+    {
+        rslt = aux_read(BMM150_DIG_Z2_LSB_ADDR, z2xy1, BMM150_DIG_Z2_LEN, dev);
+    }
+    if (rslt == BMM150_OK)
+    {
+        dev->trim.dig_x1 = (int8_t)x1y1[0];
+        dev->trim.dig_y1 = (int8_t)x1y1[1];
+        dev->trim.dig_z4 = (int16_t)(((uint16_t)z4x2y2[1] << 8) | z4x2y2[0]);
+        dev->trim.dig_x2 = (int8_t)z4x2y2[2];
+        dev->trim.dig_y2 = (int8_t)z4x2y2[3];
+        dev->trim.dig_z2 = (int16_t)(((uint16_t)z2xy1[1] << 8) | z2xy1[0]);
+        dev->trim.dig_z1 = (uint16_t)(((uint16_t)z2xy1[3] << 8) | z2xy1[2]);
+
+        /* Bit 15 of xyz1 is not part of the value */
+        dev->trim.dig_xyz1 = (uint16_t)(((uint16_t)(z2xy1[5] & 0x7F) << 8) | z2xy1[4]);
+        dev->trim.dig_z3 = (int16_t)(((uint16_t)z2xy1[7] << 8) | z2xy1[6]);
+        dev->trim.dig_xy2 = (int8_t)z2xy1[8];
+        dev->trim.dig_xy1 = z2xy1[9];
+    }
+
+    return rslt;
+}
+
+/*!
+ *  @brief This API writes the repetition registers.
+ */
+static int8_t write_rep(uint8_t rep_xy, uint8_t rep_z, const struct bmm150_dev *dev)
+{
+    uint8_t data[2] = { rep_xy, rep_z };
+
+    /* REP_XY and REP_Z are next to each other */
+    return aux_write(BMM150_REP_XY_ADDR, data, 2, dev);
+}
+
+/*!
+ *  @brief This API gives the period of a BMI160 aux ODR code.
+ */
+static uint32_t aux_odr_period(uint8_t aux_odr)
+{
+    uint32_t period = 0;
+
+    if ((aux_odr >= BMI160_AUX_ODR_0_78HZ) && (aux_odr <= BMI160_AUX_ODR_100HZ))
+    {
+        period = BMM150_AUX_ODR_100HZ_US << (BMI160_AUX_ODR_100HZ - aux_odr);
+    }
+    else if ((aux_odr > BMI160_AUX_ODR_100HZ) && (aux_odr <= BMI160_AUX_ODR_800HZ))
+    {
+        period = BMM150_AUX_ODR_100HZ_US >> (aux_odr - BMI160_AUX_ODR_100HZ);
+    }
+
+    return period;
+}
+
+/*!
+ *  @brief This API compensates the X or Y axis, the integer formula of the
+ *  BMM150 datasheet without the final scaling to uT.
+ */
+static int16_t compensate_xy(int16_t raw,
+                             uint16_t rhall,
+                             int8_t dig_1,
+                             int8_t dig_2,
+                             const struct bmm150_trim *trim)
+{
+    int32_t hall;
+    int32_t ratio;
+    int32_t sens;
+    int32_t field;
+
+    if (raw == BMM150_XY_OVERFLOW_ADC)
+    {
+        return BMM150_OVERFLOW_OUTPUT;
+    }
+
+    /* No hall resistance in the frame, fall back on the trimmed one */
+    hall = (rhall != 0) ? rhall : trim->dig_xyz1;
+    if (hall == 0)
+    {
+        return BMM150_OVERFLOW_OUTPUT;
+    }
+
+    /* Hall resistance against its trimmed value, Q14 around 1 */
+    ratio = (int16_t)((uint16_t)(((int32_t)trim->dig_xyz1 * 16384) / hall) - UINT16_C(0x4000));
+
+    /* Sensitivity, second order in the ratio */
+    sens = ((((int32_t)trim->dig_xy2 * ((ratio * ratio) / 128)) + (ratio * ((int32_t)trim->dig_xy1 * 128))) / 512) +
+           INT32_C(0x100000);
+    sens = (sens * ((int32_t)dig_2 + 0xA0)) / 4096;
+    field = (int16_t)(((int32_t)raw * sens) / 8192);
+
+    return (int16_t)(field + (int32_t)dig_1 * 8);
+}
+
+/*!
+ *  @brief This API compensates the Z axis, the integer formula of the
+ *  BMM150 datasheet without the final scaling to uT.
+ */
+static int16_t compensate_z(int16_t raw, uint16_t rhall, const struct bmm150_trim *trim)
+{
+    int32_t offset;
+    int32_t scaled;
+    int32_t gain;
+    int32_t field;
+
+    if ((raw == BMM150_Z_OVERFLOW_ADC) || (trim->dig_z1 == 0) || (trim->dig_z2 == 0) || (rhall == 0) ||
+        (trim->dig_xyz1 == 0))
+    {
+        return BMM150_OVERFLOW_OUTPUT;
+    }
+
+    offset = ((int32_t)trim->dig_z3 * ((int32_t)rhall - (int32_t)trim->dig_xyz1)) / 4;
+    scaled = ((int32_t)raw - trim->dig_z4) * 32768;
+    gain = (int16_t)((((int32_t)trim->dig_z1 * ((int32_t)rhall * 2)) + 32768) / 65536);
+    field = (scaled - offset) / ((int32_t)trim->dig_z2 + gain);
+
+    /* Keep clear of BMM150_OVERFLOW_OUTPUT */
+    if (field > INT16_MAX)
+    {
+        field = INT16_MAX;
+    }
+    else if (field < -INT16_MAX)
+    {
+        field = -INT16_MAX;
+    }
+
+    return (int16_t)field;
+}
@@ -0,0 +1,146 @@
+/*!
+ * @file    bmm150.h
+ * @brief   BMM150 magnetometer driver on the BMI160 auxiliary interface
+ *
+ * The BMM150 is never accessed by the host directly. Set up goes through
+ * the manual mode of the BMI160 secondary interface, then the BMI160 runs
+ * it in auto mode: at the aux ODR it reads the 8 data bytes into its data
+ * registers and FIFO, and writes the forced mode command back to start the
+ * next measurement.
+ *
+ * Raw frames, from bmi160_read_aux_data_auto_mode or the FIFO, are
+ * compensated with the trim registers in integer arithmetic, to
+ * 1 / BMM150_LSB_PER_UT uT. bmm150_fifo_9axis lines FIFO mag frames up
+ * with the accel and gyro frames they were stored with.
+ */
+
+#ifndef BMM150_H_
+#define BMM150_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "bmi160.h"
+#include "bmm150_defs.h"
+
+/*!
+ *  @brief This API sets up the BMI160 auxiliary interface in manual mode
+ *  for the BMM150 at dev->bmi->aux_cfg.aux_i2c_addr, BMM150_I2C_ADDR if
+ *  zero, powers the BMM150 on, checks its chip id, reads the trim
+ *  registers and selects the regular preset.
+ *
+ *  @param[in,out] dev : Structure instance of bmm150_dev, with bmi set to
+ *                       an initialised BMI160.
+ *
+ *  @return Result of API execution status
+ *  @retval zero -> Success / -ve value -> Error
+ */
+int8_t bmm150_init(struct bmm150_dev *dev);
+
+/*!
+ *  @brief This API resets the BMM150 and powers it on again. The trim
+ *  registers are kept, the repetitions are written again.
+ *
+ *  @param[in] dev : Structure instance of bmm150_dev.
+ *
+ *  @return Result of API execution status
+ *  @retval zero -> Success / -ve value -> Error
+ */
+int8_t bmm150_soft_reset(struct bmm150_dev *dev);
+
+/*!
+ *  @brief This API sets the repetitions of a preset, trading noise
+ *  against measurement time and current. Only in manual mode.
+ *
+ *  @param[in] preset  : Preset to set.
+ *  @param[in,out] dev : Structure instance of bmm150_dev.
+ *
+ *   preset                      | nXY, nZ | max aux ODR
+ *  -----------------------------|---------|--------------------
+ *   BMM150_PRESET_LOWPOWER      | 3, 3    | BMI160_AUX_ODR_200HZ
+ *   BMM150_PRESET_REGULAR       | 9, 15   | BMI160_AUX_ODR_100HZ
+ *   BMM150_PRESET_ENHANCED      | 15, 27  | BMI160_AUX_ODR_50HZ
+ *   BMM150_PRESET_HIGHACCURACY  | 47, 83  | BMI160_AUX_ODR_12_5HZ
+ *
+ *  @return Result of API execution status
+ *  @retval zero -> Success / -ve value -> Error
+ */
+int8_t bmm150_set_preset(uint8_t preset, struct bmm150_dev *dev);
+
+/*!
+ *  @brief This API hands the BMM150 to the BMI160 auto mode at
+ *  dev->bmi->aux_cfg.aux_odr: mag data shows up in the BMI160 data
+ *  registers and, with BMI160_FIFO_AUX enabled, in its FIFO.
+ *
+ *  @param[in] dev : Structure instance of bmm150_dev.
+ *
+ *  @return Result of API execution status
+ *  @retval zero -> Success / -ve value -> Error
+ *  @retval BMM150_E_INVALID_CONFIG -> The aux ODR is faster than the
+ *  measurement time of the repetitions.
+ */
+int8_t bmm150_start_auto_mode(const struct bmm150_dev *dev);
+
+/*!
+ *  @brief This API takes the auxiliary interface back to manual mode and
+ *  puts the BMM150 to sleep.
+ *
+ *  @param[in] dev : Structure instance of bmm150_dev.
+ *
+ *  @return Result of API execution status
+ *  @retval zero -> Success / -ve value -> Error
+ */
+int8_t bmm150_stop_auto_mode(const struct bmm150_dev *dev);
+
+/*!
+ *  @brief This API reads the latest mag data of auto mode from the BMI160
+ *  and compensates it.
+ *
+ *  @param[out] mag : Structure instance of bmm150_mag_data.
+ *  @param[in] dev  : Structure instance of bmm150_dev.
+ *
+ *  @return Result of API execution status
+ *  @retval zero -> Success / -ve value -> Error
+ */
+int8_t bmm150_read_mag_data(struct bmm150_mag_data *mag, const struct bmm150_dev *dev);
+
+/*!
+ *  @brief This API compensates one raw frame of BMM150_DATA_LEN bytes,
+ *  as in bmi160_aux_data.
+ *
+ *  @param[in] raw  : Raw data, X, Y, Z and RHALL, LSB first.
+ *  @param[out] mag : Structure instance of bmm150_mag_data.
+ *  @param[in] dev  : Structure instance of bmm150_dev.
+ *
+ *  @return Result of API execution status
+ *  @retval zero -> Success / -ve value -> Error
+ */
+int8_t bmm150_compensate(const uint8_t *raw, struct bmm150_mag_data *mag, const struct bmm150_dev *dev);
+
+/*!
+ *  @brief This API turns a batch parsed by bmi160_fifo_batch_parse with
+ *  accel, gyro, aux and frames set into 9-axis samples, one per frame with
+ *  accel or gyro data, mag data compensated. Parts missing from a frame,
+ *  as the slower sensors skip frames, repeat the last value seen, which
+ *  out->last carries across batches; fresh tells them apart. Mag only
+ *  frames update the mag of the next sample.
+ *
+ *  @param[in,out] out : Structure instance of bmm150_fifo_9axis.
+ *  @param[in] batch   : Parsed batch.
+ *  @param[in] dev     : Structure instance of bmm150_dev.
+ *
+ *  @return Result of API execution status
+ *  @retval zero -> Success / -ve value -> Error
+ *  @retval BMM150_E_OUT_OF_RANGE -> out->samples is smaller than
+ *  batch->frames_len.
+ */
+int8_t bmm150_fifo_9axis(struct bmm150_fifo_9axis *out,
+                         const struct bmi160_fifo_batch *batch,
+                         const struct bmm150_dev *dev);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BMM150_H_ */
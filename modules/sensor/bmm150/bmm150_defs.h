@@ -0,0 +1,194 @@
+/*!
+ * @file    bmm150_defs.h
+ * @brief   Definitions of the BMM150 magnetometer on the BMI160 auxiliary
+ *          interface
+ */
+
+#ifndef BMM150_DEFS_H_
+#define BMM150_DEFS_H_
+
+#include "bmi160_defs.h"
+
+/** API success code */
+#define BMM150_OK                           INT8_C(0)
+
+/** API error codes */
+#define BMM150_E_NULL_PTR                   INT8_C(-1)
+#define BMM150_E_COM_FAIL                   INT8_C(-2)
+#define BMM150_E_DEV_NOT_FOUND              INT8_C(-3)
+#define BMM150_E_INVALID_CONFIG             INT8_C(-4)
+#define BMM150_E_OUT_OF_RANGE               INT8_C(-5)
+
+/** BMM150 chip identifier */
+#define BMM150_CHIP_ID                      UINT8_C(0x32)
+
+/** I2C address, SDO and CSB low */
+#define BMM150_I2C_ADDR                     UINT8_C(0x10)
+
+/** Register map */
+#define BMM150_CHIP_ID_ADDR                 UINT8_C(0x40)
+#define BMM150_DATA_X_LSB_ADDR              UINT8_C(0x42)
+#define BMM150_POWER_CONTROL_ADDR           UINT8_C(0x4B)
+#define BMM150_OP_MODE_ADDR                 UINT8_C(0x4C)
+#define BMM150_REP_XY_ADDR                  UINT8_C(0x51)
+#define BMM150_REP_Z_ADDR                   UINT8_C(0x52)
+
+/** Trim registers, read in three bursts */
+#define BMM150_DIG_X1_ADDR                  UINT8_C(0x5D)
+#define BMM150_DIG_X1_LEN                   UINT8_C(2)
+#define BMM150_DIG_Z4_LSB_ADDR              UINT8_C(0x62)
+#define BMM150_DIG_Z4_LEN                   UINT8_C(4)
+#define BMM150_DIG_Z2_LSB_ADDR              UINT8_C(0x68)
+#define BMM150_DIG_Z2_LEN                   UINT8_C(10)
+
+/** Power control: power bit, and soft reset with it */
+#define BMM150_POWER_ON                     UINT8_C(0x01)
+#define BMM150_SOFT_RESET                   UINT8_C(0x83)
+
+/** Operation mode register values, ODR bits left at 10 Hz */
+#define BMM150_OP_MODE_NORMAL               UINT8_C(0x00)
+#define BMM150_OP_MODE_FORCED               UINT8_C(0x02)
+#define BMM150_OP_MODE_SLEEP                UINT8_C(0x06)
+
+/** Presets, see bmm150_set_preset */
+#define BMM150_PRESET_LOWPOWER              UINT8_C(0x01)
+#define BMM150_PRESET_REGULAR               UINT8_C(0x02)
+#define BMM150_PRESET_ENHANCED              UINT8_C(0x03)
+#define BMM150_PRESET_HIGHACCURACY          UINT8_C(0x04)
+
+/* Repetition register values of the presets, nXY = 1 + 2 * reg and
+ * nZ = 1 + reg */
+#define BMM150_LOWPOWER_REPXY               UINT8_C(1)
+#define BMM150_LOWPOWER_REPZ                UINT8_C(2)
+#define BMM150_REGULAR_REPXY                UINT8_C(4)
+#define BMM150_REGULAR_REPZ                 UINT8_C(14)
+#define BMM150_ENHANCED_REPXY               UINT8_C(7)
+#define BMM150_ENHANCED_REPZ                UINT8_C(26)
+#define BMM150_HIGHACCURACY_REPXY           UINT8_C(23)
+#define BMM150_HIGHACCURACY_REPZ            UINT8_C(82)
+
+/* Forced measurement time, 145 us per XY and 500 us per Z repetition
+ * plus 980 us, datasheet section 4.2.4 */
+#define BMM150_MEAS_XY_US                   UINT32_C(145)
+#define BMM150_MEAS_Z_US                    UINT32_C(500)
+#define BMM150_MEAS_BASE_US                 UINT32_C(980)
+
+/* Period of BMI160_AUX_ODR_100HZ, the other codes double or halve it */
+#define BMM150_AUX_ODR_100HZ_US             UINT32_C(10000)
+
+/* Delay settings, see enum bmm150_wait */
+#define BMM150_START_UP_DELAY_US            UINT32_C(3000)
+#define BMM150_START_UP_DELAY_MS            UINT8_C(3)
+#define BMM150_SOFT_RESET_DELAY_US          UINT32_C(1000)
+#define BMM150_SOFT_RESET_DELAY_MS          UINT8_C(1)
+
+/** Raw data: X and Y 13 bits, Z 15 bits, RHALL 14 bits, left aligned */
+#define BMM150_DATA_LEN                     UINT8_C(8)
+#define BMM150_XY_SHIFT                     UINT8_C(3)
+#define BMM150_Z_SHIFT                      UINT8_C(1)
+#define BMM150_RHALL_SHIFT                  UINT8_C(2)
+
+/** Raw values flagging an overflowed measurement */
+#define BMM150_XY_OVERFLOW_ADC              INT16_C(-4096)
+#define BMM150_Z_OVERFLOW_ADC               INT16_C(-16384)
+
+/** Compensated output of an overflowed or uncompensable axis */
+#define BMM150_OVERFLOW_OUTPUT              INT16_C(-32768)
+
+/** Compensated output LSB per micro tesla */
+#define BMM150_LSB_PER_UT                   INT16_C(16)
+
+/*!
+ * @brief Waits of the driver, in the order of the delay table in bmm150.c
+ */
+enum bmm150_wait {
+    BMM150_WAIT_START_UP,
+    BMM150_WAIT_SOFT_RESET,
+    BMM150_WAIT_COUNT
+};
+
+/*!
+ * @brief Trim registers, programmed per part at production
+ */
+struct bmm150_trim
+{
+    int8_t dig_x1;
+    int8_t dig_y1;
+    int8_t dig_x2;
+    int8_t dig_y2;
+    uint16_t dig_z1;
+    int16_t dig_z2;
+    int16_t dig_z3;
+    int16_t dig_z4;
+    uint8_t dig_xy1;
+    int8_t dig_xy2;
+    uint16_t dig_xyz1;
+};
+
+/*!
+ * @brief Compensated magnetic field
+ */
+struct bmm150_mag_data
+{
+    /*! Field per axis in 1 / BMM150_LSB_PER_UT uT, BMM150_OVERFLOW_OUTPUT
+     *  when the axis overflowed */
+    int16_t x;
+    int16_t y;
+    int16_t z;
+};
+
+/*!
+ * @brief One 9-axis sample, from a FIFO frame with accel or gyro data
+ */
+struct bmm150_9axis
+{
+    struct bmi160_sensor_data accel;
+    struct bmi160_sensor_data gyro;
+    struct bmm150_mag_data mag;
+
+    /*! Parts taken from this frame, BMI160_FIFO_FRAME_A/G/M bits. The
+     *  other parts repeat the last value seen, if any */
+    uint8_t fresh;
+
+    /*! Parts holding a value, BMI160_FIFO_FRAME_A/G/M bits */
+    uint8_t valid;
+};
+
+/*!
+ * @brief 9-axis output of bmm150_fifo_9axis, and the last values seen,
+ * carried from one batch to the next
+ */
+struct bmm150_fifo_9axis
+{
+    /*! Samples, one per frame with accel or gyro data */
+    struct bmm150_9axis *samples;
+
+    /*! Size of samples on input, samples stored on output */
+    size_t len;
+
+    /*! Last values seen and mag only frames not yet output. Zero before
+     *  the first batch */
+    struct bmm150_9axis last;
+};
+
+/*!
+ * @brief BMM150 device structure
+ */
+struct bmm150_dev
+{
+    /*! Chip Id */
+    uint8_t chip_id;
+
+    /*! BMI160 the BMM150 is connected to, all access goes through its
+     *  auxiliary interface */
+    struct bmi160_dev *bmi;
+
+    /*! Repetition register values */
+    uint8_t rep_xy;
+    uint8_t rep_z;
+
+    /*! Trim registers */
+    struct bmm150_trim trim;
+};
+
+#endif /* BMM150_DEFS_H_ */
@@ -0,0 +1,534 @@
+/*
+ * sensor_codec benchmark. Encodes sensor traces into flash page sized blocks,
+ * decodes them back, checks the round trip bit for bit and reports the
+ * compression ratio and encode/decode cost per sample.
+ *
+ * Built-in traces are synthesized from the sensor output formats (BMI160
+ * accel + gyro with sensortime, BME280/BME680 integer and compensated
+ * readings). Recorded traces are read from CSV with -f: first column is the
+ * timestamp, the rest are integer (-t int) or float (-t float) channels.
+ */
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "sensor_codec.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define CYCLE_UNIT    "cyc"
+static uint64_t cycles(void)
+{
+    return __rdtsc();
+}
+#else
+#define CYCLE_UNIT    "ns"
+static uint64_t cycles(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+#endif
+
+#define DEFAULT_BLOCK_SIZE    2048U
+#define CSV_LINE_LEN          1024U
+
+struct trace
+{
+    const char *name;
+    struct sensor_codec_layout layout;
+    /* Bytes per frame when stored raw and packed */
+    uint32_t raw_frame_size;
+    uint32_t num_frames;
+    union sensor_codec_value *frames;
+};
+
+struct result
+{
+    uint64_t coded_bytes;
+    uint32_t blocks;
+    uint64_t enc_cycles;
+    uint64_t dec_cycles;
+    uint32_t mismatches;
+};
+
+/* xorshift32 and Box-Muller, fixed seed so runs are comparable */
+static uint32_t rng_state = 0x12345678;
+
+static uint32_t rng(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+
+    return rng_state;
+}
+
+static double gauss(double sigma)
+{
+    double u1 = ((double)rng() + 1.0) / 4294967297.0;
+    double u2 = ((double)rng() + 1.0) / 4294967297.0;
+
+    return sigma * sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+}
+
+static int16_t clamp16(double val)
+{
+    if (val > 32767.0)
+    {
+        return 32767;
+    }
+    if (val < -32768.0)
+    {
+        return -32768;
+    }
+
+    return (int16_t)lrint(val);
+}
+
+static int8_t trace_alloc(struct trace *trace, uint32_t num_frames)
+{
+    trace->num_frames = num_frames;
+    trace->frames = calloc((size_t)num_frames * trace->layout.num_channels, sizeof(union sensor_codec_value));
+
+    return (trace->frames == NULL) ? SENSOR_CODEC_E_NULL_PTR : SENSOR_CODEC_OK;
+}
+
+/*
+ * BMI160 accel (+/-2 g, 16384 LSB/g) and gyro (+/-2000 dps, 16.4 LSB/dps) at
+ * 1600 Hz. Sensortime ticks at 39.0625 us, 16 ticks per sample, and wraps at
+ * 24 bits. Slow handling motion plus sensor noise.
+ */
+static int8_t trace_bmi160(struct trace *trace, uint32_t num_frames)
+{
+    union sensor_codec_value *f;
+    uint32_t sensortime = 0xFF0000;
+    double t;
+
+    trace->name = "bmi160_ag";
+    trace->layout.num_channels = 7;
+    trace->layout.type[0] = SENSOR_CODEC_TIMESTAMP;
+    for (uint8_t ch = 1; ch < 7; ch++)
+    {
+        trace->layout.type[ch] = SENSOR_CODEC_INT;
+    }
+    trace->raw_frame_size = sizeof(uint32_t) + 6 * sizeof(int16_t);
+
+    if (trace_alloc(trace, num_frames) != SENSOR_CODEC_OK)
+    {
+        return SENSOR_CODEC_E_NULL_PTR;
+    }
+
+    for (uint32_t i = 0; i < num_frames; i++)
+    {
+        f = &trace->frames[(size_t)i * 7];
+        t = i / 1600.0;
+
+        /* Occasional one tick jitter from FIFO header timing */
+        sensortime = (sensortime + 16 + (((rng() & 0xFF) == 0) ? 1 : 0)) & 0xFFFFFF;
+        f[0].ts = sensortime;
+        f[1].i = clamp16(1200.0 * sin(2.0 * M_PI * 0.7 * t) + gauss(8.0));
+        f[2].i = clamp16(-800.0 * cos(2.0 * M_PI * 0.4 * t) + gauss(8.0));
+        f[3].i = clamp16(16384.0 + 300.0 * sin(2.0 * M_PI * 1.3 * t) + gauss(10.0));
+        f[4].i = clamp16(16.4 * 20.0 * sin(2.0 * M_PI * 0.5 * t) + gauss(4.0));
+        f[5].i = clamp16(16.4 * 5.0 * cos(2.0 * M_PI * 0.2 * t) + gauss(4.0));
+        f[6].i = clamp16(gauss(4.0));
+    }
+
+    return SENSOR_CODEC_OK;
+}
+
+/* Indoor air at 1 Hz: drifting temperature, pressure and humidity, ms clock */
+static void bme_env(uint32_t i, double *temp, double *press, double *hum)
+{
+    double t = (double)i;
+
+    *temp = 22.5 + 1.5 * sin(2.0 * M_PI * t / 86400.0) + gauss(0.005);
+    *press = 101325.0 + 120.0 * sin(2.0 * M_PI * t / 43200.0) + gauss(1.5);
+    *hum = 45.0 + 5.0 * cos(2.0 * M_PI * t / 86400.0) + gauss(0.02);
+}
+
+static uint32_t bme_time_ms(uint32_t i)
+{
+    return i * 1000U + (rng() % 3U);
+}
+
+/* BME280 integer API: 0.01 degC, Q24.8 Pa, Q22.10 %RH */
+static int8_t trace_bme280_int(struct trace *trace, uint32_t num_frames)
+{
+    union sensor_codec_value *f;
+    double temp, press, hum;
+
+    trace->name = "bme280_int";
+    trace->layout.num_channels = 4;
+    trace->layout.type[0] = SENSOR_CODEC_TIMESTAMP;
+    trace->layout.type[1] = SENSOR_CODEC_INT;
+    trace->layout.type[2] = SENSOR_CODEC_INT;
+    trace->layout.type[3] = SENSOR_CODEC_INT;
+    trace->raw_frame_size = 4 * sizeof(uint32_t);
+
+    if (trace_alloc(trace, num_frames) != SENSOR_CODEC_OK)
+    {
+        return SENSOR_CODEC_E_NULL_PTR;
+    }
+
+    for (uint32_t i = 0; i < num_frames; i++)
+    {
+        f = &trace->frames[(size_t)i * 4];
+        bme_env(i, &temp, &press, &hum);
+        f[0].ts = bme_time_ms(i);
+        f[1].i = (int32_t)lrint(temp * 100.0);
+        f[2].i = (int32_t)lrint(press * 256.0);
+        f[3].i = (int32_t)lrint(hum * 1024.0);
+    }
+
+    return SENSOR_CODEC_OK;
+}
+
+/*
+ * Compensated floating point output. The drivers return double; stored as
+ * float, which keeps far more precision than the sensors resolve.
+ */
+static int8_t trace_bme_float(struct trace *trace, uint32_t num_frames, bool gas)
+{
+    union sensor_codec_value *f;
+    uint8_t channels = gas ? 5 : 4;
+    double temp, press, hum;
+    double gas_res = 80000.0;
+
+    trace->name = gas ? "bme680_float" : "bme280_float";
+    trace->layout.num_channels = channels;
+    trace->layout.type[0] = SENSOR_CODEC_TIMESTAMP;
+    for (uint8_t ch = 1; ch < channels; ch++)
+    {
+        trace->layout.type[ch] = SENSOR_CODEC_FLOAT;
+    }
+    trace->raw_frame_size = channels * sizeof(uint32_t);
+
+    if (trace_alloc(trace, num_frames) != SENSOR_CODEC_OK)
+    {
+        return SENSOR_CODEC_E_NULL_PTR;
+    }
+
+    for (uint32_t i = 0; i < num_frames; i++)
+    {
+        f = &trace->frames[(size_t)i * channels];
+        bme_env(i, &temp, &press, &hum);
+        f[0].ts = bme_time_ms(i);
+        f[1].f = (float)temp;
+        f[2].f = (float)press;
+        f[3].f = (float)hum;
+        if (gas)
+        {
+            /* Gas resistance only resolves to about 0.1 % */
+            gas_res *= 1.0 + gauss(0.002);
+            f[4].f = (float)(lrint(gas_res / 10.0) * 10.0);
+        }
+    }
+
+    return SENSOR_CODEC_OK;
+}
+
+static int8_t trace_csv(struct trace *trace, const char *path, uint8_t type)
+{
+    char line[CSV_LINE_LEN];
+    union sensor_codec_value *frames = NULL;
+    uint32_t cap = 0;
+    uint32_t n = 0;
+    uint8_t channels = 0;
+    FILE *fp;
+
+    fp = fopen(path, "r");
+    if (fp == NULL)
+    {
+        perror(path);
+
+        return SENSOR_CODEC_E_INVALID_INPUT;
+    }
+
+    while (fgets(line, sizeof(line), fp) != NULL)
+    {
+        union sensor_codec_value f[SENSOR_CODEC_MAX_CHANNELS];
+        char *tok = strtok(line, ",; \t\r\n");
+        uint8_t ch = 0;
+
+        /* Skip header and blank lines */
+        if ((tok == NULL) || ((tok[0] != '-') && ((tok[0] < '0') || (tok[0] > '9'))))
+        {
+            continue;
+        }
+
+        for (; (tok != NULL) && (ch < SENSOR_CODEC_MAX_CHANNELS); tok = strtok(NULL, ",; \t\r\n"), ch++)
+        {
+            if (ch == 0)
+            {
+                f[ch].ts = (uint32_t)strtoul(tok, NULL, 0);
+            }
+            else if (type == SENSOR_CODEC_FLOAT)
+            {
+                f[ch].f = strtof(tok, NULL);
+            }
+            else
+            {
+                f[ch].i = (int32_t)strtol(tok, NULL, 0);
+            }
+        }
+
+        if (channels == 0)
+        {
+            channels = ch;
+        }
+        if (ch != channels)
+        {
+            fprintf(stderr, "%s: line %u has %u columns, expected %u\n", path, n + 1, ch, channels);
+            continue;
+        }
+
+        if (n == cap)
+        {
+            cap = (cap == 0) ? 4096 : cap * 2;
+            frames = realloc(frames, (size_t)cap * channels * sizeof(union sensor_codec_value));
+            if (frames == NULL)
+            {
+                fclose(fp);
+
+                return SENSOR_CODEC_E_NULL_PTR;
+            }
+        }
+        memcpy(&frames[(size_t)n * channels], f, channels * sizeof(union sensor_codec_value));
+        n++;
+    }
+    fclose(fp);
+
+    if ((n == 0) || (channels < 2))
+    {
+        free(frames);
+        fprintf(stderr, "%s: no samples\n", path);
+
+        return SENSOR_CODEC_E_INVALID_INPUT;
+    }
+
+    trace->name = path;
+    trace->layout.num_channels = channels;
+    trace->layout.type[0] = SENSOR_CODEC_TIMESTAMP;
+    for (uint8_t ch = 1; ch < channels; ch++)
+    {
+        trace->layout.type[ch] = type;
+    }
+    trace->raw_frame_size = channels * sizeof(uint32_t);
+    trace->num_frames = n;
+    trace->frames = frames;
+
+    return SENSOR_CODEC_OK;
+}
+
+static uint32_t frame_mismatch(const struct trace *trace, const union sensor_codec_value *a,
+                               const union sensor_codec_value *b)
+{
+    /* Bitwise compare, every member is 32 bits */
+    return memcmp(a, b, trace->layout.num_channels * sizeof(union sensor_codec_value)) != 0;
+}
+
+/* Encodes the trace block by block the way a flash logger would */
+static int8_t run(const struct trace *trace, uint32_t block_size, struct result *res)
+{
+    union sensor_codec_value out[SENSOR_CODEC_MAX_CHANNELS];
+    uint8_t channels = trace->layout.num_channels;
+    struct sensor_codec_enc enc;
+    struct sensor_codec_dec dec;
+    uint8_t *block;
+    uint32_t i = 0;
+    uint32_t j = 0;
+    uint32_t len;
+    uint64_t start;
+    int8_t rslt;
+
+    memset(res, 0, sizeof(struct result));
+
+    block = malloc(block_size);
+    if (block == NULL)
+    {
+        return SENSOR_CODEC_E_NULL_PTR;
+    }
+
+    while (i < trace->num_frames)
+    {
+        start = cycles();
+        rslt = sensor_codec_enc_init(&enc, &trace->layout, block, block_size);
+        while ((rslt == SENSOR_CODEC_OK) && (i < trace->num_frames))
+        {
+            rslt = sensor_codec_enc_put(&enc, &trace->frames[(size_t)i * channels]);
+            if (rslt == SENSOR_CODEC_OK)
+            {
+                i++;
+            }
+        }
+        len = sensor_codec_enc_finish(&enc);
+        res->enc_cycles += cycles() - start;
+
+        if ((rslt != SENSOR_CODEC_OK) && (rslt != SENSOR_CODEC_E_BUF_FULL))
+        {
+            free(block);
+
+            return rslt;
+        }
+
+        res->coded_bytes += len;
+        res->blocks++;
+
+        start = cycles();
+        rslt = sensor_codec_dec_init(&dec, &trace->layout, block, len);
+        while (rslt == SENSOR_CODEC_OK)
+        {
+            rslt = sensor_codec_dec_get(&dec, out);
+            if (rslt == SENSOR_CODEC_OK)
+            {
+                res->mismatches += frame_mismatch(trace, out, &trace->frames[(size_t)j * channels]);
+                j++;
+            }
+        }
+        res->dec_cycles += cycles() - start;
+
+        if (rslt != SENSOR_CODEC_E_END)
+        {
+            free(block);
+
+            return rslt;
+        }
+    }
+
+    free(block);
+
+    /* Every frame must come back once */
+    if (j != trace->num_frames)
+    {
+        res->mismatches += trace->num_frames - j;
+    }
+
+    return SENSOR_CODEC_OK;
+}
+
+static void print_header(void)
+{
+    printf("%-14s %8s %9s %9s %6s %8s %7s %7s %s\n", "trace", "frames", "raw KB", "coded KB", "ratio",
+           "bits/fr", "enc " CYCLE_UNIT, "dec " CYCLE_UNIT, "mismatch");
+}
+
+static void print_result(const struct trace *trace, const struct result *res)
+{
+    uint64_t raw = (uint64_t)trace->num_frames * trace->raw_frame_size;
+
+    printf("%-14s %8u %9.1f %9.1f %6.2f %8.1f %7.1f %7.1f %u\n",
+           trace->name,
+           trace->num_frames,
+           raw / 1024.0,
+           res->coded_bytes / 1024.0,
+           (double)raw / (double)res->coded_bytes,
+           (res->coded_bytes * 8.0) / trace->num_frames,
+           (double)res->enc_cycles / trace->num_frames,
+           (double)res->dec_cycles / trace->num_frames,
+           res->mismatches);
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [-b block_size] [-n frames] [-f trace.csv [-t int|float]]\n"
+            "  -b  block size in bytes, one flash page (default 2048)\n"
+            "  -n  frames per built-in trace (default 160000 IMU, 86400 env)\n"
+            "  -f  CSV trace, timestamp then channels; replaces the built-ins\n"
+            "  -t  type of the CSV channels (default int)\n",
+            prog);
+}
+
+int main(int argc, char **argv)
+{
+    struct trace traces[4];
+    struct result res;
+    const char *csv = NULL;
+    uint8_t csv_type = SENSOR_CODEC_INT;
+    uint32_t block_size = DEFAULT_BLOCK_SIZE;
+    uint32_t imu_frames = 160000;
+    uint32_t env_frames = 86400;
+    uint8_t num_traces = 0;
+    int8_t rslt = SENSOR_CODEC_OK;
+    int failed = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "b:n:f:t:h")) != -1)
+    {
+        switch (opt)
+        {
+            case 'b':
+                block_size = strtoul(optarg, NULL, 0);
+                break;
+            case 'n':
+                imu_frames = strtoul(optarg, NULL, 0);
+                env_frames = imu_frames;
+                break;
+            case 'f':
+                csv = optarg;
+                break;
+            case 't':
+                csv_type = (strcmp(optarg, "float") == 0) ? SENSOR_CODEC_FLOAT : SENSOR_CODEC_INT;
+                break;
+            default:
+                usage(argv[0]);
+
+                return EXIT_FAILURE;
+        }
+    }
+
+    memset(traces, 0, sizeof(traces));
+    if (csv != NULL)
+    {
+        rslt = trace_csv(&traces[num_traces++], csv, csv_type);
+    }
+    else if ((imu_frames == 0) || (env_frames == 0))
+    {
+        usage(argv[0]);
+
+        return EXIT_FAILURE;
+    }
+    else
+    {
+        rslt |= trace_bmi160(&traces[num_traces++], imu_frames);
+        rslt |= trace_bme280_int(&traces[num_traces++], env_frames);
+        rslt |= trace_bme_float(&traces[num_traces++], env_frames, false);
+        rslt |= trace_bme_float(&traces[num_traces++], env_frames, true);
+    }
+
+    if (rslt != SENSOR_CODEC_OK)
+    {
+        return EXIT_FAILURE;
+    }
+
+    printf("block %u B\n", block_size);
+    print_header();
+
+    for (uint8_t t = 0; t < num_traces; t++)
+    {
+        rslt = run(&traces[t], block_size, &res);
+        if (rslt != SENSOR_CODEC_OK)
+        {
+            fprintf(stderr, "%s: codec error %d\n", traces[t].name, rslt);
+            failed = 1;
+        }
+        else
+        {
+            print_result(&traces[t], &res);
+            failed |= (res.mismatches != 0);
+        }
+        free(traces[t].frames);
+    }
+
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
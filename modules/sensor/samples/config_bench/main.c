@@ -0,0 +1,471 @@
+/*
+ * BMI160 configuration transaction benchmark. Brings up a full interrupt
+ * set plus the FIFO on a simulated sensor, once writing every register
+ * through and once inside bmi160_config_begin/commit, with delay_ms only
+ * and with a delay_us hook. Checks every run leaves the same register file
+ * and reports bus transfers, bytes and the time spent on the bus and in
+ * write idle waits.
+ *
+ * A second scenario compares a cold start through bmi160_init and the
+ * config calls with bmi160_config_restore of a snapshot, on a sensor back
+ * from power off and on one that kept its configuration.
+ *
+ * Bus time assumes SPI at 8 MHz plus 5 us of set up per transfer.
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bmi160.h"
+
+#define BUS_XFER_OVERHEAD_NS 5000ULL
+#define BUS_BYTE_NS          1000ULL
+
+struct bus
+{
+    uint8_t regs[128];
+    uint32_t reads;
+    uint32_t writes;
+    uint32_t bytes;
+    uint64_t bus_ns;
+    uint64_t wait_ns;
+};
+
+static struct bus bus;
+
+static int8_t bus_read(uint8_t dev_addr, uint8_t reg_addr, uint8_t *data, uint16_t len)
+{
+    reg_addr &= 0x7F;
+    for (uint16_t i = 0; i < len; i++)
+    {
+        data[i] = bus.regs[(reg_addr + i) & 0x7F];
+    }
+    bus.reads++;
+    bus.bus_ns += BUS_XFER_OVERHEAD_NS + (len + 1) * BUS_BYTE_NS;
+
+    return BMI160_OK;
+}
+
+/* Power on state: registers zero, chip id, everything suspended */
+static void bus_power_on(void)
+{
+    memset(bus.regs, 0, sizeof(bus.regs));
+    bus.regs[BMI160_CHIP_ID_ADDR] = BMI160_CHIP_ID;
+}
+
+/* Soft reset and the accel and gyro power mode commands */
+static void bus_command(uint8_t cmd)
+{
+    uint8_t *pmu = &bus.regs[BMI160_PMU_STATUS_ADDR];
+
+    if (cmd == BMI160_SOFT_RESET_CMD)
+    {
+        bus_power_on();
+    }
+    else if ((cmd >= BMI160_ACCEL_SUSPEND_MODE) && (cmd <= BMI160_ACCEL_LOWPOWER_MODE))
+    {
+        *pmu = (uint8_t)((*pmu & ~0x30) | ((cmd - BMI160_ACCEL_SUSPEND_MODE) << 4));
+    }
+    else if ((cmd >= BMI160_GYRO_SUSPEND_MODE) && (cmd <= BMI160_GYRO_FASTSTARTUP_MODE))
+    {
+        *pmu = (uint8_t)((*pmu & ~0x0C) | ((cmd - BMI160_GYRO_SUSPEND_MODE) << 2));
+    }
+}
+
+static int8_t bus_write(uint8_t dev_addr, uint8_t reg_addr, uint8_t *data, uint16_t len)
+{
+    reg_addr &= 0x7F;
+    for (uint16_t i = 0; i < len; i++)
+    {
+        if (((reg_addr + i) & 0x7F) != BMI160_COMMAND_REG_ADDR)
+        {
+            bus.regs[(reg_addr + i) & 0x7F] = data[i];
+        }
+        else
+        {
+            bus_command(data[i]);
+        }
+    }
+    bus.writes++;
+    bus.bytes += len;
+    bus.bus_ns += BUS_XFER_OVERHEAD_NS + (len + 1) * BUS_BYTE_NS;
+
+    return BMI160_OK;
+}
+
+static void bus_delay_ms(uint32_t period)
+{
+    bus.wait_ns += (uint64_t)period * 1000000ULL;
+}
+
+static void bus_delay_us(uint32_t period)
+{
+    bus.wait_ns += (uint64_t)period * 1000ULL;
+}
+
+static int8_t set_int(struct bmi160_int_settg *cfg, enum bmi160_int_types type, enum bmi160_int_channel channel,
+                      struct bmi160_dev *dev)
+{
+    cfg->int_type = type;
+    cfg->int_channel = channel;
+    cfg->int_pin_settg.output_en = BMI160_ENABLE;
+    cfg->int_pin_settg.edge_ctrl = BMI160_ENABLE;
+
+    return bmi160_set_int_config(cfg, dev);
+}
+
+/* FIFO in header mode with a watermark, and every accel feature interrupt */
+static int8_t bring_up(struct bmi160_dev *dev)
+{
+    struct bmi160_int_settg cfg;
+    int8_t rslt;
+
+    rslt = bmi160_set_fifo_config(BMI160_FIFO_HEADER | BMI160_FIFO_TIME | BMI160_FIFO_ACCEL | BMI160_FIFO_GYRO,
+                                  BMI160_ENABLE,
+                                  dev);
+    if (rslt == BMI160_OK)
+    {
+        rslt = bmi160_set_fifo_wm(130, dev);
+    }
+
+    if (rslt == BMI160_OK)
+    {
+        memset(&cfg, 0, sizeof(cfg));
+        cfg.fifo_WTM_int_en = BMI160_ENABLE;
+        rslt = set_int(&cfg, BMI160_ACC_GYRO_FIFO_WATERMARK_INT, BMI160_INT_CHANNEL_1, dev);
+    }
+    if (rslt == BMI160_OK)
+    {
+        memset(&cfg, 0, sizeof(cfg));
+        cfg.int_type_cfg.acc_any_motion_int.anymotion_en = BMI160_ENABLE;
+        cfg.int_type_cfg.acc_any_motion_int.anymotion_x = BMI160_ENABLE;
+        cfg.int_type_cfg.acc_any_motion_int.anymotion_y = BMI160_ENABLE;
+        cfg.int_type_cfg.acc_any_motion_int.anymotion_z = BMI160_ENABLE;
+        cfg.int_type_cfg.acc_any_motion_int.anymotion_dur = 1;
+        cfg.int_type_cfg.acc_any_motion_int.anymotion_thr = 20;
+        rslt = set_int(&cfg, BMI160_ACC_ANY_MOTION_INT, BMI160_INT_CHANNEL_2, dev);
+    }
+    if (rslt == BMI160_OK)
+    {
+        memset(&cfg, 0, sizeof(cfg));
+        cfg.int_type_cfg.acc_tap_int.tap_en = BMI160_ENABLE;
+        cfg.int_type_cfg.acc_tap_int.tap_thr = 2;
+        cfg.int_type_cfg.acc_tap_int.tap_dur = 2;
+        rslt = set_int(&cfg, BMI160_ACC_DOUBLE_TAP_INT, BMI160_INT_CHANNEL_2, dev);
+    }
+    if (rslt == BMI160_OK)
+    {
+        memset(&cfg, 0, sizeof(cfg));
+        cfg.int_type_cfg.acc_orient_int.orient_en = BMI160_ENABLE;
+        cfg.int_type_cfg.acc_orient_int.orient_hyst = 2;
+        cfg.int_type_cfg.acc_orient_int.orient_theta = 10;
+        rslt = set_int(&cfg, BMI160_ACC_ORIENT_INT, BMI160_INT_CHANNEL_2, dev);
+    }
+    if (rslt == BMI160_OK)
+    {
+        memset(&cfg, 0, sizeof(cfg));
+        cfg.int_type_cfg.acc_flat_int.flat_en = BMI160_ENABLE;
+        cfg.int_type_cfg.acc_flat_int.flat_theta = 8;
+        cfg.int_type_cfg.acc_flat_int.flat_hold_time = 1;
+        rslt = set_int(&cfg, BMI160_ACC_FLAT_INT, BMI160_INT_CHANNEL_2, dev);
+    }
+    if (rslt == BMI160_OK)
+    {
+        memset(&cfg, 0, sizeof(cfg));
+        cfg.int_type_cfg.acc_low_g_int.low_en = BMI160_ENABLE;
+        cfg.int_type_cfg.acc_low_g_int.low_thres = 48;
+        cfg.int_type_cfg.acc_low_g_int.low_dur = 9;
+        rslt = set_int(&cfg, BMI160_ACC_LOW_G_INT, BMI160_INT_CHANNEL_1, dev);
+    }
+    if (rslt == BMI160_OK)
+    {
+        memset(&cfg, 0, sizeof(cfg));
+        cfg.int_type_cfg.acc_high_g_int.high_g_x = BMI160_ENABLE;
+        cfg.int_type_cfg.acc_high_g_int.high_g_y = BMI160_ENABLE;
+        cfg.int_type_cfg.acc_high_g_int.high_g_z = BMI160_ENABLE;
+        cfg.int_type_cfg.acc_high_g_int.high_thres = 192;
+        cfg.int_type_cfg.acc_high_g_int.high_dur = 4;
+        rslt = set_int(&cfg, BMI160_ACC_HIGH_G_INT, BMI160_INT_CHANNEL_1, dev);
+    }
+    if (rslt == BMI160_OK)
+    {
+        memset(&cfg, 0, sizeof(cfg));
+        cfg.int_type_cfg.acc_no_motion_int.no_motion_x = BMI160_ENABLE;
+        cfg.int_type_cfg.acc_no_motion_int.no_motion_y = BMI160_ENABLE;
+        cfg.int_type_cfg.acc_no_motion_int.no_motion_z = BMI160_ENABLE;
+        cfg.int_type_cfg.acc_no_motion_int.no_motion_sel = BMI160_ENABLE;
+        cfg.int_type_cfg.acc_no_motion_int.no_motion_dur = 4;
+        cfg.int_type_cfg.acc_no_motion_int.no_motion_thres = 10;
+        rslt = set_int(&cfg, BMI160_ACC_SLOW_NO_MOTION_INT, BMI160_INT_CHANNEL_1, dev);
+    }
+
+    return rslt;
+}
+
+struct run
+{
+    const char *name;
+    bool transaction;
+    bool delay_us;
+};
+
+static const struct run runs[] = {
+    { "write through, delay_ms", false, false },
+    { "write through, delay_us", false, true },
+    { "transaction, delay_ms", true, false },
+    { "transaction, delay_us", true, true },
+};
+
+static int run_power_mode(const char *mode_name, uint8_t accel_power, uint8_t gyro_power)
+{
+    uint8_t ref[sizeof(bus.regs)];
+    struct bmi160_shadow shadow;
+    struct bmi160_fifo_frame fifo;
+    struct bmi160_dev dev;
+    int failures = 0;
+    int8_t rslt;
+
+    printf("%s\n", mode_name);
+    printf("  %-24s %7s %7s %7s %10s %10s %10s\n", "", "writes", "bytes", "reads", "bus us", "wait us", "total us");
+    for (size_t r = 0; r < sizeof(runs) / sizeof(runs[0]); r++)
+    {
+        memset(&bus, 0, sizeof(bus));
+        memset(&dev, 0, sizeof(dev));
+        memset(&shadow, 0, sizeof(shadow));
+        memset(&fifo, 0, sizeof(fifo));
+        dev.interface = BMI160_SPI_INTF;
+        dev.read = bus_read;
+        dev.write = bus_write;
+        dev.delay_ms = bus_delay_ms;
+        dev.delay_us = runs[r].delay_us ? bus_delay_us : NULL;
+        dev.fifo = &fifo;
+        dev.prev_accel_cfg.power = accel_power;
+        dev.prev_gyro_cfg.power = gyro_power;
+        dev.accel_cfg.power = accel_power;
+        dev.gyro_cfg.power = gyro_power;
+        if (runs[r].transaction)
+        {
+            dev.shadow = &shadow;
+        }
+
+        rslt = runs[r].transaction ? bmi160_config_begin(&dev) : BMI160_OK;
+        if (rslt == BMI160_OK)
+        {
+            rslt = bring_up(&dev);
+        }
+        if ((rslt == BMI160_OK) && runs[r].transaction)
+        {
+            rslt = bmi160_config_commit(&dev);
+        }
+        if (rslt != BMI160_OK)
+        {
+            printf("  %-24s failed %d\n", runs[r].name, rslt);
+            failures++;
+            continue;
+        }
+
+        if (r == 0)
+        {
+            memcpy(ref, bus.regs, sizeof(ref));
+        }
+        else if (memcmp(ref, bus.regs, sizeof(ref)) != 0)
+        {
+            printf("  %-24s register file differs\n", runs[r].name);
+            failures++;
+        }
+
+        printf("  %-24s %7u %7u %7u %10.1f %10.1f %10.1f\n",
+               runs[r].name,
+               bus.writes,
+               bus.bytes,
+               bus.reads,
+               bus.bus_ns / 1000.0,
+               bus.wait_ns / 1000.0,
+               (bus.bus_ns + bus.wait_ns) / 1000.0);
+    }
+
+    return failures;
+}
+
+static void dev_setup(struct bmi160_dev *dev, struct bmi160_fifo_frame *fifo)
+{
+    memset(dev, 0, sizeof(*dev));
+    memset(fifo, 0, sizeof(*fifo));
+    dev->interface = BMI160_SPI_INTF;
+    dev->read = bus_read;
+    dev->write = bus_write;
+    dev->delay_ms = bus_delay_ms;
+    dev->delay_us = bus_delay_us;
+    dev->fifo = fifo;
+}
+
+/* The application start up: init, sensor config, interrupts, FIFO and
+ * offsets from a past FOC */
+static int8_t cold_start(struct bmi160_dev *dev, uint8_t accel_power, uint8_t gyro_power)
+{
+    struct bmi160_foc_conf foc_conf;
+    struct bmi160_offsets offsets;
+    int8_t rslt;
+
+    rslt = bmi160_init(dev);
+    if (rslt == BMI160_OK)
+    {
+        dev->accel_cfg.power = accel_power;
+        dev->accel_cfg.odr = BMI160_ACCEL_ODR_100HZ;
+        dev->accel_cfg.range = BMI160_ACCEL_RANGE_4G;
+        dev->accel_cfg.bw = (accel_power == BMI160_ACCEL_LOWPOWER_MODE) ? BMI160_ACCEL_BW_OSR4_AVG1 :
+                            BMI160_ACCEL_BW_NORMAL_AVG4;
+        dev->gyro_cfg.power = gyro_power;
+        dev->gyro_cfg.odr = BMI160_GYRO_ODR_800HZ;
+        dev->gyro_cfg.range = BMI160_GYRO_RANGE_2000_DPS;
+        dev->gyro_cfg.bw = BMI160_GYRO_BW_NORMAL_MODE;
+        rslt = bmi160_set_sens_conf(dev);
+    }
+    if (rslt == BMI160_OK)
+    {
+        rslt = bring_up(dev);
+    }
+    if (rslt == BMI160_OK)
+    {
+        memset(&foc_conf, 0, sizeof(foc_conf));
+        foc_conf.acc_off_en = BMI160_ENABLE;
+        foc_conf.gyro_off_en = BMI160_ENABLE;
+        offsets.off_acc_x = 12;
+        offsets.off_acc_y = -7;
+        offsets.off_acc_z = 30;
+        offsets.off_gyro_x = -100;
+        offsets.off_gyro_y = 250;
+        offsets.off_gyro_z = -3;
+        rslt = bmi160_set_offsets(&foc_conf, &offsets, dev);
+    }
+
+    return rslt;
+}
+
+static void print_bus(const char *name)
+{
+    printf("  %-24s %7u %7u %7u %10.1f %10.1f %10.1f\n",
+           name,
+           bus.writes,
+           bus.bytes,
+           bus.reads,
+           bus.bus_ns / 1000.0,
+           bus.wait_ns / 1000.0,
+           (bus.bus_ns + bus.wait_ns) / 1000.0);
+}
+
+/* Window registers the image holds, plus the power status */
+static int same_config(const uint8_t *ref)
+{
+    for (uint8_t i = 0; i < BMI160_SHADOW_LEN; i++)
+    {
+        if (((BMI160_SHADOW_REG_MASK >> i) & 1) &&
+            (bus.regs[BMI160_SHADOW_START_ADDR + i] != ref[BMI160_SHADOW_START_ADDR + i]))
+        {
+            return 0;
+        }
+    }
+
+    return bus.regs[BMI160_PMU_STATUS_ADDR] == ref[BMI160_PMU_STATUS_ADDR];
+}
+
+static int run_restore(const char *mode_name, uint8_t accel_power, uint8_t gyro_power)
+{
+    uint8_t ref[sizeof(bus.regs)];
+    uint8_t image[BMI160_CONFIG_IMAGE_LEN];
+    uint16_t image_len = sizeof(image);
+    struct bmi160_fifo_frame fifo;
+    struct bmi160_dev dev;
+    struct bmi160_dev saved;
+    int failures = 0;
+    int8_t rslt;
+
+    printf("%s\n", mode_name);
+    printf("  %-24s %7s %7s %7s %10s %10s %10s\n", "", "writes", "bytes", "reads", "bus us", "wait us", "total us");
+
+    memset(&bus, 0, sizeof(bus));
+    bus_power_on();
+    dev_setup(&dev, &fifo);
+    rslt = cold_start(&dev, accel_power, gyro_power);
+    if (rslt == BMI160_OK)
+    {
+        print_bus("init and config calls");
+        memcpy(ref, bus.regs, sizeof(ref));
+        saved = dev;
+        rslt = bmi160_config_snapshot(image, &image_len, &dev);
+    }
+    if (rslt != BMI160_OK)
+    {
+        printf("  cold start failed %d\n", rslt);
+
+        return 1;
+    }
+
+    for (int warm = 0; warm < 2; warm++)
+    {
+        uint8_t kept[sizeof(bus.regs)];
+
+        memcpy(kept, bus.regs, sizeof(kept));
+        memset(&bus, 0, sizeof(bus));
+        if (warm)
+        {
+            memcpy(bus.regs, kept, sizeof(kept));
+        }
+        else
+        {
+            bus_power_on();
+        }
+        dev_setup(&dev, &fifo);
+        rslt = bmi160_config_restore(image, image_len, &dev);
+        if (rslt != BMI160_OK)
+        {
+            printf("  restore failed %d\n", rslt);
+            failures++;
+            continue;
+        }
+        print_bus(warm ? "restore, config kept" : "restore after power off");
+        if (!same_config(ref))
+        {
+            printf("  registers differ from the cold start\n");
+            failures++;
+        }
+        if ((memcmp(&dev.accel_cfg, &saved.accel_cfg, sizeof(dev.accel_cfg)) != 0) ||
+            (memcmp(&dev.gyro_cfg, &saved.gyro_cfg, sizeof(dev.gyro_cfg)) != 0) ||
+            (fifo.fifo_header_enable != saved.fifo->fifo_header_enable) ||
+            (fifo.fifo_data_enable != saved.fifo->fifo_data_enable))
+        {
+            printf("  driver state differs from the cold start\n");
+            failures++;
+        }
+    }
+
+    /* A corrupted image is refused before any bus access */
+    image[BMI160_CONFIG_IMAGE_HDR_LEN + 3] ^= 0x01;
+    memset(&bus, 0, sizeof(bus));
+    dev_setup(&dev, &fifo);
+    if ((bmi160_config_restore(image, image_len, &dev) != BMI160_E_INVALID_INPUT) || (bus.reads != 0))
+    {
+        printf("  corrupted image accepted\n");
+        failures++;
+    }
+
+    return failures;
+}
+
+int main(void)
+{
+    int failures = 0;
+
+    failures += run_power_mode("accel and gyro normal mode, burst writes", BMI160_ACCEL_NORMAL_MODE,
+                               BMI160_GYRO_NORMAL_MODE);
+    failures += run_power_mode("accel low power, gyro suspend, single byte writes", BMI160_ACCEL_LOWPOWER_MODE,
+                               BMI160_GYRO_SUSPEND_MODE);
+    failures += run_restore("warm start, accel and gyro normal mode", BMI160_ACCEL_NORMAL_MODE,
+                            BMI160_GYRO_NORMAL_MODE);
+    failures += run_restore("warm start, accel low power, gyro suspend", BMI160_ACCEL_LOWPOWER_MODE,
+                            BMI160_GYRO_SUSPEND_MODE);
+
+    return (failures == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
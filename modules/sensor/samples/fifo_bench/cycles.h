@@ -0,0 +1,27 @@
+#ifndef CYCLES_H_
+#define CYCLES_H_
+
+#include <stdint.h>
+#include <time.h>
+
+/* TSC cycles on x86, nanoseconds elsewhere */
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define CYCLE_UNIT    "cyc"
+static inline uint64_t cycles(void)
+{
+    return __rdtsc();
+}
+#else
+#define CYCLE_UNIT    "ns"
+static inline uint64_t cycles(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+#endif
+
+#endif
@@ -0,0 +1,651 @@
+/*
+ * BMI160 FIFO parser benchmark. Builds synthetic 1 KB FIFO reads, parses
+ * them with bmi160_extract_accel/gyro/aux (one pass per enabled sensor) and
+ * with bmi160_fifo_demux (one pass for all), checks both give the same
+ * frames and reports the cost per KB of FIFO data. The batch column parses
+ * all reads of a scenario, back to back, in one bmi160_fifo_batch_parse
+ * call and checks it, and the per axis output, against the per read
+ * results.
+ *
+ * Scenarios cover header mode with mixed rate sensors (frames carrying any
+ * subset of aux/gyro/accel, skip, input config and sensor time frames) and
+ * header-less mode with fixed frames.
+ *
+ * With -s the bmi160_stream engine runs instead, watermark interrupt driven
+ * on a simulated sensor, see stream_sim.h. With -u the bulk header-less
+ * unpack APIs are measured against the per frame ones, see unpack_bench.h.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bmi160.h"
+#include "cycles.h"
+#include "stream_sim.h"
+#include "unpack_bench.h"
+
+/* FIFO fill level plus the sensor time frame the chip appends on a read */
+#define FIFO_SIZE             1024U
+#define FIFO_READ_SIZE        (FIFO_SIZE + 4U)
+#define MAX_FRAMES            255U
+#define DEFAULT_NUM_READS     512U
+#define DEFAULT_ITERATIONS    200U
+#define DEFAULT_ODR_HZ        1600U
+#define DEFAULT_WATERMARK     520U
+#define DEFAULT_STREAM_READ   640U
+#define DEFAULT_SPI_HZ        8000000U
+#define DEFAULT_TASK_DELAY_US 200U
+
+struct scenario
+{
+    const char *name;
+    uint8_t header;
+
+    /* BMI160_FIFO_M/G/A_ENABLE bits */
+    uint8_t data_enable;
+
+    /* Gyro and aux run at accel ODR divided by these, header mode only */
+    uint8_t gyro_div;
+    uint8_t aux_div;
+};
+
+static const struct scenario scenarios[] = {
+    { "hdr_a+g/2+m/16", 1, BMI160_FIFO_M_G_A_ENABLE, 2, 16 },
+    { "hdr_ga", 1, BMI160_FIFO_G_A_ENABLE, 1, 1 },
+    { "hdr_mga", 1, BMI160_FIFO_M_G_A_ENABLE, 1, 1 },
+    { "nohdr_ga", 0, BMI160_FIFO_G_A_ENABLE, 1, 1 },
+    { "nohdr_mga", 0, BMI160_FIFO_M_G_A_ENABLE, 1, 1 },
+};
+
+struct fifo_read
+{
+    uint8_t data[FIFO_READ_SIZE];
+    uint16_t length;
+};
+
+struct frames
+{
+    struct bmi160_sensor_data accel[MAX_FRAMES];
+    struct bmi160_sensor_data gyro[MAX_FRAMES];
+    struct bmi160_aux_data aux[MAX_FRAMES];
+    uint8_t accel_len;
+    uint8_t gyro_len;
+    uint8_t aux_len;
+    uint32_t sensor_time;
+};
+
+/* Frames of all reads of a scenario */
+struct batch_frames
+{
+    struct bmi160_sensor_data *accel;
+    struct bmi160_sensor_data *gyro;
+    struct bmi160_aux_data *aux;
+    size_t accel_len;
+    size_t gyro_len;
+    size_t aux_len;
+    uint32_t sensor_time;
+};
+
+/* xorshift32, fixed seed so runs are comparable */
+static uint32_t rng_state = 0x12345678;
+
+static uint32_t rng(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+
+    return rng_state;
+}
+
+static void put_random(uint8_t *p, uint8_t len)
+{
+    for (uint8_t i = 0; i < len; i++)
+    {
+        p[i] = (uint8_t)rng();
+    }
+}
+
+/* One FIFO read as the chip returns it, filled up to FIFO_SIZE */
+static void build_read(const struct scenario *sc, struct fifo_read *rd)
+{
+    uint16_t len = 0;
+    uint8_t frame_len;
+    uint8_t header;
+    bool aux;
+    bool gyro;
+
+    memset(rd->data, 0, sizeof(rd->data));
+
+    if (sc->header && ((rng() & 0x3) == 0))
+    {
+        /* Overflow before this read, frames were dropped */
+        rd->data[len++] = BMI160_FIFO_HEAD_SKIP_FRAME;
+        rd->data[len++] = (uint8_t)(1 + (rng() & 0x0F));
+    }
+
+    for (uint32_t tick = rng() & 0xFF;; tick++)
+    {
+        if (!sc->header)
+        {
+            frame_len = ((sc->data_enable & BMI160_FIFO_M_ENABLE) ? BMI160_FIFO_M_LENGTH : 0) +
+                        ((sc->data_enable & BMI160_FIFO_G_ENABLE) ? BMI160_FIFO_G_LENGTH : 0) +
+                        ((sc->data_enable & BMI160_FIFO_A_ENABLE) ? BMI160_FIFO_A_LENGTH : 0);
+            if ((len + frame_len) > FIFO_SIZE)
+            {
+                break;
+            }
+            put_random(&rd->data[len], frame_len);
+            len += frame_len;
+            continue;
+        }
+
+        if ((tick % 97) == 0)
+        {
+            /* Config change in the stream */
+            if ((len + 2) > FIFO_SIZE)
+            {
+                break;
+            }
+            rd->data[len++] = BMI160_FIFO_HEAD_INPUT_CONFIG;
+            rd->data[len++] = (uint8_t)rng();
+        }
+
+        gyro = (sc->data_enable & BMI160_FIFO_G_ENABLE) && ((tick % sc->gyro_div) == 0);
+        aux = (sc->data_enable & BMI160_FIFO_M_ENABLE) && ((tick % sc->aux_div) == 0);
+        header = BMI160_FIFO_HEAD_A;
+        frame_len = BMI160_FIFO_A_LENGTH;
+        if (gyro)
+        {
+            header |= BMI160_FIFO_HEAD_G;
+            frame_len += BMI160_FIFO_G_LENGTH;
+        }
+        if (aux)
+        {
+            header |= BMI160_FIFO_HEAD_M;
+            frame_len += BMI160_FIFO_M_LENGTH;
+        }
+        if ((len + 1 + frame_len) > FIFO_SIZE)
+        {
+            break;
+        }
+
+        /* Interrupt tag bits set now and then, the parsers mask them */
+        rd->data[len++] = header | (((rng() & 0x1F) == 0) ? 0x01 : 0x00);
+        put_random(&rd->data[len], frame_len);
+        len += frame_len;
+    }
+
+    if (sc->header)
+    {
+        rd->data[len++] = BMI160_FIFO_HEAD_SENSOR_TIME;
+        put_random(&rd->data[len], BMI160_SENSOR_TIME_LENGTH);
+        len += BMI160_SENSOR_TIME_LENGTH;
+    }
+    else if ((len + 2) <= FIFO_READ_SIZE)
+    {
+        /* Reads past the fill level return the empty marker */
+        rd->data[len++] = FIFO_CONFIG_MSB_CHECK;
+        rd->data[len++] = FIFO_CONFIG_LSB_CHECK;
+    }
+
+    rd->length = len;
+}
+
+static void fifo_rewind(struct bmi160_fifo_frame *fifo, const struct fifo_read *rd)
+{
+    fifo->data = (uint8_t *)rd->data;
+    fifo->length = rd->length;
+    fifo->accel_byte_start_idx = 0;
+    fifo->gyro_byte_start_idx = 0;
+    fifo->aux_byte_start_idx = 0;
+    fifo->sensor_time = 0;
+    fifo->skipped_frame_count = 0;
+}
+
+static void parse_three_pass(const struct scenario *sc, struct bmi160_dev *dev, struct frames *out)
+{
+    out->accel_len = 0;
+    out->gyro_len = 0;
+    out->aux_len = 0;
+
+    if (sc->data_enable & BMI160_FIFO_A_ENABLE)
+    {
+        out->accel_len = MAX_FRAMES;
+        bmi160_extract_accel(out->accel, &out->accel_len, dev);
+    }
+    if (sc->data_enable & BMI160_FIFO_G_ENABLE)
+    {
+        out->gyro_len = MAX_FRAMES;
+        bmi160_extract_gyro(out->gyro, &out->gyro_len, dev);
+    }
+    if (sc->data_enable & BMI160_FIFO_M_ENABLE)
+    {
+        out->aux_len = MAX_FRAMES;
+        bmi160_extract_aux(out->aux, &out->aux_len, dev);
+    }
+    out->sensor_time = dev->fifo->sensor_time;
+}
+
+static void parse_demux(const struct scenario *sc, struct bmi160_dev *dev, struct frames *out)
+{
+    struct bmi160_fifo_demux demux;
+
+    demux.accel = (sc->data_enable & BMI160_FIFO_A_ENABLE) ? out->accel : NULL;
+    demux.gyro = (sc->data_enable & BMI160_FIFO_G_ENABLE) ? out->gyro : NULL;
+    demux.aux = (sc->data_enable & BMI160_FIFO_M_ENABLE) ? out->aux : NULL;
+    demux.accel_len = MAX_FRAMES;
+    demux.gyro_len = MAX_FRAMES;
+    demux.aux_len = MAX_FRAMES;
+
+    bmi160_fifo_demux(&demux, dev);
+
+    out->accel_len = (demux.accel != NULL) ? demux.accel_len : 0;
+    out->gyro_len = (demux.gyro != NULL) ? demux.gyro_len : 0;
+    out->aux_len = (demux.aux != NULL) ? demux.aux_len : 0;
+    out->sensor_time = demux.sensor_time_valid ? demux.sensor_time : 0;
+}
+
+static void parse_batch(const struct scenario *sc,
+                        struct bmi160_dev *dev,
+                        const uint8_t *data,
+                        size_t length,
+                        const uint16_t *read_len,
+                        size_t read_count,
+                        size_t capacity,
+                        struct batch_frames *out)
+{
+    struct bmi160_fifo_batch batch;
+
+    batch.data = data;
+    batch.length = length;
+    batch.read_len = read_len;
+    batch.read_count = read_count;
+    batch.accel = (sc->data_enable & BMI160_FIFO_A_ENABLE) ? out->accel : NULL;
+    batch.gyro = (sc->data_enable & BMI160_FIFO_G_ENABLE) ? out->gyro : NULL;
+    batch.aux = (sc->data_enable & BMI160_FIFO_M_ENABLE) ? out->aux : NULL;
+    batch.accel_soa = NULL;
+    batch.gyro_soa = NULL;
+    batch.frames = NULL;
+    batch.accel_len = capacity;
+    batch.gyro_len = capacity;
+    batch.aux_len = capacity;
+    batch.frames_len = 0;
+    batch.data_index = 0;
+    batch.read_index = 0;
+
+    if (bmi160_fifo_batch_parse(&batch, dev) != BMI160_OK)
+    {
+        batch.accel_len = 0;
+        batch.gyro_len = 0;
+        batch.aux_len = 0;
+    }
+
+    out->accel_len = (batch.accel != NULL) ? batch.accel_len : 0;
+    out->gyro_len = (batch.gyro != NULL) ? batch.gyro_len : 0;
+    out->aux_len = (batch.aux != NULL) ? batch.aux_len : 0;
+    out->sensor_time = batch.sensor_time_valid ? batch.sensor_time : 0;
+}
+
+/* Same as parse_batch into per axis arrays, aux frames as before */
+static void parse_batch_soa(const struct scenario *sc,
+                            struct bmi160_dev *dev,
+                            const uint8_t *data,
+                            size_t length,
+                            const uint16_t *read_len,
+                            size_t read_count,
+                            size_t capacity,
+                            int16_t *axes[6],
+                            struct batch_frames *out)
+{
+    struct bmi160_sensor_soa accel = { axes[0], axes[1], axes[2], NULL, capacity, 0 };
+    struct bmi160_sensor_soa gyro = { axes[3], axes[4], axes[5], NULL, capacity, 0 };
+    struct bmi160_fifo_batch batch;
+
+    memset(&batch, 0, sizeof(batch));
+    batch.data = data;
+    batch.length = length;
+    batch.read_len = read_len;
+    batch.read_count = read_count;
+    batch.accel_soa = (sc->data_enable & BMI160_FIFO_A_ENABLE) ? &accel : NULL;
+    batch.gyro_soa = (sc->data_enable & BMI160_FIFO_G_ENABLE) ? &gyro : NULL;
+    batch.aux = (sc->data_enable & BMI160_FIFO_M_ENABLE) ? out->aux : NULL;
+    batch.aux_len = capacity;
+
+    if (bmi160_fifo_batch_parse(&batch, dev) != BMI160_OK)
+    {
+        accel.count = 0;
+        gyro.count = 0;
+        batch.aux_len = 0;
+    }
+
+    out->accel_len = accel.count;
+    out->gyro_len = gyro.count;
+    out->aux_len = (batch.aux != NULL) ? batch.aux_len : 0;
+    out->sensor_time = batch.sensor_time_valid ? batch.sensor_time : 0;
+    for (size_t i = 0; i < accel.count; i++)
+    {
+        out->accel[i].x = accel.x[i];
+        out->accel[i].y = accel.y[i];
+        out->accel[i].z = accel.z[i];
+    }
+    for (size_t i = 0; i < gyro.count; i++)
+    {
+        out->gyro[i].x = gyro.x[i];
+        out->gyro[i].y = gyro.y[i];
+        out->gyro[i].z = gyro.z[i];
+    }
+}
+
+/* Appends the frames of one read to all */
+static void append_frames(struct batch_frames *all, const struct frames *f)
+{
+    memcpy(&all->accel[all->accel_len], f->accel, f->accel_len * sizeof(f->accel[0]));
+    memcpy(&all->gyro[all->gyro_len], f->gyro, f->gyro_len * sizeof(f->gyro[0]));
+    memcpy(&all->aux[all->aux_len], f->aux, f->aux_len * sizeof(f->aux[0]));
+    all->accel_len += f->accel_len;
+    all->gyro_len += f->gyro_len;
+    all->aux_len += f->aux_len;
+    all->sensor_time = f->sensor_time;
+}
+
+static bool same_xyz(const struct bmi160_sensor_data *a, const struct bmi160_sensor_data *b, size_t len)
+{
+    for (size_t i = 0; i < len; i++)
+    {
+        if ((a[i].x != b[i].x) || (a[i].y != b[i].y) || (a[i].z != b[i].z))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool same_frames(const struct frames *a, const struct frames *b)
+{
+    if ((a->accel_len != b->accel_len) || (a->gyro_len != b->gyro_len) || (a->aux_len != b->aux_len) ||
+        (a->sensor_time != b->sensor_time))
+    {
+        return false;
+    }
+
+    return same_xyz(a->accel, b->accel, a->accel_len) && same_xyz(a->gyro, b->gyro, a->gyro_len) &&
+           (memcmp(a->aux, b->aux, a->aux_len * sizeof(a->aux[0])) == 0);
+}
+
+static bool same_batch(const struct batch_frames *a, const struct batch_frames *b)
+{
+    if ((a->accel_len != b->accel_len) || (a->gyro_len != b->gyro_len) || (a->aux_len != b->aux_len) ||
+        (a->sensor_time != b->sensor_time))
+    {
+        return false;
+    }
+
+    return same_xyz(a->accel, b->accel, a->accel_len) && same_xyz(a->gyro, b->gyro, a->gyro_len) &&
+           (memcmp(a->aux, b->aux, a->aux_len * sizeof(a->aux[0])) == 0);
+}
+
+static bool alloc_batch(struct batch_frames *f, size_t capacity)
+{
+    f->accel = malloc(capacity * sizeof(*f->accel));
+    f->gyro = malloc(capacity * sizeof(*f->gyro));
+    f->aux = malloc(capacity * sizeof(*f->aux));
+
+    return (f->accel != NULL) && (f->gyro != NULL) && (f->aux != NULL);
+}
+
+static void free_batch(struct batch_frames *f)
+{
+    free(f->accel);
+    free(f->gyro);
+    free(f->aux);
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [-u] [-n reads] [-i iterations]\n"
+            "       %s -s ms [-o odr_hz] [-w watermark] [-b read_size] [-c spi_khz] [-d task_delay_us]\n"
+            "          [-p drift_ppm]\n"
+            "  -u  header-less bulk unpack instead of the parsers\n"
+            "  -n  FIFO reads per scenario (default %u)\n"
+            "  -i  passes over the reads per parser (default %u)\n"
+            "  -s  stream accel+gyro through bmi160_stream for ms of virtual time\n"
+            "  -o  ODR (default %u)\n"
+            "  -w  FIFO watermark in bytes (default %u)\n"
+            "  -b  bytes per FIFO read (default %u)\n"
+            "  -c  SPI clock in kHz (default %u)\n"
+            "  -d  interrupt to consumer task delay in us (default %u)\n"
+            "  -p  sensor clock drift against the host in ppm (default 0)\n",
+            prog,
+            prog,
+            DEFAULT_NUM_READS,
+            DEFAULT_ITERATIONS,
+            DEFAULT_ODR_HZ,
+            DEFAULT_WATERMARK,
+            DEFAULT_STREAM_READ,
+            DEFAULT_SPI_HZ / 1000,
+            DEFAULT_TASK_DELAY_US);
+}
+
+int main(int argc, char **argv)
+{
+    struct bmi160_fifo_frame fifo;
+    struct bmi160_dev dev;
+    struct fifo_read *reads;
+    static struct frames ref, out;
+    struct batch_frames all_ref, all_out;
+    uint8_t *concat;
+    uint16_t *read_len;
+    int16_t *axes[6] = { NULL };
+    size_t concat_len, capacity;
+    uint32_t num_reads = DEFAULT_NUM_READS;
+    uint32_t iterations = DEFAULT_ITERATIONS;
+    uint32_t mismatches;
+    uint64_t bytes, frames, t0, three_cycles, demux_cycles, batch_cycles;
+    double three_kb, demux_kb, batch_kb;
+    struct stream_sim_config stream_cfg = {
+        DEFAULT_ODR_HZ, 0, DEFAULT_WATERMARK, DEFAULT_STREAM_READ, DEFAULT_SPI_HZ, DEFAULT_TASK_DELAY_US, 0
+    };
+    bool unpack = false;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:i:s:o:w:b:c:d:p:uh")) != -1)
+    {
+        switch (opt)
+        {
+            case 'u':
+                unpack = true;
+                break;
+            case 's':
+                stream_cfg.duration_ms = strtoul(optarg, NULL, 0);
+                break;
+            case 'o':
+                stream_cfg.odr_hz = strtoul(optarg, NULL, 0);
+                break;
+            case 'w':
+                stream_cfg.watermark = (uint16_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'b':
+                stream_cfg.buf_len = (uint16_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'c':
+                stream_cfg.spi_hz = strtoul(optarg, NULL, 0) * 1000;
+                break;
+            case 'd':
+                stream_cfg.task_delay_us = strtoul(optarg, NULL, 0);
+                break;
+            case 'p':
+                stream_cfg.drift_ppm = (int32_t)strtol(optarg, NULL, 0);
+                break;
+            case 'n':
+                num_reads = strtoul(optarg, NULL, 0);
+                break;
+            case 'i':
+                iterations = strtoul(optarg, NULL, 0);
+                break;
+            default:
+                usage(argv[0]);
+
+                return EXIT_FAILURE;
+        }
+    }
+
+    if ((num_reads == 0) || (iterations == 0) || (stream_cfg.odr_hz == 0) || (stream_cfg.spi_hz == 0))
+    {
+        usage(argv[0]);
+
+        return EXIT_FAILURE;
+    }
+
+    if (stream_cfg.duration_ms != 0)
+    {
+        return (stream_sim_run(&stream_cfg) == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (unpack)
+    {
+        return (unpack_bench_run(num_reads, iterations) == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    capacity = (size_t)num_reads * MAX_FRAMES;
+    reads = malloc((size_t)num_reads * sizeof(*reads));
+    concat = malloc((size_t)num_reads * FIFO_READ_SIZE);
+    read_len = malloc((size_t)num_reads * sizeof(*read_len));
+    for (int a = 0; a < 6; a++)
+    {
+        axes[a] = malloc(capacity * sizeof(*axes[a]));
+    }
+    if ((reads == NULL) || (concat == NULL) || (read_len == NULL) || !alloc_batch(&all_ref, capacity) ||
+        !alloc_batch(&all_out, capacity) || (axes[0] == NULL) || (axes[1] == NULL) || (axes[2] == NULL) ||
+        (axes[3] == NULL) || (axes[4] == NULL) || (axes[5] == NULL))
+    {
+        perror("fifo_bench: malloc");
+
+        return EXIT_FAILURE;
+    }
+
+    memset(&dev, 0, sizeof(dev));
+    memset(&fifo, 0, sizeof(fifo));
+    dev.fifo = &fifo;
+
+    printf("%-16s %7s %7s %12s %12s %8s %12s %s\n",
+           "scenario",
+           "KB",
+           "frames",
+           "3pass/KB",
+           "demux/KB",
+           "speedup",
+           "batch/KB",
+           "check");
+
+    for (size_t s = 0; s < sizeof(scenarios) / sizeof(scenarios[0]); s++)
+    {
+        const struct scenario *sc = &scenarios[s];
+
+        fifo.fifo_header_enable = sc->header ? BMI160_FIFO_HEAD_ENABLE : 0;
+        fifo.fifo_data_enable = sc->data_enable;
+
+        bytes = 0;
+        frames = 0;
+        mismatches = 0;
+        concat_len = 0;
+        all_ref.accel_len = 0;
+        all_ref.gyro_len = 0;
+        all_ref.aux_len = 0;
+        for (uint32_t r = 0; r < num_reads; r++)
+        {
+            build_read(sc, &reads[r]);
+            bytes += reads[r].length;
+            memcpy(&concat[concat_len], reads[r].data, reads[r].length);
+            concat_len += reads[r].length;
+            read_len[r] = reads[r].length;
+
+            fifo_rewind(&fifo, &reads[r]);
+            parse_three_pass(sc, &dev, &ref);
+            fifo_rewind(&fifo, &reads[r]);
+            parse_demux(sc, &dev, &out);
+            frames += (uint64_t)ref.accel_len + ref.gyro_len + ref.aux_len;
+            if (!same_frames(&ref, &out))
+            {
+                mismatches++;
+            }
+            append_frames(&all_ref, &ref);
+        }
+
+        parse_batch(sc, &dev, concat, concat_len, read_len, num_reads, capacity, &all_out);
+        if (!same_batch(&all_ref, &all_out))
+        {
+            mismatches++;
+        }
+        parse_batch_soa(sc, &dev, concat, concat_len, read_len, num_reads, capacity, axes, &all_out);
+        if (!same_batch(&all_ref, &all_out))
+        {
+            mismatches++;
+        }
+
+        t0 = cycles();
+        for (uint32_t it = 0; it < iterations; it++)
+        {
+            for (uint32_t r = 0; r < num_reads; r++)
+            {
+                fifo_rewind(&fifo, &reads[r]);
+                parse_three_pass(sc, &dev, &out);
+            }
+        }
+        three_cycles = cycles() - t0;
+
+        t0 = cycles();
+        for (uint32_t it = 0; it < iterations; it++)
+        {
+            for (uint32_t r = 0; r < num_reads; r++)
+            {
+                fifo_rewind(&fifo, &reads[r]);
+                parse_demux(sc, &dev, &out);
+            }
+        }
+        demux_cycles = cycles() - t0;
+
+        t0 = cycles();
+        for (uint32_t it = 0; it < iterations; it++)
+        {
+            parse_batch(sc, &dev, concat, concat_len, read_len, num_reads, capacity, &all_out);
+        }
+        batch_cycles = cycles() - t0;
+
+        three_kb = (double)three_cycles * 1024.0 / ((double)bytes * iterations);
+        demux_kb = (double)demux_cycles * 1024.0 / ((double)bytes * iterations);
+        batch_kb = (double)batch_cycles * 1024.0 / ((double)bytes * iterations);
+        printf("%-16s %7.1f %7llu %9.0f %s %9.0f %s %7.2fx %9.0f %s %s\n",
+               sc->name,
+               bytes / 1024.0,
+               (unsigned long long)frames,
+               three_kb,
+               CYCLE_UNIT,
+               demux_kb,
+               CYCLE_UNIT,
+               three_kb / demux_kb,
+               batch_kb,
+               CYCLE_UNIT,
+               (mismatches == 0) ? "ok" : "MISMATCH");
+    }
+
+    free(reads);
+    free(concat);
+    free(read_len);
+    free_batch(&all_ref);
+    free_batch(&all_out);
+    for (int a = 0; a < 6; a++)
+    {
+        free(axes[a]);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,444 @@
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "bmi160_stream.h"
+#include "bmi160_ts.h"
+#include "stream_sim.h"
+
+#define SIM_FIFO_SIZE       1024U
+#define SIM_FRAME_LEN       (1U + BMI160_FIFO_GA_LENGTH)
+#define SIM_FRAMES_LEN      255U
+/* Chip select, command and DMA set up around every burst */
+#define SIM_XFER_OVERHEAD   5000ULL
+/* Sensor time ticks every 39.0625 us */
+#define SIM_TIME_TICK_NS    39062.5
+#define SIM_TIME_TICK_HZ    25600U
+#define NS_NONE             UINT64_MAX
+
+struct sim
+{
+    uint64_t now_ns;
+    uint8_t regs[128];
+    /* FIFO of whole accel+gyro frames, oldest first */
+    uint8_t fifo[SIM_FIFO_SIZE];
+    uint16_t fill;
+    uint8_t skipped;
+    bool wm_line;
+    uint32_t sample_seq;
+    uint64_t generated;
+    /* Read in flight */
+    uint64_t dma_done_ns;
+    /* Consumer task wake up */
+    uint64_t task_ns;
+    uint32_t task_delay_ns;
+    uint32_t spi_hz;
+    uint32_t wakeups;
+    /* Consumer check */
+    uint32_t next_seq;
+    uint64_t gaps;
+    uint64_t consumed;
+    uint32_t last_read_seq;
+    uint64_t latency_sum_us;
+    uint32_t latency_samples;
+    /* Sensor clock ticks per host ns tick, sample period in sensor ticks */
+    double clock;
+    uint32_t period;
+    /* Timestamp check */
+    struct bmi160_ts ts;
+    uint64_t ts_err_max_ns;
+    uint64_t host_err_max_ns;
+    uint64_t host_checked;
+    struct bmi160_stream stream;
+};
+
+static struct sim sim;
+
+static uint32_t sim_time_us(void)
+{
+    return (uint32_t)(sim.now_ns / 1000);
+}
+
+/* Host time of sample n, the first one after the sensor tick it is due */
+static uint64_t sim_sample_ns(uint32_t n)
+{
+    return (uint64_t)ceil((double)(n + 1) * sim.period * SIM_TIME_TICK_NS / sim.clock) + 1;
+}
+
+static uint64_t sim_abs_diff(uint64_t a, uint64_t b)
+{
+    return (a > b) ? (a - b) : (b - a);
+}
+
+static void sim_delay_ms(uint32_t period)
+{
+    sim.now_ns += (uint64_t)period * 1000000ULL;
+}
+
+static uint16_t sim_watermark(void)
+{
+    return (uint16_t)sim.regs[BMI160_FIFO_CONFIG_0_ADDR] * BMI160_STREAM_WM_UNIT;
+}
+
+/* Watermark interrupt on the rising edge of fill >= watermark */
+static void sim_check_wm(void)
+{
+    bool level = (sim.regs[BMI160_INT_ENABLE_1_ADDR] & BMI160_FIFO_WTM_INT_MSK) && (sim.fill >= sim_watermark());
+
+    if (level && !sim.wm_line)
+    {
+        sim.wakeups++;
+        bmi160_stream_irq(&sim.stream);
+    }
+    sim.wm_line = level;
+}
+
+/* Accel and gyro x carry the sample number so the consumer sees gaps */
+static void sim_push_sample(void)
+{
+    uint8_t *frame;
+
+    while ((sim.fill + SIM_FRAME_LEN) > SIM_FIFO_SIZE)
+    {
+        /* Full FIFO drops the oldest frame */
+        memmove(sim.fifo, &sim.fifo[SIM_FRAME_LEN], sim.fill - SIM_FRAME_LEN);
+        sim.fill -= SIM_FRAME_LEN;
+        if (sim.skipped < UINT8_MAX)
+        {
+            sim.skipped++;
+        }
+    }
+
+    frame = &sim.fifo[sim.fill];
+    frame[0] = BMI160_FIFO_HEAD_G_A;
+    for (uint8_t i = 1; i < SIM_FRAME_LEN; i++)
+    {
+        frame[i] = (uint8_t)(sim.sample_seq * 31 + i);
+    }
+    frame[1] = frame[7] = (uint8_t)sim.sample_seq;
+    frame[2] = frame[8] = (uint8_t)(sim.sample_seq >> 8);
+    sim.fill += SIM_FRAME_LEN;
+    sim.sample_seq++;
+    sim.generated++;
+
+    sim_check_wm();
+}
+
+/*
+ * Burst read of the FIFO data register: skip frame, whole frames, the start
+ * of a frame that does not fit (repeated next time), the sensor time once
+ * the FIFO is empty, then over-read bytes.
+ */
+static void sim_read_fifo(uint8_t *data, uint16_t len)
+{
+    uint16_t pos = 0;
+    uint16_t taken = 0;
+    uint32_t sensor_time;
+
+    memset(data, BMI160_FIFO_HEAD_OVER_READ, len);
+
+    if (sim.skipped && (len >= 2))
+    {
+        data[pos++] = BMI160_FIFO_HEAD_SKIP_FRAME;
+        data[pos++] = sim.skipped;
+        sim.skipped = 0;
+    }
+
+    while ((taken < sim.fill) && ((pos + SIM_FRAME_LEN) <= len))
+    {
+        memcpy(&data[pos], &sim.fifo[taken], SIM_FRAME_LEN);
+        pos += SIM_FRAME_LEN;
+        taken += SIM_FRAME_LEN;
+    }
+
+    if (taken < sim.fill)
+    {
+        memcpy(&data[pos], &sim.fifo[taken], len - pos);
+    }
+    else if ((pos + BMI160_STREAM_TIME_FRAME_LEN) <= len)
+    {
+        sensor_time = (uint32_t)((double)sim.now_ns * sim.clock / SIM_TIME_TICK_NS) & 0xFFFFFF;
+        data[pos++] = BMI160_FIFO_HEAD_SENSOR_TIME;
+        data[pos++] = (uint8_t)sensor_time;
+        data[pos++] = (uint8_t)(sensor_time >> 8);
+        data[pos++] = (uint8_t)(sensor_time >> 16);
+    }
+
+    memmove(sim.fifo, &sim.fifo[taken], sim.fill - taken);
+    sim.fill -= taken;
+}
+
+static int8_t sim_read(uint8_t dev_addr, uint8_t reg_addr, uint8_t *data, uint16_t len)
+{
+    reg_addr &= 0x7F;
+    if (reg_addr == BMI160_FIFO_DATA_ADDR)
+    {
+        sim_read_fifo(data, len);
+
+        return BMI160_OK;
+    }
+
+    for (uint16_t i = 0; i < len; i++)
+    {
+        data[i] = sim.regs[(reg_addr + i) & 0x7F];
+    }
+
+    return BMI160_OK;
+}
+
+static int8_t sim_write(uint8_t dev_addr, uint8_t reg_addr, uint8_t *data, uint16_t len)
+{
+    reg_addr &= 0x7F;
+    for (uint16_t i = 0; i < len; i++)
+    {
+        if (((reg_addr + i) == BMI160_COMMAND_REG_ADDR) && (data[i] == BMI160_FIFO_FLUSH_VALUE))
+        {
+            sim.fill = 0;
+            sim.skipped = 0;
+            continue;
+        }
+        sim.regs[(reg_addr + i) & 0x7F] = data[i];
+    }
+
+    return BMI160_OK;
+}
+
+/* The FIFO is read when the burst starts, the data lands when it ends */
+static int8_t sim_read_async(uint8_t dev_id, uint8_t reg_addr, uint8_t *data, uint16_t len, void *ctx)
+{
+    sim_read(dev_id, reg_addr, data, len);
+    sim.dma_done_ns = sim.now_ns + SIM_XFER_OVERHEAD + ((uint64_t)(len + 1) * 8 * 1000000000ULL) / sim.spi_hz;
+
+    return BMI160_OK;
+}
+
+/* Checks timestamps against the sensor tick of each sample */
+static void sim_check_ts(uint32_t n, uint64_t stamp)
+{
+    uint64_t truth = (uint64_t)(n + 1) * sim.period * BMI160_TS_TICK_NS_NUM / BMI160_TS_TICK_NS_DEN;
+    uint64_t err = sim_abs_diff(stamp, truth);
+
+    if (err > sim.ts_err_max_ns)
+    {
+        sim.ts_err_max_ns = err;
+    }
+
+    if (sim.ts.drift_valid)
+    {
+        err = sim_abs_diff(bmi160_ts_to_host(&sim.ts, stamp), sim_sample_ns(n));
+        if (err > sim.host_err_max_ns)
+        {
+            sim.host_err_max_ns = err;
+        }
+        sim.host_checked++;
+    }
+}
+
+static void sim_on_batch(struct bmi160_stream *stream, const struct bmi160_stream_batch *batch, void *ctx)
+{
+    static uint64_t accel_t[UINT8_MAX];
+    static uint64_t gyro_t[UINT8_MAX];
+    struct bmi160_ts_batch ts_batch;
+    uint16_t seq;
+    uint32_t n;
+
+    memset(&ts_batch, 0, sizeof(ts_batch));
+    ts_batch.accel_len = batch->frames.accel_len;
+    ts_batch.gyro_len = batch->frames.gyro_len;
+    ts_batch.accel_t = accel_t;
+    ts_batch.gyro_t = gyro_t;
+    ts_batch.sensor_time = batch->frames.sensor_time;
+    ts_batch.sensor_time_valid = batch->frames.sensor_time_valid;
+    ts_batch.skipped_frames = batch->frames.skipped_frame_count;
+    ts_batch.host_time_ns = (uint64_t)batch->irq_time_us * 1000;
+    if (bmi160_ts_stamp(&sim.ts, &ts_batch) != BMI160_OK)
+    {
+        sim.gaps++;
+    }
+
+    if ((sim.latency_samples == 0) || (batch->read_seq != sim.last_read_seq))
+    {
+        sim.latency_sum_us += sim_time_us() - batch->irq_time_us;
+        sim.latency_samples++;
+        sim.last_read_seq = batch->read_seq;
+    }
+
+    if (batch->frames.skipped_frame_count)
+    {
+        sim.next_seq += batch->frames.skipped_frame_count;
+    }
+
+    for (uint8_t i = 0; i < batch->frames.accel_len; i++)
+    {
+        seq = (uint16_t)batch->frames.accel[i].x;
+        n = sim.next_seq + (uint32_t)(int16_t)(uint16_t)(seq - (uint16_t)sim.next_seq);
+        sim_check_ts(n, accel_t[i]);
+        sim_check_ts(n, gyro_t[i]);
+        if ((seq != (uint16_t)sim.next_seq) || ((uint16_t)batch->frames.gyro[i].x != seq))
+        {
+            sim.gaps++;
+        }
+        sim.next_seq = n + 1;
+        sim.consumed++;
+    }
+}
+
+int stream_sim_run(const struct stream_sim_config *cfg)
+{
+    static struct bmi160_sensor_data accel[SIM_FRAMES_LEN];
+    static struct bmi160_sensor_data gyro[SIM_FRAMES_LEN];
+    static uint8_t buf[BMI160_STREAM_NUM_BUFS][SIM_FIFO_SIZE + BMI160_FIFO_BYTES_OVERREAD];
+    struct bmi160_fifo_frame fifo;
+    struct bmi160_stream_cfg stream_cfg;
+    struct bmi160_dev dev;
+    const struct bmi160_stream_stats *st = &sim.stream.stats;
+    uint64_t end_ns;
+    uint64_t next_sample_ns;
+    uint64_t next_ns;
+    int8_t rslt;
+
+    /* Sensor sample periods are a power of two of sensor ticks */
+    if (((SIM_TIME_TICK_HZ % cfg->odr_hz) != 0) || ((SIM_TIME_TICK_HZ / cfg->odr_hz) & (SIM_TIME_TICK_HZ / cfg->odr_hz - 1)))
+    {
+        fprintf(stderr, "stream: ODR not 25600 Hz over a power of two\n");
+
+        return -1;
+    }
+
+    if (cfg->buf_len > sizeof(buf[0]))
+    {
+        fprintf(stderr, "stream: read size above %zu B\n", sizeof(buf[0]));
+
+        return -1;
+    }
+
+    memset(&sim, 0, sizeof(sim));
+    sim.dma_done_ns = NS_NONE;
+    sim.task_ns = NS_NONE;
+    sim.task_delay_ns = cfg->task_delay_us * 1000U;
+    sim.spi_hz = cfg->spi_hz;
+    sim.clock = 1.0 + cfg->drift_ppm * 1e-6;
+    sim.period = SIM_TIME_TICK_HZ / cfg->odr_hz;
+
+    memset(&dev, 0, sizeof(dev));
+    memset(&fifo, 0, sizeof(fifo));
+    dev.interface = BMI160_SPI_INTF;
+    dev.read = sim_read;
+    dev.write = sim_write;
+    dev.delay_ms = sim_delay_ms;
+    dev.fifo = &fifo;
+    dev.prev_accel_cfg.power = BMI160_ACCEL_NORMAL_MODE;
+    dev.accel_cfg.odr = BMI160_TS_ODR_TICK_CODE;
+    for (uint32_t p = sim.period; p > 1; p >>= 1)
+    {
+        dev.accel_cfg.odr--;
+    }
+    dev.gyro_cfg.odr = dev.accel_cfg.odr;
+    bmi160_ts_init(&sim.ts, &dev);
+
+    memset(&stream_cfg, 0, sizeof(stream_cfg));
+    stream_cfg.dev = &dev;
+    stream_cfg.fifo_config = BMI160_FIFO_ACCEL | BMI160_FIFO_GYRO;
+    stream_cfg.watermark = cfg->watermark;
+    stream_cfg.int_channel = BMI160_INT_CHANNEL_1;
+    stream_cfg.int_pin_settg.output_en = BMI160_ENABLE;
+    stream_cfg.int_pin_settg.edge_ctrl = BMI160_ENABLE;
+    stream_cfg.buf[0] = buf[0];
+    stream_cfg.buf[1] = buf[1];
+    stream_cfg.buf_len = cfg->buf_len;
+    stream_cfg.accel = accel;
+    stream_cfg.gyro = gyro;
+    stream_cfg.frames_len = SIM_FRAMES_LEN;
+    stream_cfg.read_async = sim_read_async;
+    stream_cfg.time_us = sim_time_us;
+    stream_cfg.on_batch = sim_on_batch;
+
+    rslt = bmi160_stream_start(&sim.stream, &stream_cfg);
+    if (rslt != BMI160_OK)
+    {
+        fprintf(stderr, "stream: start failed %d\n", rslt);
+
+        return -1;
+    }
+
+    end_ns = sim.now_ns + (uint64_t)cfg->duration_ms * 1000000ULL;
+    next_sample_ns = sim_sample_ns(0);
+    while (sim.now_ns < end_ns)
+    {
+        next_ns = next_sample_ns;
+        if (sim.dma_done_ns < next_ns)
+        {
+            next_ns = sim.dma_done_ns;
+        }
+        if (sim.task_ns < next_ns)
+        {
+            next_ns = sim.task_ns;
+        }
+        sim.now_ns = next_ns;
+
+        /* Samples first, a read starting now sees the samples of its sensor time */
+        if (sim.now_ns == next_sample_ns)
+        {
+            sim_push_sample();
+            next_sample_ns = sim_sample_ns(sim.sample_seq);
+        }
+        if (sim.now_ns == sim.dma_done_ns)
+        {
+            sim.dma_done_ns = NS_NONE;
+            sim.wakeups++;
+            bmi160_stream_read_done(&sim.stream, BMI160_OK);
+            if (sim.task_ns == NS_NONE)
+            {
+                sim.task_ns = sim.now_ns + sim.task_delay_ns;
+            }
+            sim_check_wm();
+        }
+        if (sim.now_ns == sim.task_ns)
+        {
+            sim.task_ns = NS_NONE;
+            sim.wakeups++;
+            bmi160_stream_process(&sim.stream, NULL);
+        }
+    }
+
+    bmi160_stream_stop(&sim.stream);
+
+    printf("stream: %u Hz accel+gyro for %u ms, watermark %u B, read %u B, task delay %u us\n",
+           cfg->odr_hz,
+           cfg->duration_ms,
+           (unsigned)(cfg->watermark / BMI160_STREAM_WM_UNIT * BMI160_STREAM_WM_UNIT),
+           cfg->buf_len,
+           cfg->task_delay_us);
+    printf("  irqs %u, reads %u, undrained %u, overruns %u, read errors %u\n",
+           st->irqs,
+           st->reads,
+           st->undrained_reads,
+           st->overruns,
+           st->read_errors);
+    printf("  frames generated %llu, delivered %llu, in FIFO %u, skipped by sensor %u, sequence gaps %llu\n",
+           (unsigned long long)sim.generated,
+           (unsigned long long)sim.consumed,
+           sim.fill / SIM_FRAME_LEN,
+           st->skipped_frames,
+           (unsigned long long)sim.gaps);
+    printf("  batches %u, %.1f frames per batch, latency irq to consumer avg %llu us max %u us\n",
+           st->batches,
+           st->batches ? (double)st->accel_frames / st->batches : 0.0,
+           sim.latency_samples ? (unsigned long long)(sim.latency_sum_us / sim.latency_samples) : 0ULL,
+           st->latency_max_us);
+    printf("  wakeups %u, %.1f per s (irq, dma done, task)\n",
+           sim.wakeups,
+           sim.wakeups * 1000.0 / cfg->duration_ms);
+    printf("  timestamps max error %llu ns, lost %u, resyncs %u\n",
+           (unsigned long long)sim.ts_err_max_ns,
+           sim.ts.lost_samples,
+           sim.ts.resyncs);
+    printf("  drift %+d ppm, estimate %+.3f ppm, on host clock max error %.1f us over %llu samples\n",
+           cfg->drift_ppm,
+           sim.ts.drift_valid ? -sim.ts.drift_ppb / 1000.0 : 0.0,
+           sim.host_err_max_ns / 1000.0,
+           (unsigned long long)sim.host_checked);
+
+    return (sim.gaps == 0) ? 0 : -1;
+}
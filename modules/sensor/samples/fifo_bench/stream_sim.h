@@ -0,0 +1,31 @@
+#ifndef STREAM_SIM_H_
+#define STREAM_SIM_H_
+
+#include <stdint.h>
+
+/*
+ * bmi160_stream on a simulated BMI160: register file, 1 KB FIFO filled at
+ * the configured ODR, watermark interrupt on the rising edge of the fill
+ * level, SPI burst reads completing after their bus time and a consumer
+ * task waking task_delay_us after each DMA completion. All in virtual time.
+ * The sensor clock runs drift_ppm off the host clock, the consumer stamps
+ * every sample with bmi160_ts and checks it against the sensor clock.
+ */
+struct stream_sim_config
+{
+    /* Accel and gyro ODR in Hz, 0 disables the run */
+    uint32_t odr_hz;
+    uint32_t duration_ms;
+    /* Watermark and read size in bytes */
+    uint16_t watermark;
+    uint16_t buf_len;
+    uint32_t spi_hz;
+    /* Interrupt to task wake up, models scheduling and a busy consumer */
+    uint32_t task_delay_us;
+    /* Sensor clock against the host clock, the ODR divides 25600 Hz */
+    int32_t drift_ppm;
+};
+
+int stream_sim_run(const struct stream_sim_config *cfg);
+
+#endif
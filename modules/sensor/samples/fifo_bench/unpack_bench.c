@@ -0,0 +1,350 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bmi160_fifo_unpack.h"
+#include "cycles.h"
+#include "unpack_bench.h"
+
+#define UB_FIFO_SIZE     1024U
+/* Fill level plus the empty marker of an over-read */
+#define UB_READ_SIZE     (UB_FIFO_SIZE + 2U)
+#define UB_MAX_FRAMES    255U
+
+#if (BMI160_FIFO_UNPACK_KERNEL == BMI160_FIFO_UNPACK_AVX2)
+#define UB_KERNEL_NAME   "avx2"
+#elif (BMI160_FIFO_UNPACK_KERNEL == BMI160_FIFO_UNPACK_SSE2)
+#define UB_KERNEL_NAME   "sse2"
+#elif (BMI160_FIFO_UNPACK_KERNEL == BMI160_FIFO_UNPACK_NEON)
+#define UB_KERNEL_NAME   "neon"
+#elif (BMI160_FIFO_UNPACK_KERNEL == BMI160_FIFO_UNPACK_PAIR)
+#define UB_KERNEL_NAME   "pair"
+#else
+#define UB_KERNEL_NAME   "scalar"
+#endif
+
+struct ub_scenario
+{
+    const char *name;
+    uint8_t data_enable;
+};
+
+static const struct ub_scenario ub_scenarios[] = {
+    { "nohdr_a", BMI160_FIFO_A_ENABLE },
+    { "nohdr_ga", BMI160_FIFO_G_A_ENABLE },
+    { "nohdr_ma", BMI160_FIFO_M_ENABLE | BMI160_FIFO_A_ENABLE },
+    { "nohdr_mga", BMI160_FIFO_M_G_A_ENABLE },
+};
+
+struct ub_read
+{
+    uint8_t data[UB_READ_SIZE];
+    uint16_t length;
+};
+
+/* AoS output of one read, also the reference */
+struct ub_aos
+{
+    struct bmi160_sensor_data accel[UB_MAX_FRAMES];
+    struct bmi160_sensor_data gyro[UB_MAX_FRAMES];
+    struct bmi160_aux_data aux[UB_MAX_FRAMES];
+    uint8_t accel_len;
+    uint8_t gyro_len;
+    uint8_t aux_len;
+};
+
+struct ub_soa
+{
+    int16_t axis[6][UB_MAX_FRAMES];
+    struct bmi160_aux_data aux[UB_MAX_FRAMES];
+    size_t frames;
+};
+
+static uint32_t ub_rng_state = 0x9E3779B9;
+
+static uint32_t ub_rng(void)
+{
+    ub_rng_state ^= ub_rng_state << 13;
+    ub_rng_state ^= ub_rng_state >> 17;
+    ub_rng_state ^= ub_rng_state << 5;
+
+    return ub_rng_state;
+}
+
+/* Full FIFO of frames, read with the empty marker behind it */
+static void build_read(uint8_t data_enable, struct ub_read *rd)
+{
+    uint8_t stride = bmi160_fifo_unpack_frame_len(data_enable);
+    uint16_t len = 0;
+
+    while ((len + stride) <= UB_FIFO_SIZE)
+    {
+        for (uint8_t i = 0; i < stride; i++)
+        {
+            rd->data[len + i] = (uint8_t)ub_rng();
+        }
+
+        /* A sample that looks like the empty marker ends the parse */
+        if ((rd->data[len] == FIFO_CONFIG_MSB_CHECK) && (rd->data[len + 1] == FIFO_CONFIG_LSB_CHECK))
+        {
+            rd->data[len]++;
+        }
+        len += stride;
+    }
+    rd->data[len++] = FIFO_CONFIG_MSB_CHECK;
+    rd->data[len++] = FIFO_CONFIG_LSB_CHECK;
+    rd->length = len;
+}
+
+static void fifo_rewind(struct bmi160_fifo_frame *fifo, const struct ub_read *rd)
+{
+    fifo->data = (uint8_t *)rd->data;
+    fifo->length = rd->length;
+    fifo->accel_byte_start_idx = 0;
+    fifo->gyro_byte_start_idx = 0;
+    fifo->aux_byte_start_idx = 0;
+}
+
+static void unpack_extract(uint8_t data_enable, struct bmi160_dev *dev, struct ub_aos *out)
+{
+    out->accel_len = 0;
+    out->gyro_len = 0;
+    out->aux_len = 0;
+    if (data_enable & BMI160_FIFO_A_ENABLE)
+    {
+        out->accel_len = UB_MAX_FRAMES;
+        bmi160_extract_accel(out->accel, &out->accel_len, dev);
+    }
+    if (data_enable & BMI160_FIFO_G_ENABLE)
+    {
+        out->gyro_len = UB_MAX_FRAMES;
+        bmi160_extract_gyro(out->gyro, &out->gyro_len, dev);
+    }
+    if (data_enable & BMI160_FIFO_M_ENABLE)
+    {
+        out->aux_len = UB_MAX_FRAMES;
+        bmi160_extract_aux(out->aux, &out->aux_len, dev);
+    }
+}
+
+static void unpack_demux(uint8_t data_enable, struct bmi160_dev *dev, struct ub_aos *out)
+{
+    struct bmi160_fifo_demux demux;
+
+    demux.accel = (data_enable & BMI160_FIFO_A_ENABLE) ? out->accel : NULL;
+    demux.gyro = (data_enable & BMI160_FIFO_G_ENABLE) ? out->gyro : NULL;
+    demux.aux = (data_enable & BMI160_FIFO_M_ENABLE) ? out->aux : NULL;
+    demux.accel_len = UB_MAX_FRAMES;
+    demux.gyro_len = UB_MAX_FRAMES;
+    demux.aux_len = UB_MAX_FRAMES;
+    bmi160_fifo_demux(&demux, dev);
+    out->accel_len = (demux.accel != NULL) ? demux.accel_len : 0;
+    out->gyro_len = (demux.gyro != NULL) ? demux.gyro_len : 0;
+    out->aux_len = (demux.aux != NULL) ? demux.aux_len : 0;
+}
+
+static void unpack_aos(uint8_t data_enable, const struct ub_read *rd, struct ub_aos *out)
+{
+    size_t frames = bmi160_fifo_unpack_count(rd->data, rd->length, data_enable);
+
+    bmi160_fifo_unpack_aos(rd->data,
+                           frames,
+                           data_enable,
+                           (data_enable & BMI160_FIFO_A_ENABLE) ? out->accel : NULL,
+                           (data_enable & BMI160_FIFO_G_ENABLE) ? out->gyro : NULL,
+                           (data_enable & BMI160_FIFO_M_ENABLE) ? out->aux : NULL);
+    out->accel_len = (data_enable & BMI160_FIFO_A_ENABLE) ? (uint8_t)frames : 0;
+    out->gyro_len = (data_enable & BMI160_FIFO_G_ENABLE) ? (uint8_t)frames : 0;
+    out->aux_len = (data_enable & BMI160_FIFO_M_ENABLE) ? (uint8_t)frames : 0;
+}
+
+static void unpack_soa(uint8_t data_enable, const struct ub_read *rd, struct ub_soa *out)
+{
+    struct bmi160_sensor_soa gyro = { out->axis[0], out->axis[1], out->axis[2], NULL, UB_MAX_FRAMES, 0 };
+    struct bmi160_sensor_soa accel = { out->axis[3], out->axis[4], out->axis[5], NULL, UB_MAX_FRAMES, 0 };
+
+    out->frames = bmi160_fifo_unpack_count(rd->data, rd->length, data_enable);
+    bmi160_fifo_unpack_soa(rd->data,
+                           out->frames,
+                           data_enable,
+                           (data_enable & BMI160_FIFO_A_ENABLE) ? &accel : NULL,
+                           (data_enable & BMI160_FIFO_G_ENABLE) ? &gyro : NULL,
+                           (data_enable & BMI160_FIFO_M_ENABLE) ? out->aux : NULL);
+}
+
+static bool same_xyz(const struct bmi160_sensor_data *a, const struct bmi160_sensor_data *b, uint8_t len)
+{
+    for (uint8_t i = 0; i < len; i++)
+    {
+        if ((a[i].x != b[i].x) || (a[i].y != b[i].y) || (a[i].z != b[i].z))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool same_aos(const struct ub_aos *a, const struct ub_aos *b)
+{
+    return (a->accel_len == b->accel_len) && (a->gyro_len == b->gyro_len) && (a->aux_len == b->aux_len) &&
+           same_xyz(a->accel, b->accel, a->accel_len) && same_xyz(a->gyro, b->gyro, a->gyro_len) &&
+           (memcmp(a->aux, b->aux, a->aux_len * sizeof(a->aux[0])) == 0);
+}
+
+static bool same_sensor_soa(const struct bmi160_sensor_data *ref, uint8_t len, const struct ub_soa *soa, int first)
+{
+    if (len != soa->frames)
+    {
+        return false;
+    }
+    for (uint8_t i = 0; i < len; i++)
+    {
+        if ((ref[i].x != soa->axis[first][i]) || (ref[i].y != soa->axis[first + 1][i]) ||
+            (ref[i].z != soa->axis[first + 2][i]))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool same_soa(uint8_t data_enable, const struct ub_aos *ref, const struct ub_soa *soa)
+{
+    if ((data_enable & BMI160_FIFO_A_ENABLE) && !same_sensor_soa(ref->accel, ref->accel_len, soa, 3))
+    {
+        return false;
+    }
+    if ((data_enable & BMI160_FIFO_G_ENABLE) && !same_sensor_soa(ref->gyro, ref->gyro_len, soa, 0))
+    {
+        return false;
+    }
+
+    return !(data_enable & BMI160_FIFO_M_ENABLE) ||
+           ((ref->aux_len == soa->frames) && (memcmp(ref->aux, soa->aux, ref->aux_len * sizeof(ref->aux[0])) == 0));
+}
+
+int unpack_bench_run(uint32_t num_reads, uint32_t iterations)
+{
+    struct bmi160_fifo_frame fifo;
+    struct bmi160_dev dev;
+    struct ub_read *reads;
+    static struct ub_aos ref, aos;
+    static struct ub_soa soa;
+    uint64_t bytes, t0, extract_cycles, demux_cycles, aos_cycles, soa_cycles;
+    uint32_t mismatches, total_mismatches = 0;
+    double kb;
+
+    reads = malloc((size_t)num_reads * sizeof(*reads));
+    if (reads == NULL)
+    {
+        perror("fifo_bench: malloc");
+
+        return -1;
+    }
+
+    memset(&dev, 0, sizeof(dev));
+    memset(&fifo, 0, sizeof(fifo));
+    dev.fifo = &fifo;
+
+    printf("header-less unpack, SoA kernel %s, per KB of FIFO data\n", UB_KERNEL_NAME);
+    printf("%-12s %7s %12s %12s %12s %12s %8s %s\n",
+           "scenario",
+           "frames",
+           "extract",
+           "demux",
+           "unpack_aos",
+           "unpack_soa",
+           "soa gain",
+           "check");
+
+    for (size_t s = 0; s < sizeof(ub_scenarios) / sizeof(ub_scenarios[0]); s++)
+    {
+        uint8_t data_enable = ub_scenarios[s].data_enable;
+
+        fifo.fifo_header_enable = 0;
+        fifo.fifo_data_enable = data_enable;
+
+        bytes = 0;
+        mismatches = 0;
+        for (uint32_t r = 0; r < num_reads; r++)
+        {
+            build_read(data_enable, &reads[r]);
+            bytes += reads[r].length;
+
+            fifo_rewind(&fifo, &reads[r]);
+            unpack_extract(data_enable, &dev, &ref);
+            fifo_rewind(&fifo, &reads[r]);
+            unpack_demux(data_enable, &dev, &aos);
+            mismatches += !same_aos(&ref, &aos);
+            unpack_aos(data_enable, &reads[r], &aos);
+            mismatches += !same_aos(&ref, &aos);
+            unpack_soa(data_enable, &reads[r], &soa);
+            mismatches += !same_soa(data_enable, &ref, &soa);
+        }
+
+        t0 = cycles();
+        for (uint32_t it = 0; it < iterations; it++)
+        {
+            for (uint32_t r = 0; r < num_reads; r++)
+            {
+                fifo_rewind(&fifo, &reads[r]);
+                unpack_extract(data_enable, &dev, &aos);
+            }
+        }
+        extract_cycles = cycles() - t0;
+
+        t0 = cycles();
+        for (uint32_t it = 0; it < iterations; it++)
+        {
+            for (uint32_t r = 0; r < num_reads; r++)
+            {
+                fifo_rewind(&fifo, &reads[r]);
+                unpack_demux(data_enable, &dev, &aos);
+            }
+        }
+        demux_cycles = cycles() - t0;
+
+        t0 = cycles();
+        for (uint32_t it = 0; it < iterations; it++)
+        {
+            for (uint32_t r = 0; r < num_reads; r++)
+            {
+                unpack_aos(data_enable, &reads[r], &aos);
+            }
+        }
+        aos_cycles = cycles() - t0;
+
+        t0 = cycles();
+        for (uint32_t it = 0; it < iterations; it++)
+        {
+            for (uint32_t r = 0; r < num_reads; r++)
+            {
+                unpack_soa(data_enable, &reads[r], &soa);
+            }
+        }
+        soa_cycles = cycles() - t0;
+
+        kb = (double)bytes * iterations / 1024.0;
+        printf("%-12s %7zu %8.0f %s %8.0f %s %8.0f %s %8.0f %s %7.1fx %s\n",
+               ub_scenarios[s].name,
+               soa.frames,
+               extract_cycles / kb,
+               CYCLE_UNIT,
+               demux_cycles / kb,
+               CYCLE_UNIT,
+               aos_cycles / kb,
+               CYCLE_UNIT,
+               soa_cycles / kb,
+               CYCLE_UNIT,
+               (double)extract_cycles / soa_cycles,
+               (mismatches == 0) ? "ok" : "MISMATCH");
+        total_mismatches += mismatches;
+    }
+
+    free(reads);
+
+    return (total_mismatches == 0) ? 0 : -1;
+}
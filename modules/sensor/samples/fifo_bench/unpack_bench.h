@@ -0,0 +1,13 @@
+#ifndef UNPACK_BENCH_H_
+#define UNPACK_BENCH_H_
+
+#include <stdint.h>
+
+/*
+ * Header-less FIFO reads unpacked by the per frame extract APIs, by
+ * bmi160_fifo_demux and by the bulk bmi160_fifo_unpack_aos/soa, checked
+ * against each other. Returns 0 when all agree.
+ */
+int unpack_bench_run(uint32_t num_reads, uint32_t iterations);
+
+#endif
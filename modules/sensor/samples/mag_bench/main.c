@@ -0,0 +1,535 @@
+/*
+ * BMM150 driver check on a simulated BMI160 with a BMM150 on its
+ * auxiliary interface.
+ *
+ *  - bring-up: init, preset and auto mode through the BMI160 manual mode
+ *    only, then auto mode reads, checked against the simulated field
+ *  - compensation: the integer formula against the floating point one of
+ *    the datasheet over a grid of raw values, max error in uT
+ *  - 9-axis FIFO: header mode FIFO reads with gyro at 200 Hz, accel at
+ *    100 Hz and mag at 25 Hz, and mag faster than accel, split over two
+ *    batches; every sample must carry the latest value of each sensor
+ */
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bmi160.h"
+#include "bmm150.h"
+
+/* Trim of a typical part */
+static const struct bmm150_trim trim_ref = {
+    .dig_x1 = 2, .dig_y1 = -3, .dig_x2 = 26, .dig_y2 = 27, .dig_z1 = 24200, .dig_z2 = 770, .dig_z3 = -120,
+    .dig_z4 = 15, .dig_xy1 = 29, .dig_xy2 = -3, .dig_xyz1 = 6800
+};
+
+struct sim
+{
+    uint8_t bmi[128];
+    uint8_t bmm[256];
+    uint32_t measurements;
+
+    /* Raw values of the next measurement */
+    int16_t x;
+    int16_t y;
+    int16_t z;
+    uint16_t rhall;
+};
+
+static struct sim sim;
+
+static void encode_raw(uint8_t *out, int16_t x, int16_t y, int16_t z, uint16_t rhall)
+{
+    out[0] = (uint8_t)((uint16_t)x << 3);
+    out[1] = (uint8_t)(x >> 5);
+    out[2] = (uint8_t)((uint16_t)y << 3);
+    out[3] = (uint8_t)(y >> 5);
+    out[4] = (uint8_t)((uint16_t)z << 1);
+    out[5] = (uint8_t)(z >> 7);
+    out[6] = (uint8_t)(rhall << 2);
+    out[7] = (uint8_t)(rhall >> 6);
+}
+
+static void put16(uint8_t *out, uint16_t v)
+{
+    out[0] = (uint8_t)v;
+    out[1] = (uint8_t)(v >> 8);
+}
+
+static void sim_trim(void)
+{
+    sim.bmm[0x5D] = (uint8_t)trim_ref.dig_x1;
+    sim.bmm[0x5E] = (uint8_t)trim_ref.dig_y1;
+    put16(&sim.bmm[0x62], (uint16_t)trim_ref.dig_z4);
+    sim.bmm[0x64] = (uint8_t)trim_ref.dig_x2;
+    sim.bmm[0x65] = (uint8_t)trim_ref.dig_y2;
+    put16(&sim.bmm[0x68], (uint16_t)trim_ref.dig_z2);
+    put16(&sim.bmm[0x6A], trim_ref.dig_z1);
+
+    /* Bit 15 set, the driver must mask it */
+    put16(&sim.bmm[0x6C], trim_ref.dig_xyz1 | 0x8000);
+    put16(&sim.bmm[0x6E], (uint16_t)trim_ref.dig_z3);
+    sim.bmm[0x70] = (uint8_t)trim_ref.dig_xy2;
+    sim.bmm[0x71] = trim_ref.dig_xy1;
+}
+
+static void bmm_write(uint8_t reg, uint8_t value)
+{
+    if (reg == BMM150_POWER_CONTROL_ADDR)
+    {
+        memset(sim.bmm, 0, sizeof(sim.bmm));
+        sim_trim();
+        sim.bmm[BMM150_CHIP_ID_ADDR] = (value & BMM150_POWER_ON) ? BMM150_CHIP_ID : 0;
+        sim.bmm[BMM150_POWER_CONTROL_ADDR] = value & BMM150_POWER_ON;
+        sim.bmm[BMM150_OP_MODE_ADDR] = BMM150_OP_MODE_SLEEP;
+
+        return;
+    }
+    if ((sim.bmm[BMM150_POWER_CONTROL_ADDR] & BMM150_POWER_ON) == 0)
+    {
+        return;
+    }
+    sim.bmm[reg] = value;
+    if ((reg == BMM150_OP_MODE_ADDR) && (((value >> 1) & 0x03) == 0x01))
+    {
+        encode_raw(&sim.bmm[BMM150_DATA_X_LSB_ADDR], sim.x, sim.y, sim.z, sim.rhall);
+        sim.measurements++;
+
+        /* Back to sleep after a forced measurement */
+        sim.bmm[BMM150_OP_MODE_ADDR] = BMM150_OP_MODE_SLEEP;
+    }
+}
+
+/* One read of the BMI160 auto mode: data, then the trigger write */
+static void sim_auto_cycle(void)
+{
+    if ((sim.bmi[BMI160_AUX_IF_1_ADDR] & BMI160_MANUAL_MODE_EN_MSK) == 0)
+    {
+        memcpy(&sim.bmi[BMI160_AUX_DATA_ADDR], &sim.bmm[sim.bmi[BMI160_AUX_IF_2_ADDR]], BMM150_DATA_LEN);
+        bmm_write(sim.bmi[BMI160_AUX_IF_3_ADDR], sim.bmi[BMI160_AUX_IF_4_ADDR]);
+    }
+}
+
+static int8_t bus_read(uint8_t dev_addr, uint8_t reg_addr, uint8_t *data, uint16_t len)
+{
+    reg_addr &= 0x7F;
+    for (uint16_t i = 0; i < len; i++)
+    {
+        data[i] = sim.bmi[(reg_addr + i) & 0x7F];
+    }
+
+    return BMI160_OK;
+}
+
+static int8_t bus_write(uint8_t dev_addr, uint8_t reg_addr, uint8_t *data, uint16_t len)
+{
+    uint8_t manual;
+    uint8_t reg;
+
+    reg_addr &= 0x7F;
+    for (uint16_t i = 0; i < len; i++)
+    {
+        reg = (reg_addr + i) & 0x7F;
+        if (reg == BMI160_COMMAND_REG_ADDR)
+        {
+            continue;
+        }
+        sim.bmi[reg] = data[i];
+
+        /* Manual mode: the read address starts an 8 byte read, the write
+         * address a write of the write data */
+        manual = sim.bmi[BMI160_AUX_IF_1_ADDR] & BMI160_MANUAL_MODE_EN_MSK;
+        if (manual && (reg == BMI160_AUX_IF_2_ADDR))
+        {
+            memcpy(&sim.bmi[BMI160_AUX_DATA_ADDR], &sim.bmm[data[i]], BMM150_DATA_LEN);
+        }
+        else if (manual && (reg == BMI160_AUX_IF_3_ADDR))
+        {
+            bmm_write(data[i], sim.bmi[BMI160_AUX_IF_4_ADDR]);
+        }
+    }
+
+    return BMI160_OK;
+}
+
+static void bus_delay_ms(uint32_t period)
+{
+}
+
+static int setup(struct bmi160_dev *bmi, struct bmm150_dev *mag)
+{
+    int8_t rslt;
+
+    memset(&sim, 0, sizeof(sim));
+    sim.bmi[BMI160_CHIP_ID_ADDR] = BMI160_CHIP_ID;
+    memset(bmi, 0, sizeof(*bmi));
+    bmi->interface = BMI160_SPI_INTF;
+    bmi->read = bus_read;
+    bmi->write = bus_write;
+    bmi->delay_ms = bus_delay_ms;
+    rslt = bmi160_init(bmi);
+    if (rslt == BMI160_OK)
+    {
+        bmi->accel_cfg.power = BMI160_ACCEL_NORMAL_MODE;
+        rslt = bmi160_set_power_mode(bmi);
+    }
+    if (rslt != BMI160_OK)
+    {
+        printf("  bmi160 set up failed %d\n", rslt);
+
+        return 1;
+    }
+
+    memset(mag, 0, sizeof(*mag));
+    mag->bmi = bmi;
+    rslt = bmm150_init(mag);
+    if (rslt != BMM150_OK)
+    {
+        printf("  bmm150_init failed %d\n", rslt);
+
+        return 1;
+    }
+
+    return 0;
+}
+
+static int run_bring_up(void)
+{
+    struct bmi160_dev bmi;
+    struct bmm150_dev mag;
+    struct bmm150_mag_data out;
+    struct bmm150_mag_data want;
+    uint8_t raw[BMM150_DATA_LEN];
+    int failures = 0;
+
+    printf("bring-up\n");
+    if (setup(&bmi, &mag) != 0)
+    {
+        return 1;
+    }
+    if (memcmp(&mag.trim, &trim_ref, sizeof(trim_ref)) != 0)
+    {
+        printf("  trim registers read wrong\n");
+        failures++;
+    }
+    if ((sim.bmm[BMM150_REP_XY_ADDR] != BMM150_REGULAR_REPXY) || (sim.bmm[BMM150_REP_Z_ADDR] != BMM150_REGULAR_REPZ))
+    {
+        printf("  regular preset not written\n");
+        failures++;
+    }
+
+    /* The high accuracy preset can not keep up with 25 Hz */
+    bmi.aux_cfg.aux_odr = BMI160_AUX_ODR_25HZ;
+    if ((bmm150_set_preset(BMM150_PRESET_HIGHACCURACY, &mag) != BMM150_OK) ||
+        (bmm150_start_auto_mode(&mag) != BMM150_E_INVALID_CONFIG))
+    {
+        printf("  too fast an aux ODR accepted\n");
+        failures++;
+    }
+
+    bmi.aux_cfg.aux_odr = BMI160_AUX_ODR_100HZ;
+    sim.x = 1200;
+    sim.y = -800;
+    sim.z = 3000;
+    sim.rhall = 6900;
+    if ((bmm150_set_preset(BMM150_PRESET_REGULAR, &mag) != BMM150_OK) || (bmm150_start_auto_mode(&mag) != BMM150_OK))
+    {
+        printf("  bmm150_start_auto_mode failed\n");
+
+        return failures + 1;
+    }
+    if ((sim.bmi[BMI160_AUX_IF_1_ADDR] & BMI160_MANUAL_MODE_EN_MSK) ||
+        (sim.bmi[BMI160_AUX_IF_2_ADDR] != BMM150_DATA_X_LSB_ADDR) ||
+        (sim.bmi[BMI160_AUX_IF_3_ADDR] != BMM150_OP_MODE_ADDR) ||
+        (sim.bmi[BMI160_AUX_IF_4_ADDR] != BMM150_OP_MODE_FORCED) ||
+        (sim.bmi[BMI160_AUX_ODR_ADDR] != BMI160_AUX_ODR_100HZ))
+    {
+        printf("  auto mode registers wrong\n");
+        failures++;
+    }
+
+    /* Every auto mode read starts the next measurement */
+    sim.x = -1500;
+    sim_auto_cycle();
+    sim_auto_cycle();
+    encode_raw(raw, sim.x, sim.y, sim.z, sim.rhall);
+    if ((bmm150_read_mag_data(&out, &mag) != BMM150_OK) || (bmm150_compensate(raw, &want, &mag) != BMM150_OK) ||
+        (memcmp(&out, &want, sizeof(out)) != 0))
+    {
+        printf("  auto mode data wrong\n");
+        failures++;
+    }
+    printf("  %u measurements, field %.2f %.2f %.2f uT\n",
+           sim.measurements,
+           out.x / (double)BMM150_LSB_PER_UT,
+           out.y / (double)BMM150_LSB_PER_UT,
+           out.z / (double)BMM150_LSB_PER_UT);
+
+    if ((bmm150_set_preset(BMM150_PRESET_LOWPOWER, &mag) != BMM150_E_INVALID_CONFIG) ||
+        (bmm150_stop_auto_mode(&mag) != BMM150_OK) ||
+        (bmm150_set_preset(BMM150_PRESET_LOWPOWER, &mag) != BMM150_OK) ||
+        (sim.bmm[BMM150_REP_XY_ADDR] != BMM150_LOWPOWER_REPXY))
+    {
+        printf("  preset change around auto mode wrong\n");
+        failures++;
+    }
+
+    return failures;
+}
+
+/* Floating point compensation of the datasheet, in uT */
+static double ref_xy(int16_t raw, uint16_t rhall, int8_t dig_1, int8_t dig_2, const struct bmm150_trim *t)
+{
+    double r = (double)t->dig_xyz1 * 16384.0 / rhall - 16384.0;
+    double s = (double)t->dig_xy2 * (r * r / 268435456.0) + r * t->dig_xy1 / 16384.0;
+
+    return ((raw * ((s + 256.0) * (dig_2 + 160.0))) / 8192.0 + dig_1 * 8.0) / 16.0;
+}
+
+static double ref_z(int16_t raw, uint16_t rhall, const struct bmm150_trim *t)
+{
+    double num = ((double)raw - t->dig_z4) * 131072.0 - (double)t->dig_z3 * ((double)rhall - t->dig_xyz1);
+    double den = ((double)t->dig_z2 + (double)t->dig_z1 * rhall / 32768.0) * 4.0;
+
+    return num / den / 16.0;
+}
+
+static int run_compensation(void)
+{
+    struct bmm150_dev mag;
+    struct bmm150_mag_data out;
+    uint8_t raw[BMM150_DATA_LEN];
+    double err_xy = 0;
+    double err_z = 0;
+    double range = 0;
+    uint32_t points = 0;
+    int failures = 0;
+
+    printf("compensation, integer against floating point\n");
+    memset(&mag, 0, sizeof(mag));
+    mag.trim = trim_ref;
+    for (int16_t xy = -4095; xy <= 4095; xy += 91)
+    {
+        for (int16_t z = -16383; z <= 16383; z += 331)
+        {
+            for (uint16_t rhall = 6000; rhall <= 7600; rhall += 400)
+            {
+                encode_raw(raw, xy, (int16_t)-xy, z, rhall);
+                bmm150_compensate(raw, &out, &mag);
+                err_xy = fmax(err_xy, fabs(out.x / 16.0 - ref_xy(xy, rhall, trim_ref.dig_x1, trim_ref.dig_x2, &trim_ref)));
+                err_xy =
+                    fmax(err_xy, fabs(out.y / 16.0 - ref_xy((int16_t)-xy, rhall, trim_ref.dig_y1, trim_ref.dig_y2, &trim_ref)));
+
+                /* Outside of the clamp only */
+                if (fabs(ref_z(z, rhall, &trim_ref)) < INT16_MAX / 16.0)
+                {
+                    err_z = fmax(err_z, fabs(out.z / 16.0 - ref_z(z, rhall, &trim_ref)));
+                    range = fmax(range, fabs(ref_z(z, rhall, &trim_ref)));
+                }
+                points++;
+            }
+        }
+    }
+    printf("  %u points up to %.0f uT, max error xy %.3f uT, z %.3f uT\n", points, range, err_xy, err_z);
+    /* Z divides by a gain rounded to an integer, about 1e-4 of the reading */
+    if ((err_xy > 0.125) || (err_z > 0.25))
+    {
+        printf("  error above 2 LSB xy, 4 LSB z\n");
+        failures++;
+    }
+
+    /* Overflow flags */
+    encode_raw(raw, BMM150_XY_OVERFLOW_ADC, 0, BMM150_Z_OVERFLOW_ADC, 6800);
+    bmm150_compensate(raw, &out, &mag);
+    if ((out.x != BMM150_OVERFLOW_OUTPUT) || (out.z != BMM150_OVERFLOW_OUTPUT) || (out.y == BMM150_OVERFLOW_OUTPUT))
+    {
+        printf("  overflow not flagged\n");
+        failures++;
+    }
+
+    return failures;
+}
+
+/* One FIFO frame per tick, sensors in the frame at their own rate */
+struct fifo_scenario
+{
+    const char *name;
+    uint32_t ticks;
+    uint32_t accel_every;
+    uint32_t gyro_every;
+    uint32_t mag_every;
+};
+
+static const struct fifo_scenario fifo_scenarios[] = {
+    { "gyro 200 Hz, accel 100 Hz, mag 25 Hz", 160, 2, 1, 8 },
+    { "accel 50 Hz, mag 100 Hz, no gyro", 120, 4, 0, 2 },
+};
+
+static bool has(uint32_t tick, uint32_t every)
+{
+    return (every != 0) && ((tick % every) == 0);
+}
+
+static size_t build_fifo(const struct fifo_scenario *sc, uint32_t from, uint32_t to, uint8_t *out)
+{
+    size_t len = 0;
+    uint8_t header;
+
+    for (uint32_t t = from; t < to; t++)
+    {
+        header = BMI160_FIFO_HEAD_DATA;
+        header |= has(t, sc->mag_every) ? (BMI160_FIFO_FRAME_M << BMI160_FIFO_HEAD_FRAME_POS) : 0;
+        header |= has(t, sc->gyro_every) ? (BMI160_FIFO_FRAME_G << BMI160_FIFO_HEAD_FRAME_POS) : 0;
+        header |= has(t, sc->accel_every) ? (BMI160_FIFO_FRAME_A << BMI160_FIFO_HEAD_FRAME_POS) : 0;
+        if (header == BMI160_FIFO_HEAD_DATA)
+        {
+            continue;
+        }
+        out[len++] = header;
+        if (has(t, sc->mag_every))
+        {
+            encode_raw(&out[len], (int16_t)(t * 10), (int16_t)-t, (int16_t)(t * 20), 6800);
+            len += BMI160_FIFO_M_LENGTH;
+        }
+        if (has(t, sc->gyro_every))
+        {
+            put16(&out[len], (uint16_t)t);
+            put16(&out[len + 2], 0);
+            put16(&out[len + 4], 0);
+            len += BMI160_FIFO_G_LENGTH;
+        }
+        if (has(t, sc->accel_every))
+        {
+            put16(&out[len], (uint16_t)t);
+            put16(&out[len + 2], 0);
+            put16(&out[len + 4], 0);
+            len += BMI160_FIFO_A_LENGTH;
+        }
+    }
+    out[len++] = BMI160_FIFO_HEAD_OVER_READ;
+
+    return len;
+}
+
+static int check_sample(const struct fifo_scenario *sc,
+                        const struct bmm150_9axis *s,
+                        uint32_t tick,
+                        const struct bmm150_dev *mag)
+{
+    uint8_t raw[BMM150_DATA_LEN];
+    struct bmm150_mag_data want;
+    uint32_t last_mag = (tick / sc->mag_every) * sc->mag_every;
+    uint8_t fresh = 0;
+
+    fresh |= has(tick, sc->accel_every) ? BMI160_FIFO_FRAME_A : 0;
+    fresh |= has(tick, sc->gyro_every) ? BMI160_FIFO_FRAME_G : 0;
+
+    /* Mag only frames since the previous sample show up here */
+    for (uint32_t t = tick;; t--)
+    {
+        if (has(t, sc->mag_every))
+        {
+            fresh |= BMI160_FIFO_FRAME_M;
+        }
+        if ((t == 0) || has(t - 1, sc->accel_every) || has(t - 1, sc->gyro_every))
+        {
+            break;
+        }
+    }
+    encode_raw(raw, (int16_t)(last_mag * 10), (int16_t)-last_mag, (int16_t)(last_mag * 20), 6800);
+    bmm150_compensate(raw, &want, mag);
+
+    return (s->fresh != fresh) ||
+           ((sc->accel_every != 0) && (s->accel.x != (int16_t)((tick / sc->accel_every) * sc->accel_every))) ||
+           ((sc->gyro_every != 0) && (s->gyro.x != (int16_t)((tick / sc->gyro_every) * sc->gyro_every))) ||
+           (memcmp(&s->mag, &want, sizeof(want)) != 0);
+}
+
+static int run_fifo(const struct fifo_scenario *sc)
+{
+    static uint8_t data[4096];
+    static struct bmi160_sensor_data accel[256];
+    static struct bmi160_sensor_data gyro[256];
+    static struct bmi160_aux_data aux[256];
+    static uint8_t frames[256];
+    static struct bmm150_9axis samples[256];
+    struct bmi160_fifo_frame fifo;
+    struct bmi160_fifo_batch batch;
+    struct bmm150_fifo_9axis out;
+    struct bmi160_dev bmi;
+    struct bmm150_dev mag;
+    uint32_t split = sc->ticks / 2 + 1;
+    uint32_t tick = 0;
+    size_t total = 0;
+    int failures = 0;
+
+    printf("9-axis FIFO, %s\n", sc->name);
+    memset(&bmi, 0, sizeof(bmi));
+    memset(&fifo, 0, sizeof(fifo));
+    fifo.fifo_header_enable = BMI160_FIFO_HEAD_ENABLE;
+    bmi.fifo = &fifo;
+    memset(&mag, 0, sizeof(mag));
+    mag.trim = trim_ref;
+    memset(&out, 0, sizeof(out));
+
+    /* Two FIFO reads, split away from any frame boundary of the sensors */
+    for (int part = 0; part < 2; part++)
+    {
+        memset(&batch, 0, sizeof(batch));
+        batch.data = data;
+        batch.length = build_fifo(sc, part ? split : 0, part ? sc->ticks : split, data);
+        batch.accel = accel;
+        batch.gyro = gyro;
+        batch.aux = aux;
+        batch.frames = frames;
+        batch.accel_len = 256;
+        batch.gyro_len = 256;
+        batch.aux_len = 256;
+        batch.frames_len = 256;
+        out.samples = samples;
+        out.len = 256;
+        if ((bmi160_fifo_batch_parse(&batch, &bmi) != BMI160_OK) || (bmm150_fifo_9axis(&out, &batch, &mag) != BMM150_OK))
+        {
+            printf("  parse failed\n");
+
+            return failures + 1;
+        }
+
+        for (size_t i = 0; i < out.len; i++)
+        {
+            while (!has(tick, sc->accel_every) && !has(tick, sc->gyro_every))
+            {
+                tick++;
+            }
+            if (check_sample(sc, &samples[i], tick, &mag))
+            {
+                if (failures++ < 3)
+                {
+                    printf("  sample %zu at tick %u misaligned\n", total + i, tick);
+                }
+            }
+            tick++;
+        }
+        total += out.len;
+    }
+    printf("  %zu samples from %zu mag frames in 2 reads\n", total, (size_t)((sc->ticks + sc->mag_every - 1) / sc->mag_every));
+
+    return failures;
+}
+
+int main(void)
+{
+    int failures = 0;
+
+    failures += run_bring_up();
+    failures += run_compensation();
+    for (size_t i = 0; i < sizeof(fifo_scenarios) / sizeof(fifo_scenarios[0]); i++)
+    {
+        failures += run_fifo(&fifo_scenarios[i]);
+    }
+
+    return (failures == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
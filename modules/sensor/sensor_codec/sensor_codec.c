@@ -0,0 +1,536 @@
+/*!
+ * @file    sensor_codec.c
+ * @brief   Lossless streaming codec for sensor samples
+ */
+
+#include <string.h>
+
+#include "sensor_codec.h"
+
+/*! No XOR window yet for a float channel */
+#define FLOAT_WINDOW_NONE    UINT8_C(0xFF)
+
+/****************************** Bit I/O ***************************************/
+
+static uint32_t zigzag(int32_t val)
+{
+    return ((uint32_t)val << 1) ^ (uint32_t)(val >> 31);
+}
+
+static int32_t unzigzag(uint32_t val)
+{
+    return (int32_t)((val >> 1) ^ (0U - (val & 1U)));
+}
+
+static uint8_t clz32(uint32_t val)
+{
+#if defined(__GNUC__)
+    return (val == 0) ? 32 : (uint8_t)__builtin_clz(val);
+#else
+    uint8_t n = 0;
+
+    if (val == 0)
+    {
+        return 32;
+    }
+    while ((val & 0x80000000UL) == 0)
+    {
+        val <<= 1;
+        n++;
+    }
+
+    return n;
+#endif
+}
+
+static uint8_t ctz32(uint32_t val)
+{
+#if defined(__GNUC__)
+    return (val == 0) ? 32 : (uint8_t)__builtin_ctz(val);
+#else
+    uint8_t n = 0;
+
+    if (val == 0)
+    {
+        return 32;
+    }
+    while ((val & 1U) == 0)
+    {
+        val >>= 1;
+        n++;
+    }
+
+    return n;
+#endif
+}
+
+static void state_reset(struct sensor_codec_state *state)
+{
+    memset(state, 0, sizeof(struct sensor_codec_state));
+    memset(state->lead, FLOAT_WINDOW_NONE, sizeof(state->lead));
+}
+
+/* MSB first, bits <= 32. Bytes past cap are dropped and flagged via pos */
+static void put_bits(struct sensor_codec_enc *enc, uint32_t val, uint8_t bits)
+{
+    if (bits == 0)
+    {
+        return;
+    }
+
+    if (bits < 32)
+    {
+        val &= (1UL << bits) - 1;
+    }
+    enc->acc = (enc->acc << bits) | val;
+    enc->acc_bits += bits;
+
+    while (enc->acc_bits >= 8)
+    {
+        enc->acc_bits -= 8;
+        if (enc->pos < enc->cap)
+        {
+            enc->buf[enc->pos] = (uint8_t)(enc->acc >> enc->acc_bits);
+        }
+        enc->pos++;
+    }
+}
+
+static int8_t get_bits(struct sensor_codec_dec *dec, uint8_t bits, uint32_t *val)
+{
+    if (bits == 0)
+    {
+        *val = 0;
+
+        return SENSOR_CODEC_OK;
+    }
+
+    while (dec->acc_bits < bits)
+    {
+        if (dec->pos >= dec->len)
+        {
+            return SENSOR_CODEC_E_CORRUPT;
+        }
+        dec->acc = (dec->acc << 8) | dec->buf[dec->pos++];
+        dec->acc_bits += 8;
+    }
+
+    dec->acc_bits -= bits;
+    *val = (uint32_t)(dec->acc >> dec->acc_bits);
+    if (bits < 32)
+    {
+        *val &= (1UL << bits) - 1;
+    }
+
+    return SENSOR_CODEC_OK;
+}
+
+/****************************** Channel coders ********************************/
+
+/*
+ * Timestamp: zigzag(delta - prev_delta) in buckets
+ *   0            '0'
+ *   < 2^7        '10'   + 7 bits
+ *   < 2^9        '110'  + 9 bits
+ *   < 2^12       '1110' + 12 bits
+ *   otherwise    '1111' + 32 bits
+ * Arithmetic is mod 2^32, so a wrapping sensor time only costs one long code.
+ */
+static void put_ts(struct sensor_codec_enc *enc, uint8_t ch, uint32_t ts)
+{
+    struct sensor_codec_state *state = &enc->state;
+    uint32_t delta = ts - state->prev[ch];
+    uint32_t dod = zigzag((int32_t)(delta - state->prev_delta[ch]));
+
+    if (dod == 0)
+    {
+        put_bits(enc, 0x0, 1);
+    }
+    else if (dod < (1UL << 7))
+    {
+        put_bits(enc, 0x2, 2);
+        put_bits(enc, dod, 7);
+    }
+    else if (dod < (1UL << 9))
+    {
+        put_bits(enc, 0x6, 3);
+        put_bits(enc, dod, 9);
+    }
+    else if (dod < (1UL << 12))
+    {
+        put_bits(enc, 0xE, 4);
+        put_bits(enc, dod, 12);
+    }
+    else
+    {
+        put_bits(enc, 0xF, 4);
+        put_bits(enc, dod, 32);
+    }
+
+    state->prev_delta[ch] = delta;
+    state->prev[ch] = ts;
+}
+
+static int8_t get_ts(struct sensor_codec_dec *dec, uint8_t ch, uint32_t *ts)
+{
+    static const uint8_t bucket_bits[] = { 7, 9, 12, 32 };
+    struct sensor_codec_state *state = &dec->state;
+    uint32_t bit = 1;
+    uint32_t dod = 0;
+    uint8_t prefix = 0;
+    int8_t rslt = SENSOR_CODEC_OK;
+
+    /* Count leading ones, at most four */
+    while ((prefix < 4) && (rslt == SENSOR_CODEC_OK))
+    {
+        rslt = get_bits(dec, 1, &bit);
+        if (bit == 0)
+        {
+            break;
+        }
+        prefix++;
+    }
+
+    if ((rslt == SENSOR_CODEC_OK) && (prefix != 0))
+    {
+        rslt = get_bits(dec, bucket_bits[prefix - 1], &dod);
+    }
+
+    if (rslt == SENSOR_CODEC_OK)
+    {
+        state->prev_delta[ch] += (uint32_t)unzigzag(dod);
+        state->prev[ch] += state->prev_delta[ch];
+        *ts = state->prev[ch];
+    }
+
+    return rslt;
+}
+
+/* Integer: zigzag(delta) as a varint, 7 bits per byte, MSB is continuation */
+static void put_int(struct sensor_codec_enc *enc, uint8_t ch, int32_t val)
+{
+    struct sensor_codec_state *state = &enc->state;
+    uint32_t z = zigzag((int32_t)((uint32_t)val - state->prev[ch]));
+
+    while (z >= 0x80)
+    {
+        put_bits(enc, (z & 0x7F) | 0x80, 8);
+        z >>= 7;
+    }
+    put_bits(enc, z, 8);
+
+    state->prev[ch] = (uint32_t)val;
+}
+
+static int8_t get_int(struct sensor_codec_dec *dec, uint8_t ch, int32_t *val)
+{
+    struct sensor_codec_state *state = &dec->state;
+    uint32_t z = 0;
+    uint32_t byte;
+    uint8_t shift = 0;
+    int8_t rslt;
+
+    do
+    {
+        rslt = get_bits(dec, 8, &byte);
+        if ((rslt != SENSOR_CODEC_OK) || (shift > 28))
+        {
+            return SENSOR_CODEC_E_CORRUPT;
+        }
+        z |= (byte & 0x7F) << shift;
+        shift += 7;
+    } while (byte & 0x80);
+
+    state->prev[ch] += (uint32_t)unzigzag(z);
+    *val = (int32_t)state->prev[ch];
+
+    return SENSOR_CODEC_OK;
+}
+
+/*
+ * Float: XOR with the previous bit pattern
+ *   equal                               '0'
+ *   fits the previous zero window       '10' + meaningful bits
+ *   otherwise                           '11' + 5 bit leading zeros
+ *                                       + 5 bit (length - 1) + meaningful bits
+ */
+static void put_float(struct sensor_codec_enc *enc, uint8_t ch, float val)
+{
+    struct sensor_codec_state *state = &enc->state;
+    uint32_t bits;
+    uint32_t x;
+    uint8_t lead;
+    uint8_t trail;
+    uint8_t len;
+
+    memcpy(&bits, &val, sizeof(bits));
+    x = bits ^ state->prev[ch];
+    state->prev[ch] = bits;
+
+    if (x == 0)
+    {
+        put_bits(enc, 0x0, 1);
+
+        return;
+    }
+
+    /* x != 0, so lead <= 31 and fits the 5 bit field */
+    lead = clz32(x);
+    trail = ctz32(x);
+
+    if ((state->lead[ch] != FLOAT_WINDOW_NONE) && (lead >= state->lead[ch]) && (trail >= state->trail[ch]))
+    {
+        put_bits(enc, 0x2, 2);
+        put_bits(enc, x >> state->trail[ch], 32 - state->lead[ch] - state->trail[ch]);
+
+        return;
+    }
+
+    len = 32 - lead - trail;
+    put_bits(enc, 0x3, 2);
+    put_bits(enc, lead, 5);
+    put_bits(enc, len - 1, 5);
+    put_bits(enc, x >> trail, len);
+    state->lead[ch] = lead;
+    state->trail[ch] = trail;
+}
+
+static int8_t get_float(struct sensor_codec_dec *dec, uint8_t ch, float *val)
+{
+    struct sensor_codec_state *state = &dec->state;
+    uint32_t ctrl;
+    uint32_t lead;
+    uint32_t len;
+    uint32_t x = 0;
+    int8_t rslt;
+
+    rslt = get_bits(dec, 1, &ctrl);
+    if ((rslt == SENSOR_CODEC_OK) && (ctrl != 0))
+    {
+        rslt = get_bits(dec, 1, &ctrl);
+        if ((rslt == SENSOR_CODEC_OK) && (ctrl == 0))
+        {
+            if (state->lead[ch] == FLOAT_WINDOW_NONE)
+            {
+                return SENSOR_CODEC_E_CORRUPT;
+            }
+            rslt = get_bits(dec, 32 - state->lead[ch] - state->trail[ch], &x);
+            x <<= state->trail[ch];
+        }
+        else if (rslt == SENSOR_CODEC_OK)
+        {
+            rslt = get_bits(dec, 5, &lead);
+            if (rslt == SENSOR_CODEC_OK)
+            {
+                rslt = get_bits(dec, 5, &len);
+            }
+            len++;
+            if ((rslt == SENSOR_CODEC_OK) && ((lead + len) > 32))
+            {
+                return SENSOR_CODEC_E_CORRUPT;
+            }
+            if (rslt == SENSOR_CODEC_OK)
+            {
+                rslt = get_bits(dec, (uint8_t)len, &x);
+                state->lead[ch] = (uint8_t)lead;
+                state->trail[ch] = (uint8_t)(32 - lead - len);
+                x <<= state->trail[ch];
+            }
+        }
+    }
+
+    if (rslt == SENSOR_CODEC_OK)
+    {
+        state->prev[ch] ^= x;
+        memcpy(val, &state->prev[ch], sizeof(*val));
+    }
+
+    return rslt;
+}
+
+static void encode_frame(struct sensor_codec_enc *enc, const union sensor_codec_value *frame)
+{
+    for (uint8_t ch = 0; ch < enc->layout->num_channels; ch++)
+    {
+        switch (enc->layout->type[ch])
+        {
+            case SENSOR_CODEC_TIMESTAMP:
+                put_ts(enc, ch, frame[ch].ts);
+                break;
+            case SENSOR_CODEC_INT:
+                put_int(enc, ch, frame[ch].i);
+                break;
+            default:
+                put_float(enc, ch, frame[ch].f);
+                break;
+        }
+    }
+}
+
+static int8_t decode_frame(struct sensor_codec_dec *dec, union sensor_codec_value *frame)
+{
+    int8_t rslt = SENSOR_CODEC_OK;
+
+    for (uint8_t ch = 0; (ch < dec->layout->num_channels) && (rslt == SENSOR_CODEC_OK); ch++)
+    {
+        switch (dec->layout->type[ch])
+        {
+            case SENSOR_CODEC_TIMESTAMP:
+                rslt = get_ts(dec, ch, &frame[ch].ts);
+                break;
+            case SENSOR_CODEC_INT:
+                rslt = get_int(dec, ch, &frame[ch].i);
+                break;
+            default:
+                rslt = get_float(dec, ch, &frame[ch].f);
+                break;
+        }
+    }
+
+    return rslt;
+}
+
+/****************************** User functions ********************************/
+
+int8_t sensor_codec_enc_init(struct sensor_codec_enc *enc,
+                             const struct sensor_codec_layout *layout,
+                             uint8_t *buf,
+                             uint32_t cap)
+{
+    if ((enc == NULL) || (layout == NULL) || (buf == NULL))
+    {
+        return SENSOR_CODEC_E_NULL_PTR;
+    }
+
+    if ((layout->num_channels == 0) || (layout->num_channels > SENSOR_CODEC_MAX_CHANNELS) ||
+        (cap <= SENSOR_CODEC_HEADER_SIZE))
+    {
+        return SENSOR_CODEC_E_INVALID_INPUT;
+    }
+
+    memset(enc, 0, sizeof(struct sensor_codec_enc));
+    state_reset(&enc->state);
+    enc->layout = layout;
+    enc->buf = buf;
+    enc->cap = cap;
+    enc->pos = SENSOR_CODEC_HEADER_SIZE;
+    enc->frame_max_bits = (uint32_t)layout->num_channels * SENSOR_CODEC_MAX_VALUE_BITS;
+
+    return SENSOR_CODEC_OK;
+}
+
+int8_t sensor_codec_enc_put(struct sensor_codec_enc *enc, const union sensor_codec_value *frame)
+{
+    struct sensor_codec_state saved_state;
+    uint32_t saved_pos;
+    uint64_t saved_acc;
+    uint8_t saved_acc_bits;
+    uint32_t room_bits;
+
+    if ((enc == NULL) || (frame == NULL))
+    {
+        return SENSOR_CODEC_E_NULL_PTR;
+    }
+
+    if (enc->num_frames == UINT16_MAX)
+    {
+        return SENSOR_CODEC_E_BUF_FULL;
+    }
+
+    room_bits = ((enc->cap - enc->pos) * 8) - enc->acc_bits;
+    if (room_bits >= enc->frame_max_bits)
+    {
+        encode_frame(enc, frame);
+        enc->num_frames++;
+
+        return SENSOR_CODEC_OK;
+    }
+
+    /* Near the end of the block: encode on trial, roll back if it spills */
+    saved_state = enc->state;
+    saved_pos = enc->pos;
+    saved_acc = enc->acc;
+    saved_acc_bits = enc->acc_bits;
+
+    encode_frame(enc, frame);
+    if ((enc->pos > enc->cap) || ((enc->pos == enc->cap) && (enc->acc_bits != 0)))
+    {
+        enc->state = saved_state;
+        enc->pos = saved_pos;
+        enc->acc = saved_acc;
+        enc->acc_bits = saved_acc_bits;
+
+        return SENSOR_CODEC_E_BUF_FULL;
+    }
+    enc->num_frames++;
+
+    return SENSOR_CODEC_OK;
+}
+
+uint32_t sensor_codec_enc_finish(struct sensor_codec_enc *enc)
+{
+    if (enc == NULL)
+    {
+        return 0;
+    }
+
+    if (enc->acc_bits != 0)
+    {
+        put_bits(enc, 0, 8 - enc->acc_bits);
+    }
+
+    enc->buf[0] = (uint8_t)(enc->num_frames & 0xFF);
+    enc->buf[1] = (uint8_t)(enc->num_frames >> 8);
+
+    return enc->pos;
+}
+
+int8_t sensor_codec_dec_init(struct sensor_codec_dec *dec,
+                             const struct sensor_codec_layout *layout,
+                             const uint8_t *buf,
+                             uint32_t len)
+{
+    if ((dec == NULL) || (layout == NULL) || (buf == NULL))
+    {
+        return SENSOR_CODEC_E_NULL_PTR;
+    }
+
+    if ((layout->num_channels == 0) || (layout->num_channels > SENSOR_CODEC_MAX_CHANNELS) ||
+        (len < SENSOR_CODEC_HEADER_SIZE))
+    {
+        return SENSOR_CODEC_E_INVALID_INPUT;
+    }
+
+    memset(dec, 0, sizeof(struct sensor_codec_dec));
+    state_reset(&dec->state);
+    dec->layout = layout;
+    dec->buf = buf;
+    dec->len = len;
+    dec->pos = SENSOR_CODEC_HEADER_SIZE;
+    dec->num_frames = (uint16_t)(buf[0] | ((uint16_t)buf[1] << 8));
+
+    return SENSOR_CODEC_OK;
+}
+
+int8_t sensor_codec_dec_get(struct sensor_codec_dec *dec, union sensor_codec_value *frame)
+{
+    int8_t rslt;
+
+    if ((dec == NULL) || (frame == NULL))
+    {
+        return SENSOR_CODEC_E_NULL_PTR;
+    }
+
+    if (dec->frame >= dec->num_frames)
+    {
+        return SENSOR_CODEC_E_END;
+    }
+
+    rslt = decode_frame(dec, frame);
+    if (rslt == SENSOR_CODEC_OK)
+    {
+        dec->frame++;
+    }
+
+    return rslt;
+}
@@ -0,0 +1,159 @@
+/*!
+ * @file    sensor_codec.h
+ * @brief   Lossless streaming codec for sensor samples
+ *
+ * Sits between the sensor drivers and the flash writer. A sample is a frame
+ * of up to SENSOR_CODEC_MAX_CHANNELS values, each channel coded against the
+ * previous frame:
+ *  - SENSOR_CODEC_TIMESTAMP : delta-of-delta, zigzag, prefix coded buckets
+ *  - SENSOR_CODEC_INT       : delta, zigzag, varint
+ *  - SENSOR_CODEC_FLOAT     : XOR with the previous value, leading/trailing
+ *                             zero window reuse
+ *
+ * Frames are packed into blocks, typically one flash page. Every block starts
+ * from a clean state so it decodes on its own and a bad page only loses
+ * itself.
+ */
+
+#ifndef SENSOR_CODEC_H_
+#define SENSOR_CODEC_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*! Return codes */
+#define SENSOR_CODEC_OK                 INT8_C(0)
+#define SENSOR_CODEC_E_NULL_PTR         INT8_C(-1)
+#define SENSOR_CODEC_E_INVALID_INPUT    INT8_C(-2)
+/*! Frame does not fit in the rest of the block, nothing was written */
+#define SENSOR_CODEC_E_BUF_FULL         INT8_C(-3)
+/*! All frames of the block have been decoded */
+#define SENSOR_CODEC_E_END              INT8_C(-4)
+#define SENSOR_CODEC_E_CORRUPT          INT8_C(-5)
+
+#define SENSOR_CODEC_MAX_CHANNELS       16U
+/*! Block header: little endian frame count */
+#define SENSOR_CODEC_HEADER_SIZE        2U
+/*! Worst case coded size of one channel value in bits */
+#define SENSOR_CODEC_MAX_VALUE_BITS     48U
+
+/*!
+ * @brief Channel types
+ */
+enum sensor_codec_type
+{
+    SENSOR_CODEC_TIMESTAMP = 0,
+    SENSOR_CODEC_INT,
+    SENSOR_CODEC_FLOAT
+};
+
+/*!
+ * @brief One channel value, member picked by the channel type
+ */
+union sensor_codec_value
+{
+    uint32_t ts;
+    int32_t i;
+    float f;
+};
+
+/*!
+ * @brief Channel types of a frame, shared by encoder and decoder
+ */
+struct sensor_codec_layout
+{
+    uint8_t num_channels;
+    uint8_t type[SENSOR_CODEC_MAX_CHANNELS];
+};
+
+/*!
+ * @brief Per channel prediction state
+ */
+struct sensor_codec_state
+{
+    uint32_t prev[SENSOR_CODEC_MAX_CHANNELS];
+    uint32_t prev_delta[SENSOR_CODEC_MAX_CHANNELS];
+    uint8_t lead[SENSOR_CODEC_MAX_CHANNELS];
+    uint8_t trail[SENSOR_CODEC_MAX_CHANNELS];
+};
+
+struct sensor_codec_enc
+{
+    const struct sensor_codec_layout *layout;
+    struct sensor_codec_state state;
+    uint8_t *buf;
+    uint32_t cap;
+    uint32_t pos;
+    uint64_t acc;
+    uint8_t acc_bits;
+    uint16_t num_frames;
+    uint32_t frame_max_bits;
+};
+
+struct sensor_codec_dec
+{
+    const struct sensor_codec_layout *layout;
+    struct sensor_codec_state state;
+    const uint8_t *buf;
+    uint32_t len;
+    uint32_t pos;
+    uint64_t acc;
+    uint8_t acc_bits;
+    uint16_t num_frames;
+    uint16_t frame;
+};
+
+/*!
+ * @brief Starts a new block in buf.
+ *
+ * @param[out] enc    : Encoder instance
+ * @param[in]  layout : Channel layout, must outlive the block
+ * @param[out] buf    : Block storage, e.g. a page buffer
+ * @param[in]  cap    : Size of buf in bytes
+ *
+ * @return Result of API execution status
+ */
+int8_t sensor_codec_enc_init(struct sensor_codec_enc *enc,
+                             const struct sensor_codec_layout *layout,
+                             uint8_t *buf,
+                             uint32_t cap);
+
+/*!
+ * @brief Appends one frame of layout->num_channels values.
+ *
+ * @return SENSOR_CODEC_OK, or SENSOR_CODEC_E_BUF_FULL when the block has no
+ * room left for a worst case frame. The frame is then not consumed and goes
+ * into the next block.
+ */
+int8_t sensor_codec_enc_put(struct sensor_codec_enc *enc, const union sensor_codec_value *frame);
+
+/*!
+ * @brief Pads the last byte, writes the header and returns the block size.
+ */
+uint32_t sensor_codec_enc_finish(struct sensor_codec_enc *enc);
+
+/*!
+ * @brief Opens a block written by sensor_codec_enc_finish().
+ */
+int8_t sensor_codec_dec_init(struct sensor_codec_dec *dec,
+                             const struct sensor_codec_layout *layout,
+                             const uint8_t *buf,
+                             uint32_t len);
+
+/*!
+ * @brief Decodes the next frame.
+ *
+ * @return SENSOR_CODEC_OK, SENSOR_CODEC_E_END after the last frame or
+ * SENSOR_CODEC_E_CORRUPT if the block ends early.
+ */
+int8_t sensor_codec_dec_get(struct sensor_codec_dec *dec, union sensor_codec_value *frame);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SENSOR_CODEC_H_ */
@@ -0,0 +1,650 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "nand_dump.h"
+#include "bmi160.h"
+#include "bme280.h"
+#include "bme680_defs.h"
+
+/* flash_commit tag in the ECC protected user spare bytes, see flash_commit.c */
+#define ND_SPARE_SECTOR_SIZE        16U
+#define ND_SPARE_USER_OFFSET        4U
+#define ND_SPARE_USER_PER_SECTOR    4U
+#define ND_SPARE_SECTORS            4U
+#define ND_COMMIT_TAG_SIZE          16U
+#define ND_COMMIT_MAGIC             0xC0A7U
+#define ND_COMMIT_FLAG_COMMIT       0x01U
+
+/* A FIFO read holds at most the 1 KB FIFO plus the sensor time frame */
+#define ND_BMI160_READ_MAX          (1024U + 1U + BMI160_SENSOR_TIME_LENGTH)
+#define ND_BMI160_MAX_FRAMES        \
+    ((ND_BMI160_READ_MAX / (1U + BMI160_FIFO_A_LENGTH)) + 1U)
+#define ND_BME680_RECORD            BME680_FIELD_LENGTH
+
+static const char* const format_names[ND_FMT_MAX] = {
+    [ND_FMT_PAGES] = "pages",
+    [ND_FMT_COMMIT] = "commit",
+    [ND_FMT_BMI160] = "bmi160",
+    [ND_FMT_BME280] = "bme280",
+    [ND_FMT_BME680] = "bme680",
+    [ND_FMT_CODEC] = "codec",
+};
+
+/* Column sets, codec columns are built from the layout */
+static const nd_column_t pages_cols[] = {
+    {"block", ND_COL_U32}, {"page", ND_COL_U32}, {"programmed", ND_COL_U32},
+    {"bad_marker", ND_COL_U32}, {"commit_tag", ND_COL_U32},
+};
+static const nd_column_t commit_cols[] = {
+    {"block", ND_COL_U32}, {"page", ND_COL_U32}, {"seq", ND_COL_U32},
+    {"index", ND_COL_U32}, {"len", ND_COL_U32}, {"commit", ND_COL_U32},
+    {"crc_ok", ND_COL_U32},
+};
+static const nd_column_t bmi160_cols[] = {
+    {"block", ND_COL_U32}, {"page", ND_COL_U32}, {"offset", ND_COL_U32},
+    {"frame", ND_COL_U32}, {"contents", ND_COL_U32},
+    {"skipped", ND_COL_U32}, {"sensor_time", ND_COL_U32},
+    {"time_valid", ND_COL_U32},
+    {"mag_x", ND_COL_I32}, {"mag_y", ND_COL_I32}, {"mag_z", ND_COL_I32},
+    {"rhall", ND_COL_I32},
+    {"gyr_x", ND_COL_I32}, {"gyr_y", ND_COL_I32}, {"gyr_z", ND_COL_I32},
+    {"acc_x", ND_COL_I32}, {"acc_y", ND_COL_I32}, {"acc_z", ND_COL_I32},
+};
+static const nd_column_t bme280_cols[] = {
+    {"block", ND_COL_U32}, {"page", ND_COL_U32}, {"offset", ND_COL_U32},
+    {"adc_t", ND_COL_U32}, {"adc_p", ND_COL_U32}, {"adc_h", ND_COL_U32},
+};
+static const nd_column_t bme680_cols[] = {
+    {"block", ND_COL_U32}, {"page", ND_COL_U32}, {"offset", ND_COL_U32},
+    {"status", ND_COL_U32}, {"gas_index", ND_COL_U32},
+    {"meas_index", ND_COL_U32}, {"adc_t", ND_COL_U32}, {"adc_p", ND_COL_U32},
+    {"adc_h", ND_COL_U32}, {"adc_gas", ND_COL_U32}, {"gas_range", ND_COL_U32},
+};
+
+static uint16_t get_le16(const uint8_t* p)
+{
+    return (uint16_t)(p[0] | ((uint16_t)p[1] << 8));
+}
+
+static uint32_t get_le32(const uint8_t* p)
+{
+    return get_le16(p) | ((uint32_t)get_le16(p + 2) << 16);
+}
+
+/* CRC-32 (IEEE, reflected), same as flash_commit */
+static uint32_t crc32_update(uint32_t crc, const uint8_t* data, uint32_t len)
+{
+    static const uint32_t table[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC,
+        0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+        0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C};
+
+    crc = ~crc;
+    for (uint32_t i = 0; i < len; i++)
+    {
+        crc = table[(crc ^ data[i]) & 0x0F] ^ (crc >> 4);
+        crc = table[(crc ^ (data[i] >> 4)) & 0x0F] ^ (crc >> 4);
+    }
+    return ~crc;
+}
+
+static const uint8_t* page_data(const nd_image_t* img, uint32_t page)
+{
+    return img->base + ((size_t)page * img->page_stride);
+}
+
+static bool all_ff(const uint8_t* p, uint32_t len)
+{
+    uint64_t word;
+    uint32_t i = 0;
+
+    for (; (i + sizeof(word)) <= len; i += sizeof(word))
+    {
+        memcpy(&word, &p[i], sizeof(word));
+        if (word != UINT64_MAX)
+        {
+            return false;
+        }
+    }
+    for (; i < len; i++)
+    {
+        if (p[i] != 0xFF)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Gathers the four 4 byte user runs of the spare area */
+static bool commit_tag(const nd_image_t* img, uint32_t page, uint8_t* raw)
+{
+    const uint8_t* spare = page_data(img, page) + img->page_size;
+
+    if (img->spare_size < ND_SPARE_SIZE)
+    {
+        return false;
+    }
+    for (uint8_t s = 0; s < ND_SPARE_SECTORS; s++)
+    {
+        memcpy(&raw[s * ND_SPARE_USER_PER_SECTOR],
+               &spare[(s * ND_SPARE_SECTOR_SIZE) + ND_SPARE_USER_OFFSET],
+               ND_SPARE_USER_PER_SECTOR);
+    }
+    return get_le16(raw) == ND_COMMIT_MAGIC;
+}
+
+/*
+ * Byte streams (FIFO dumps, raw sensor records) are laid out back to back
+ * over the page data areas of the region, the spare bytes are not part of
+ * them. Stream offset to image pointer, page and column.
+ */
+static const uint8_t* stream_ptr(const nd_image_t* img,
+                                 const nd_region_t* region, uint64_t pos,
+                                 uint32_t* page, uint32_t* col)
+{
+    uint32_t p = (uint32_t)(pos / img->page_size);
+
+    *col = (uint32_t)(pos % img->page_size);
+    *page = (region->first_block * img->pages_per_block) + p;
+    return page_data(img, *page) + *col;
+}
+
+static uint64_t stream_len(const nd_image_t* img, const nd_region_t* region)
+{
+    return (uint64_t)region->num_blocks * img->pages_per_block *
+           img->page_size;
+}
+
+static uint64_t block_stream_start(const nd_image_t* img, uint32_t block)
+{
+    return (uint64_t)block * img->pages_per_block * img->page_size;
+}
+
+/* Copies len stream bytes, records may straddle a page boundary */
+static void stream_copy(const nd_image_t* img, const nd_region_t* region,
+                        uint64_t pos, uint8_t* out, uint32_t len)
+{
+    const uint8_t* p;
+    uint32_t page;
+    uint32_t col;
+    uint32_t n;
+
+    while (len != 0)
+    {
+        p = stream_ptr(img, region, pos, &page, &col);
+        n = img->page_size - col;
+        n = (n < len) ? n : len;
+        memcpy(out, p, n);
+        out += n;
+        pos += n;
+        len -= n;
+    }
+}
+
+/*
+ * Header mode FIFO reads go through the driver's batch parser, one read per
+ * call. The dump does not keep read boundaries, a read ends where the
+ * parser stops: at its over-read or unknown header, or at a frame cut by
+ * the end of the chunk, which the next chunk starts with.
+ */
+static struct bmi160_fifo_frame bmi160_fifo = {
+    .fifo_header_enable = BMI160_FIFO_HEAD_ENABLE,
+};
+static const struct bmi160_dev bmi160_host = {
+    .fifo = &bmi160_fifo,
+};
+
+/*
+ * Walks the FIFO stream from pos up to end. Over-read bytes (0x80) and
+ * erased bytes (0xFF) are padding, anything else the parser takes no frame
+ * from is skipped a byte at a time. One row per data frame, a read without
+ * data frames still gets one row for its sensor time. Returns where the
+ * walk stopped, the start of the first read at or after end.
+ */
+static uint64_t bmi160_walk(const nd_image_t* img, const nd_region_t* region,
+                            uint64_t pos, uint64_t end, uint32_t block,
+                            nd_sink_t* sink)
+{
+    uint64_t limit = stream_len(img, region);
+    uint8_t buf[ND_BMI160_READ_MAX];
+    struct bmi160_sensor_data accel[ND_BMI160_MAX_FRAMES];
+    struct bmi160_sensor_data gyro[ND_BMI160_MAX_FRAMES];
+    struct bmi160_aux_data aux[ND_BMI160_MAX_FRAMES];
+    uint8_t frames[ND_BMI160_MAX_FRAMES];
+    struct bmi160_fifo_batch batch;
+    uint32_t vals[ND_MAX_COLUMNS];
+    size_t a;
+    size_t g;
+    size_t m;
+    const uint8_t* p;
+    uint32_t page;
+    uint32_t col;
+    uint32_t len;
+
+    while (pos < end)
+    {
+        p = stream_ptr(img, region, pos, &page, &col);
+        if ((*p == BMI160_FIFO_HEAD_OVER_READ) || (*p == 0xFF))
+        {
+            pos++;
+            continue;
+        }
+
+        len = ((limit - pos) < ND_BMI160_READ_MAX)
+              ? (uint32_t)(limit - pos) : ND_BMI160_READ_MAX;
+        if ((col + len) > img->page_size)
+        {
+            stream_copy(img, region, pos, buf, len);
+            p = buf;
+        }
+
+        memset(&batch, 0, sizeof(batch));
+        batch.data = p;
+        batch.length = len;
+        batch.accel = accel;
+        batch.accel_len = ND_BMI160_MAX_FRAMES;
+        batch.gyro = gyro;
+        batch.gyro_len = ND_BMI160_MAX_FRAMES;
+        batch.aux = aux;
+        batch.aux_len = ND_BMI160_MAX_FRAMES;
+        batch.frames = frames;
+        batch.frames_len = ND_BMI160_MAX_FRAMES;
+        if (bmi160_fifo_batch_parse(&batch, &bmi160_host) != BMI160_OK)
+        {
+            batch.frames_end = 0;
+        }
+
+        if (batch.frames_end == 0)
+        {
+            if (sink != NULL)
+            {
+                sink->bad_bytes++;
+            }
+            pos++;
+            continue;
+        }
+        if (sink == NULL)
+        {
+            pos += batch.frames_end;
+            continue;
+        }
+
+        memset(vals, 0, sizeof(vals));
+        vals[0] = block;
+        vals[1] = page;
+        vals[2] = col;
+        vals[5] = (batch.skipped_frames > UINT32_MAX)
+                  ? UINT32_MAX : (uint32_t)batch.skipped_frames;
+        vals[6] = batch.sensor_time;
+        vals[7] = batch.sensor_time_valid;
+        if (batch.frames_len == 0)
+        {
+            nd_sink_row(sink, vals);
+        }
+        a = 0;
+        g = 0;
+        m = 0;
+        for (size_t f = 0; f < batch.frames_len; f++)
+        {
+            memset(&vals[8], 0, sizeof(vals[8]) * 10);
+            vals[3] = (uint32_t)f;
+            vals[4] = frames[f];
+            if (frames[f] & BMI160_FIFO_FRAME_M)
+            {
+                for (uint8_t i = 0; i < 4; i++)
+                {
+                    vals[8 + i] = (uint32_t)(int32_t)(int16_t)
+                                  get_le16(&aux[m].data[i * 2]);
+                }
+                m++;
+            }
+            if (frames[f] & BMI160_FIFO_FRAME_G)
+            {
+                vals[12] = (uint32_t)(int32_t)gyro[g].x;
+                vals[13] = (uint32_t)(int32_t)gyro[g].y;
+                vals[14] = (uint32_t)(int32_t)gyro[g].z;
+                g++;
+            }
+            if (frames[f] & BMI160_FIFO_FRAME_A)
+            {
+                vals[15] = (uint32_t)(int32_t)accel[a].x;
+                vals[16] = (uint32_t)(int32_t)accel[a].y;
+                vals[17] = (uint32_t)(int32_t)accel[a].z;
+                a++;
+            }
+            nd_sink_row(sink, vals);
+        }
+        pos += batch.frames_end;
+    }
+
+    return pos;
+}
+
+static void decode_pages(const nd_image_t* img, uint32_t block,
+                         nd_sink_t* sink)
+{
+    uint32_t first = block * img->pages_per_block;
+    uint8_t raw[ND_COMMIT_TAG_SIZE];
+    uint32_t vals[5];
+    const uint8_t* p;
+    bool bad;
+
+    /* Factory marker: first spare byte of the block's first page */
+    bad = (img->spare_size != 0) &&
+          (page_data(img, first)[img->page_size] != 0xFF);
+
+    for (uint32_t i = 0; i < img->pages_per_block; i++)
+    {
+        p = page_data(img, first + i);
+        vals[0] = block;
+        vals[1] = first + i;
+        vals[2] = !all_ff(p, img->page_size + img->spare_size);
+        vals[3] = bad;
+        vals[4] = commit_tag(img, first + i, raw);
+        nd_sink_row(sink, vals);
+    }
+}
+
+static void decode_commit(const nd_image_t* img, uint32_t block,
+                          nd_sink_t* sink)
+{
+    uint32_t first = block * img->pages_per_block;
+    uint8_t raw[ND_COMMIT_TAG_SIZE];
+    uint32_t vals[7];
+    uint32_t crc;
+    uint16_t len;
+
+    for (uint32_t i = 0; i < img->pages_per_block; i++)
+    {
+        if (!commit_tag(img, first + i, raw))
+        {
+            if (!all_ff(raw, sizeof(raw)))
+            {
+                sink->bad_pages++;
+            }
+            continue;
+        }
+
+        len = get_le16(&raw[10]);
+        crc = (len <= img->page_size)
+              ? crc32_update(crc32_update(0, page_data(img, first + i), len),
+                             raw, ND_COMMIT_TAG_SIZE - sizeof(uint32_t))
+              : ~get_le32(&raw[12]);
+        vals[0] = block;
+        vals[1] = first + i;
+        vals[2] = get_le32(&raw[4]);
+        vals[3] = get_le16(&raw[8]);
+        vals[4] = len;
+        vals[5] = (raw[2] & ND_COMMIT_FLAG_COMMIT) != 0;
+        vals[6] = (crc == get_le32(&raw[12]));
+        if (!vals[6])
+        {
+            sink->bad_pages++;
+        }
+        nd_sink_row(sink, vals);
+    }
+}
+
+/* Fixed size records packed back to back over the region */
+static void decode_records(const nd_image_t* img, const nd_region_t* region,
+                           uint32_t block, uint32_t rec_len, nd_sink_t* sink)
+{
+    uint32_t rel = block - region->first_block;
+    uint64_t start = block_stream_start(img, rel);
+    uint64_t end = block_stream_start(img, rel + 1);
+    uint64_t pos = ((start + rec_len - 1) / rec_len) * rec_len;
+    struct bme280_uncomp_data uncomp;
+    uint8_t rec[ND_BME680_RECORD];
+    uint32_t vals[ND_MAX_COLUMNS];
+    uint32_t page;
+    uint32_t col;
+
+    for (; (pos < end) && ((pos + rec_len) <= stream_len(img, region));
+         pos += rec_len)
+    {
+        stream_copy(img, region, pos, rec, rec_len);
+        if (all_ff(rec, rec_len))
+        {
+            continue;
+        }
+
+        stream_ptr(img, region, pos, &page, &col);
+        vals[0] = block;
+        vals[1] = page;
+        vals[2] = col;
+        if (region->format == ND_FMT_BME280)
+        {
+            bme280_parse_sensor_data(rec, &uncomp);
+            vals[3] = uncomp.temperature;
+            vals[4] = uncomp.pressure;
+            vals[5] = uncomp.humidity;
+        }
+        else
+        {
+            /* Field data registers as read by the bme680 driver */
+            vals[3] = rec[0] & (BME680_NEW_DATA_MSK | BME680_GASM_VALID_MSK |
+                                BME680_HEAT_STAB_MSK);
+            vals[3] |= rec[14] & (BME680_GASM_VALID_MSK |
+                                  BME680_HEAT_STAB_MSK);
+            vals[4] = rec[0] & BME680_GAS_INDEX_MSK;
+            vals[5] = rec[1];
+            vals[6] = ((uint32_t)rec[5] << 12) | ((uint32_t)rec[6] << 4) |
+                      (rec[7] >> 4);
+            vals[7] = ((uint32_t)rec[2] << 12) | ((uint32_t)rec[3] << 4) |
+                      (rec[4] >> 4);
+            vals[8] = ((uint32_t)rec[8] << 8) | rec[9];
+            vals[9] = ((uint32_t)rec[13] << 2) | (rec[14] >> 6);
+            vals[10] = rec[14] & BME680_GAS_RANGE_MSK;
+        }
+        nd_sink_row(sink, vals);
+    }
+}
+
+/* One sensor_codec block per page */
+static void decode_codec(const nd_image_t* img, const nd_region_t* region,
+                         uint32_t block, nd_sink_t* sink)
+{
+    uint32_t first = block * img->pages_per_block;
+    union sensor_codec_value frame[SENSOR_CODEC_MAX_CHANNELS];
+    struct sensor_codec_dec dec;
+    uint32_t vals[ND_MAX_COLUMNS];
+    const uint8_t* p;
+    int8_t rslt;
+
+    for (uint32_t i = 0; i < img->pages_per_block; i++)
+    {
+        p = page_data(img, first + i);
+        if ((p[0] == 0xFF) && (p[1] == 0xFF))
+        {
+            continue;
+        }
+
+        rslt = sensor_codec_dec_init(&dec, &region->layout, p,
+                                     img->page_size);
+        for (uint32_t f = 0; rslt == SENSOR_CODEC_OK; f++)
+        {
+            rslt = sensor_codec_dec_get(&dec, frame);
+            if (rslt != SENSOR_CODEC_OK)
+            {
+                break;
+            }
+            vals[0] = block;
+            vals[1] = first + i;
+            vals[2] = f;
+            for (uint8_t c = 0; c < region->layout.num_channels; c++)
+            {
+                memcpy(&vals[3 + c], &frame[c], sizeof(uint32_t));
+            }
+            nd_sink_row(sink, vals);
+        }
+        if (rslt != SENSOR_CODEC_E_END)
+        {
+            sink->bad_pages++;
+        }
+    }
+}
+
+const char* nd_format_name(uint8_t format)
+{
+    return (format < ND_FMT_MAX) ? format_names[format] : "?";
+}
+
+int nd_parse_format(const char* spec, nd_region_t* region)
+{
+    const char* layout;
+    uint8_t n = 0;
+
+    for (uint8_t f = 0; f < ND_FMT_MAX; f++)
+    {
+        if ((f != ND_FMT_CODEC) && (strcmp(spec, format_names[f]) == 0))
+        {
+            region->format = f;
+            return 0;
+        }
+    }
+
+    if (strncmp(spec, "codec:", 6) != 0)
+    {
+        return -1;
+    }
+
+    region->format = ND_FMT_CODEC;
+    for (layout = spec + 6; *layout != '\0'; layout++)
+    {
+        if (n == SENSOR_CODEC_MAX_CHANNELS)
+        {
+            return -1;
+        }
+        switch (*layout)
+        {
+            case 't':
+                region->layout.type[n++] = SENSOR_CODEC_TIMESTAMP;
+                break;
+            case 'i':
+                region->layout.type[n++] = SENSOR_CODEC_INT;
+                break;
+            case 'f':
+                region->layout.type[n++] = SENSOR_CODEC_FLOAT;
+                break;
+            default:
+                return -1;
+        }
+    }
+    region->layout.num_channels = n;
+    return (n != 0) ? 0 : -1;
+}
+
+static void set_columns(nd_region_t* region, const nd_column_t* cols,
+                        uint32_t num_cols)
+{
+    memcpy(region->cols, cols, num_cols * sizeof(cols[0]));
+    region->num_cols = num_cols;
+}
+
+int nd_region_prepare(const nd_image_t* img, nd_region_t* region)
+{
+    static const uint8_t codec_types[] = {
+        [SENSOR_CODEC_TIMESTAMP] = ND_COL_U32,
+        [SENSOR_CODEC_INT] = ND_COL_I32,
+        [SENSOR_CODEC_FLOAT] = ND_COL_F32,
+    };
+    uint64_t pos = 0;
+
+    if ((region->num_blocks == 0) ||
+        (region->first_block + region->num_blocks > img->num_blocks))
+    {
+        return -1;
+    }
+
+    switch (region->format)
+    {
+        case ND_FMT_PAGES:
+            set_columns(region, pages_cols, 5);
+            break;
+        case ND_FMT_COMMIT:
+            if (img->spare_size < ND_SPARE_SIZE)
+            {
+                return -1;
+            }
+            set_columns(region, commit_cols, 7);
+            break;
+        case ND_FMT_BMI160:
+            set_columns(region, bmi160_cols, 18);
+            region->block_start = malloc((region->num_blocks + 1) *
+                                         sizeof(uint64_t));
+            if (region->block_start == NULL)
+            {
+                return -1;
+            }
+            /* Frames straddle blocks, only a walk from the start finds them */
+            for (uint32_t b = 0; b < region->num_blocks; b++)
+            {
+                region->block_start[b] = pos;
+                pos = bmi160_walk(img, region, pos,
+                                  block_stream_start(img, b + 1), 0, NULL);
+            }
+            region->block_start[region->num_blocks] = pos;
+            break;
+        case ND_FMT_BME280:
+            set_columns(region, bme280_cols, 6);
+            break;
+        case ND_FMT_BME680:
+            set_columns(region, bme680_cols, 11);
+            break;
+        case ND_FMT_CODEC:
+            set_columns(region, pages_cols, 2);
+            region->cols[2] = (nd_column_t){"frame", ND_COL_U32};
+            for (uint8_t c = 0; c < region->layout.num_channels; c++)
+            {
+                snprintf(region->cols[3 + c].name,
+                         sizeof(region->cols[3 + c].name), "ch%u", c);
+                region->cols[3 + c].type =
+                    codec_types[region->layout.type[c]];
+            }
+            region->num_cols = 3 + region->layout.num_channels;
+            break;
+        default:
+            return -1;
+    }
+
+    return 0;
+}
+
+void nd_region_release(nd_region_t* region)
+{
+    free(region->block_start);
+    region->block_start = NULL;
+}
+
+void nd_decode_block(const nd_image_t* img, const nd_region_t* region,
+                     uint32_t block, nd_sink_t* sink)
+{
+    uint32_t rel = block - region->first_block;
+
+    switch (region->format)
+    {
+        case ND_FMT_PAGES:
+            decode_pages(img, block, sink);
+            break;
+        case ND_FMT_COMMIT:
+            decode_commit(img, block, sink);
+            break;
+        case ND_FMT_BMI160:
+            bmi160_walk(img, region, region->block_start[rel],
+                        block_stream_start(img, rel + 1), block, sink);
+            break;
+        case ND_FMT_BME280:
+            decode_records(img, region, block, BME280_P_T_H_DATA_LEN, sink);
+            break;
+        case ND_FMT_BME680:
+            decode_records(img, region, block, ND_BME680_RECORD, sink);
+            break;
+        case ND_FMT_CODEC:
+            decode_codec(img, region, block, sink);
+            break;
+        default:
+            break;
+    }
+}
@@ -0,0 +1,498 @@
+/*
+ * Host side analyzer for raw W25N01GV dumps (page data plus spare, as read
+ * with the page data read command or written by the host sim). The image is
+ * mapped read only, split into (region, block) work units and decoded on a
+ * thread pool. Units are written out strictly in order by the main thread,
+ * workers run at most a window of units ahead of it so memory stays bounded
+ * whatever the image size.
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "nand_dump.h"
+
+/* Units decoded ahead of the writer, per thread */
+#define UNITS_PER_THREAD    4U
+#define MAX_THREADS         64U
+
+typedef struct unit
+{
+    uint32_t region;
+    uint32_t block;
+} unit_t;
+
+typedef struct pool
+{
+    const nd_image_t* img;
+    nd_region_t* regions;
+    const unit_t* units;
+    uint32_t num_units;
+    bool csv;
+    /* Ring of window sinks, unit u decodes into sinks[u % window] */
+    nd_sink_t* sinks;
+    bool* done;
+    uint32_t window;
+    atomic_uint next;
+    uint32_t written;
+    pthread_mutex_t lock;
+    pthread_cond_t cond_done;
+    pthread_cond_t cond_space;
+} pool_t;
+
+static const char* const col_suffix[] = {
+    [ND_COL_I32] = "i32",
+    [ND_COL_U32] = "u32",
+    [ND_COL_F32] = "f32",
+};
+
+static double now_s(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + (ts.tv_nsec / 1e9);
+}
+
+static void usage(const char* prog)
+{
+    fprintf(stderr,
+            "usage: %s [-j threads] [-o prefix] [-f csv|bin] [-s spare_size] "
+            "image [region ...]\n"
+            "  region is first_block[:num_blocks]:format, the default is the "
+            "whole image as pages\n"
+            "  format is one of\n"
+            "    pages         one row per page: programmed, bad block marker, "
+            "commit tag\n"
+            "    commit        flash_commit tags with CRC check\n"
+            "    bmi160        BMI160 header mode FIFO reads, one row per data "
+            "frame\n"
+            "    bme280        BME280 8 B raw pressure/temperature/humidity "
+            "reads\n"
+            "    bme680        BME680 15 B raw field reads\n"
+            "    codec:<tif>   sensor_codec blocks, one per page, channel "
+            "types t(imestamp), i(nt), f(loat)\n"
+            "  -j  decode threads (default online CPUs)\n"
+            "  -o  output prefix (default the image path), files are "
+            "<prefix>.<region>.<format>.csv\n"
+            "  -f  csv, or bin for one raw little endian file per column\n"
+            "  -s  spare bytes per page, 64 or 0 (default from the image "
+            "size)\n",
+            prog);
+}
+
+/* first_block[:num_blocks]:format */
+static int parse_region(const char* spec, const nd_image_t* img,
+                        nd_region_t* region)
+{
+    char* end;
+
+    memset(region, 0, sizeof(*region));
+    region->first_block = strtoul(spec, &end, 0);
+    if ((end == spec) || (*end != ':'))
+    {
+        return -1;
+    }
+    spec = end + 1;
+
+    region->num_blocks = strtoul(spec, &end, 0);
+    if ((end != spec) && (*end == ':'))
+    {
+        spec = end + 1;
+    }
+    else
+    {
+        region->num_blocks = (region->first_block < img->num_blocks)
+                             ? (img->num_blocks - region->first_block) : 0;
+    }
+
+    return nd_parse_format(spec, region);
+}
+
+static int open_outputs(const char* prefix, uint32_t k, nd_region_t* region,
+                        bool csv)
+{
+    char path[4096];
+
+    if (csv)
+    {
+        snprintf(path, sizeof(path), "%s.%u.%s.csv", prefix, k,
+                 nd_format_name(region->format));
+        region->csv = fopen(path, "w");
+        if (region->csv == NULL)
+        {
+            perror(path);
+            return -1;
+        }
+        nd_sink_header(region->cols, region->num_cols, region->csv);
+        return 0;
+    }
+
+    for (uint32_t c = 0; c < region->num_cols; c++)
+    {
+        snprintf(path, sizeof(path), "%s.%u.%s.%s.%s", prefix, k,
+                 nd_format_name(region->format), region->cols[c].name,
+                 col_suffix[region->cols[c].type]);
+        region->bin[c] = fopen(path, "wb");
+        if (region->bin[c] == NULL)
+        {
+            perror(path);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static void close_outputs(nd_region_t* region)
+{
+    if (region->csv != NULL)
+    {
+        fclose(region->csv);
+    }
+    for (uint32_t c = 0; c < ND_MAX_COLUMNS; c++)
+    {
+        if (region->bin[c] != NULL)
+        {
+            fclose(region->bin[c]);
+        }
+    }
+}
+
+static void* worker(void* arg)
+{
+    pool_t* pool = arg;
+    const nd_region_t* region;
+    nd_sink_t* sink;
+    uint32_t u;
+
+    for (;;)
+    {
+        u = atomic_fetch_add(&pool->next, 1);
+        if (u >= pool->num_units)
+        {
+            break;
+        }
+
+        pthread_mutex_lock(&pool->lock);
+        while (u >= (pool->written + pool->window))
+        {
+            pthread_cond_wait(&pool->cond_space, &pool->lock);
+        }
+        pthread_mutex_unlock(&pool->lock);
+
+        region = &pool->regions[pool->units[u].region];
+        sink = &pool->sinks[u % pool->window];
+        if (sink->cols != region->cols)
+        {
+            /* Column arrays are sized for the region they were grown for */
+            nd_sink_free(sink);
+            nd_sink_init(sink, pool->csv, region->cols, region->num_cols);
+        }
+        nd_sink_reset(sink);
+        nd_decode_block(pool->img, region, pool->units[u].block, sink);
+
+        pthread_mutex_lock(&pool->lock);
+        pool->done[u % pool->window] = true;
+        pthread_cond_broadcast(&pool->cond_done);
+        pthread_mutex_unlock(&pool->lock);
+    }
+
+    return NULL;
+}
+
+static int write_sink(nd_region_t* region, const nd_sink_t* sink)
+{
+    region->rows += sink->rows;
+    region->bad_bytes += sink->bad_bytes;
+    region->bad_pages += sink->bad_pages;
+
+    if (region->csv != NULL)
+    {
+        return (fwrite(sink->text, 1, sink->len, region->csv) == sink->len)
+               ? 0 : -1;
+    }
+    for (uint32_t c = 0; c < region->num_cols; c++)
+    {
+        if (fwrite(sink->data[c], sizeof(uint32_t), sink->rows,
+                   region->bin[c]) != sink->rows)
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int run_pool(pool_t* pool, uint32_t threads)
+{
+    pthread_t tid[MAX_THREADS];
+    nd_sink_t* sink;
+    int status = 0;
+
+    for (uint32_t t = 0; t < threads; t++)
+    {
+        pthread_create(&tid[t], NULL, worker, pool);
+    }
+
+    for (uint32_t u = 0; u < pool->num_units; u++)
+    {
+        sink = &pool->sinks[u % pool->window];
+
+        pthread_mutex_lock(&pool->lock);
+        while (!pool->done[u % pool->window])
+        {
+            pthread_cond_wait(&pool->cond_done, &pool->lock);
+        }
+        pthread_mutex_unlock(&pool->lock);
+
+        if ((status == 0) &&
+            (write_sink(&pool->regions[pool->units[u].region], sink) != 0))
+        {
+            perror("nand_dump: write");
+            status = -1;
+        }
+
+        pthread_mutex_lock(&pool->lock);
+        pool->done[u % pool->window] = false;
+        pool->written++;
+        pthread_cond_broadcast(&pool->cond_space);
+        pthread_mutex_unlock(&pool->lock);
+    }
+
+    for (uint32_t t = 0; t < threads; t++)
+    {
+        pthread_join(tid[t], NULL);
+    }
+    return status;
+}
+
+static int map_image(const char* path, uint32_t spare_size, nd_image_t* img)
+{
+    uint64_t block_bytes;
+    struct stat st;
+    void* base;
+    int fd;
+
+    fd = open(path, O_RDONLY);
+    if ((fd < 0) || (fstat(fd, &st) != 0))
+    {
+        perror(path);
+        return -1;
+    }
+
+    memset(img, 0, sizeof(*img));
+    img->size = (size_t)st.st_size;
+    img->page_size = ND_PAGE_SIZE;
+    img->pages_per_block = ND_PAGES_PER_BLOCK;
+    if (spare_size == UINT32_MAX)
+    {
+        /* Dumps with spare are preferred when both sizes fit */
+        block_bytes = (uint64_t)(ND_PAGE_SIZE + ND_SPARE_SIZE) *
+                      ND_PAGES_PER_BLOCK;
+        spare_size = ((img->size % block_bytes) == 0) ? ND_SPARE_SIZE : 0;
+    }
+    img->spare_size = spare_size;
+    img->page_stride = img->page_size + spare_size;
+    block_bytes = (uint64_t)img->page_stride * img->pages_per_block;
+    img->num_blocks = (uint32_t)(img->size / block_bytes);
+
+    if ((img->num_blocks == 0) || ((img->size % block_bytes) != 0))
+    {
+        fprintf(stderr, "nand_dump: %s: %zu bytes is not a whole number of "
+                        "%llu byte blocks\n", path, img->size,
+                (unsigned long long)block_bytes);
+        close(fd);
+        return -1;
+    }
+
+    base = mmap(NULL, img->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+    {
+        perror("nand_dump: mmap");
+        return -1;
+    }
+    img->base = base;
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    static nd_region_t regions[ND_MAX_REGIONS];
+    uint32_t spare_size = UINT32_MAX;
+    uint32_t num_regions = 0;
+    uint32_t threads = 0;
+    const char* prefix = NULL;
+    const char* path;
+    bool csv = true;
+    nd_image_t img;
+    pool_t pool;
+    unit_t* units;
+    uint64_t bytes = 0;
+    double start;
+    double elapsed;
+    int status = EXIT_SUCCESS;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "j:o:f:s:h")) != -1)
+    {
+        switch (opt)
+        {
+            case 'j':
+                threads = strtoul(optarg, NULL, 0);
+                break;
+            case 'o':
+                prefix = optarg;
+                break;
+            case 'f':
+                if ((strcmp(optarg, "csv") != 0) && (strcmp(optarg, "bin") != 0))
+                {
+                    usage(argv[0]);
+                    return EXIT_FAILURE;
+                }
+                csv = (strcmp(optarg, "csv") == 0);
+                break;
+            case 's':
+                spare_size = strtoul(optarg, NULL, 0);
+                if ((spare_size != 0) && (spare_size != ND_SPARE_SIZE))
+                {
+                    usage(argv[0]);
+                    return EXIT_FAILURE;
+                }
+                break;
+            default:
+                usage(argv[0]);
+                return (opt == 'h') ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+    if (optind >= argc)
+    {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    path = argv[optind++];
+    prefix = (prefix != NULL) ? prefix : path;
+
+    if (threads == 0)
+    {
+        threads = (uint32_t)sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    threads = (threads < 1) ? 1 : ((threads > MAX_THREADS) ? MAX_THREADS
+                                                          : threads);
+
+    if (map_image(path, spare_size, &img) != 0)
+    {
+        return EXIT_FAILURE;
+    }
+
+    start = now_s();
+
+    for (; optind < argc; optind++)
+    {
+        if ((num_regions == ND_MAX_REGIONS) ||
+            (parse_region(argv[optind], &img, &regions[num_regions]) != 0))
+        {
+            fprintf(stderr, "nand_dump: bad region '%s'\n", argv[optind]);
+            return EXIT_FAILURE;
+        }
+        num_regions++;
+    }
+    if (num_regions == 0)
+    {
+        regions[0].format = ND_FMT_PAGES;
+        regions[0].num_blocks = img.num_blocks;
+        num_regions = 1;
+    }
+
+    pool.num_units = 0;
+    for (uint32_t k = 0; k < num_regions; k++)
+    {
+        if (nd_region_prepare(&img, &regions[k]) != 0)
+        {
+            fprintf(stderr, "nand_dump: region %u (%s, blocks %u+%u) does not "
+                            "fit this image\n", k,
+                    nd_format_name(regions[k].format), regions[k].first_block,
+                    regions[k].num_blocks);
+            return EXIT_FAILURE;
+        }
+        if (open_outputs(prefix, k, &regions[k], csv) != 0)
+        {
+            return EXIT_FAILURE;
+        }
+        pool.num_units += regions[k].num_blocks;
+        bytes += (uint64_t)regions[k].num_blocks * img.pages_per_block *
+                 img.page_stride;
+    }
+
+    units = malloc(pool.num_units * sizeof(units[0]));
+    pool.window = threads * UNITS_PER_THREAD;
+    pool.sinks = calloc(pool.window, sizeof(pool.sinks[0]));
+    pool.done = calloc(pool.window, sizeof(pool.done[0]));
+    if ((units == NULL) || (pool.sinks == NULL) || (pool.done == NULL))
+    {
+        perror("nand_dump: malloc");
+        return EXIT_FAILURE;
+    }
+
+    pool.num_units = 0;
+    for (uint32_t k = 0; k < num_regions; k++)
+    {
+        for (uint32_t b = 0; b < regions[k].num_blocks; b++)
+        {
+            units[pool.num_units].region = k;
+            units[pool.num_units].block = regions[k].first_block + b;
+            pool.num_units++;
+        }
+    }
+
+    pool.img = &img;
+    pool.regions = regions;
+    pool.units = units;
+    pool.csv = csv;
+    pool.written = 0;
+    atomic_init(&pool.next, 0);
+    pthread_mutex_init(&pool.lock, NULL);
+    pthread_cond_init(&pool.cond_done, NULL);
+    pthread_cond_init(&pool.cond_space, NULL);
+
+    if (run_pool(&pool, threads) != 0)
+    {
+        status = EXIT_FAILURE;
+    }
+    elapsed = now_s() - start;
+
+    for (uint32_t k = 0; k < num_regions; k++)
+    {
+        fprintf(stderr, "region %u: %-7s blocks %4u+%-4u rows %10llu "
+                        "bad bytes %llu bad pages %llu\n",
+                k, nd_format_name(regions[k].format), regions[k].first_block,
+                regions[k].num_blocks, (unsigned long long)regions[k].rows,
+                (unsigned long long)regions[k].bad_bytes,
+                (unsigned long long)regions[k].bad_pages);
+        close_outputs(&regions[k]);
+        nd_region_release(&regions[k]);
+    }
+    fprintf(stderr, "%s: %u blocks of %u B pages + %u B spare, %u threads, "
+                    "%.3f s, %.1f MB/s\n",
+            path, img.num_blocks, img.page_size, img.spare_size, threads,
+            elapsed, (bytes / 1e6) / ((elapsed > 0) ? elapsed : 1e-9));
+
+    for (uint32_t w = 0; w < pool.window; w++)
+    {
+        nd_sink_free(&pool.sinks[w]);
+    }
+    free(pool.sinks);
+    free(pool.done);
+    free(units);
+    munmap((void*)img.base, img.size);
+
+    return status;
+}
@@ -0,0 +1,106 @@
+#ifndef _NAND_DUMP_H_
+#define _NAND_DUMP_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "sensor_codec.h"
+
+/* W25N01GV geometry, the spare size is taken from the dump size */
+#define ND_PAGE_SIZE            2048U
+#define ND_SPARE_SIZE           64U
+#define ND_PAGES_PER_BLOCK      64U
+#define ND_MAX_COLUMNS          (SENSOR_CODEC_MAX_CHANNELS + 3U)
+#define ND_MAX_REGIONS          16U
+
+enum nd_format
+{
+    ND_FMT_PAGES = 0,
+    ND_FMT_COMMIT,
+    ND_FMT_BMI160,
+    ND_FMT_BME280,
+    ND_FMT_BME680,
+    ND_FMT_CODEC,
+    ND_FMT_MAX
+};
+
+enum nd_col_type
+{
+    ND_COL_I32 = 0,
+    ND_COL_U32,
+    ND_COL_F32
+};
+
+typedef struct nd_image
+{
+    const uint8_t* base;
+    size_t size;
+    uint32_t page_size;
+    uint32_t spare_size;
+    /* page_size + spare_size, distance between pages in the dump */
+    uint32_t page_stride;
+    uint32_t pages_per_block;
+    uint32_t num_blocks;
+} nd_image_t;
+
+typedef struct nd_column
+{
+    char name[12];
+    uint8_t type;
+} nd_column_t;
+
+/* Output of one block, rows as text or as one array per column */
+typedef struct nd_sink
+{
+    bool csv;
+    uint32_t num_cols;
+    const nd_column_t* cols;
+    char* text;
+    size_t len;
+    size_t cap;
+    uint32_t* data[ND_MAX_COLUMNS];
+    size_t rows;
+    size_t rows_cap;
+    /* Bytes that were neither a frame nor padding */
+    uint32_t bad_bytes;
+    uint32_t bad_pages;
+} nd_sink_t;
+
+typedef struct nd_region
+{
+    uint8_t format;
+    uint32_t first_block;
+    uint32_t num_blocks;
+    struct sensor_codec_layout layout;
+    nd_column_t cols[ND_MAX_COLUMNS];
+    uint32_t num_cols;
+    /* Byte streams: offset of the first record starting in each block */
+    uint64_t* block_start;
+    /* Totals, updated by the writer */
+    uint64_t rows;
+    uint64_t bad_bytes;
+    uint64_t bad_pages;
+    FILE* csv;
+    FILE* bin[ND_MAX_COLUMNS];
+} nd_region_t;
+
+const char* nd_format_name(uint8_t format);
+/* Parses "name" or "codec:<layout>", layout being one of t/i/f per channel */
+int nd_parse_format(const char* spec, nd_region_t* region);
+/* Column set, plus the sequential record sync for byte stream formats */
+int nd_region_prepare(const nd_image_t* img, nd_region_t* region);
+void nd_region_release(nd_region_t* region);
+void nd_decode_block(const nd_image_t* img, const nd_region_t* region,
+                     uint32_t block, nd_sink_t* sink);
+
+void nd_sink_init(nd_sink_t* sink, bool csv, const nd_column_t* cols,
+                  uint32_t num_cols);
+void nd_sink_reset(nd_sink_t* sink);
+void nd_sink_free(nd_sink_t* sink);
+/* One row, num_cols raw 32 bit values interpreted per column type */
+void nd_sink_row(nd_sink_t* sink, const uint32_t* vals);
+void nd_sink_header(const nd_column_t* cols, uint32_t num_cols, FILE* out);
+
+#endif
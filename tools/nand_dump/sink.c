@@ -0,0 +1,145 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "nand_dump.h"
+
+/* Longest formatted value: "-2147483648" or a %.9g float, plus separator */
+#define ND_MAX_FIELD    24U
+
+static void grow_text(nd_sink_t* sink, size_t need)
+{
+    size_t cap = (sink->cap != 0) ? sink->cap : 4096;
+
+    while (cap < need)
+    {
+        cap *= 2;
+    }
+    if (cap == sink->cap)
+    {
+        return;
+    }
+
+    sink->text = realloc(sink->text, cap);
+    if (sink->text == NULL)
+    {
+        perror("nand_dump: realloc");
+        exit(EXIT_FAILURE);
+    }
+    sink->cap = cap;
+}
+
+/* snprintf is the bottleneck on a full chip, integers are done by hand */
+static char* put_u32(char* p, uint32_t val)
+{
+    char tmp[10];
+    uint8_t n = 0;
+
+    do
+    {
+        tmp[n++] = (char)('0' + (val % 10));
+        val /= 10;
+    } while (val != 0);
+
+    while (n != 0)
+    {
+        *p++ = tmp[--n];
+    }
+    return p;
+}
+
+static char* put_field(char* p, uint8_t type, uint32_t raw)
+{
+    float f;
+
+    switch (type)
+    {
+        case ND_COL_I32:
+            if ((int32_t)raw < 0)
+            {
+                *p++ = '-';
+                raw = 0U - raw;
+            }
+            return put_u32(p, raw);
+        case ND_COL_U32:
+            return put_u32(p, raw);
+        default:
+            memcpy(&f, &raw, sizeof(f));
+            return p + snprintf(p, ND_MAX_FIELD, "%.9g", f);
+    }
+}
+
+void nd_sink_init(nd_sink_t* sink, bool csv, const nd_column_t* cols,
+                  uint32_t num_cols)
+{
+    memset(sink, 0, sizeof(*sink));
+    sink->csv = csv;
+    sink->cols = cols;
+    sink->num_cols = num_cols;
+}
+
+void nd_sink_reset(nd_sink_t* sink)
+{
+    sink->len = 0;
+    sink->rows = 0;
+    sink->bad_bytes = 0;
+    sink->bad_pages = 0;
+}
+
+void nd_sink_free(nd_sink_t* sink)
+{
+    free(sink->text);
+    for (uint32_t c = 0; c < ND_MAX_COLUMNS; c++)
+    {
+        free(sink->data[c]);
+    }
+    memset(sink, 0, sizeof(*sink));
+}
+
+void nd_sink_row(nd_sink_t* sink, const uint32_t* vals)
+{
+    size_t rows_cap;
+    char* p;
+
+    if (sink->csv)
+    {
+        grow_text(sink, sink->len + (sink->num_cols * ND_MAX_FIELD) + 1);
+        p = &sink->text[sink->len];
+        for (uint32_t c = 0; c < sink->num_cols; c++)
+        {
+            p = put_field(p, sink->cols[c].type, vals[c]);
+            *p++ = (c + 1 < sink->num_cols) ? ',' : '\n';
+        }
+        sink->len = (size_t)(p - sink->text);
+    }
+    else
+    {
+        if (sink->rows == sink->rows_cap)
+        {
+            rows_cap = (sink->rows_cap != 0) ? (sink->rows_cap * 2) : 1024;
+            for (uint32_t c = 0; c < sink->num_cols; c++)
+            {
+                sink->data[c] = realloc(sink->data[c],
+                                        rows_cap * sizeof(uint32_t));
+                if (sink->data[c] == NULL)
+                {
+                    perror("nand_dump: realloc");
+                    exit(EXIT_FAILURE);
+                }
+            }
+            sink->rows_cap = rows_cap;
+        }
+        for (uint32_t c = 0; c < sink->num_cols; c++)
+        {
+            sink->data[c][sink->rows] = vals[c];
+        }
+    }
+    sink->rows++;
+}
+
+void nd_sink_header(const nd_column_t* cols, uint32_t num_cols, FILE* out)
+{
+    for (uint32_t c = 0; c < num_cols; c++)
+    {
+        fprintf(out, "%s%c", cols[c].name, (c + 1 < num_cols) ? ',' : '\n');
+    }
+}